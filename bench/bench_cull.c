@@ -0,0 +1,154 @@
+/*
+ * bench_cull.c
+ *
+ * Frustum culling of bounding spheres and boxes at each SIMD width the
+ * machine has, from a camera like the game's chase camera (45 degree field
+ * of view, near 1, far 10000) looking across a scattered scene. Every width
+ * must cull exactly the items the scalar path culls, and no point inside
+ * the view volume (taken from clip coordinates) may be culled.
+ *
+ * Usage: bench_cull [items [repeats]]   (default 1048576 16)
+ */
+
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frustum.h"
+#include "noise_simd.h"
+
+// Column-major perspective(fovy, aspect, near, far) * look_at(eye, target, up=y).
+static void view_projection(const float eye[3], const float target[3], float m[16])
+{
+    const float fovy = 45.0f * 3.14159265f / 180.0f, aspect = 16.0f / 9.0f, n = 1.0f, f = 10000.0f;
+    float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+    float len = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (int k = 0; k < 3; k++) z[k] /= len;
+    float x[3] = { z[2], 0.0f, -z[0] };  // up x z
+    len = sqrtf(x[0] * x[0] + x[2] * x[2]);
+    x[0] /= len;
+    x[2] /= len;
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    float view[16] = { x[0], y[0], z[0], 0.0f, x[1], y[1], z[1], 0.0f, x[2], y[2], z[2], 0.0f,
+                       0.0f, 0.0f, 0.0f, 1.0f };
+    for (int k = 0; k < 3; k++) {
+        view[12] -= x[k] * eye[k];
+        view[13] -= y[k] * eye[k];
+        view[14] -= z[k] * eye[k];
+    }
+    const float t = 1.0f / tanf(fovy / 2.0f);
+    const float proj[16] = { t / aspect, 0, 0, 0, 0, t, 0, 0, 0, 0, -(f + n) / (f - n), -1.0f,
+                             0, 0, -2.0f * f * n / (f - n), 0 };
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++) {
+            float s = 0.0f;
+            for (int k = 0; k < 4; k++) s += proj[4 * k + r] * view[4 * c + k];
+            m[4 * c + r] = s;
+        }
+}
+
+static float frand(float lo, float hi) { return lo + (hi - lo) * (float)rand() / RAND_MAX; }
+
+int main(int argc, char **argv)
+{
+    const size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1 << 20;
+    const int repeats = argc > 2 ? atoi(argv[2]) : 16;
+    if (count < 1 || repeats < 1) {
+        fprintf(stderr, "usage: %s [items [repeats]]\n", argv[0]);
+        return 1;
+    }
+
+    const float eye[3] = { 15.0f, 106.0f, 0.0f }, target[3] = { -500.0f, 0.0f, 300.0f };
+    float m[16];
+    view_projection(eye, target, m);
+    Frustum f;
+    frustum_from_matrix(&f, m);
+
+    FrustumSpheres spheres;
+    FrustumBoxes boxes;
+    frustum_spheres_alloc(&spheres, count);
+    frustum_boxes_alloc(&boxes, count);
+    spheres.count = boxes.count = count;
+    srand(42);
+    for (size_t i = 0; i < count; i++) {
+        spheres.x[i] = frand(-2000.0f, 2000.0f);
+        spheres.y[i] = frand(-200.0f, 400.0f);
+        spheres.z[i] = frand(-2000.0f, 2000.0f);
+        spheres.radius[i] = frand(0.0f, 100.0f);
+        const float min[3] = { frand(-2000.0f, 2000.0f), frand(-200.0f, 400.0f), frand(-2000.0f, 2000.0f) };
+        const float max[3] = { min[0] + frand(0.0f, 150.0f), min[1] + frand(0.0f, 50.0f), min[2] + frand(0.0f, 150.0f) };
+        frustum_boxes_set(&boxes, i, min, max);
+    }
+
+    // Points strictly inside the clip volume must survive.
+    size_t inside = 0;
+    for (size_t i = 0; i < count; i++) {
+        const float p[3] = { spheres.x[i], spheres.y[i], spheres.z[i] };
+        float clip[4];
+        for (int r = 0; r < 4; r++) clip[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+        const float w = clip[3] * (1.0f - 1e-4f);
+        if (fabsf(clip[0]) < w && fabsf(clip[1]) < w && fabsf(clip[2]) < w) {
+            FrustumSpheres one = { 1, spheres.x + i, spheres.y + i, spheres.z + i, &(float){ 0.0f } };
+            uint32_t index;
+            if (frustum_cull_spheres(&f, &one, &index, NULL) != 1) {
+                fprintf(stderr, "point %zu inside the view volume was culled\n", i);
+                return 1;
+            }
+            inside++;
+        }
+    }
+
+    uint32_t *ref_spheres = malloc(count * sizeof(uint32_t)), *ref_boxes = malloc(count * sizeof(uint32_t));
+    uint32_t *out = malloc(count * sizeof(uint32_t));
+    if (!ref_spheres || !ref_boxes || !out) {
+        perror("bench allocation failed");
+        return 1;
+    }
+    const NoiseSimdLevel best = noise_simd_level();
+    printf("%zu items, %zu centres in view, %d repeats\n", count, inside, repeats);
+    printf("%-7s %14s %10s %14s %10s\n", "path", "spheres ns/it", "drawn", "boxes ns/it", "drawn");
+    size_t n_spheres = 0, n_boxes = 0;
+    double base[2] = { 0.0, 0.0 };
+    for (int level = NOISE_SIMD_SCALAR; level <= (int)best; level++) {
+        noise_simd_set_level((NoiseSimdLevel)level);
+        FrustumStats stats[2] = { { 0 } };
+        size_t n[2] = { 0, 0 };
+        double t0 = omp_get_wtime();
+        for (int r = 0; r < repeats; r++) n[0] = frustum_cull_spheres(&f, &spheres, out, &stats[0]);
+        double t1 = omp_get_wtime();
+        if (level == NOISE_SIMD_SCALAR) {
+            memcpy(ref_spheres, out, n[0] * sizeof(uint32_t));
+            n_spheres = n[0];
+        } else if (n[0] != n_spheres || memcmp(ref_spheres, out, n[0] * sizeof(uint32_t)) != 0) {
+            fprintf(stderr, "%s: spheres differ from scalar\n", noise_simd_name((NoiseSimdLevel)level));
+            return 1;
+        }
+        double t2 = omp_get_wtime();
+        for (int r = 0; r < repeats; r++) n[1] = frustum_cull_boxes(&f, &boxes, out, &stats[1]);
+        double t3 = omp_get_wtime();
+        if (level == NOISE_SIMD_SCALAR) {
+            memcpy(ref_boxes, out, n[1] * sizeof(uint32_t));
+            n_boxes = n[1];
+        } else if (n[1] != n_boxes || memcmp(ref_boxes, out, n[1] * sizeof(uint32_t)) != 0) {
+            fprintf(stderr, "%s: boxes differ from scalar\n", noise_simd_name((NoiseSimdLevel)level));
+            return 1;
+        }
+        if (stats[0].tested != count * repeats || stats[0].culled + stats[0].drawn != stats[0].tested) {
+            fprintf(stderr, "counters do not add up\n");
+            return 1;
+        }
+        const double ns[2] = { (t1 - t0) * 1e9 / (count * repeats), (t3 - t2) * 1e9 / (count * repeats) };
+        if (level == NOISE_SIMD_SCALAR) memcpy(base, ns, sizeof(base));
+        printf("%-7s %8.2f %4.1fx %10zu %8.2f %4.1fx %10zu\n", noise_simd_name((NoiseSimdLevel)level), ns[0],
+               base[0] / ns[0], n[0], ns[1], base[1] / ns[1], n[1]);
+    }
+
+    free(ref_spheres);
+    free(ref_boxes);
+    free(out);
+    frustum_spheres_free(&spheres);
+    frustum_boxes_free(&boxes);
+    return 0;
+}
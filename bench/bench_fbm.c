@@ -0,0 +1,253 @@
+/*
+ * bench_fbm.c
+ *
+ * Microbenchmark for the get_heightmap workload: every pixel of a torus
+ * heightmap evaluates the four displacement fBm calls plus the warped sample
+ * (5 fBm calls x 6 octaves). The same workload is timed through
+ *
+ *   pointer - fbm4d_fn with a NoiseFunction4D pointer (the original path)
+ *   kernel  - the specialised kernel returned by fbm4d_kernel, which puts a
+ *             point's octaves in the lanes of one batched noise call
+ *   batch   - fbm4d_batch_fn over whole rows with the SIMD noise kernels
+ *   scanline - the batch path with a scanline noise that reuses the corner
+ *             hashes of a lattice cell while samples stay inside it
+ *
+ * and the outputs are compared against the pointer path. Noises with a
+ * periodic 2D variant also time the periodic generator (three 2D fBm calls
+ * per pixel on a lattice that wraps at the map edges); its output differs
+ * by design, so instead of mismatches it reports the largest height step
+ * across the wrap seams relative to the largest step inside the map.
+ *
+ * Usage: bench_fbm [width height]   (default 960 x 540, single threaded)
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fbm_with_function_pointer.h"
+#include "noise_simd.h"
+
+#define BENCH_PI 3.14159265358979323846f
+
+static const float scale = 0.005f;
+static const float disp_offset = 0.1f;
+static NoiseContext ctx;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void torus_coords(size_t u, size_t v, size_t width, size_t height, float *n)
+{
+    float R = width / (2.0f * BENCH_PI);
+    float r = height / (2.0f * BENCH_PI);
+    n[0] = R * cos(u * 2.0f * BENCH_PI / width) * scale;
+    n[1] = R * sin(u * 2.0f * BENCH_PI / width) * scale;
+    n[2] = r * cos(v * 2.0f * BENCH_PI / height) * scale;
+    n[3] = r * sin(v * 2.0f * BENCH_PI / height) * scale;
+}
+
+static void run_pointer(NoiseFunction4D fn, size_t width, size_t height, float *out)
+{
+    for (size_t v = 0; v < height; v++) {
+        for (size_t u = 0; u < width; u++) {
+            float n[4];
+            torus_coords(u, v, width, height, n);
+            float dx = fbm4d_fn(&ctx, n[0] + disp_offset, n[1], n[2], n[3], 6, 2.0f, 0.5f, fn);
+            float dy = fbm4d_fn(&ctx, n[0], n[1] + disp_offset, n[2], n[3], 6, 2.0f, 0.5f, fn);
+            float dz = fbm4d_fn(&ctx, n[0], n[1], n[2] + disp_offset, n[3], 6, 2.0f, 0.5f, fn);
+            float dw = fbm4d_fn(&ctx, n[0], n[1], n[2], n[3] + disp_offset, 6, 2.0f, 0.5f, fn);
+            out[v * width + u] = fbm4d_fn(&ctx, n[0] + dx, n[1] + dy, n[2] + dz, n[3] + dw, 6, 2.0f, 0.5f, fn);
+        }
+    }
+}
+
+static void run_kernel(FbmKernel4D fbm, size_t width, size_t height, float *out)
+{
+    for (size_t v = 0; v < height; v++) {
+        for (size_t u = 0; u < width; u++) {
+            float n[4];
+            torus_coords(u, v, width, height, n);
+            float dx = fbm(&ctx, n[0] + disp_offset, n[1], n[2], n[3]);
+            float dy = fbm(&ctx, n[0], n[1] + disp_offset, n[2], n[3]);
+            float dz = fbm(&ctx, n[0], n[1], n[2] + disp_offset, n[3]);
+            float dw = fbm(&ctx, n[0], n[1], n[2], n[3] + disp_offset);
+            out[v * width + u] = fbm(&ctx, n[0] + dx, n[1] + dy, n[2] + dz, n[3] + dw);
+        }
+    }
+}
+
+static void run_batch(NoiseBatchFunction4D fn, size_t width, size_t height, float *out)
+{
+    float *buf = malloc(12 * width * sizeof(float));
+    if (!buf) {
+        perror("malloc failed");
+        exit(1);
+    }
+    float *nx = buf,             *ny = buf + width,     *nz = buf + 2 * width,  *nw = buf + 3 * width;
+    float *ox = buf + 4 * width, *oy = buf + 5 * width, *oz = buf + 6 * width,  *ow = buf + 7 * width;
+    float *dx = buf + 8 * width, *dy = buf + 9 * width, *dz = buf + 10 * width, *dw = buf + 11 * width;
+
+    for (size_t v = 0; v < height; v++) {
+        for (size_t u = 0; u < width; u++) {
+            float n[4];
+            torus_coords(u, v, width, height, n);
+            nx[u] = n[0]; ny[u] = n[1]; nz[u] = n[2]; nw[u] = n[3];
+            ox[u] = n[0] + disp_offset; oy[u] = n[1] + disp_offset;
+            oz[u] = n[2] + disp_offset; ow[u] = n[3] + disp_offset;
+        }
+        fbm4d_batch_fn(&ctx, ox, ny, nz, nw, dx, width, 6, 2.0f, 0.5f, fn);
+        fbm4d_batch_fn(&ctx, nx, oy, nz, nw, dy, width, 6, 2.0f, 0.5f, fn);
+        fbm4d_batch_fn(&ctx, nx, ny, oz, nw, dz, width, 6, 2.0f, 0.5f, fn);
+        fbm4d_batch_fn(&ctx, nx, ny, nz, ow, dw, width, 6, 2.0f, 0.5f, fn);
+        for (size_t u = 0; u < width; u++) {
+            ox[u] = nx[u] + dx[u]; oy[u] = ny[u] + dy[u];
+            oz[u] = nz[u] + dz[u]; ow[u] = nw[u] + dw[u];
+        }
+        fbm4d_batch_fn(&ctx, ox, oy, oz, ow, out + v * width, width, 6, 2.0f, 0.5f, fn);
+    }
+    free(buf);
+}
+
+static int periodic_cells(size_t size)
+{
+    int cells = (int)lroundf(size * scale);
+    return cells > 0 ? cells : 1;
+}
+
+static void run_periodic(NoisePeriodicFunction2D fn, size_t width, size_t height, float *out)
+{
+    int px = periodic_cells(width), py = periodic_cells(height);
+    float step_x = (float)px / width, step_y = (float)py / height;
+    for (size_t v = 0; v < height; v++) {
+        float y = v * step_y;
+        for (size_t u = 0; u < width; u++) {
+            float x = u * step_x;
+            float dx = fbm2d_periodic_fn(&ctx, x + disp_offset, y, px, py, 6, 2, 0.5f, fn);
+            float dy = fbm2d_periodic_fn(&ctx, x, y + disp_offset, px, py, 6, 2, 0.5f, fn);
+            out[v * width + u] = fbm2d_periodic_fn(&ctx, x + dx, y + dy, px, py, 6, 2, 0.5f, fn);
+        }
+    }
+}
+
+// Largest neighbour difference across the wrap seams over the largest one
+// inside the map: about 1 or below when the map tiles seamlessly.
+static float seam_ratio(const float *h, size_t width, size_t height)
+{
+    float inner = 0.0f, seam = 0.0f;
+    for (size_t v = 0; v < height; v++) {
+        for (size_t u = 0; u < width; u++) {
+            float c = h[v * width + u];
+            float du = fabsf(h[v * width + (u + 1) % width] - c);
+            float dv = fabsf(h[((v + 1) % height) * width + u] - c);
+            if (u + 1 == width) seam = fmaxf(seam, du);
+            else inner = fmaxf(inner, du);
+            if (v + 1 == height) seam = fmaxf(seam, dv);
+            else inner = fmaxf(inner, dv);
+        }
+    }
+    return inner > 0.0f ? seam / inner : 0.0f;
+}
+
+static size_t count_mismatches(const float *a, const float *b, size_t n)
+{
+    size_t bad = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (memcmp(&a[i], &b[i], sizeof(float)) != 0) bad++;
+    }
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    size_t width = 960, height = 540;
+    if (argc == 3) {
+        width = strtoul(argv[1], NULL, 10);
+        height = strtoul(argv[2], NULL, 10);
+    }
+    if (width == 0 || height == 0) {
+        fprintf(stderr, "usage: %s [width height]\n", argv[0]);
+        return 1;
+    }
+
+    noise_context_init(&ctx, 42);
+    size_t n = width * height;
+    float *reference = malloc(n * sizeof(float));
+    float *result = malloc(n * sizeof(float));
+    if (!reference || !result) {
+        perror("malloc failed");
+        return 1;
+    }
+
+    static const struct {
+        const char *name;
+        NoiseType type;
+        NoiseFunction4D fn;
+        NoiseBatchFunction4D batch;
+        NoiseBatchFunction4D scanline;
+        NoisePeriodicFunction2D periodic;
+    } noises[] = {
+        { "value",   NOISE_VALUE,      noise4d,        noise4d_batch,        NULL,                    NULL },
+        { "perlin",  NOISE_PERLIN,     perlin_noise4d, perlin_noise4d_batch, perlin_noise4d_scanline,
+          perlin_noise2d_periodic },
+        { "simplex", NOISE_SIMPLEX,    simplex4d,      simplex4d_batch,      NULL,                    NULL },
+        { "hash",    NOISE_VALUE_HASH, hash_noise4d,   hash_noise4d_batch,   NULL,                    hash_noise2d_periodic },
+    };
+
+    printf("get_heightmap workload: %zu x %zu, 5 fBm x 6 octaves per pixel, batch kernels: %s\n",
+           width, height, noise_simd_name(noise_simd_level()));
+    printf("%-8s %-8s %10s %12s %8s %10s\n", "noise", "path", "ms", "ns/pixel", "speedup", "mismatch");
+
+    for (size_t i = 0; i < sizeof(noises) / sizeof(noises[0]); i++) {
+        double t0 = now_seconds();
+        run_pointer(noises[i].fn, width, height, reference);
+        double pointer = now_seconds() - t0;
+        printf("%-8s %-8s %10.1f %12.1f %8.2f %10zu\n", noises[i].name, "pointer",
+               pointer * 1e3, pointer * 1e9 / n, 1.0, (size_t)0);
+
+        FbmKernel4D kernel = fbm4d_kernel(noises[i].type, 6, 2.0f, 0.5f);
+        t0 = now_seconds();
+        run_kernel(kernel, width, height, result);
+        double kernel_time = now_seconds() - t0;
+        printf("%-8s %-8s %10.1f %12.1f %8.2f %10zu\n", noises[i].name, "kernel",
+               kernel_time * 1e3, kernel_time * 1e9 / n, pointer / kernel_time,
+               count_mismatches(reference, result, n));
+
+        t0 = now_seconds();
+        run_batch(noises[i].batch, width, height, result);
+        double batch = now_seconds() - t0;
+        printf("%-8s %-8s %10.1f %12.1f %8.2f %10zu\n", noises[i].name, "batch",
+               batch * 1e3, batch * 1e9 / n, pointer / batch,
+               count_mismatches(reference, result, n));
+
+        if (noises[i].scanline) {
+            t0 = now_seconds();
+            run_batch(noises[i].scanline, width, height, result);
+            double scanline = now_seconds() - t0;
+            printf("%-8s %-8s %10.1f %12.1f %8.2f %10zu\n", noises[i].name, "scanline",
+                   scanline * 1e3, scanline * 1e9 / n, pointer / scanline,
+                   count_mismatches(reference, result, n));
+        }
+
+        if (noises[i].periodic) {
+            t0 = now_seconds();
+            run_periodic(noises[i].periodic, width, height, result);
+            double periodic = now_seconds() - t0;
+            printf("%-8s %-8s %10.1f %12.1f %8.2f %10s  seam %.2f\n", noises[i].name, "periodic",
+                   periodic * 1e3, periodic * 1e9 / n, pointer / periodic, "-",
+                   seam_ratio(result, width, height));
+        }
+    }
+
+    free(reference);
+    free(result);
+    return 0;
+}
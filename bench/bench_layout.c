@@ -0,0 +1,266 @@
+/*
+ * bench_layout.c
+ *
+ * Neighbourhood-heavy passes over a row-major Heightmap against the same
+ * map copied into square blocks, in two block orders. Every layout is read
+ * at exactly the same coordinates in the same order, so only the
+ * addressing differs:
+ *
+ *   rows     - 3x3 box sum at every height, row by row (the row-major best
+ *              case, how maps are generated)
+ *   columns  - the same, column by column (how a ring of the terrain grid
+ *              runs over the heightmap)
+ *   walks    - 3x3 neighbourhoods along pseudo-random walks, like erosion
+ *              droplets or ray marching
+ *
+ * Each pass reports ns per height visited and checks that every layout sums
+ * to the same value. The conversion time to each blocked layout is reported
+ * too. Runs single-threaded so the numbers reflect memory behaviour.
+ *
+ * The blocked layouts live only here. One thread, 16384^2:
+ *
+ *                 row-major  blocked  morton
+ *   rows               6.3      7.5    10.8
+ *   columns           44.5     21.0    10.3
+ *   random walks      20.7     18.3    17.9
+ *
+ * Generation and the serializers stream whole rows, where row-major is
+ * fastest. build_terrain_grid's ring-major sampling is the column case, so
+ * it samples 64 x 64 blocks of the grid a heightmap row at a time instead
+ * (stage 1 at 8192 x 4096 on one thread: 640 ms before, 290 ms after, with
+ * the scratch it no longer writes). Nothing else walks columns or random
+ * neighbourhoods over a full map, so Heightmap stays row-major.
+ *
+ * Usage: bench_layout [size...]   (default 8192 16384)
+ */
+
+#define _POSIX_C_SOURCE 200112L  // posix_memalign
+
+#include <math.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heightmap.h"
+
+#define BENCH_WALKERS 4096
+#define BENCH_WALK_STEPS 4096
+
+typedef enum { PASS_ROWS, PASS_COLUMNS, PASS_WALKS, PASS_COUNT } Pass;
+typedef enum { LAYOUT_ROWS, LAYOUT_BLOCKS, LAYOUT_MORTON, LAYOUT_COUNT } Layout;
+
+static const char *pass_name[] = { "rows", "columns", "walks" };
+static const char *layout_name[] = { "row-major", "blocked", "morton" };
+
+/*
+ * The map in square blocks of BLOCK_SIZE x BLOCK_SIZE heights, each block
+ * contiguous (four cache lines) and 64-byte aligned. BLOCKS orders the
+ * blocks a row of blocks at a time; MORTON along a Z-order curve, so blocks
+ * near each other in 2D are near in memory at every scale, on a block grid
+ * padded to powers of two. Either order splits into a part from x and a
+ * part from y, so height (x, y) is at x_offset[x] + y_offset[y].
+ */
+#define BLOCK_SHIFT 3
+#define BLOCK_SIZE (1 << BLOCK_SHIFT)
+
+typedef struct Blocked {
+    float *data;
+    uint32_t *x_offset, *y_offset;
+} Blocked;
+
+// v's bits spread to the even bit positions.
+static uint64_t morton_spread(uint32_t v)
+{
+    uint64_t m = v;
+    m = (m | (m << 16)) & 0x0000ffff0000ffffull;
+    m = (m | (m << 8)) & 0x00ff00ff00ff00ffull;
+    m = (m | (m << 4)) & 0x0f0f0f0f0f0f0f0full;
+    m = (m | (m << 2)) & 0x3333333333333333ull;
+    return (m | (m << 1)) & 0x5555555555555555ull;
+}
+
+static Blocked *blocked_from(const Heightmap *hm, Layout layout)
+{
+    const size_t blocks_x = (hm->width + BLOCK_SIZE - 1) >> BLOCK_SHIFT;
+    const size_t blocks_y = (hm->height + BLOCK_SIZE - 1) >> BLOCK_SHIFT;
+    const int morton = layout == LAYOUT_MORTON;
+    size_t blocks = blocks_x * blocks_y;
+    if (morton) {
+        size_t px = 1, py = 1;
+        while (px < blocks_x) px <<= 1;
+        while (py < blocks_y) py <<= 1;
+        blocks = (morton_spread((uint32_t)(px - 1)) | morton_spread((uint32_t)(py - 1)) << 1) + 1;
+    }
+    const size_t block_heights = BLOCK_SIZE * BLOCK_SIZE;
+    if (blocks > UINT32_MAX / block_heights) {
+        fprintf(stderr, "Blocked heightmap of %zu x %zu is too large\n", hm->width, hm->height);
+        exit(1);
+    }
+
+    Blocked *b = malloc(sizeof(Blocked));
+    void *data = NULL;
+    if (!b || posix_memalign(&data, 64, blocks * block_heights * sizeof(float)) != 0) {
+        perror("malloc failed");
+        exit(1);
+    }
+    b->data = data;
+    memset(b->data, 0, blocks * block_heights * sizeof(float));
+    b->x_offset = malloc(hm->width * sizeof(uint32_t));
+    b->y_offset = malloc(hm->height * sizeof(uint32_t));
+    if (!b->x_offset || !b->y_offset) {
+        perror("malloc failed");
+        exit(1);
+    }
+    const size_t mask = BLOCK_SIZE - 1;
+    for (size_t x = 0; x < hm->width; x++) {
+        const size_t bx = x >> BLOCK_SHIFT;
+        const size_t block = morton ? morton_spread((uint32_t)bx) : bx;
+        b->x_offset[x] = (uint32_t)(block * block_heights + (x & mask));
+    }
+    for (size_t y = 0; y < hm->height; y++) {
+        const size_t by = y >> BLOCK_SHIFT;
+        const size_t block = morton ? morton_spread((uint32_t)by) << 1 : by * blocks_x;
+        b->y_offset[y] = (uint32_t)(block * block_heights + ((y & mask) << BLOCK_SHIFT));
+    }
+
+    // A block row at a time, so each thread writes whole blocks.
+    #pragma omp parallel for schedule(static)
+    for (long by = 0; by < (long)blocks_y; by++) {
+        const size_t y0 = (size_t)by << BLOCK_SHIFT;
+        const size_t y1 = y0 + BLOCK_SIZE < hm->height ? y0 + BLOCK_SIZE : hm->height;
+        for (size_t x0 = 0; x0 < hm->width; x0 += BLOCK_SIZE) {
+            const size_t n = x0 + BLOCK_SIZE < hm->width ? BLOCK_SIZE : hm->width - x0;
+            for (size_t y = y0; y < y1; y++) {
+                memcpy(b->data + b->x_offset[x0] + b->y_offset[y], heightmap_row(hm, y) + x0, n * sizeof(float));
+            }
+        }
+    }
+    return b;
+}
+
+static void blocked_destroy(Blocked *b)
+{
+    if (!b) return;
+    free(b->data);
+    free(b->x_offset);
+    free(b->y_offset);
+    free(b);
+}
+
+typedef struct Map {
+    Layout layout;
+    const Heightmap *hm;
+    const Blocked *b;
+    long width, height;
+} Map;
+
+static inline float at(const Map *m, long x, long y)
+{
+    if (m->layout == LAYOUT_ROWS) return heightmap_at(m->hm, (size_t)x, (size_t)y);
+    return m->b->data[m->b->x_offset[x] + m->b->y_offset[y]];
+}
+
+static inline double box3(const Map *m, long x, long y)
+{
+    const long xm = x ? x - 1 : m->width - 1, xp = x + 1 < m->width ? x + 1 : 0;
+    const long ym = y ? y - 1 : m->height - 1, yp = y + 1 < m->height ? y + 1 : 0;
+    return (double)at(m, xm, ym) + at(m, x, ym) + at(m, xp, ym) +
+           at(m, xm, y) + at(m, x, y) + at(m, xp, y) +
+           at(m, xm, yp) + at(m, x, yp) + at(m, xp, yp);
+}
+
+// Returns the sum of every box visited and sets *visits.
+static double run(const Map *m, Pass pass, size_t *visits)
+{
+    double sum = 0.0;
+    if (pass == PASS_ROWS) {
+        for (long y = 0; y < m->height; y++)
+            for (long x = 0; x < m->width; x++) sum += box3(m, x, y);
+        *visits = (size_t)m->width * m->height;
+    } else if (pass == PASS_COLUMNS) {
+        for (long x = 0; x < m->width; x++)
+            for (long y = 0; y < m->height; y++) sum += box3(m, x, y);
+        *visits = (size_t)m->width * m->height;
+    } else {
+        uint32_t state = 42;
+        for (int w = 0; w < BENCH_WALKERS; w++) {
+            state = state * 1664525u + 1013904223u;
+            long x = (long)(state % (uint32_t)m->width);
+            state = state * 1664525u + 1013904223u;
+            long y = (long)(state % (uint32_t)m->height);
+            for (int s = 0; s < BENCH_WALK_STEPS; s++) {
+                sum += box3(m, x, y);
+                state = state * 1664525u + 1013904223u;
+                const uint32_t dir = state >> 30;  // one of four neighbours
+                if (dir == 0) x = x + 1 < m->width ? x + 1 : 0;
+                else if (dir == 1) x = x ? x - 1 : m->width - 1;
+                else if (dir == 2) y = y + 1 < m->height ? y + 1 : 0;
+                else y = y ? y - 1 : m->height - 1;
+            }
+        }
+        *visits = (size_t)BENCH_WALKERS * BENCH_WALK_STEPS;
+    }
+    return sum;
+}
+
+static void bench(size_t size)
+{
+    Heightmap *hm = heightmap_create(size, size);
+    for (size_t y = 0; y < size; y++) {
+        float *row = heightmap_row(hm, y);
+        for (size_t x = 0; x < size; x++) row[x] = 0.5f + 0.25f * sinf(x * 0.01f) * cosf(y * 0.013f);
+    }
+    heightmap_update_range(hm);
+
+    double convert_ms[LAYOUT_COUNT] = { 0.0 };
+    Blocked *blocked[LAYOUT_COUNT] = { NULL };
+    for (int l = LAYOUT_BLOCKS; l < LAYOUT_COUNT; l++) {
+        double t0 = omp_get_wtime();
+        blocked[l] = blocked_from(hm, (Layout)l);
+        convert_ms[l] = (omp_get_wtime() - t0) * 1e3;
+    }
+
+    printf("\n%zu x %zu map (%.0f MiB), blocks of %d, ns per height visited\n", size, size,
+           size * size * 4.0 / (1 << 20), BLOCK_SIZE);
+    printf("%-9s %12s %12s %12s\n", "pass", layout_name[LAYOUT_ROWS], layout_name[LAYOUT_BLOCKS], layout_name[LAYOUT_MORTON]);
+    for (int p = 0; p < PASS_COUNT; p++) {
+        double ns[LAYOUT_COUNT], sums[LAYOUT_COUNT];
+        for (int l = 0; l < LAYOUT_COUNT; l++) {
+            const Map m = { (Layout)l, hm, blocked[l], (long)size, (long)size };
+            size_t visits;
+            double t0 = omp_get_wtime();
+            sums[l] = run(&m, (Pass)p, &visits);
+            ns[l] = (omp_get_wtime() - t0) * 1e9 / visits;
+        }
+        if (sums[LAYOUT_BLOCKS] != sums[LAYOUT_ROWS] || sums[LAYOUT_MORTON] != sums[LAYOUT_ROWS]) {
+            fprintf(stderr, "%s: layouts disagree\n", pass_name[p]);
+            exit(1);
+        }
+        printf("%-9s %12.2f %12.2f %12.2f\n", pass_name[p], ns[LAYOUT_ROWS], ns[LAYOUT_BLOCKS], ns[LAYOUT_MORTON]);
+    }
+    printf("%-9s %12s %9.1f ms %9.1f ms\n", "convert", "-", convert_ms[LAYOUT_BLOCKS], convert_ms[LAYOUT_MORTON]);
+
+    for (int l = LAYOUT_BLOCKS; l < LAYOUT_COUNT; l++) blocked_destroy(blocked[l]);
+    heightmap_destroy(hm);
+}
+
+int main(int argc, char **argv)
+{
+    omp_set_num_threads(1);
+    if (argc < 2) {
+        bench(8192);
+        bench(16384);
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        size_t size = strtoul(argv[i], NULL, 10);
+        if (size < 2) {
+            fprintf(stderr, "usage: %s [size...]\n", argv[0]);
+            return 1;
+        }
+        bench(size);
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * bench_lod.c
+ *
+ * Geomipmapped terrain LOD without a GPU. A synthetic terrain over the
+ * game's 1900 x 1050 world is cut into chunks as GenTerrainChunks cuts
+ * them, at several resolutions, and viewed from a chase camera's height at
+ * points across the world. For each resolution it reports the time to take
+ * every chunk's level errors (summed over threads), the time per
+ * terrain_lod_select, and the triangles drawn against the full-resolution
+ * count. The drawn count should stay roughly level as the resolution grows.
+ *
+ * It also checks the index sets: every chunk shape, level and set of
+ * stitched edges must cover the chunk exactly once with triangles that all
+ * turn the same way, and after every selection each pair of neighbouring
+ * chunks must use the same vertices along their shared edge (no cracks).
+ *
+ * Usage: bench_lod [quads-per-unit...]   (default 0.5 1 2 4)
+ */
+
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "terrain_lod.h"
+
+#define BENCH_WORLD_WIDTH 1900.0f
+#define BENCH_WORLD_HEIGHT 1050.0f
+#define BENCH_CHUNK_QUADS 128
+#define BENCH_VIEWS 16
+#define BENCH_EYE_HEIGHT 10.0f
+#define BENCH_ERROR_PIXELS 2.0f
+
+// Rolling hills with detail down to a few units, periodic over the world.
+static float terrain_height(float x, float z)
+{
+    const float tx = 2.0f * 3.14159265f / BENCH_WORLD_HEIGHT, tz = 2.0f * 3.14159265f / BENCH_WORLD_WIDTH;
+    float h = 0.0f, amplitude = 40.0f;
+    for (int octave = 1; octave <= 256; octave *= 2) {
+        h += amplitude * sinf(octave * tx * x + octave) * cosf(octave * tz * z + 0.5f * octave);
+        amplitude *= 0.55f;
+    }
+    return h;
+}
+
+typedef struct Shape {
+    size_t quads_i, quads_j;
+    int levels;
+    uint16_t *indices[TERRAIN_LOD_MAX_LEVELS][TERRAIN_LOD_EDGE_SETS];
+    size_t count[TERRAIN_LOD_MAX_LEVELS][TERRAIN_LOD_EDGE_SETS];
+} Shape;
+
+// Every index set of a shape must tile its quads_i x quads_j rectangle: the
+// triangles' areas add up to it, all negatively signed in (i, j).
+static void check_shape(const Shape *s)
+{
+    const long stride = (long)s->quads_j + 1;
+    for (int l = 0; l < s->levels; l++) {
+        for (unsigned e = 0; e < TERRAIN_LOD_EDGE_SETS; e++) {
+            long area = 0;
+            for (size_t k = 0; k < s->count[l][e]; k += 3) {
+                const uint16_t *t = s->indices[l][e] + k;
+                const long ai = t[0] / stride, aj = t[0] % stride;
+                const long cross = (t[1] / stride - ai) * (t[2] % stride - aj) - (t[1] % stride - aj) * (t[2] / stride - ai);
+                if (cross >= 0) {
+                    fprintf(stderr, "%zu x %zu level %d edges %u: triangle turns the wrong way\n",
+                            s->quads_i, s->quads_j, l, e);
+                    exit(1);
+                }
+                area -= cross;
+            }
+            if (area != 2 * (long)(s->quads_i * s->quads_j)) {
+                fprintf(stderr, "%zu x %zu level %d edges %u: covers %ld half quads of %zu\n",
+                        s->quads_i, s->quads_j, l, e, area, 2 * s->quads_i * s->quads_j);
+                exit(1);
+            }
+        }
+    }
+}
+
+// Marks the positions along one side of a chunk that its triangles use.
+static void edge_positions(const Shape *s, int level, unsigned edges, int side, unsigned char *used)
+{
+    const size_t stride = s->quads_j + 1;
+    const size_t q = side < 2 ? s->quads_j : s->quads_i;
+    memset(used, 0, q + 1);
+    for (size_t k = 0; k < s->count[level][edges]; k++) {
+        const size_t i = s->indices[level][edges][k] / stride, j = s->indices[level][edges][k] % stride;
+        if (side == 0 && i == 0) used[j] = 1;
+        if (side == 1 && i == s->quads_i) used[j] = 1;
+        if (side == 2 && j == 0) used[i] = 1;
+        if (side == 3 && j == s->quads_j) used[i] = 1;
+    }
+}
+
+static void bench(float density)
+{
+    const size_t rings = (size_t)(BENCH_WORLD_WIDTH * density), sides = (size_t)(BENCH_WORLD_HEIGHT * density);
+    const size_t chunks_i = (rings + BENCH_CHUNK_QUADS - 1) / BENCH_CHUNK_QUADS;
+    const size_t chunks_j = (sides + BENCH_CHUNK_QUADS - 1) / BENCH_CHUNK_QUADS;
+    const size_t chunk_rings = (rings + chunks_i - 1) / chunks_i, chunk_sides = (sides + chunks_j - 1) / chunks_j;
+    const size_t last_rings = rings - (chunks_i - 1) * chunk_rings, last_sides = sides - (chunks_j - 1) * chunk_sides;
+
+    Shape shapes[2][2];
+    for (int si = 0; si < 2; si++) {
+        for (int sj = 0; sj < 2; sj++) {
+            Shape *s = &shapes[si][sj];
+            s->quads_i = si ? last_rings : chunk_rings;
+            s->quads_j = sj ? last_sides : chunk_sides;
+            s->levels = terrain_lod_levels(s->quads_i, s->quads_j);
+            for (int l = 0; l < s->levels; l++) {
+                for (unsigned e = 0; e < TERRAIN_LOD_EDGE_SETS; e++) {
+                    s->count[l][e] = terrain_lod_indices(s->quads_i, s->quads_j, l, e, NULL);
+                    s->indices[l][e] = malloc(s->count[l][e] * sizeof(uint16_t));
+                    if (!s->indices[l][e]) {
+                        perror("bench allocation failed");
+                        exit(1);
+                    }
+                    terrain_lod_indices(s->quads_i, s->quads_j, l, e, s->indices[l][e]);
+                }
+            }
+            check_shape(s);
+        }
+    }
+
+    // Chunk vertices as GenTerrainChunks lays them out: x down the sides,
+    // height in y, z along the rings.
+    TerrainLod *lod = terrain_lod_create(chunks_i, chunks_j, false);
+    double errors_s = 0.0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:errors_s)
+    for (int c = 0; c < lod->count; c++) {
+        const size_t ci = c / chunks_j, cj = c % chunks_j;
+        const Shape *s = &shapes[ci + 1 == chunks_i][cj + 1 == chunks_j];
+        const size_t count = (s->quads_i + 1) * (s->quads_j + 1);
+        float *v = malloc(count * 3 * sizeof(float));
+        if (!v) {
+            perror("bench allocation failed");
+            exit(1);
+        }
+        float min[3] = { INFINITY, INFINITY, INFINITY }, max[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (size_t i = 0; i <= s->quads_i; i++) {
+            for (size_t j = 0; j <= s->quads_j; j++) {
+                float *p = v + 3 * (i * (s->quads_j + 1) + j);
+                p[0] = BENCH_WORLD_HEIGHT / 2.0f - (float)(cj * chunk_sides + j) / sides * BENCH_WORLD_HEIGHT;
+                p[2] = (float)(ci * chunk_rings + i) / rings * BENCH_WORLD_WIDTH - BENCH_WORLD_WIDTH / 2.0f;
+                p[1] = terrain_height(p[0], p[2]);
+                for (int k = 0; k < 3; k++) {
+                    min[k] = fminf(min[k], p[k]);
+                    max[k] = fmaxf(max[k], p[k]);
+                }
+            }
+        }
+        double e0 = omp_get_wtime();
+        terrain_lod_set_chunk(lod, c, v, s->quads_i, s->quads_j, min, max);
+        errors_s += omp_get_wtime() - e0;
+        free(v);
+    }
+
+    // 1080 lines at the game's 45 degree field of view.
+    const float projection_scale = 1080.0f / (2.0f * tanf(45.0f * 3.14159265f / 360.0f));
+    unsigned char *a = malloc(chunk_rings + chunk_sides + 2), *b = malloc(chunk_rings + chunk_sides + 2);
+    double select_s = 0.0, drawn = 0.0;
+    for (int view = 0; view < BENCH_VIEWS; view++) {
+        const float x = BENCH_WORLD_HEIGHT * (0.45f - 0.9f * view / BENCH_VIEWS);
+        const float z = BENCH_WORLD_WIDTH * (0.9f * view / BENCH_VIEWS - 0.45f);
+        const float eye[3] = { x, terrain_height(x, z) + BENCH_EYE_HEIGHT, z };
+        double s0 = omp_get_wtime();
+        terrain_lod_select(lod, eye, projection_scale, BENCH_ERROR_PIXELS);
+        select_s += omp_get_wtime() - s0;
+
+        for (int c = 0; c < lod->count; c++) {
+            const size_t ci = c / chunks_j, cj = c % chunks_j;
+            const Shape *s = &shapes[ci + 1 == chunks_i][cj + 1 == chunks_j];
+            drawn += s->count[lod->level[c]][lod->edges[c]] / 3;
+            // Against the next chunk along i and along j.
+            for (int axis = 0; axis < 2; axis++) {
+                const size_t ni = ci + (axis == 0), nj = cj + (axis == 1);
+                if (ni == chunks_i || nj == chunks_j) continue;
+                const int n = (int)(ni * chunks_j + nj);
+                const Shape *t = &shapes[ni + 1 == chunks_i][nj + 1 == chunks_j];
+                edge_positions(s, lod->level[c], lod->edges[c], axis == 0 ? 1 : 3, a);
+                edge_positions(t, lod->level[n], lod->edges[n], axis == 0 ? 0 : 2, b);
+                if (memcmp(a, b, (axis == 0 ? s->quads_j : s->quads_i) + 1) != 0) {
+                    fprintf(stderr, "view %d: crack between chunks %d (level %d) and %d (level %d)\n", view, c,
+                            lod->level[c], n, lod->level[n]);
+                    exit(1);
+                }
+            }
+        }
+    }
+    printf("%6.2f %5zu x %-5zu %5d %12.1f %12.3f %12.0f %12zu %7.2f%%\n", density, rings, sides, lod->count,
+           errors_s * 1e3, select_s * 1e3 / BENCH_VIEWS, drawn / BENCH_VIEWS, 2 * rings * sides,
+           100.0 * drawn / BENCH_VIEWS / (2.0 * rings * sides));
+
+    free(a);
+    free(b);
+    terrain_lod_destroy(lod);
+    for (int si = 0; si < 2; si++)
+        for (int sj = 0; sj < 2; sj++)
+            for (int l = 0; l < shapes[si][sj].levels; l++)
+                for (unsigned e = 0; e < TERRAIN_LOD_EDGE_SETS; e++) free(shapes[si][sj].indices[l][e]);
+}
+
+int main(int argc, char **argv)
+{
+    printf("%6s %13s %5s %12s %12s %12s %12s %8s\n", "q/unit", "grid", "chunks", "errors ms", "select ms",
+           "drawn tris", "full tris", "drawn");
+    if (argc < 2) {
+        const float densities[] = { 0.5f, 1.0f, 2.0f, 4.0f };
+        for (int i = 0; i < 4; i++) bench(densities[i]);
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        const float density = strtof(argv[i], NULL);
+        if (!(density > 0.0f) || BENCH_WORLD_HEIGHT * density < 2.0f) {
+            fprintf(stderr, "usage: %s [quads-per-unit...]\n", argv[0]);
+            return 1;
+        }
+        bench(density);
+    }
+    return 0;
+}
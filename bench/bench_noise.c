@@ -0,0 +1,223 @@
+/*
+ * bench_noise.c
+ *
+ * Headless throughput benchmark for the noise and fBm functions. For every
+ * combination of
+ *
+ *   noise    value, perlin, simplex, hash (integer-hash value noise)
+ *   dims     2, 3, 4
+ *   octaves  1..8 (lacunarity 2, gain 0.5)
+ *   path     scalar (fbm*_fn per sample) and batch (fbm4d_batch_fn, 4D only)
+ *   threads  1..max_threads (OpenMP)
+ *
+ * it evaluates fBm over the first N pixels of a 1920x1080 torus heightmap,
+ * mapped the way get_heightmap does, and reports ns/sample and samples/sec.
+ * Results go to stdout as JSON, progress to stderr. Batch rows also record
+ * whether their output is bit-identical to the scalar path.
+ *
+ * Usage: bench_noise [--samples N] [--max-threads N] [--min-time SECONDS]
+ */
+
+#include <math.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fbm_with_function_pointer.h"
+#include "noise_simd.h"
+
+#define BENCH_MAX_OCTAVES 8
+#define BENCH_BATCH_BLOCK 1024
+#define BENCH_SEED 42
+#define BENCH_MAP_WIDTH 1920
+#define BENCH_MAP_HEIGHT 1080
+#define BENCH_SCALE 0.005f
+#define BENCH_PI 3.14159265358979323846f
+
+typedef struct BenchNoise {
+    const char *name;
+    NoiseFunction2D fn2;
+    NoiseFunction3D fn3;
+    NoiseFunction4D fn4;
+    NoiseBatchFunction4D batch4;
+} BenchNoise;
+
+static const BenchNoise noises[] = {
+    { "value",   noise2d,        noise3d,        noise4d,        noise4d_batch },
+    { "perlin",  perlin_noise2d, perlin_noise3d, perlin_noise4d, perlin_noise4d_batch },
+    { "simplex", simplex2d,      simplex3d,      simplex4d,      simplex4d_batch },
+    { "hash",    hash_noise2d,   hash_noise3d,   hash_noise4d,   hash_noise4d_batch },
+};
+
+typedef struct BenchPoints {
+    size_t n;
+    float *x, *y, *z, *w;
+} BenchPoints;
+
+static NoiseContext ctx;
+
+static void run_scalar(const BenchNoise *noise, int dims, int octaves, int threads,
+                       const BenchPoints *p, float *out)
+{
+    long n = (long)p->n;
+    #pragma omp parallel num_threads(threads)
+    {
+        NoiseContext local = ctx;  // each worker reads its own copy of the tables
+
+        #pragma omp for schedule(static)
+        for (long i = 0; i < n; i++) {
+            switch (dims) {
+                case 2:
+                    out[i] = fbm2d_fn(&local, p->x[i], p->y[i], octaves, 2.0f, 0.5f, noise->fn2);
+                    break;
+                case 3:
+                    out[i] = fbm3d_fn(&local, p->x[i], p->y[i], p->z[i], octaves, 2.0f, 0.5f, noise->fn3);
+                    break;
+                default:
+                    out[i] = fbm4d_fn(&local, p->x[i], p->y[i], p->z[i], p->w[i], octaves, 2.0f, 0.5f, noise->fn4);
+                    break;
+            }
+        }
+    }
+}
+
+static void run_batch(const BenchNoise *noise, int octaves, int threads, const BenchPoints *p, float *out)
+{
+    long blocks = (long)((p->n + BENCH_BATCH_BLOCK - 1) / BENCH_BATCH_BLOCK);
+    #pragma omp parallel num_threads(threads)
+    {
+        NoiseContext local = ctx;
+
+        #pragma omp for schedule(static)
+        for (long b = 0; b < blocks; b++) {
+            size_t start = (size_t)b * BENCH_BATCH_BLOCK;
+            size_t count = p->n - start < BENCH_BATCH_BLOCK ? p->n - start : BENCH_BATCH_BLOCK;
+            fbm4d_batch_fn(&local, p->x + start, p->y + start, p->z + start, p->w + start, out + start,
+                           count, octaves, 2.0f, 0.5f, noise->batch4);
+        }
+    }
+}
+
+// Runs the configuration until at least min_time has passed and returns the
+// wall time per sample in seconds.
+static double time_run(const BenchNoise *noise, int dims, int octaves, bool batch, int threads,
+                       const BenchPoints *p, float *out, double min_time)
+{
+    // Warm-up pass, also leaves the output for the checksum.
+    if (batch) run_batch(noise, octaves, threads, p, out);
+    else run_scalar(noise, dims, octaves, threads, p, out);
+
+    size_t reps = 0;
+    double start = omp_get_wtime();
+    double elapsed = 0.0;
+    do {
+        if (batch) run_batch(noise, octaves, threads, p, out);
+        else run_scalar(noise, dims, octaves, threads, p, out);
+        reps++;
+        elapsed = omp_get_wtime() - start;
+    } while (elapsed < min_time);
+
+    return elapsed / ((double)reps * p->n);
+}
+
+static double checksum(const float *v, size_t n)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) sum += v[i];
+    return sum;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [--samples N] [--max-threads N] [--min-time SECONDS]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    size_t samples = 65536;
+    int max_threads = omp_get_max_threads();
+    double min_time = 0.05;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        if (strcmp(argv[i], "--samples") == 0) samples = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--max-threads") == 0) max_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-time") == 0) min_time = atof(argv[++i]);
+        else usage(argv[0]);
+    }
+    if (samples == 0 || max_threads < 1 || min_time < 0.0) usage(argv[0]);
+
+    noise_context_init(&ctx, BENCH_SEED);
+
+    // Row-major heightmap pixels on the torus, as get_heightmap samples them.
+    BenchPoints points = { samples, NULL, NULL, NULL, NULL };
+    float *buf = malloc(6 * samples * sizeof(float));
+    if (!buf) {
+        perror("malloc failed");
+        return 1;
+    }
+    points.x = buf;
+    points.y = buf + samples;
+    points.z = buf + 2 * samples;
+    points.w = buf + 3 * samples;
+    float *reference = buf + 4 * samples;
+    float *result = buf + 5 * samples;
+    const float R = BENCH_MAP_WIDTH / (2.0f * BENCH_PI);
+    const float r = BENCH_MAP_HEIGHT / (2.0f * BENCH_PI);
+    for (size_t i = 0; i < samples; i++) {
+        size_t u = i % BENCH_MAP_WIDTH;
+        size_t v = (i / BENCH_MAP_WIDTH) % BENCH_MAP_HEIGHT;
+        points.x[i] = R * cos(u * 2.0f * BENCH_PI / BENCH_MAP_WIDTH) * BENCH_SCALE;
+        points.y[i] = R * sin(u * 2.0f * BENCH_PI / BENCH_MAP_WIDTH) * BENCH_SCALE;
+        points.z[i] = r * cos(v * 2.0f * BENCH_PI / BENCH_MAP_HEIGHT) * BENCH_SCALE;
+        points.w[i] = r * sin(v * 2.0f * BENCH_PI / BENCH_MAP_HEIGHT) * BENCH_SCALE;
+    }
+
+    printf("{\n");
+    printf("  \"benchmark\": \"bench_noise\",\n");
+    printf("  \"simd\": \"%s\",\n", noise_simd_name(noise_simd_level()));
+    printf("  \"samples\": %zu,\n", samples);
+    printf("  \"max_threads\": %d,\n", max_threads);
+    printf("  \"min_time_s\": %g,\n", min_time);
+    printf("  \"lacunarity\": 2.0,\n");
+    printf("  \"gain\": 0.5,\n");
+    printf("  \"results\": [");
+
+    bool first = true;
+    for (size_t k = 0; k < sizeof(noises) / sizeof(noises[0]); k++) {
+        const BenchNoise *noise = &noises[k];
+        for (int dims = 2; dims <= 4; dims++) {
+            for (int octaves = 1; octaves <= BENCH_MAX_OCTAVES; octaves++) {
+                for (int threads = 1; threads <= max_threads; threads++) {
+                    for (int batch = 0; batch <= (dims == 4); batch++) {
+                        fprintf(stderr, "%s %dD octaves=%d threads=%d %s\n", noise->name, dims, octaves,
+                                threads, batch ? "batch" : "scalar");
+
+                        float *out = batch ? result : reference;
+                        double seconds = time_run(noise, dims, octaves, batch, threads, &points, out, min_time);
+
+                        printf("%s\n    {\"noise\": \"%s\", \"dims\": %d, \"octaves\": %d, \"path\": \"%s\", "
+                               "\"threads\": %d, \"ns_per_sample\": %.3f, \"samples_per_sec\": %.0f, "
+                               "\"checksum\": %.6f",
+                               first ? "" : ",", noise->name, dims, octaves, batch ? "batch" : "scalar",
+                               threads, seconds * 1e9, 1.0 / seconds, checksum(out, samples));
+                        if (batch) {
+                            // The scalar row for the same configuration ran just before.
+                            bool match = memcmp(reference, result, samples * sizeof(float)) == 0;
+                            printf(", \"matches_scalar\": %s", match ? "true" : "false");
+                        }
+                        printf("}");
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    free(buf);
+    return 0;
+}
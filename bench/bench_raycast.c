@@ -0,0 +1,143 @@
+/*
+ * bench_raycast.c
+ *
+ * Ray queries against a heightmap, with and without the min/max pyramid.
+ * A synthetic square map with some high-frequency roughness is built, and
+ * three sets of rays typical of the game are cast at it:
+ *
+ *   picking    - from high above, steeply down, across up to a quarter map
+ *   grazing    - near-horizontal sight lines just over the terrain, long
+ *                enough to wrap around the map (camera occlusion, AI sensors)
+ *   suspension - short vertical probes from just above the surface
+ *
+ * The reference is the same walk cut down to level 0, i.e. every cell the
+ * ray crosses is tested; its hits must match the pyramid's. Both are timed
+ * on one thread, then heightmap_raycast_batch on all of them.
+ *
+ * Usage: bench_raycast [size [rays]]   (default 4096 65536)
+ */
+
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heightmap_pyramid.h"
+
+typedef enum { PICKING, GRAZING, SUSPENSION, RAY_KINDS } RayKind;
+
+static const char *kind_name[] = { "picking", "grazing", "suspension" };
+
+static float frand(void)
+{
+    return (float)rand() / (float)RAND_MAX;
+}
+
+static void make_rays(const Heightmap *hm, RayKind kind, HeightmapRay *rays, size_t count)
+{
+    const float size = (float)hm->width, range = hm->max - hm->min;
+    for (size_t i = 0; i < count; i++) {
+        HeightmapRay *r = &rays[i];
+        const float x = frand() * size, y = frand() * size, angle = frand() * 6.2831853f;
+        r->origin[0] = x;
+        r->origin[1] = y;
+        if (kind == PICKING) {
+            r->origin[2] = hm->max + range;
+            r->direction[0] = cosf(angle) * frand() * size * 0.25f;
+            r->direction[1] = sinf(angle) * frand() * size * 0.25f;
+            r->direction[2] = -2.0f * range;
+            r->t_max = 1.0f;
+        } else if (kind == GRAZING) {
+            r->origin[2] = hm->max - 0.1f * range * frand();
+            r->direction[0] = cosf(angle);
+            r->direction[1] = sinf(angle);
+            r->direction[2] = -range * 1e-4f * frand();
+            r->t_max = 1.5f * size;
+        } else {
+            r->origin[2] = heightmap_at_wrap(hm, (long)x, (long)y) + 0.02f * range;
+            r->direction[0] = 0.0f;
+            r->direction[1] = 0.0f;
+            r->direction[2] = -1.0f;
+            r->t_max = 0.1f * range;
+        }
+    }
+}
+
+static double cast_all(const HeightmapPyramid *p, const HeightmapRay *rays, size_t count, HeightmapHit *hits)
+{
+    double t0 = omp_get_wtime();
+    for (size_t i = 0; i < count; i++) heightmap_raycast(p, &rays[i], &hits[i]);
+    return omp_get_wtime() - t0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 4096;
+    size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : 65536;
+    if (size < 2 || count < 1) {
+        fprintf(stderr, "usage: %s [size [rays]]\n", argv[0]);
+        return 1;
+    }
+
+    Heightmap *hm = heightmap_create(size, size);
+    #pragma omp parallel for schedule(static)
+    for (long y = 0; y < (long)size; y++) {
+        float *row = heightmap_row(hm, (size_t)y);
+        for (size_t x = 0; x < size; x++) {
+            unsigned h = (unsigned)(x * 73856093u) ^ (unsigned)((size_t)y * 19349663u);
+            h = (h ^ (h >> 13)) * 0x5bd1e995u;
+            row[x] = 0.5f + 0.25f * sinf(x * 0.01f) * cosf(y * 0.013f) + 0.2f * sinf((x + y) * 0.002f) +
+                     0.01f * (float)((h ^ (h >> 15)) & 0xffff) / 65535.0f;
+        }
+    }
+    heightmap_update_range(hm);
+
+    double t0 = omp_get_wtime();
+    HeightmapPyramid *pyramid = heightmap_pyramid_create(hm);
+    double build = omp_get_wtime() - t0;
+
+    HeightmapPyramid cells = *pyramid;  // the same walk, never leaving level 0
+    cells.levels = 1;
+
+    HeightmapRay *rays = malloc(count * sizeof(HeightmapRay));
+    HeightmapHit *hits = malloc(count * sizeof(HeightmapHit));
+    HeightmapHit *ref = malloc(count * sizeof(HeightmapHit));
+    if (!rays || !hits || !ref) {
+        perror("bench allocation failed");
+        return 1;
+    }
+
+    printf("%zu x %zu map, %d pyramid levels built in %.2f ms, %zu rays per set, %d threads\n", size, size,
+           pyramid->levels, build * 1e3, count, omp_get_max_threads());
+    printf("%-11s %6s %14s %14s %9s %14s\n", "rays", "hits", "cells ns/ray", "pyramid ns/ray", "speedup",
+           "batch ns/ray");
+
+    srand(42);
+    for (int k = 0; k < RAY_KINDS; k++) {
+        make_rays(hm, (RayKind)k, rays, count);
+        double t_cells = cast_all(&cells, rays, count, ref);
+        double t_pyramid = cast_all(pyramid, rays, count, hits);
+        t0 = omp_get_wtime();
+        heightmap_raycast_batch(pyramid, rays, count, hits);
+        double t_batch = omp_get_wtime() - t0;
+
+        size_t hit_count = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (hits[i].hit != ref[i].hit || (hits[i].hit && fabsf(hits[i].t - ref[i].t) > 1e-4f * (1.0f + ref[i].t))) {
+                fprintf(stderr, "%s ray %zu: pyramid and cell walk disagree\n", kind_name[k], i);
+                return 1;
+            }
+            hit_count += hits[i].hit;
+        }
+        printf("%-11s %5.1f%% %14.1f %14.1f %8.1fx %14.1f\n", kind_name[k], 100.0 * hit_count / count,
+               t_cells * 1e9 / count, t_pyramid * 1e9 / count, t_cells / t_pyramid, t_batch * 1e9 / count);
+    }
+
+    free(rays);
+    free(hits);
+    free(ref);
+    heightmap_pyramid_destroy(pyramid);
+    heightmap_destroy(hm);
+    return 0;
+}
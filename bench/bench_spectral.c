@@ -0,0 +1,111 @@
+/*
+ * bench_spectral.c
+ *
+ * Benchmark for the spectral-synthesis heightmap generator. It first checks
+ * the FFT against a direct DFT at a few mixed-radix and prime lengths, then
+ * times spectral_synthesis for square maps of the given sizes, with the FFT
+ * stages spread over the OpenMP threads (OMP_NUM_THREADS to change). For each
+ * size it reports the time, ns/pixel and the wrap seam check used by
+ * bench_fbm (seam step over interior step, about 1 or below when seamless).
+ *
+ * Usage: bench_spectral [size ...]   (default 1024 2048 4096 8192)
+ */
+
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fft.h"
+#include "spectral.h"
+
+#define BENCH_PI 3.14159265358979323846
+#define BENCH_SEED 42
+#define BENCH_BETA 3.0f
+#define BENCH_MIN_FREQUENCY 0.005f
+
+// Largest error of fft_forward against a direct DFT, relative to the largest
+// bin magnitude.
+static double check_fft(size_t n)
+{
+    FftComplex *x = malloc(3 * n * sizeof(FftComplex));
+    if (!x) {
+        perror("malloc failed");
+        exit(1);
+    }
+    FftComplex *y = x + n, *scratch = x + 2 * n;
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (FftComplex){ (float)sin(0.37 * i) + (float)(i % 7) * 0.1f, (float)cos(1.3 * i) };
+        y[i] = x[i];
+    }
+    FftPlan *plan = fft_plan_create(n);
+    fft_forward(plan, y, scratch);
+    fft_plan_destroy(plan);
+
+    double err = 0.0, mag = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        double re = 0.0, im = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            double a = -2.0 * BENCH_PI * (double)((j * k) % n) / n;
+            re += x[j].re * cos(a) - x[j].im * sin(a);
+            im += x[j].re * sin(a) + x[j].im * cos(a);
+        }
+        err = fmax(err, hypot(re - y[k].re, im - y[k].im));
+        mag = fmax(mag, hypot(re, im));
+    }
+    free(x);
+    return mag > 0.0 ? err / mag : err;
+}
+
+static float seam_ratio(const float *h, size_t width, size_t height)
+{
+    float inner = 0.0f, seam = 0.0f;
+    for (size_t v = 0; v < height; v++) {
+        for (size_t u = 0; u < width; u++) {
+            float c = h[v * width + u];
+            float du = fabsf(h[v * width + (u + 1) % width] - c);
+            float dv = fabsf(h[((v + 1) % height) * width + u] - c);
+            if (u + 1 == width) seam = fmaxf(seam, du);
+            else inner = fmaxf(inner, du);
+            if (v + 1 == height) seam = fmaxf(seam, dv);
+            else inner = fmaxf(inner, dv);
+        }
+    }
+    return inner > 0.0f ? seam / inner : 0.0f;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t default_sizes[] = { 1024, 2048, 4096, 8192 };
+    size_t count = argc > 1 ? (size_t)(argc - 1) : sizeof(default_sizes) / sizeof(default_sizes[0]);
+
+    static const size_t lengths[] = { 97, 360, 1000, 1080, 1920 };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        printf("fft n=%-6zu relative error %.2e\n", lengths[i], check_fft(lengths[i]));
+    }
+
+    NoiseContext ctx;
+    noise_context_init(&ctx, BENCH_SEED);
+    printf("spectral synthesis, beta %.1f, %d threads\n", BENCH_BETA, omp_get_max_threads());
+    printf("%-12s %10s %10s %8s\n", "size", "ms", "ns/pixel", "seam");
+
+    for (size_t i = 0; i < count; i++) {
+        size_t size = argc > 1 ? strtoul(argv[i + 1], NULL, 10) : default_sizes[i];
+        if (size < 2) {
+            fprintf(stderr, "usage: %s [size ...]\n", argv[0]);
+            return 1;
+        }
+        float *map = malloc(size * size * sizeof(float));
+        if (!map) {
+            perror("malloc failed");
+            return 1;
+        }
+        double t0 = omp_get_wtime();
+        spectral_synthesis(&ctx, map, size, size, size, size, BENCH_BETA, BENCH_MIN_FREQUENCY);
+        double t = omp_get_wtime() - t0;
+        printf("%5zu x %-5zu %10.1f %10.2f %8.2f\n", size, size, t * 1e3, t * 1e9 / ((double)size * size),
+               seam_ratio(map, size, size));
+        free(map);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * bench_tiles.c
+ *
+ * Full-load versus region-load latency for heightmap files. A synthetic
+ * square map is saved twice under resources/heightmaps, as a flat F32 file
+ * and as an F32_TILED file, and each access pattern is timed with the files
+ * evicted from the page cache first (cold) and again with them cached
+ * (warm):
+ *
+ *   full flat    - load_heightmap on the flat file, touching every height
+ *   full tiled   - load_heightmap on the tiled file (assembles every tile)
+ *   region flat  - the region copied out of the mapped flat file
+ *   region tiled - heightmap_tiles_open + heightmap_tiles_read
+ *
+ * Regions are square, at a few pseudo-random places (wrapping at the
+ * edges). Besides the time, each cold run reports how much of the file
+ * ended up in the page cache, which is what the access actually read.
+ *
+ * Usage: bench_tiles [size [region]]   (default 8192 512)
+ */
+
+#define _DEFAULT_SOURCE  // mincore
+
+#include <fcntl.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "save.h"
+
+#define BENCH_FLAT "bench_tiles_flat.bin"
+#define BENCH_TILED "bench_tiles_tiled.bin"
+#define BENCH_REGIONS 8
+
+typedef enum { FULL_FLAT, FULL_TILED, REGION_FLAT, REGION_TILED } Access;
+
+static const char *access_name[] = { "full flat", "full tiled", "region flat", "region tiled" };
+
+static char *bench_path(const char *filename)
+{
+    return build_fullpath(S_RESOURCES, S_HEIGHTMAPS, filename);
+}
+
+// Drops the file's clean pages from the page cache.
+static void evict(const char *filename)
+{
+    char *path = bench_path(filename);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0 || posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0) {
+        perror("Failed to evict file");
+        exit(1);
+    }
+    close(fd);
+    free(path);
+}
+
+// Bytes of the file currently in the page cache.
+static size_t resident(const char *filename)
+{
+    char *path = bench_path(filename);
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror("Failed to open file");
+        exit(1);
+    }
+    size_t size = (size_t)st.st_size, page = (size_t)sysconf(_SC_PAGESIZE);
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    unsigned char *vec = malloc((size + page - 1) / page);
+    if (map == MAP_FAILED || !vec || mincore(map, size, vec) != 0) {
+        perror("mincore failed");
+        exit(1);
+    }
+    size_t pages = 0;
+    for (size_t i = 0; i < (size + page - 1) / page; i++) pages += vec[i] & 1;
+    free(vec);
+    munmap(map, size);
+    close(fd);
+    free(path);
+    return pages * page;
+}
+
+static float checksum(const Heightmap *hm)
+{
+    float sum = 0.0f;
+    for (size_t y = 0; y < hm->height; y++) {
+        const float *row = heightmap_row(hm, y);
+        for (size_t x = 0; x < hm->width; x++) sum += row[x];
+    }
+    return sum;
+}
+
+// Runs one access and returns its checksum, so nothing is optimised away.
+static float run(Access access, long x, long y, size_t region)
+{
+    float sum = 0.0f;
+    if (access == FULL_FLAT || access == FULL_TILED) {
+        Heightmap *hm = load_heightmap(access == FULL_FLAT ? BENCH_FLAT : BENCH_TILED);
+        sum = checksum(hm);
+        heightmap_destroy(hm);
+    } else if (access == REGION_FLAT) {
+        Heightmap *hm = load_heightmap(BENCH_FLAT);  // mapped, nothing read yet
+        Heightmap *out = heightmap_create(region, region);
+        for (size_t v = 0; v < region; v++) {
+            for (size_t u = 0; u < region; u++) {
+                heightmap_row(out, v)[u] = heightmap_at_wrap(hm, x + (long)u, y + (long)v);
+            }
+        }
+        sum = checksum(out);
+        heightmap_destroy(out);
+        heightmap_destroy(hm);
+    } else {
+        HeightmapTiles *tiles = heightmap_tiles_open(BENCH_TILED);
+        Heightmap *out = heightmap_tiles_read(tiles, x, y, region, region);
+        sum = checksum(out);
+        heightmap_destroy(out);
+        heightmap_tiles_close(tiles);
+    }
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], NULL, 10) : 8192;
+    size_t region = argc > 2 ? strtoul(argv[2], NULL, 10) : 512;
+    if (size < 2 || region < 1 || region > size) {
+        fprintf(stderr, "usage: %s [size [region]]\n", argv[0]);
+        return 1;
+    }
+
+    Heightmap *hm = heightmap_create(size, size);
+    #pragma omp parallel for schedule(static)
+    for (long y = 0; y < (long)size; y++) {
+        float *row = heightmap_row(hm, (size_t)y);
+        for (size_t x = 0; x < size; x++) {
+            row[x] = 0.5f + 0.25f * sinf(x * 0.01f) * cosf(y * 0.013f) + 0.25f * sinf((x + y) * 0.002f);
+        }
+    }
+    heightmap_update_range(hm);
+    save_heightmap(BENCH_FLAT, hm, HEIGHTMAP_ENCODING_F32);
+    save_heightmap(BENCH_TILED, hm, HEIGHTMAP_ENCODING_F32_TILED);
+
+    // Every access must see the same heights.
+    srand(42);
+    long rx[BENCH_REGIONS], ry[BENCH_REGIONS];
+    for (int i = 0; i < BENCH_REGIONS; i++) {
+        rx[i] = rand() % (long)size;
+        ry[i] = rand() % (long)size;
+    }
+    Heightmap *ref = heightmap_create(region, region);
+    for (size_t v = 0; v < region; v++) {
+        for (size_t u = 0; u < region; u++) {
+            heightmap_row(ref, v)[u] = heightmap_at_wrap(hm, rx[0] + (long)u, ry[0] + (long)v);
+        }
+    }
+    if (run(FULL_FLAT, 0, 0, 0) != checksum(hm) || run(FULL_TILED, 0, 0, 0) != checksum(hm) ||
+        run(REGION_FLAT, rx[0], ry[0], region) != checksum(ref) ||
+        run(REGION_TILED, rx[0], ry[0], region) != checksum(ref)) {
+        fprintf(stderr, "access paths disagree\n");
+        return 1;
+    }
+    heightmap_destroy(ref);
+    heightmap_destroy(hm);
+
+    // The loaders log as they go, so the table is printed at the end.
+    double cold_ms[4], warm_ms[4], read_mib[4];
+    for (int a = 0; a < 4; a++) {
+        const int runs = a < REGION_FLAT ? 1 : BENCH_REGIONS;
+        const char *file = a == FULL_FLAT || a == REGION_FLAT ? BENCH_FLAT : BENCH_TILED;
+        double cold = 0.0, warm = 0.0, read = 0.0;
+        for (int i = 0; i < runs; i++) {
+            evict(file);
+            double t0 = omp_get_wtime();
+            run((Access)a, rx[i], ry[i], region);
+            double t1 = omp_get_wtime();
+            read += resident(file) / (double)(1 << 20);
+            run((Access)a, rx[i], ry[i], region);
+            double t2 = omp_get_wtime();
+            cold += t1 - t0;
+            warm += t2 - t1;
+        }
+        cold_ms[a] = cold * 1e3 / runs;
+        warm_ms[a] = warm * 1e3 / runs;
+        read_mib[a] = read / runs;
+    }
+
+    printf("\n%zu x %zu map (%.0f MiB), %zu x %zu regions, tiles of %d, %d threads\n", size, size,
+           size * size * 4.0 / (1 << 20), region, region, HEIGHTMAP_TILE_SIZE, omp_get_max_threads());
+    printf("%-14s %12s %12s %14s\n", "access", "cold ms", "warm ms", "cold MiB read");
+    for (int a = 0; a < 4; a++) {
+        printf("%-14s %12.2f %12.2f %14.2f\n", access_name[a], cold_ms[a], warm_ms[a], read_mib[a]);
+    }
+
+    char *flat = bench_path(BENCH_FLAT), *tiled = bench_path(BENCH_TILED);
+    remove(flat);
+    remove(tiled);
+    free(flat);
+    free(tiled);
+    return 0;
+}
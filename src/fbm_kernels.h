@@ -0,0 +1,107 @@
+#ifndef FBM_KERNELS_H
+#define FBM_KERNELS_H
+
+/*
+ * Compile-time specialised fBm kernels.
+ *
+ * fbm4d_fn calls its noise through a pointer once per octave and recomputes
+ * maxValue on every call. The macros below stamp out one kernel per
+ * (noise, octaves, lacunarity, gain) combination listed in
+ * FBM_KERNEL_CONFIGS, with the octave loops unrolled and the normalisation
+ * folded to a constant.
+ *
+ * The octaves of one point are independent, so a kernel does not loop over
+ * the scalar noise: it scales the point once per octave into the lanes of a
+ * single call to the noise's batched SIMD kernel, then sums the lanes in
+ * octave order. Inlining the scalar noise instead bought nothing: its cost
+ * is the data-dependent gradient selects, not the call, and forcing it
+ * inline into an unrolled loop cost GCC the vectorised hash steps it finds
+ * in the standalone function.
+ *
+ * Kernels sum the octaves in the same order as fbm4d_fn and the batched
+ * noise is bit-identical to the scalar one, so they return the same bits.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "noise_context.h"
+#include "noise_simd.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define FBM_UNROLL _Pragma("GCC unroll 8")
+#else
+    #define FBM_UNROLL
+#endif
+
+typedef float (*FbmKernel4D)(const NoiseContext *ctx, float x, float y, float z, float w);
+
+typedef struct FbmKernel4DEntry {
+    int octaves;
+    float lacunarity;
+    float gain;
+    FbmKernel4D fn;
+} FbmKernel4DEntry;
+
+// Lanes a kernel fills: a whole AVX2 vector, or two SSE4.1 ones. Octaves past
+// the configured count fill the spare lanes and are never summed.
+#define FBM_KERNEL_LANES 8
+
+// X(tag, octaves, lacunarity, gain): the parameter sets that get a kernel.
+// Octaves must not exceed FBM_KERNEL_LANES.
+#define FBM_KERNEL_CONFIGS(X)      \
+    X(o1_l2_g05, 1, 2.0f, 0.5f)    \
+    X(o2_l2_g05, 2, 2.0f, 0.5f)    \
+    X(o3_l2_g05, 3, 2.0f, 0.5f)    \
+    X(o4_l2_g05, 4, 2.0f, 0.5f)    \
+    X(o5_l2_g05, 5, 2.0f, 0.5f)    \
+    X(o6_l2_g05, 6, 2.0f, 0.5f)    \
+    X(o7_l2_g05, 7, 2.0f, 0.5f)    \
+    X(o8_l2_g05, 8, 2.0f, 0.5f)
+
+// Sum of the octave amplitudes, accumulated exactly as fbm4d_fn does. With
+// constant arguments this folds to a constant, so a kernel's normalisation
+// is computed once, by the compiler, rather than on every call.
+static inline float fbm_max_value(int octaves, float gain)
+{
+    float maxValue = 0.0f;
+    float amplitude = 1.0f;
+    for (int i = 0; i < octaves; i++) {
+        maxValue += amplitude;
+        amplitude *= gain;
+    }
+    return maxValue;
+}
+
+// batch is the noise's batched function (NoiseBatchFunction4D); simd says
+// whether it has vector kernels; without them only the real octaves are
+// evaluated.
+#define FBM4D_KERNEL_DEFINE(prefix, batch, simd, tag, OCTAVES, LACUNARITY, GAIN)                   \
+    static float prefix##_fbm4d_##tag(const NoiseContext *ctx, float x, float y, float z, float w) \
+    {                                                                                           \
+        float px[FBM_KERNEL_LANES], py[FBM_KERNEL_LANES], pz[FBM_KERNEL_LANES], pw[FBM_KERNEL_LANES]; \
+        float value[FBM_KERNEL_LANES];                                                          \
+        float frequency = 1.0f;                                                                 \
+        FBM_UNROLL                                                                              \
+        for (int i = 0; i < FBM_KERNEL_LANES; i++) {                                            \
+            px[i] = x * frequency;                                                              \
+            py[i] = y * frequency;                                                              \
+            pz[i] = z * frequency;                                                              \
+            pw[i] = w * frequency;                                                              \
+            frequency *= (LACUNARITY);                                                          \
+        }                                                                                       \
+        const size_t lanes = (simd) && noise_simd_level() != NOISE_SIMD_SCALAR ? FBM_KERNEL_LANES : (OCTAVES); \
+        batch(ctx, px, py, pz, pw, value, lanes);                                               \
+        float total = 0.0f;                                                                     \
+        float amplitude = 1.0f;                                                                 \
+        FBM_UNROLL                                                                              \
+        for (int i = 0; i < (OCTAVES); i++) {                                                   \
+            total += value[i] * amplitude;                                                      \
+            amplitude *= (GAIN);                                                                \
+        }                                                                                       \
+        return (total / fbm_max_value((OCTAVES), (GAIN)) + 1.0f) / 2.0f;                        \
+    }
+
+#define FBM4D_KERNEL_ENTRY(prefix, tag, OCTAVES, LACUNARITY, GAIN) \
+    { (OCTAVES), (LACUNARITY), (GAIN), prefix##_fbm4d_##tag },
+
+#endif // FBM_KERNELS_H
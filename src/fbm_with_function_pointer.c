@@ -1,13 +1,14 @@
 #include "fbm_with_function_pointer.h"
 
-float fbm3d_fn(float x, float y, float z, int octaves, float lacunarity, float gain, NoiseFunction3D noise) {
+float fbm2d_fn(const NoiseContext *ctx, float x, float y, int octaves, float lacunarity, float gain,
+               NoiseFunction2D noise) {
     float total = 0.0f;
     float frequency = 1.0f;
     float amplitude = 1.0f;
     float maxValue = 0.0f;
 
     for (int i = 0; i < octaves; i++) {
-        total += noise(x * frequency, y * frequency, z * frequency) * amplitude;
+        total += noise(ctx, x * frequency, y * frequency) * amplitude;
         maxValue += amplitude;
         amplitude *= gain;
         frequency *= lacunarity;
@@ -16,18 +17,238 @@ float fbm3d_fn(float x, float y, float z, int octaves, float lacunarity, float g
     return (total / maxValue + 1.0f) / 2.0f;  // Normalise to [0, 1]
 }
 
-float fbm4d_fn(float x, float y, float z, float w, int octaves, float lacunarity, float gain, NoiseFunction4D noise) {
+float fbm2d_periodic_fn(const NoiseContext *ctx, float x, float y, int period_x, int period_y, int octaves,
+                        int lacunarity, float gain, NoisePeriodicFunction2D noise) {
     float total = 0.0f;
     float frequency = 1.0f;
     float amplitude = 1.0f;
     float maxValue = 0.0f;
 
     for (int i = 0; i < octaves; i++) {
-        total += noise(x * frequency, y * frequency, z * frequency, w * frequency) * amplitude;
+        total += noise(ctx, x * frequency, y * frequency, period_x, period_y) * amplitude;
         maxValue += amplitude;
         amplitude *= gain;
         frequency *= lacunarity;
+        period_x *= lacunarity;
+        period_y *= lacunarity;
     }
 
     return (total / maxValue + 1.0f) / 2.0f;  // Normalise to [0, 1]
-}
\ No newline at end of file
+}
+
+float fbm3d_fn(const NoiseContext *ctx, float x, float y, float z, int octaves, float lacunarity, float gain,
+               NoiseFunction3D noise) {
+    float total = 0.0f;
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+
+    for (int i = 0; i < octaves; i++) {
+        total += noise(ctx, x * frequency, y * frequency, z * frequency) * amplitude;
+        maxValue += amplitude;
+        amplitude *= gain;
+        frequency *= lacunarity;
+    }
+
+    return (total / maxValue + 1.0f) / 2.0f;  // Normalise to [0, 1]
+}
+
+float fbm4d_fn(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity, float gain,
+               NoiseFunction4D noise) {
+    float total = 0.0f;
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+
+    for (int i = 0; i < octaves; i++) {
+        total += noise(ctx, x * frequency, y * frequency, z * frequency, w * frequency) * amplitude;
+        maxValue += amplitude;
+        amplitude *= gain;
+        frequency *= lacunarity;
+    }
+
+    return (total / maxValue + 1.0f) / 2.0f;  // Normalise to [0, 1]
+}
+
+#define FBM_BATCH_BLOCK 256
+
+// Same sum as fbm4d_fn, evaluated octave by octave over blocks of points so
+// each octave is a single call into the batched noise kernel.
+void fbm4d_batch_fn(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                    float *out, size_t n, int octaves, float lacunarity, float gain, NoiseBatchFunction4D noise) {
+    float sx[FBM_BATCH_BLOCK], sy[FBM_BATCH_BLOCK], sz[FBM_BATCH_BLOCK], sw[FBM_BATCH_BLOCK];
+    float value[FBM_BATCH_BLOCK], total[FBM_BATCH_BLOCK];
+
+    for (size_t start = 0; start < n; start += FBM_BATCH_BLOCK) {
+        size_t count = n - start < FBM_BATCH_BLOCK ? n - start : FBM_BATCH_BLOCK;
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+        float maxValue = 0.0f;
+
+        for (size_t i = 0; i < count; i++) total[i] = 0.0f;
+
+        for (int o = 0; o < octaves; o++) {
+            for (size_t i = 0; i < count; i++) {
+                sx[i] = x[start + i] * frequency;
+                sy[i] = y[start + i] * frequency;
+                sz[i] = z[start + i] * frequency;
+                sw[i] = w[start + i] * frequency;
+            }
+            noise(ctx, sx, sy, sz, sw, value, count);
+            for (size_t i = 0; i < count; i++) total[i] += value[i] * amplitude;
+            maxValue += amplitude;
+            amplitude *= gain;
+            frequency *= lacunarity;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            out[start + i] = (total[i] / maxValue + 1.0f) / 2.0f;  // Normalise to [0, 1]
+        }
+    }
+}
+
+float fbm4d_deriv_fn(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity,
+                     float gain, NoiseDerivFunction4D noise, float *grad) {
+    float total = 0.0f;
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float maxValue = 0.0f;
+    float g[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (int i = 0; i < octaves; i++) {
+        float ng[4];
+        total += noise(ctx, x * frequency, y * frequency, z * frequency, w * frequency, ng) * amplitude;
+        for (int a = 0; a < 4; a++) g[a] += ng[a] * (amplitude * frequency);
+        maxValue += amplitude;
+        amplitude *= gain;
+        frequency *= lacunarity;
+    }
+
+    for (int a = 0; a < 4; a++) grad[a] = g[a] / maxValue / 2.0f;
+    return (total / maxValue + 1.0f) / 2.0f;  // Normalise to [0, 1]
+}
+
+void fbm4d_deriv_batch_fn(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                          float *out, float *gx, float *gy, float *gz, float *gw, size_t n,
+                          int octaves, float lacunarity, float gain, NoiseDerivBatchFunction4D noise) {
+    float sx[FBM_BATCH_BLOCK], sy[FBM_BATCH_BLOCK], sz[FBM_BATCH_BLOCK], sw[FBM_BATCH_BLOCK];
+    float value[FBM_BATCH_BLOCK], total[FBM_BATCH_BLOCK];
+    float ng[4][FBM_BATCH_BLOCK], g[4][FBM_BATCH_BLOCK];
+    float *grad[4] = { gx, gy, gz, gw };
+
+    for (size_t start = 0; start < n; start += FBM_BATCH_BLOCK) {
+        size_t count = n - start < FBM_BATCH_BLOCK ? n - start : FBM_BATCH_BLOCK;
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+        float maxValue = 0.0f;
+
+        for (size_t i = 0; i < count; i++) {
+            total[i] = 0.0f;
+            g[0][i] = g[1][i] = g[2][i] = g[3][i] = 0.0f;
+        }
+
+        for (int o = 0; o < octaves; o++) {
+            for (size_t i = 0; i < count; i++) {
+                sx[i] = x[start + i] * frequency;
+                sy[i] = y[start + i] * frequency;
+                sz[i] = z[start + i] * frequency;
+                sw[i] = w[start + i] * frequency;
+            }
+            noise(ctx, sx, sy, sz, sw, value, ng[0], ng[1], ng[2], ng[3], count);
+            float weight = amplitude * frequency;
+            for (size_t i = 0; i < count; i++) total[i] += value[i] * amplitude;
+            for (int a = 0; a < 4; a++) {
+                for (size_t i = 0; i < count; i++) g[a][i] += ng[a][i] * weight;
+            }
+            maxValue += amplitude;
+            amplitude *= gain;
+            frequency *= lacunarity;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            out[start + i] = (total[i] / maxValue + 1.0f) / 2.0f;  // Normalise to [0, 1]
+        }
+        for (int a = 0; a < 4; a++) {
+            for (size_t i = 0; i < count; i++) grad[a][start + i] = g[a][i] / maxValue / 2.0f;
+        }
+    }
+}
+
+// Specialised kernels (fbm_kernels.h). Value noise has no vector kernel, so
+// its kernels only save the dispatch and the normalisation.
+#define VALUE_FBM4D_KERNEL(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_DEFINE(value, noise4d_batch, false, tag, octaves, lacunarity, gain)
+#define VALUE_FBM4D_ENTRY(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_ENTRY(value, tag, octaves, lacunarity, gain)
+
+FBM_KERNEL_CONFIGS(VALUE_FBM4D_KERNEL)
+
+static const FbmKernel4DEntry value_fbm4d_kernels[] = {
+    FBM_KERNEL_CONFIGS(VALUE_FBM4D_ENTRY)
+    { 0, 0.0f, 0.0f, NULL }
+};
+
+#define PERLIN_FBM4D_KERNEL(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_DEFINE(perlin, perlin_noise4d_batch, true, tag, octaves, lacunarity, gain)
+#define PERLIN_FBM4D_ENTRY(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_ENTRY(perlin, tag, octaves, lacunarity, gain)
+
+FBM_KERNEL_CONFIGS(PERLIN_FBM4D_KERNEL)
+
+static const FbmKernel4DEntry perlin_fbm4d_kernels[] = {
+    FBM_KERNEL_CONFIGS(PERLIN_FBM4D_ENTRY)
+    { 0, 0.0f, 0.0f, NULL }
+};
+
+#define SIMPLEX_FBM4D_KERNEL(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_DEFINE(simplex, simplex4d_batch, true, tag, octaves, lacunarity, gain)
+#define SIMPLEX_FBM4D_ENTRY(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_ENTRY(simplex, tag, octaves, lacunarity, gain)
+
+FBM_KERNEL_CONFIGS(SIMPLEX_FBM4D_KERNEL)
+
+static const FbmKernel4DEntry simplex_fbm4d_kernels[] = {
+    FBM_KERNEL_CONFIGS(SIMPLEX_FBM4D_ENTRY)
+    { 0, 0.0f, 0.0f, NULL }
+};
+
+#define HASH_FBM4D_KERNEL(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_DEFINE(hash, hash_noise4d_batch, true, tag, octaves, lacunarity, gain)
+#define HASH_FBM4D_ENTRY(tag, octaves, lacunarity, gain) \
+    FBM4D_KERNEL_ENTRY(hash, tag, octaves, lacunarity, gain)
+
+FBM_KERNEL_CONFIGS(HASH_FBM4D_KERNEL)
+
+static const FbmKernel4DEntry hash_fbm4d_kernels[] = {
+    FBM_KERNEL_CONFIGS(HASH_FBM4D_ENTRY)
+    { 0, 0.0f, 0.0f, NULL }
+};
+
+FbmKernel4D fbm4d_kernel(NoiseType type, int octaves, float lacunarity, float gain) {
+    const FbmKernel4DEntry *table = NULL;
+    switch (type) {
+        case NOISE_VALUE:   table = value_fbm4d_kernels;   break;
+        case NOISE_PERLIN:  table = perlin_fbm4d_kernels;  break;
+        case NOISE_SIMPLEX: table = simplex_fbm4d_kernels; break;
+        case NOISE_VALUE_HASH: table = hash_fbm4d_kernels; break;
+        default: return NULL;
+    }
+    for (; table->fn; table++) {
+        if (table->octaves == octaves && table->lacunarity == lacunarity && table->gain == gain) {
+            return table->fn;
+        }
+    }
+    return NULL;
+}
+
+float fbm4d(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity, float gain) {
+    FbmKernel4D kernel = fbm4d_kernel(NOISE_PERLIN, octaves, lacunarity, gain);
+    if (kernel) return kernel(ctx, x, y, z, w);
+    return fbm4d_fn(ctx, x, y, z, w, octaves, lacunarity, gain, perlin_noise4d);
+}
+
+float fbm4dx(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity, float gain) {
+    FbmKernel4D kernel = fbm4d_kernel(NOISE_SIMPLEX, octaves, lacunarity, gain);
+    if (kernel) return kernel(ctx, x, y, z, w);
+    return fbm4d_fn(ctx, x, y, z, w, octaves, lacunarity, gain, simplex4d);
+}
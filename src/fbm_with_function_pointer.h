@@ -4,18 +4,55 @@
 #include "noise3d4d.h"
 #include "perlin_noise.h"
 #include "simplex_noise.h"
+#include "hash_noise.h"
+#include "fbm_kernels.h"
 
-typedef float (*NoiseFunction3D)(float, float, float);
-typedef float (*NoiseFunction4D)(float, float, float, float);
+// Every noise and fBm function takes the NoiseContext that seeds it first.
+typedef float (*NoiseFunction2D)(const NoiseContext *, float, float);
+typedef float (*NoisePeriodicFunction2D)(const NoiseContext *, float, float, int, int);
+typedef float (*NoiseFunction3D)(const NoiseContext *, float, float, float);
+typedef float (*NoiseFunction4D)(const NoiseContext *, float, float, float, float);
+typedef void (*NoiseBatchFunction4D)(const NoiseContext *, const float *, const float *, const float *,
+                                     const float *, float *, size_t);
+typedef float (*NoiseDerivFunction4D)(const NoiseContext *, float, float, float, float, float *);
+typedef void (*NoiseDerivBatchFunction4D)(const NoiseContext *, const float *, const float *, const float *,
+                                          const float *, float *, float *, float *, float *, float *, size_t);
 
-float fbm3d_fn(float x, float y, float z, int octaves, float lacunarity, float gain, NoiseFunction3D noiseFunc);
-float fbm4d_fn(float x, float y, float z, float w, int octaves, float lacunarity, float gain, NoiseFunction4D noiseFunc);
-float fbm4d(float x, float y, float z, float w, int octaves, float lacunarity, float gain);
-float fbm4dx(float x, float y, float z, float w, int octaves, float lacunarity, float gain);
+float fbm2d_fn(const NoiseContext *ctx, float x, float y, int octaves, float lacunarity, float gain,
+               NoiseFunction2D noiseFunc);
+// Tileable fBm: octave i samples noiseFunc with periods period * lacunarity^i,
+// so the sum wraps at (period_x, period_y) like its base octave. The integer
+// lacunarity is what keeps every octave's period whole.
+float fbm2d_periodic_fn(const NoiseContext *ctx, float x, float y, int period_x, int period_y, int octaves,
+                        int lacunarity, float gain, NoisePeriodicFunction2D noiseFunc);
+float fbm3d_fn(const NoiseContext *ctx, float x, float y, float z, int octaves, float lacunarity, float gain,
+               NoiseFunction3D noiseFunc);
+float fbm4d_fn(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity, float gain,
+               NoiseFunction4D noiseFunc);
+void fbm4d_batch_fn(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                    float *out, size_t n, int octaves, float lacunarity, float gain, NoiseBatchFunction4D noiseFunc);
+
+// fbm4d_fn plus the gradient of the normalised result, accumulated across
+// octaves (each octave contributes amplitude * frequency * its noise gradient).
+float fbm4d_deriv_fn(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity,
+                     float gain, NoiseDerivFunction4D noiseFunc, float *grad);
+void fbm4d_deriv_batch_fn(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                          float *out, float *gx, float *gy, float *gz, float *gw, size_t n,
+                          int octaves, float lacunarity, float gain, NoiseDerivBatchFunction4D noiseFunc);
+// fBm over Perlin (fbm4d) and simplex (fbm4dx) noise. Parameter sets with a
+// specialised kernel run it; anything else falls back to fbm4d_fn.
+float fbm4d(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity, float gain);
+float fbm4dx(const NoiseContext *ctx, float x, float y, float z, float w, int octaves, float lacunarity, float gain);
 
 typedef enum {
     NOISE_VALUE,
     NOISE_PERLIN,
-    NOISE_SIMPLEX
+    NOISE_SIMPLEX,
+    NOISE_VALUE_HASH    // value noise on an integer-hashed lattice (hash_noise.h)
 } NoiseType;
+
+// Returns the specialised kernel for these parameters, or NULL if none was
+// generated (see FBM_KERNEL_CONFIGS in fbm_kernels.h). Kernels return the
+// same bits as fbm4d_fn with the matching noise.
+FbmKernel4D fbm4d_kernel(NoiseType type, int octaves, float lacunarity, float gain);
 #endif // FBM_WITH_FUNCTION_POINTER_H
\ No newline at end of file
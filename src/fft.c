@@ -0,0 +1,431 @@
+/*
+ * fft.c
+ *
+ * Mixed-radix Stockham FFT. Each stage of radix R reads R elements n / R
+ * apart, twiddles them, runs an R-point DFT and writes them R * ns apart
+ * into the other buffer (ns being the product of the earlier radices), so
+ * the output lands in natural order without a bit-reversal pass. The data
+ * ping-pongs between the caller's array and the scratch buffer.
+ *
+ * Twiddles are computed once per plan in double precision. The inverse runs
+ * the forward stages on the conjugated input: ifft(x) = conj(fft(conj(x))).
+ */
+
+#include "fft.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FFT_PI 3.14159265358979323846
+#define FFT_MAX_STAGES 64
+#define FFT_COLUMN_BLOCK 8   // columns gathered together: 64 bytes per row
+
+typedef struct FftStage {
+    size_t radix;
+    size_t ns;                // product of the earlier radices
+    const FftComplex *twiddle;  // ns * radix entries: w^(r * k) for column k
+    const FftComplex *roots;    // radix entries, for the generic DFT stage
+} FftStage;
+
+struct FftPlan {
+    size_t n;
+    int stages;
+    FftStage stage[FFT_MAX_STAGES];
+    FftComplex *tables;
+};
+
+struct FftRealPlan {
+    size_t n;
+    FftPlan *plan;           // length n / 2 for even n, n for odd n
+    FftComplex *twiddle;     // n / 2 + 1 entries exp(-2 pi i k / n), even n only
+};
+
+static void *fft_alloc(size_t bytes)
+{
+    void *p = malloc(bytes ? bytes : 1);
+    if (!p) {
+        perror("fft allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+static FftComplex unit(double angle)
+{
+    return (FftComplex){ (float)cos(angle), (float)sin(angle) };
+}
+
+static inline FftComplex cadd(FftComplex a, FftComplex b)
+{
+    return (FftComplex){ a.re + b.re, a.im + b.im };
+}
+
+static inline FftComplex csub(FftComplex a, FftComplex b)
+{
+    return (FftComplex){ a.re - b.re, a.im - b.im };
+}
+
+static inline FftComplex cmul(FftComplex a, FftComplex b)
+{
+    return (FftComplex){ a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re };
+}
+
+static inline FftComplex cscale(FftComplex a, float s)
+{
+    return (FftComplex){ a.re * s, a.im * s };
+}
+
+static inline FftComplex cconj(FftComplex a)
+{
+    return (FftComplex){ a.re, -a.im };
+}
+
+// -i * a
+static inline FftComplex cmul_neg_i(FftComplex a)
+{
+    return (FftComplex){ a.im, -a.re };
+}
+
+FftPlan *fft_plan_create(size_t n)
+{
+    if (n == 0) {
+        fprintf(stderr, "fft_plan_create: length must be positive\n");
+        exit(1);
+    }
+    FftPlan *plan = fft_alloc(sizeof(FftPlan));
+    memset(plan, 0, sizeof(*plan));
+    plan->n = n;
+
+    // Radix 4 first while it divides, then 2, 3, 5 and any remaining primes.
+    size_t radices[FFT_MAX_STAGES];
+    int stages = 0;
+    size_t rest = n;
+    while (rest % 4 == 0) { radices[stages++] = 4; rest /= 4; }
+    while (rest % 2 == 0) { radices[stages++] = 2; rest /= 2; }
+    for (size_t p = 3; rest > 1; p += 2) {
+        if (p * p > rest) p = rest;  // what is left is prime
+        while (rest % p == 0) { radices[stages++] = p; rest /= p; }
+    }
+
+    size_t table_size = 0;
+    size_t ns = 1;
+    for (int s = 0; s < stages; s++) {
+        table_size += ns * radices[s];
+        if (radices[s] > 5) table_size += radices[s];
+        ns *= radices[s];
+    }
+    plan->tables = fft_alloc(table_size * sizeof(FftComplex));
+    plan->stages = stages;
+
+    FftComplex *t = plan->tables;
+    ns = 1;
+    for (int s = 0; s < stages; s++) {
+        size_t radix = radices[s];
+        FftStage *stage = &plan->stage[s];
+        stage->radix = radix;
+        stage->ns = ns;
+        stage->twiddle = t;
+        for (size_t k = 0; k < ns; k++) {
+            for (size_t r = 0; r < radix; r++) {
+                t[k * radix + r] = unit(-2.0 * FFT_PI * (double)(r * k) / (double)(ns * radix));
+            }
+        }
+        t += ns * radix;
+        if (radix > 5) {
+            stage->roots = t;
+            for (size_t r = 0; r < radix; r++) t[r] = unit(-2.0 * FFT_PI * (double)r / (double)radix);
+            t += radix;
+        }
+        ns *= radix;
+    }
+    return plan;
+}
+
+void fft_plan_destroy(FftPlan *plan)
+{
+    if (!plan) return;
+    free(plan->tables);
+    free(plan);
+}
+
+size_t fft_scratch_size(const FftPlan *plan)
+{
+    return plan->n;
+}
+
+// One Stockham stage: for every group of ns columns, R inputs m = n / R
+// apart become R outputs ns apart.
+static void fft_stage(const FftStage *stage, size_t n, const FftComplex *src, FftComplex *dst)
+{
+    const size_t R = stage->radix;
+    const size_t ns = stage->ns;
+    const size_t m = n / R;
+    const FftComplex *twiddle = stage->twiddle;
+
+    for (size_t j0 = 0; j0 < m; j0 += ns) {
+        FftComplex *out = dst + j0 * R;
+        for (size_t k = 0; k < ns; k++) {
+            const FftComplex *in = src + j0 + k;
+            const FftComplex *w = twiddle + k * R;
+            FftComplex *o = out + k;
+
+            switch (R) {
+                case 2: {
+                    FftComplex v0 = in[0], v1 = cmul(in[m], w[1]);
+                    o[0]  = cadd(v0, v1);
+                    o[ns] = csub(v0, v1);
+                    break;
+                }
+                case 3: {
+                    const float s = 0.86602540378443864676f;  // sin(2 pi / 3)
+                    FftComplex v0 = in[0], v1 = cmul(in[m], w[1]), v2 = cmul(in[2 * m], w[2]);
+                    FftComplex t1 = cadd(v1, v2);
+                    FftComplex t2 = csub(v0, cscale(t1, 0.5f));
+                    FftComplex t3 = cmul_neg_i(cscale(csub(v1, v2), s));
+                    o[0]      = cadd(v0, t1);
+                    o[ns]     = cadd(t2, t3);
+                    o[2 * ns] = csub(t2, t3);
+                    break;
+                }
+                case 4: {
+                    FftComplex v0 = in[0], v1 = cmul(in[m], w[1]);
+                    FftComplex v2 = cmul(in[2 * m], w[2]), v3 = cmul(in[3 * m], w[3]);
+                    FftComplex a0 = cadd(v0, v2), a1 = csub(v0, v2);
+                    FftComplex a2 = cadd(v1, v3), a3 = cmul_neg_i(csub(v1, v3));
+                    o[0]      = cadd(a0, a2);
+                    o[ns]     = cadd(a1, a3);
+                    o[2 * ns] = csub(a0, a2);
+                    o[3 * ns] = csub(a1, a3);
+                    break;
+                }
+                case 5: {
+                    const float c1 = 0.30901699437494742410f;   // cos(2 pi / 5)
+                    const float c2 = -0.80901699437494742410f;  // cos(4 pi / 5)
+                    const float s1 = 0.95105651629515357212f;   // sin(2 pi / 5)
+                    const float s2 = 0.58778525229247312917f;   // sin(4 pi / 5)
+                    FftComplex v0 = in[0], v1 = cmul(in[m], w[1]), v2 = cmul(in[2 * m], w[2]);
+                    FftComplex v3 = cmul(in[3 * m], w[3]), v4 = cmul(in[4 * m], w[4]);
+                    FftComplex t1 = cadd(v1, v4), t2 = cadd(v2, v3);
+                    FftComplex t3 = csub(v1, v4), t4 = csub(v2, v3);
+                    FftComplex a1 = cadd(v0, cadd(cscale(t1, c1), cscale(t2, c2)));
+                    FftComplex a2 = cadd(v0, cadd(cscale(t1, c2), cscale(t2, c1)));
+                    FftComplex b1 = cmul_neg_i(cadd(cscale(t3, s1), cscale(t4, s2)));
+                    FftComplex b2 = cmul_neg_i(csub(cscale(t3, s2), cscale(t4, s1)));
+                    o[0]      = cadd(v0, cadd(t1, t2));
+                    o[ns]     = cadd(a1, b1);
+                    o[2 * ns] = cadd(a2, b2);
+                    o[3 * ns] = csub(a2, b2);
+                    o[4 * ns] = csub(a1, b1);
+                    break;
+                }
+                default: {
+                    // Direct DFT for a prime radix.
+                    const FftComplex *roots = stage->roots;
+                    for (size_t q = 0; q < R; q++) {
+                        FftComplex sum = in[0];
+                        size_t e = 0;
+                        for (size_t r = 1; r < R; r++) {
+                            e += q;
+                            if (e >= R) e -= R;
+                            sum = cadd(sum, cmul(cmul(in[r * m], w[r]), roots[e]));
+                        }
+                        o[q * ns] = sum;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void fft_forward(const FftPlan *plan, FftComplex *data, FftComplex *scratch)
+{
+    FftComplex *src = data, *dst = scratch;
+    for (int s = 0; s < plan->stages; s++) {
+        fft_stage(&plan->stage[s], plan->n, src, dst);
+        FftComplex *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != data) memcpy(data, src, plan->n * sizeof(FftComplex));
+}
+
+void fft_inverse(const FftPlan *plan, FftComplex *data, FftComplex *scratch)
+{
+    for (size_t i = 0; i < plan->n; i++) data[i].im = -data[i].im;
+    fft_forward(plan, data, scratch);
+    for (size_t i = 0; i < plan->n; i++) data[i].im = -data[i].im;
+}
+
+FftRealPlan *fft_real_plan_create(size_t n)
+{
+    if (n == 0) {
+        fprintf(stderr, "fft_real_plan_create: length must be positive\n");
+        exit(1);
+    }
+    FftRealPlan *plan = fft_alloc(sizeof(FftRealPlan));
+    plan->n = n;
+    plan->twiddle = NULL;
+    if (n % 2 == 0) {
+        size_t h = n / 2;
+        plan->plan = fft_plan_create(h);
+        plan->twiddle = fft_alloc((h + 1) * sizeof(FftComplex));
+        for (size_t k = 0; k <= h; k++) plan->twiddle[k] = unit(-2.0 * FFT_PI * (double)k / (double)n);
+    } else {
+        plan->plan = fft_plan_create(n);
+    }
+    return plan;
+}
+
+void fft_real_plan_destroy(FftRealPlan *plan)
+{
+    if (!plan) return;
+    fft_plan_destroy(plan->plan);
+    free(plan->twiddle);
+    free(plan);
+}
+
+size_t fft_real_scratch_size(const FftRealPlan *plan)
+{
+    return 2 * plan->plan->n;
+}
+
+// Even n packs the samples into n / 2 complex values z[j] = x[2j] + i x[2j+1]
+// and splits their transform Z into the even- and odd-sample spectra:
+//   X[k] = (Z[k] + conj(Z[h-k])) / 2 - i w^k (Z[k] - conj(Z[h-k])) / 2
+void fft_real_forward(const FftRealPlan *plan, const float *in, FftComplex *out, FftComplex *scratch)
+{
+    const size_t n = plan->n;
+    FftComplex *z = scratch;
+    FftComplex *work = scratch + plan->plan->n;
+
+    if (n % 2) {
+        for (size_t i = 0; i < n; i++) z[i] = (FftComplex){ in[i], 0.0f };
+        fft_forward(plan->plan, z, work);
+        memcpy(out, z, (n / 2 + 1) * sizeof(FftComplex));
+        return;
+    }
+
+    const size_t h = n / 2;
+    for (size_t j = 0; j < h; j++) z[j] = (FftComplex){ in[2 * j], in[2 * j + 1] };
+    fft_forward(plan->plan, z, work);
+    for (size_t k = 0; k <= h; k++) {
+        FftComplex a = z[k == h ? 0 : k];
+        FftComplex b = cconj(z[k == 0 ? 0 : h - k]);
+        FftComplex even = cscale(cadd(a, b), 0.5f);
+        FftComplex odd = cmul_neg_i(cscale(csub(a, b), 0.5f));
+        out[k] = cadd(even, cmul(plan->twiddle[k], odd));
+    }
+}
+
+// The reverse of the split above: Z[k] = E[k] + i O[k] with
+//   E[k] = X[k] + conj(X[h-k]),  O[k] = (X[k] - conj(X[h-k])) conj(w^k)
+// and the inverse length-h transform of Z interleaves the even and odd
+// output samples in its real and imaginary parts.
+void fft_real_inverse(const FftRealPlan *plan, const FftComplex *in, float *out, FftComplex *scratch)
+{
+    const size_t n = plan->n;
+    FftComplex *z = scratch;
+    FftComplex *work = scratch + plan->plan->n;
+
+    if (n % 2) {
+        z[0] = (FftComplex){ in[0].re, 0.0f };
+        for (size_t k = 1; k <= n / 2; k++) {
+            z[k] = in[k];
+            z[n - k] = cconj(in[k]);
+        }
+        fft_inverse(plan->plan, z, work);
+        for (size_t i = 0; i < n; i++) out[i] = z[i].re;
+        return;
+    }
+
+    const size_t h = n / 2;
+    // Bins 0 and h are real in a Hermitian spectrum.
+    z[0] = (FftComplex){ in[0].re + in[h].re, in[0].re - in[h].re };
+    for (size_t k = 1; k < h; k++) {
+        FftComplex a = in[k];
+        FftComplex b = cconj(in[h - k]);
+        FftComplex even = cadd(a, b);
+        FftComplex odd = cmul(csub(a, b), cconj(plan->twiddle[k]));
+        z[k] = (FftComplex){ even.re - odd.im, even.im + odd.re };
+    }
+    fft_inverse(plan->plan, z, work);
+    for (size_t j = 0; j < h; j++) {
+        out[2 * j] = z[j].re;
+        out[2 * j + 1] = z[j].im;
+    }
+}
+
+// Runs plan over every column of a rows x cols complex array, a block of
+// adjacent columns at a time so each row access touches whole cache lines.
+static void fft_columns(const FftPlan *plan, FftComplex *data, size_t rows, size_t cols, int inverse)
+{
+    const long blocks = (long)((cols + FFT_COLUMN_BLOCK - 1) / FFT_COLUMN_BLOCK);
+    #pragma omp parallel
+    {
+        FftComplex *buf = fft_alloc((FFT_COLUMN_BLOCK + 1) * rows * sizeof(FftComplex));
+        FftComplex *scratch = buf + FFT_COLUMN_BLOCK * rows;
+
+        #pragma omp for schedule(static)
+        for (long b = 0; b < blocks; b++) {
+            size_t c0 = (size_t)b * FFT_COLUMN_BLOCK;
+            size_t count = cols - c0 < FFT_COLUMN_BLOCK ? cols - c0 : FFT_COLUMN_BLOCK;
+            for (size_t y = 0; y < rows; y++) {
+                const FftComplex *row = data + y * cols + c0;
+                for (size_t c = 0; c < count; c++) buf[c * rows + y] = row[c];
+            }
+            for (size_t c = 0; c < count; c++) {
+                if (inverse) fft_inverse(plan, buf + c * rows, scratch);
+                else fft_forward(plan, buf + c * rows, scratch);
+            }
+            for (size_t y = 0; y < rows; y++) {
+                FftComplex *row = data + y * cols + c0;
+                for (size_t c = 0; c < count; c++) row[c] = buf[c * rows + y];
+            }
+        }
+        free(buf);
+    }
+}
+
+void fft2d_real_forward(const float *in, FftComplex *out, size_t width, size_t height)
+{
+    const size_t bins = width / 2 + 1;
+    FftRealPlan *row_plan = fft_real_plan_create(width);
+    FftPlan *column_plan = fft_plan_create(height);
+
+    #pragma omp parallel
+    {
+        FftComplex *scratch = fft_alloc(fft_real_scratch_size(row_plan) * sizeof(FftComplex));
+        #pragma omp for schedule(static)
+        for (long y = 0; y < (long)height; y++) {
+            fft_real_forward(row_plan, in + (size_t)y * width, out + (size_t)y * bins, scratch);
+        }
+        free(scratch);
+    }
+    fft_columns(column_plan, out, height, bins, 0);
+
+    fft_plan_destroy(column_plan);
+    fft_real_plan_destroy(row_plan);
+}
+
+void fft2d_real_inverse(FftComplex *in, float *out, size_t width, size_t height)
+{
+    const size_t bins = width / 2 + 1;
+    FftRealPlan *row_plan = fft_real_plan_create(width);
+    FftPlan *column_plan = fft_plan_create(height);
+
+    fft_columns(column_plan, in, height, bins, 1);
+    #pragma omp parallel
+    {
+        FftComplex *scratch = fft_alloc(fft_real_scratch_size(row_plan) * sizeof(FftComplex));
+        #pragma omp for schedule(static)
+        for (long y = 0; y < (long)height; y++) {
+            fft_real_inverse(row_plan, in + (size_t)y * bins, out + (size_t)y * width, scratch);
+        }
+        free(scratch);
+    }
+
+    fft_plan_destroy(column_plan);
+    fft_real_plan_destroy(row_plan);
+}
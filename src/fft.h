@@ -0,0 +1,53 @@
+#ifndef FFT_H
+#define FFT_H
+
+/*
+ * Dependency-free mixed-radix FFT.
+ *
+ * Any length works: a plan factors n into radix 4, 2, 3 and 5 stages, and
+ * any other prime factor p gets a direct DFT stage costing O(n * p), so
+ * lengths with large prime factors are slow but still exact. Transforms are
+ * unnormalised: inverse(forward(x)) == n * x.
+ *
+ * The real transforms map n real samples to the n / 2 + 1 bins that
+ * determine their Hermitian spectrum; for even n they run one complex FFT
+ * of length n / 2.
+ *
+ * Plans are read-only once created, so threads can share one. Each call
+ * takes a caller-owned scratch buffer of the plan's scratch size.
+ */
+
+#include <stddef.h>
+
+typedef struct FftComplex {
+    float re, im;
+} FftComplex;
+
+typedef struct FftPlan FftPlan;
+typedef struct FftRealPlan FftRealPlan;
+
+// Plans exit on allocation failure.
+FftPlan *fft_plan_create(size_t n);
+void fft_plan_destroy(FftPlan *plan);
+size_t fft_scratch_size(const FftPlan *plan);  // in FftComplex elements
+
+// In-place transforms of n elements; forward uses exp(-2 pi i jk / n).
+void fft_forward(const FftPlan *plan, FftComplex *data, FftComplex *scratch);
+void fft_inverse(const FftPlan *plan, FftComplex *data, FftComplex *scratch);
+
+FftRealPlan *fft_real_plan_create(size_t n);
+void fft_real_plan_destroy(FftRealPlan *plan);
+size_t fft_real_scratch_size(const FftRealPlan *plan);
+
+// n reals <-> n / 2 + 1 complex bins. The inverse ignores the imaginary part
+// of bin 0 (and of bin n / 2 for even n), as a Hermitian spectrum has none.
+void fft_real_forward(const FftRealPlan *plan, const float *in, FftComplex *out, FftComplex *scratch);
+void fft_real_inverse(const FftRealPlan *plan, const FftComplex *in, float *out, FftComplex *scratch);
+
+// Real 2D transforms of a row-major width x height image. The spectrum has
+// height rows of width / 2 + 1 bins. Rows and columns are spread over the
+// OpenMP threads. The inverse overwrites its input spectrum.
+void fft2d_real_forward(const float *in, FftComplex *out, size_t width, size_t height);
+void fft2d_real_inverse(FftComplex *in, float *out, size_t width, size_t height);
+
+#endif // FFT_H
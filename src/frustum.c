@@ -0,0 +1,246 @@
+#include "frustum.h"
+#include "noise_simd.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if NOISE_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+static float *frustum_alloc(size_t count)
+{
+    float *p = malloc((count ? count : 1) * sizeof(float));
+    if (!p) {
+        perror("frustum allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+// Gribb and Hartmann: each plane is the last row of the matrix plus or
+// minus one of the others.
+void frustum_from_matrix(Frustum *f, const float m[16])
+{
+    for (int p = 0; p < 6; p++) {
+        const int row = p / 2;
+        const float sign = p % 2 ? -1.0f : 1.0f;
+        float plane[4];
+        for (int k = 0; k < 4; k++) plane[k] = m[4 * k + 3] + sign * m[4 * k + row];
+        const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        f->a[p] = plane[0] / length;
+        f->b[p] = plane[1] / length;
+        f->c[p] = plane[2] / length;
+        f->d[p] = plane[3] / length;
+        f->abs_a[p] = fabsf(f->a[p]);
+        f->abs_b[p] = fabsf(f->b[p]);
+        f->abs_c[p] = fabsf(f->c[p]);
+    }
+}
+
+void frustum_spheres_alloc(FrustumSpheres *s, size_t capacity)
+{
+    s->count = 0;
+    s->x = frustum_alloc(capacity);
+    s->y = frustum_alloc(capacity);
+    s->z = frustum_alloc(capacity);
+    s->radius = frustum_alloc(capacity);
+}
+
+void frustum_spheres_free(FrustumSpheres *s)
+{
+    free(s->x);
+    free(s->y);
+    free(s->z);
+    free(s->radius);
+    *s = (FrustumSpheres){ 0 };
+}
+
+void frustum_boxes_alloc(FrustumBoxes *b, size_t capacity)
+{
+    b->count = 0;
+    b->x = frustum_alloc(capacity);
+    b->y = frustum_alloc(capacity);
+    b->z = frustum_alloc(capacity);
+    b->ex = frustum_alloc(capacity);
+    b->ey = frustum_alloc(capacity);
+    b->ez = frustum_alloc(capacity);
+}
+
+void frustum_boxes_free(FrustumBoxes *b)
+{
+    free(b->x);
+    free(b->y);
+    free(b->z);
+    free(b->ex);
+    free(b->ey);
+    free(b->ez);
+    *b = (FrustumBoxes){ 0 };
+}
+
+void frustum_boxes_set(FrustumBoxes *b, size_t i, const float min[3], const float max[3])
+{
+    b->x[i] = 0.5f * (min[0] + max[0]);
+    b->y[i] = 0.5f * (min[1] + max[1]);
+    b->z[i] = 0.5f * (min[2] + max[2]);
+    b->ex[i] = 0.5f * (max[0] - min[0]);
+    b->ey[i] = 0.5f * (max[1] - min[1]);
+    b->ez[i] = 0.5f * (max[2] - min[2]);
+}
+
+/*
+ * The scalar tests, which the SIMD ones follow operation for operation: an
+ * item is outside a plane when its centre is further than its reach r behind
+ * it. A box reaches |a| ex + |b| ey + |c| ez along the plane's normal.
+ */
+static inline bool sphere_visible(const Frustum *f, float x, float y, float z, float r)
+{
+    for (int p = 0; p < 6; p++)
+        if (f->a[p] * x + f->b[p] * y + f->c[p] * z + f->d[p] < -r) return false;
+    return true;
+}
+
+static inline bool box_visible(const Frustum *f, float x, float y, float z, float ex, float ey, float ez)
+{
+    for (int p = 0; p < 6; p++) {
+        const float r = f->abs_a[p] * ex + f->abs_b[p] * ey + f->abs_c[p] * ez;
+        if (f->a[p] * x + f->b[p] * y + f->c[p] * z + f->d[p] < -r) return false;
+    }
+    return true;
+}
+
+// Appends the indices base + bit of the set bits of mask.
+static inline size_t append_mask(unsigned mask, size_t base, uint32_t *visible, size_t n)
+{
+    while (mask) {
+        visible[n++] = (uint32_t)(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return n;
+}
+
+#if NOISE_HAVE_X86_SIMD
+NOISE_TARGET_AVX2 static inline __m256 distance_avx2(const Frustum *f, int p, __m256 x, __m256 y, __m256 z)
+{
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f->a[p]), x), _mm256_mul_ps(_mm256_set1_ps(f->b[p]), y));
+    s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_set1_ps(f->c[p]), z));
+    return _mm256_add_ps(s, _mm256_set1_ps(f->d[p]));
+}
+
+NOISE_TARGET_AVX2 static size_t spheres_avx2(const Frustum *f, const FrustumSpheres *s, uint32_t *visible,
+                                             size_t *done)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t n = 0, i = 0;
+    for (; i + 8 <= s->count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(s->x + i), y = _mm256_loadu_ps(s->y + i), z = _mm256_loadu_ps(s->z + i);
+        const __m256 reach = _mm256_xor_ps(_mm256_loadu_ps(s->radius + i), sign);
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++)
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance_avx2(f, p, x, y, z), reach, _CMP_LT_OQ));
+        n = append_mask(~(unsigned)_mm256_movemask_ps(outside) & 0xffu, i, visible, n);
+    }
+    *done = i;
+    return n;
+}
+
+NOISE_TARGET_AVX2 static size_t boxes_avx2(const Frustum *f, const FrustumBoxes *b, uint32_t *visible, size_t *done)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t n = 0, i = 0;
+    for (; i + 8 <= b->count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(b->x + i), y = _mm256_loadu_ps(b->y + i), z = _mm256_loadu_ps(b->z + i);
+        const __m256 ex = _mm256_loadu_ps(b->ex + i), ey = _mm256_loadu_ps(b->ey + i), ez = _mm256_loadu_ps(b->ez + i);
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f->abs_a[p]), ex),
+                                     _mm256_mul_ps(_mm256_set1_ps(f->abs_b[p]), ey));
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(f->abs_c[p]), ez));
+            outside = _mm256_or_ps(outside,
+                                   _mm256_cmp_ps(distance_avx2(f, p, x, y, z), _mm256_xor_ps(r, sign), _CMP_LT_OQ));
+        }
+        n = append_mask(~(unsigned)_mm256_movemask_ps(outside) & 0xffu, i, visible, n);
+    }
+    *done = i;
+    return n;
+}
+
+NOISE_TARGET_SSE41 static inline __m128 distance_sse41(const Frustum *f, int p, __m128 x, __m128 y, __m128 z)
+{
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f->a[p]), x), _mm_mul_ps(_mm_set1_ps(f->b[p]), y));
+    s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(f->c[p]), z));
+    return _mm_add_ps(s, _mm_set1_ps(f->d[p]));
+}
+
+NOISE_TARGET_SSE41 static size_t spheres_sse41(const Frustum *f, const FrustumSpheres *s, uint32_t *visible,
+                                               size_t *done)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t n = 0, i = 0;
+    for (; i + 4 <= s->count; i += 4) {
+        const __m128 x = _mm_loadu_ps(s->x + i), y = _mm_loadu_ps(s->y + i), z = _mm_loadu_ps(s->z + i);
+        const __m128 reach = _mm_xor_ps(_mm_loadu_ps(s->radius + i), sign);
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) outside = _mm_or_ps(outside, _mm_cmplt_ps(distance_sse41(f, p, x, y, z), reach));
+        n = append_mask(~(unsigned)_mm_movemask_ps(outside) & 0xfu, i, visible, n);
+    }
+    *done = i;
+    return n;
+}
+
+NOISE_TARGET_SSE41 static size_t boxes_sse41(const Frustum *f, const FrustumBoxes *b, uint32_t *visible, size_t *done)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t n = 0, i = 0;
+    for (; i + 4 <= b->count; i += 4) {
+        const __m128 x = _mm_loadu_ps(b->x + i), y = _mm_loadu_ps(b->y + i), z = _mm_loadu_ps(b->z + i);
+        const __m128 ex = _mm_loadu_ps(b->ex + i), ey = _mm_loadu_ps(b->ey + i), ez = _mm_loadu_ps(b->ez + i);
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f->abs_a[p]), ex), _mm_mul_ps(_mm_set1_ps(f->abs_b[p]), ey));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(f->abs_c[p]), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance_sse41(f, p, x, y, z), _mm_xor_ps(r, sign)));
+        }
+        n = append_mask(~(unsigned)_mm_movemask_ps(outside) & 0xfu, i, visible, n);
+    }
+    *done = i;
+    return n;
+}
+#endif
+
+static void add_stats(FrustumStats *stats, size_t tested, size_t drawn)
+{
+    if (!stats) return;
+    stats->tested += tested;
+    stats->culled += tested - drawn;
+    stats->drawn += drawn;
+}
+
+size_t frustum_cull_spheres(const Frustum *f, const FrustumSpheres *s, uint32_t *visible, FrustumStats *stats)
+{
+    size_t n = 0, i = 0;
+#if NOISE_HAVE_X86_SIMD
+    const NoiseSimdLevel level = noise_simd_level();
+    if (level == NOISE_SIMD_AVX2) n = spheres_avx2(f, s, visible, &i);
+    else if (level == NOISE_SIMD_SSE41) n = spheres_sse41(f, s, visible, &i);
+#endif
+    for (; i < s->count; i++)
+        if (sphere_visible(f, s->x[i], s->y[i], s->z[i], s->radius[i])) visible[n++] = (uint32_t)i;
+    add_stats(stats, s->count, n);
+    return n;
+}
+
+size_t frustum_cull_boxes(const Frustum *f, const FrustumBoxes *b, uint32_t *visible, FrustumStats *stats)
+{
+    size_t n = 0, i = 0;
+#if NOISE_HAVE_X86_SIMD
+    const NoiseSimdLevel level = noise_simd_level();
+    if (level == NOISE_SIMD_AVX2) n = boxes_avx2(f, b, visible, &i);
+    else if (level == NOISE_SIMD_SSE41) n = boxes_sse41(f, b, visible, &i);
+#endif
+    for (; i < b->count; i++)
+        if (box_visible(f, b->x[i], b->y[i], b->z[i], b->ex[i], b->ey[i], b->ez[i])) visible[n++] = (uint32_t)i;
+    add_stats(stats, b->count, n);
+    return n;
+}
@@ -0,0 +1,58 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+/*
+ * View frustum culling of bounding spheres and boxes, in batches.
+ *
+ * Bounds are kept structure-of-arrays, one array per coordinate, so the
+ * batch tests load eight (AVX2) or four (SSE4.1) items per plane at a time;
+ * noise_simd_level picks the width at runtime as for the noise kernels,
+ * and every width culls exactly the same items. A test is conservative: an
+ * item is culled only when it lies wholly outside one of the six planes,
+ * so the odd item beyond a corner of the frustum is still drawn.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Plane p is a[p] x + b[p] y + c[p] z + d[p] >= 0 inside, with (a, b, c) of
+// unit length; left, right, bottom, top, near, far.
+typedef struct Frustum {
+    float a[6], b[6], c[6], d[6];
+    float abs_a[6], abs_b[6], abs_c[6];
+} Frustum;
+
+typedef struct FrustumSpheres {
+    size_t count;
+    float *x, *y, *z;  // centres
+    float *radius;
+} FrustumSpheres;
+
+typedef struct FrustumBoxes {
+    size_t count;
+    float *x, *y, *z;     // centres
+    float *ex, *ey, *ez;  // half extents
+} FrustumBoxes;
+
+// Items tested, culled and passed to be drawn, added to by every batch.
+typedef struct FrustumStats {
+    size_t tested, culled, drawn;
+} FrustumStats;
+
+// The frustum of a view-projection matrix, column-major as OpenGL and
+// raylib's MatrixToFloatV lay it out (clip = m (x, y, z, 1)).
+void frustum_from_matrix(Frustum *f, const float m[16]);
+
+// Sets hold up to capacity items; count is how many are in use.
+void frustum_spheres_alloc(FrustumSpheres *s, size_t capacity);
+void frustum_spheres_free(FrustumSpheres *s);
+void frustum_boxes_alloc(FrustumBoxes *b, size_t capacity);
+void frustum_boxes_free(FrustumBoxes *b);
+void frustum_boxes_set(FrustumBoxes *b, size_t i, const float min[3], const float max[3]);
+
+// Writes the indices of the items at least partly inside the frustum, in
+// order, to visible and returns how many there are. stats may be NULL.
+size_t frustum_cull_spheres(const Frustum *f, const FrustumSpheres *s, uint32_t *visible, FrustumStats *stats);
+size_t frustum_cull_boxes(const Frustum *f, const FrustumBoxes *b, uint32_t *visible, FrustumStats *stats);
+
+#endif // FRUSTUM_H
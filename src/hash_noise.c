@@ -0,0 +1,310 @@
+/*
+ * hash_noise.c
+ *
+ * Value noise with an integer lattice hash.
+ *
+ * noise3d4d.c derives each lattice value from fract(sin(dot) * 43758.5453),
+ * which costs a transcendental per corner and degrades as the coordinates
+ * grow, because sinf of a large argument keeps only a few significant bits.
+ * Here the integer cell coordinates are folded into an xxHash32-style hash
+ * keyed by the context seed, and the top 24 bits of the avalanche give the
+ * lattice value. The hash is exact at any cell, so it gives the same result
+ * on every compiler and far from the origin, and it needs only integer
+ * multiplies, which the batch kernels below vectorise directly.
+ *
+ * Interpolation is the same smoothstep as the sinf-based value noise.
+ */
+
+#include "hash_noise.h"
+#include "noise_simd.h"
+#include <math.h>
+#include <stdint.h>
+
+#if NOISE_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#define HASH_PRIME2 0x85EBCA77u
+#define HASH_PRIME3 0xC2B2AE3Du
+#define HASH_PRIME4 0x27D4EB2Fu
+#define HASH_PRIME5 0x165667B1u
+
+static inline uint32_t rotl32(uint32_t v, int r)
+{
+    return (v << r) | (v >> (32 - r));
+}
+
+// One xxHash32 input round: folds a lattice coordinate into h.
+static inline uint32_t hash_step(uint32_t h, uint32_t v)
+{
+    return rotl32(h + v * HASH_PRIME3, 17) * HASH_PRIME4;
+}
+
+// xxHash32 avalanche, then the top 24 bits mapped exactly onto [-1, 1).
+static inline float hash_to_float(uint32_t h)
+{
+    h ^= h >> 15;
+    h *= HASH_PRIME2;
+    h ^= h >> 13;
+    h *= HASH_PRIME3;
+    h ^= h >> 16;
+    return (float)(h >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+static inline float smooth_interp(float t)
+{
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static inline float lerp(float t, float a, float b)
+{
+    return a + t * (b - a);
+}
+
+float hash_noise2d(const NoiseContext *ctx, float x, float y)
+{
+    float fx = floorf(x), fy = floorf(y);
+    uint32_t ix = (uint32_t)(int)fx, iy = (uint32_t)(int)fy;
+    float u = smooth_interp(x - fx);
+    float v = smooth_interp(y - fy);
+
+    uint32_t h = ctx->hash_seed + HASH_PRIME5;
+    uint32_t hx0 = hash_step(h, ix), hx1 = hash_step(h, ix + 1);
+
+    float n00 = hash_to_float(hash_step(hx0, iy));
+    float n10 = hash_to_float(hash_step(hx1, iy));
+    float n01 = hash_to_float(hash_step(hx0, iy + 1));
+    float n11 = hash_to_float(hash_step(hx1, iy + 1));
+
+    return lerp(v, lerp(u, n00, n10), lerp(u, n01, n11));
+}
+
+// Wraps a lattice coordinate into [0, period).
+static inline uint32_t wrap_lattice(int i, int period)
+{
+    // Samples mostly stay in [0, period), so skip the division there.
+    if ((unsigned)i >= (unsigned)period) {
+        i %= period;
+        if (i < 0) i += period;
+    }
+    return (uint32_t)i;
+}
+
+float hash_noise2d_periodic(const NoiseContext *ctx, float x, float y, int period_x, int period_y)
+{
+    float fx = floorf(x), fy = floorf(y);
+    uint32_t ix0 = wrap_lattice((int)fx, period_x), iy0 = wrap_lattice((int)fy, period_y);
+    uint32_t ix1 = ix0 + 1 == (uint32_t)period_x ? 0 : ix0 + 1;
+    uint32_t iy1 = iy0 + 1 == (uint32_t)period_y ? 0 : iy0 + 1;
+    float u = smooth_interp(x - fx);
+    float v = smooth_interp(y - fy);
+
+    uint32_t h = ctx->hash_seed + HASH_PRIME5;
+    uint32_t hx0 = hash_step(h, ix0), hx1 = hash_step(h, ix1);
+
+    float n00 = hash_to_float(hash_step(hx0, iy0));
+    float n10 = hash_to_float(hash_step(hx1, iy0));
+    float n01 = hash_to_float(hash_step(hx0, iy1));
+    float n11 = hash_to_float(hash_step(hx1, iy1));
+
+    return lerp(v, lerp(u, n00, n10), lerp(u, n01, n11));
+}
+
+float hash_noise3d(const NoiseContext *ctx, float x, float y, float z)
+{
+    float fx = floorf(x), fy = floorf(y), fz = floorf(z);
+    uint32_t ix = (uint32_t)(int)fx, iy = (uint32_t)(int)fy, iz = (uint32_t)(int)fz;
+    float u = smooth_interp(x - fx);
+    float v = smooth_interp(y - fy);
+    float s = smooth_interp(z - fz);
+
+    // Corner k has its x/y/z offset in bits 0/1/2.
+    uint32_t h = ctx->hash_seed + HASH_PRIME5;
+    uint32_t hx[2], hxy[4];
+    float n[8];
+    for (int k = 0; k < 2; k++) hx[k] = hash_step(h, ix + k);
+    for (int k = 0; k < 4; k++) hxy[k] = hash_step(hx[k & 1], iy + (k >> 1));
+    for (int k = 0; k < 8; k++) n[k] = hash_to_float(hash_step(hxy[k & 3], iz + (k >> 2)));
+
+    float x0 = lerp(u, n[0], n[1]), x1 = lerp(u, n[2], n[3]);
+    float x2 = lerp(u, n[4], n[5]), x3 = lerp(u, n[6], n[7]);
+    return lerp(s, lerp(v, x0, x1), lerp(v, x2, x3));
+}
+
+float hash_noise4d(const NoiseContext *ctx, float x, float y, float z, float w)
+{
+    float fx = floorf(x), fy = floorf(y), fz = floorf(z), fw = floorf(w);
+    uint32_t ix = (uint32_t)(int)fx, iy = (uint32_t)(int)fy;
+    uint32_t iz = (uint32_t)(int)fz, iw = (uint32_t)(int)fw;
+    float u = smooth_interp(x - fx);
+    float v = smooth_interp(y - fy);
+    float s = smooth_interp(z - fz);
+    float t = smooth_interp(w - fw);
+
+    // Hash one axis at a time; corner k has its x/y/z/w offset in bits 0/1/2/3.
+    uint32_t h = ctx->hash_seed + HASH_PRIME5;
+    uint32_t hx[2], hxy[4], hxyz[8];
+    float n[16];
+    for (int k = 0; k < 2; k++) hx[k] = hash_step(h, ix + k);
+    for (int k = 0; k < 4; k++) hxy[k] = hash_step(hx[k & 1], iy + (k >> 1));
+    for (int k = 0; k < 8; k++) hxyz[k] = hash_step(hxy[k & 3], iz + (k >> 2));
+    for (int k = 0; k < 16; k++) n[k] = hash_to_float(hash_step(hxyz[k & 7], iw + (k >> 3)));
+
+    float nx[8], ny[4], nz[2];
+    for (int k = 0; k < 8; k++) nx[k] = lerp(u, n[2 * k], n[2 * k + 1]);
+    for (int k = 0; k < 4; k++) ny[k] = lerp(v, nx[2 * k], nx[2 * k + 1]);
+    for (int k = 0; k < 2; k++) nz[k] = lerp(s, ny[2 * k], ny[2 * k + 1]);
+    return lerp(t, nz[0], nz[1]);
+}
+
+// --- Batched 4D hash noise ---
+//
+// Integer hashing is exact and the float steps follow hash4d's order with no
+// fused multiply-add, so every lane is bit-identical to the scalar function.
+
+#if NOISE_HAVE_X86_SIMD
+
+NOISE_TARGET_AVX2 static inline __m256i hash_step8(__m256i h, __m256i v)
+{
+    __m256i a = _mm256_add_epi32(h, _mm256_mullo_epi32(v, _mm256_set1_epi32((int)HASH_PRIME3)));
+    a = _mm256_or_si256(_mm256_slli_epi32(a, 17), _mm256_srli_epi32(a, 15));
+    return _mm256_mullo_epi32(a, _mm256_set1_epi32((int)HASH_PRIME4));
+}
+
+NOISE_TARGET_AVX2 static inline __m256 hash_to_float8(__m256i h)
+{
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)HASH_PRIME2));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)HASH_PRIME3));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    __m256 f = _mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8));
+    return _mm256_sub_ps(_mm256_mul_ps(f, _mm256_set1_ps(2.0f / 16777216.0f)), _mm256_set1_ps(1.0f));
+}
+
+NOISE_TARGET_AVX2 static inline __m256 smooth8(__m256 t)
+{
+    __m256 a = _mm256_sub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(_mm256_set1_ps(2.0f), t));
+    return _mm256_mul_ps(_mm256_mul_ps(t, t), a);
+}
+
+NOISE_TARGET_AVX2 static inline __m256 hlerp8(__m256 t, __m256 a, __m256 b)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+NOISE_TARGET_AVX2 static void hash_noise4d_avx2(const NoiseContext *ctx, const float *px, const float *py,
+                                                const float *pz, const float *pw, float *out, size_t n)
+{
+    const __m256i seed = _mm256_set1_epi32((int)(ctx->hash_seed + HASH_PRIME5));
+
+    for (size_t i = 0; i < n; i += 8) {
+        __m256 p[4] = { _mm256_loadu_ps(px + i), _mm256_loadu_ps(py + i),
+                        _mm256_loadu_ps(pz + i), _mm256_loadu_ps(pw + i) };
+        __m256i cell[4];
+        __m256 f[4];
+        for (int a = 0; a < 4; a++) {
+            __m256 fl = _mm256_floor_ps(p[a]);
+            cell[a] = _mm256_cvttps_epi32(fl);
+            f[a] = smooth8(_mm256_sub_ps(p[a], fl));
+        }
+
+        __m256i hx[2], hxy[4], hxyz[8];
+        __m256 c[16];
+        for (int k = 0; k < 2; k++) hx[k] = hash_step8(seed, _mm256_add_epi32(cell[0], _mm256_set1_epi32(k)));
+        for (int k = 0; k < 4; k++) hxy[k] = hash_step8(hx[k & 1], _mm256_add_epi32(cell[1], _mm256_set1_epi32(k >> 1)));
+        for (int k = 0; k < 8; k++) hxyz[k] = hash_step8(hxy[k & 3], _mm256_add_epi32(cell[2], _mm256_set1_epi32(k >> 2)));
+        for (int k = 0; k < 16; k++) {
+            c[k] = hash_to_float8(hash_step8(hxyz[k & 7], _mm256_add_epi32(cell[3], _mm256_set1_epi32(k >> 3))));
+        }
+
+        __m256 cx[8], cy[4], cz[2];
+        for (int k = 0; k < 8; k++) cx[k] = hlerp8(f[0], c[2 * k], c[2 * k + 1]);
+        for (int k = 0; k < 4; k++) cy[k] = hlerp8(f[1], cx[2 * k], cx[2 * k + 1]);
+        for (int k = 0; k < 2; k++) cz[k] = hlerp8(f[2], cy[2 * k], cy[2 * k + 1]);
+        _mm256_storeu_ps(out + i, hlerp8(f[3], cz[0], cz[1]));
+    }
+}
+
+NOISE_TARGET_SSE41 static inline __m128i hash_step4(__m128i h, __m128i v)
+{
+    __m128i a = _mm_add_epi32(h, _mm_mullo_epi32(v, _mm_set1_epi32((int)HASH_PRIME3)));
+    a = _mm_or_si128(_mm_slli_epi32(a, 17), _mm_srli_epi32(a, 15));
+    return _mm_mullo_epi32(a, _mm_set1_epi32((int)HASH_PRIME4));
+}
+
+NOISE_TARGET_SSE41 static inline __m128 hash_to_float4(__m128i h)
+{
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32((int)HASH_PRIME2));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32((int)HASH_PRIME3));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    __m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(h, 8));
+    return _mm_sub_ps(_mm_mul_ps(f, _mm_set1_ps(2.0f / 16777216.0f)), _mm_set1_ps(1.0f));
+}
+
+NOISE_TARGET_SSE41 static inline __m128 smooth4(__m128 t)
+{
+    __m128 a = _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), t));
+    return _mm_mul_ps(_mm_mul_ps(t, t), a);
+}
+
+NOISE_TARGET_SSE41 static inline __m128 hlerp4(__m128 t, __m128 a, __m128 b)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+NOISE_TARGET_SSE41 static void hash_noise4d_sse41(const NoiseContext *ctx, const float *px, const float *py,
+                                                  const float *pz, const float *pw, float *out, size_t n)
+{
+    const __m128i seed = _mm_set1_epi32((int)(ctx->hash_seed + HASH_PRIME5));
+
+    for (size_t i = 0; i < n; i += 4) {
+        __m128 p[4] = { _mm_loadu_ps(px + i), _mm_loadu_ps(py + i),
+                        _mm_loadu_ps(pz + i), _mm_loadu_ps(pw + i) };
+        __m128i cell[4];
+        __m128 f[4];
+        for (int a = 0; a < 4; a++) {
+            __m128 fl = _mm_floor_ps(p[a]);
+            cell[a] = _mm_cvttps_epi32(fl);
+            f[a] = smooth4(_mm_sub_ps(p[a], fl));
+        }
+
+        __m128i hx[2], hxy[4], hxyz[8];
+        __m128 c[16];
+        for (int k = 0; k < 2; k++) hx[k] = hash_step4(seed, _mm_add_epi32(cell[0], _mm_set1_epi32(k)));
+        for (int k = 0; k < 4; k++) hxy[k] = hash_step4(hx[k & 1], _mm_add_epi32(cell[1], _mm_set1_epi32(k >> 1)));
+        for (int k = 0; k < 8; k++) hxyz[k] = hash_step4(hxy[k & 3], _mm_add_epi32(cell[2], _mm_set1_epi32(k >> 2)));
+        for (int k = 0; k < 16; k++) {
+            c[k] = hash_to_float4(hash_step4(hxyz[k & 7], _mm_add_epi32(cell[3], _mm_set1_epi32(k >> 3))));
+        }
+
+        __m128 cx[8], cy[4], cz[2];
+        for (int k = 0; k < 8; k++) cx[k] = hlerp4(f[0], c[2 * k], c[2 * k + 1]);
+        for (int k = 0; k < 4; k++) cy[k] = hlerp4(f[1], cx[2 * k], cx[2 * k + 1]);
+        for (int k = 0; k < 2; k++) cz[k] = hlerp4(f[2], cy[2 * k], cy[2 * k + 1]);
+        _mm_storeu_ps(out + i, hlerp4(f[3], cz[0], cz[1]));
+    }
+}
+
+#endif // NOISE_HAVE_X86_SIMD
+
+void hash_noise4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                        const float *w, float *out, size_t n)
+{
+    size_t done = 0;
+#if NOISE_HAVE_X86_SIMD
+    NoiseSimdLevel level = noise_simd_level();
+    if (level >= NOISE_SIMD_AVX2) {
+        done = n & ~(size_t)7;
+        hash_noise4d_avx2(ctx, x, y, z, w, out, done);
+    } else if (level >= NOISE_SIMD_SSE41) {
+        done = n & ~(size_t)3;
+        hash_noise4d_sse41(ctx, x, y, z, w, out, done);
+    }
+#endif
+    for (size_t i = done; i < n; i++) {
+        out[i] = hash_noise4d(ctx, x[i], y[i], z[i], w[i]);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef HASH_NOISE_H
+#define HASH_NOISE_H
+
+#include <stddef.h>
+#include "noise_context.h"
+
+// Value noise whose lattice values come from an integer hash of the cell
+// coordinates (keyed by ctx->hash_seed). Output is in [-1, 1).
+float hash_noise2d(const NoiseContext *ctx, float x, float y);
+float hash_noise3d(const NoiseContext *ctx, float x, float y, float z);
+float hash_noise4d(const NoiseContext *ctx, float x, float y, float z, float w);
+
+// hash_noise2d on a lattice that wraps every period_x cells in x and
+// period_y cells in y. Any positive period tiles exactly.
+float hash_noise2d_periodic(const NoiseContext *ctx, float x, float y, int period_x, int period_y);
+
+// Evaluates hash_noise4d for n points given as separate coordinate arrays.
+void hash_noise4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                        const float *w, float *out, size_t n);
+
+#endif // HASH_NOISE_H
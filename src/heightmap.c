@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200112L  // posix_memalign
+
+#include "heightmap.h"
+#include "noise_simd.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>  // _aligned_malloc
+#else
+#include <sys/mman.h>
+#endif
+#if NOISE_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Rows of width elements of the given size, padded to whole cache lines.
+static size_t row_stride(size_t width, size_t size)
+{
+    const size_t per_line = HEIGHTMAP_ALIGNMENT / size;
+    return (width + per_line - 1) / per_line * per_line;
+}
+
+// Zeroed, cache-line aligned; exits on failure.
+static void *aligned_calloc(size_t bytes)
+{
+    void *p = NULL;
+#ifdef _WIN32
+    p = _aligned_malloc(bytes ? bytes : HEIGHTMAP_ALIGNMENT, HEIGHTMAP_ALIGNMENT);
+#else
+    if (posix_memalign(&p, HEIGHTMAP_ALIGNMENT, bytes ? bytes : HEIGHTMAP_ALIGNMENT) != 0) p = NULL;
+#endif
+    if (!p) {
+        perror("heightmap allocation failed");
+        exit(1);
+    }
+    memset(p, 0, bytes);
+    return p;
+}
+
+static void aligned_free(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+Heightmap *heightmap_create(size_t width, size_t height)
+{
+    Heightmap *hm = malloc(sizeof(Heightmap));
+    if (!hm) {
+        perror("heightmap allocation failed");
+        exit(1);
+    }
+    memset(hm, 0, sizeof(*hm));
+    hm->width = width;
+    hm->height = height;
+    hm->stride = row_stride(width, sizeof(float));
+    hm->data = aligned_calloc(hm->stride * height * sizeof(float));
+    return hm;
+}
+
+void heightmap_destroy(Heightmap *hm)
+{
+    if (!hm) return;
+#ifndef _WIN32
+    if (hm->mapping) munmap(hm->mapping, hm->mapping_size);
+    else
+#endif
+    aligned_free(hm->data);
+    free(hm);
+}
+
+Heightmap *heightmap_copy(const Heightmap *hm)
+{
+    Heightmap *copy = heightmap_create(hm->width, hm->height);
+    copy->min = hm->min;
+    copy->max = hm->max;
+    copy->params = hm->params;
+    if (hm->stride == copy->stride) {
+        memcpy(copy->data, hm->data, hm->stride * hm->height * sizeof(float));
+    } else {
+        for (size_t y = 0; y < hm->height; y++) {
+            memcpy(heightmap_row(copy, y), heightmap_row(hm, y), hm->width * sizeof(float));
+        }
+    }
+    return copy;
+}
+
+void heightmap_update_range(Heightmap *hm)
+{
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    for (size_t y = 0; y < hm->height; y++) {
+        const float *row = heightmap_row(hm, y);
+        for (size_t x = 0; x < hm->width; x++) {
+            if (row[x] < lo) lo = row[x];
+            if (row[x] > hi) hi = row[x];
+        }
+    }
+    hm->min = hm->width && hm->height ? lo : 0.0f;
+    hm->max = hm->width && hm->height ? hi : 0.0f;
+}
+
+// Brush height at t of the radius (0 centre, 1 rim), per unit amount.
+static float brush_profile(HeightmapBrush brush, float t)
+{
+    if (brush == HEIGHTMAP_BRUSH_SMOOTH) return (1.0f - t * t) * (1.0f - t * t);
+    if (t < 0.8f) {
+        const float s = t / 0.8f;
+        return -(1.0f - s * s) + 0.3f * s * s * s * s;
+    }
+    const float s = (t - 0.8f) / 0.2f;
+    return 0.3f * (1.0f - s * s * (3.0f - 2.0f * s));
+}
+
+HeightmapRect heightmap_stamp(Heightmap *hm, HeightmapBrush brush, float x, float y, float rx, float ry,
+                              float amount)
+{
+    HeightmapRect rect = { (long)ceilf(x - rx), (long)ceilf(y - ry), (long)floorf(x + rx), (long)floorf(y + ry) };
+    // A brush wider than the map reaches each sample once, from its copy
+    // nearest the centre.
+    if (rect.x1 - rect.x0 >= (long)hm->width) {
+        rect.x0 = (long)ceilf(x - hm->width / 2.0f);
+        rect.x1 = rect.x0 + (long)hm->width - 1;
+    }
+    if (rect.y1 - rect.y0 >= (long)hm->height) {
+        rect.y0 = (long)ceilf(y - hm->height / 2.0f);
+        rect.y1 = rect.y0 + (long)hm->height - 1;
+    }
+    if (!(rx > 0.0f) || !(ry > 0.0f) || rect.x1 < rect.x0 || rect.y1 < rect.y0) {
+        return (HeightmapRect){ 0, 0, -1, -1 };
+    }
+
+    const long w = (long)hm->width, h = (long)hm->height;
+    for (long sy = rect.y0; sy <= rect.y1; sy++) {
+        float *row = heightmap_row(hm, (size_t)(((sy % h) + h) % h));
+        const float dy = (sy - y) / ry;
+        for (long sx = rect.x0; sx <= rect.x1; sx++) {
+            const float dx = (sx - x) / rx;
+            const float t2 = dx * dx + dy * dy;
+            if (t2 < 1.0f) row[((sx % w) + w) % w] += amount * brush_profile(brush, sqrtf(t2));
+        }
+    }
+    return rect;
+}
+
+HeightmapQ16 *heightmap_q16_create(size_t width, size_t height, float min, float max)
+{
+    HeightmapQ16 *q = malloc(sizeof(HeightmapQ16));
+    if (!q) {
+        perror("heightmap allocation failed");
+        exit(1);
+    }
+    memset(q, 0, sizeof(*q));
+    q->width = width;
+    q->height = height;
+    q->stride = row_stride(width, sizeof(uint16_t));
+    q->min = min;
+    q->max = max;
+    q->step = max > min ? (max - min) / 65535.0f : 0.0f;
+    q->data = aligned_calloc(q->stride * height * sizeof(uint16_t));
+    return q;
+}
+
+void heightmap_q16_destroy(HeightmapQ16 *q)
+{
+    if (!q) return;
+    aligned_free(q->data);
+    free(q);
+}
+
+HeightmapQ16 *heightmap_quantize(const Heightmap *hm)
+{
+    HeightmapQ16 *q = heightmap_q16_create(hm->width, hm->height, hm->min, hm->max);
+    q->params = hm->params;
+    const float inv_step = q->step > 0.0f ? 1.0f / q->step : 0.0f;
+    #pragma omp parallel for schedule(static)
+    for (long y = 0; y < (long)hm->height; y++) {
+        const float *src = heightmap_row(hm, (size_t)y);
+        uint16_t *dst = heightmap_q16_row(q, (size_t)y);
+        for (size_t x = 0; x < hm->width; x++) {
+            float c = (src[x] - q->min) * inv_step + 0.5f;
+            dst[x] = c <= 0.0f ? 0 : c >= 65535.0f ? 65535 : (uint16_t)c;
+        }
+    }
+    return q;
+}
+
+#if NOISE_HAVE_X86_SIMD
+NOISE_TARGET_AVX2 static void decode_avx2(const uint16_t *in, float *out, size_t count, float min, float step)
+{
+    const __m256 vmin = _mm256_set1_ps(min), vstep = _mm256_set1_ps(step);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i c = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(vmin, _mm256_mul_ps(_mm256_cvtepi32_ps(c), vstep)));
+    }
+    for (; i < count; i++) out[i] = min + (float)in[i] * step;
+}
+
+NOISE_TARGET_SSE41 static void decode_sse41(const uint16_t *in, float *out, size_t count, float min, float step)
+{
+    const __m128 vmin = _mm_set1_ps(min), vstep = _mm_set1_ps(step);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i c = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(in + i)));
+        _mm_storeu_ps(out + i, _mm_add_ps(vmin, _mm_mul_ps(_mm_cvtepi32_ps(c), vstep)));
+    }
+    for (; i < count; i++) out[i] = min + (float)in[i] * step;
+}
+#endif
+
+void heightmap_q16_decode(const HeightmapQ16 *q, size_t y, size_t x, size_t count, float *out)
+{
+    const uint16_t *in = heightmap_q16_row(q, y) + x;
+#if NOISE_HAVE_X86_SIMD
+    switch (noise_simd_level()) {
+        case NOISE_SIMD_AVX2:  decode_avx2(in, out, count, q->min, q->step);  return;
+        case NOISE_SIMD_SSE41: decode_sse41(in, out, count, q->min, q->step); return;
+        default: break;
+    }
+#endif
+    for (size_t i = 0; i < count; i++) out[i] = q->min + (float)in[i] * q->step;
+}
+
+Heightmap *heightmap_dequantize(const HeightmapQ16 *q)
+{
+    Heightmap *hm = heightmap_create(q->width, q->height);
+    hm->params = q->params;
+    hm->min = q->min;
+    hm->max = q->max;
+    #pragma omp parallel for schedule(static)
+    for (long y = 0; y < (long)q->height; y++) {
+        heightmap_q16_decode(q, (size_t)y, 0, q->width, heightmap_row(hm, (size_t)y));
+    }
+    return hm;
+}
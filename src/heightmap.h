@@ -0,0 +1,146 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+/*
+ * A terrain heightmap in one cache-aligned allocation.
+ *
+ * Rows are stride floats apart; the stride rounds the width up to a whole
+ * number of cache lines, so every row starts 64-byte aligned and whole rows
+ * (or, when stride == width, the whole map) can go to SIMD code or to disk
+ * in one piece. min and max describe the heights after the last
+ * heightmap_update_range.
+ *
+ * A map loaded by load_heightmap (save.h) points into a read-only file
+ * mapping instead of owning its data; heightmap_destroy releases either.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEIGHTMAP_ALIGNMENT 64
+
+// The settings a map was generated with, stored in its file header. Enum
+// fields hold the HeightmapGenerator, NoiseType and HeightmapWarp values.
+typedef struct HeightmapParams {
+    uint64_t seed;
+    int32_t generator;
+    int32_t noise;
+    int32_t warp;
+    int32_t octaves;
+    float scale;
+    float lacunarity;
+    float gain;
+    float disp_offset;
+    float displacement_strength;
+    float spectral_beta;
+} HeightmapParams;
+
+typedef struct Heightmap {
+    float *data;
+    size_t width, height;
+    size_t stride;      // floats from one row to the next
+    float min, max;
+    HeightmapParams params;
+    void *mapping;      // file mapping that data points into, or NULL if heap-owned
+    size_t mapping_size;
+} Heightmap;
+
+// Zero-filled heightmap; exits on allocation failure.
+Heightmap *heightmap_create(size_t width, size_t height);
+void heightmap_destroy(Heightmap *hm);
+// Heap-owned, writable copy of hm, whether hm is heap-owned or mapped.
+Heightmap *heightmap_copy(const Heightmap *hm);
+
+// Recomputes min and max from the data.
+void heightmap_update_range(Heightmap *hm);
+
+/*
+ * Brushes for editing a map in place. SMOOTH adds amount at the centre,
+ * easing to nothing at the rim, so a negative amount digs; CRATER digs a
+ * bowl amount deep ringed by a rim raised by 0.3 amount, as an impact
+ * leaves.
+ */
+typedef enum {
+    HEIGHTMAP_BRUSH_SMOOTH,
+    HEIGHTMAP_BRUSH_CRATER
+} HeightmapBrush;
+
+// Samples [x0, x1] x [y0, y1], unwrapped: x0 may be negative and x1 past
+// the width, for an edit straddling an edge.
+typedef struct HeightmapRect {
+    long x0, y0, x1, y1;
+} HeightmapRect;
+
+// Applies brush over the ellipse of radii rx and ry samples around (x, y),
+// wrapping around the map as on the torus, and returns the samples it
+// touched. hm must be heap-owned (see heightmap_copy). min and max are left
+// alone, so whatever was scaled by them keeps its scale; costs only the
+// samples inside the rectangle.
+HeightmapRect heightmap_stamp(Heightmap *hm, HeightmapBrush brush, float x, float y, float rx, float ry,
+                              float amount);
+
+static inline float *heightmap_row(const Heightmap *hm, size_t y)
+{
+    return hm->data + y * hm->stride;
+}
+
+static inline float heightmap_at(const Heightmap *hm, size_t x, size_t y)
+{
+    return hm->data[y * hm->stride + x];
+}
+
+// Any integer coordinates, wrapped onto the map as on the torus.
+static inline float heightmap_at_wrap(const Heightmap *hm, long x, long y)
+{
+    long w = (long)hm->width, h = (long)hm->height;
+    x %= w;
+    y %= h;
+    if (x < 0) x += w;
+    if (y < 0) y += h;
+    return hm->data[(size_t)y * hm->stride + (size_t)x];
+}
+
+/*
+ * The same map quantized to 16 bits: code c stands for min + c * step with
+ * step = (max - min) / 65535. That halves the memory of a float map at a
+ * height resolution far below anything the terrain mesh resolves. The
+ * Q16_RANS file encoding (save.h) compresses the codes, and
+ * heightmap_q16_sample (heightmap_sample.h) reads them in place, so a map
+ * can stay resident this way. Rows are laid out as in Heightmap, stride
+ * codes apart and 64-byte aligned.
+ */
+typedef struct HeightmapQ16 {
+    uint16_t *data;
+    size_t width, height;
+    size_t stride;      // codes from one row to the next
+    float min, max;
+    float step;
+    HeightmapParams params;
+} HeightmapQ16;
+
+// Zero-filled quantized map over [min, max]; exits on allocation failure.
+HeightmapQ16 *heightmap_q16_create(size_t width, size_t height, float min, float max);
+void heightmap_q16_destroy(HeightmapQ16 *q);
+
+// Quantizes hm over its current range, rounding to the nearest code.
+HeightmapQ16 *heightmap_quantize(const Heightmap *hm);
+// Float map decoded from q, with q's range. Uses the widest SIMD level
+// noise_simd_level allows; every level gives the same heights.
+Heightmap *heightmap_dequantize(const HeightmapQ16 *q);
+
+// Decodes count heights of row y, starting at column x, into out. Uses the
+// widest SIMD level noise_simd_level allows; every level gives the same
+// heights as heightmap_q16_at.
+void heightmap_q16_decode(const HeightmapQ16 *q, size_t y, size_t x, size_t count, float *out);
+
+static inline uint16_t *heightmap_q16_row(const HeightmapQ16 *q, size_t y)
+{
+    return q->data + y * q->stride;
+}
+
+static inline float heightmap_q16_at(const HeightmapQ16 *q, size_t x, size_t y)
+{
+    return q->min + (float)q->data[y * q->stride + x] * q->step;
+}
+
+#endif // HEIGHTMAP_H
@@ -0,0 +1,289 @@
+/*
+ * heightmap_codec.c
+ *
+ * Stream layout, all little-endian as written by this machine (the file
+ * header's byte order marker guards the rest):
+ *
+ *   CodecHeader                 stripe size and the two normalized models
+ *   uint64_t end[stripe_count]  end of each stripe's data, from the stream start
+ *   stripe data                 each a rANS state (4 bytes) then its bytes
+ *
+ * The rANS coder follows the usual byte-wise construction: a 32-bit state
+ * kept in [RANS_L, RANS_L << 8), symbols encoded in reverse so the decoder
+ * reads forwards, probabilities quantized to RANS_PROB_BITS.
+ */
+
+#include "heightmap_codec.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RANS_PROB_BITS 12
+#define RANS_PROB_SCALE (1u << RANS_PROB_BITS)
+#define RANS_L (1u << 23)
+#define CODEC_STRIPE_ROWS 32
+
+typedef struct CodecHeader {
+    uint32_t stripe_rows;
+    uint32_t stripe_count;
+    uint16_t freq[2][256];  // low byte and high byte models, each summing to RANS_PROB_SCALE
+} CodecHeader;
+
+typedef struct RansModel {
+    uint32_t freq[256];
+    uint32_t start[256];
+    uint8_t symbol[RANS_PROB_SCALE];  // symbol owning each slot, for decoding
+} RansModel;
+
+static size_t stripe_count(size_t height)
+{
+    return (height + CODEC_STRIPE_ROWS - 1) / CODEC_STRIPE_ROWS;
+}
+
+// Worst case for one stripe: a symbol of frequency 1 costs RANS_PROB_BITS
+// bits, so two symbols per code never take more than four bytes.
+static size_t stripe_bound(size_t width)
+{
+    return width * CODEC_STRIPE_ROWS * 4 + 8;
+}
+
+// Planar predictor: the terrain has no hard edges, so extending the local
+// slope beats edge-detecting predictors such as LOCO-I's median. up is NULL
+// on a stripe's first row, which is predicted from the west alone so stripes
+// stay independent.
+static inline uint32_t predict(const uint16_t *row, const uint16_t *up, size_t x)
+{
+    if (!up) return x ? row[x - 1] : 0;
+    if (!x) return up[0];
+    int32_t p = (int32_t)row[x - 1] + up[x] - up[x - 1];
+    return p < 0 ? 0 : p > 65535 ? 65535 : (uint32_t)p;
+}
+
+// Small residuals of either sign become small unsigned values.
+static inline uint16_t zigzag(uint16_t d)
+{
+    return (uint16_t)((d << 1) ^ (uint16_t)-(d >> 15));
+}
+
+static inline uint16_t unzigzag(uint16_t z)
+{
+    return (uint16_t)((z >> 1) ^ (uint16_t)-(z & 1));
+}
+
+// Scales symbol counts to frequencies summing to RANS_PROB_SCALE, keeping
+// every symbol that occurs codable.
+static void normalize_freq(const uint64_t *count, uint16_t *freq)
+{
+    uint64_t total = 0;
+    for (int s = 0; s < 256; s++) total += count[s];
+    if (total == 0) {
+        memset(freq, 0, 256 * sizeof(uint16_t));
+        return;
+    }
+
+    uint32_t sum = 0;
+    for (int s = 0; s < 256; s++) {
+        uint32_t f = (uint32_t)(count[s] * RANS_PROB_SCALE / total);
+        freq[s] = (uint16_t)(count[s] && f == 0 ? 1 : f);
+        sum += freq[s];
+    }
+    // Rounding up the rare symbols can overshoot; take it from the common ones.
+    while (sum > RANS_PROB_SCALE) {
+        int largest = 0;
+        for (int s = 1; s < 256; s++) {
+            if (freq[s] > freq[largest]) largest = s;
+        }
+        uint32_t take = sum - RANS_PROB_SCALE;
+        if (take > freq[largest] / 2u) take = freq[largest] / 2u;
+        freq[largest] -= (uint16_t)take;
+        sum -= take;
+    }
+    int largest = 0;
+    for (int s = 1; s < 256; s++) {
+        if (freq[s] > freq[largest]) largest = s;
+    }
+    freq[largest] += (uint16_t)(RANS_PROB_SCALE - sum);
+}
+
+// False unless freq sums to RANS_PROB_SCALE.
+static bool build_model(const uint16_t *freq, RansModel *m)
+{
+    uint32_t start = 0;
+    for (int s = 0; s < 256; s++) {
+        m->freq[s] = freq[s];
+        m->start[s] = start;
+        if (start + freq[s] > RANS_PROB_SCALE) return false;
+        memset(m->symbol + start, s, freq[s]);
+        start += freq[s];
+    }
+    return start == RANS_PROB_SCALE;
+}
+
+static inline void rans_put(uint32_t *state, unsigned char **ptr, const RansModel *m, uint32_t s)
+{
+    uint32_t x = *state, freq = m->freq[s];
+    const uint32_t x_max = ((RANS_L >> RANS_PROB_BITS) << 8) * freq;
+    while (x >= x_max) {
+        *--*ptr = (unsigned char)x;
+        x >>= 8;
+    }
+    *state = ((x / freq) << RANS_PROB_BITS) + (x % freq) + m->start[s];
+}
+
+// Encodes count residuals backwards from end and returns the bytes used.
+static size_t encode_stripe(const uint16_t *residual, size_t count, const RansModel *model, unsigned char *end)
+{
+    unsigned char *ptr = end;
+    uint32_t x = RANS_L;
+    for (size_t i = count; i-- > 0;) {
+        rans_put(&x, &ptr, &model[1], residual[i] >> 8);  // reversed: the decoder reads low then high
+        rans_put(&x, &ptr, &model[0], residual[i] & 0xFF);
+    }
+    ptr -= 4;
+    for (int i = 0; i < 4; i++) ptr[i] = (unsigned char)(x >> (8 * i));
+    return (size_t)(end - ptr);
+}
+
+size_t heightmap_encode_bound(const HeightmapQ16 *q)
+{
+    size_t stripes = stripe_count(q->height);
+    return sizeof(CodecHeader) + stripes * (sizeof(uint64_t) + stripe_bound(q->width));
+}
+
+size_t heightmap_encode(const HeightmapQ16 *q, unsigned char *out)
+{
+    const size_t width = q->width, height = q->height;
+    const size_t stripes = stripe_count(height), n = width * height;
+    uint16_t *residual = malloc((n ? n : 1) * sizeof(uint16_t));
+    if (!residual) {
+        perror("malloc failed");
+        exit(1);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (long y = 0; y < (long)height; y++) {
+        const uint16_t *row = heightmap_q16_row(q, (size_t)y);
+        const uint16_t *up = y % CODEC_STRIPE_ROWS ? heightmap_q16_row(q, (size_t)y - 1) : NULL;
+        uint16_t *res = residual + (size_t)y * width;
+        for (size_t x = 0; x < width; x++) {
+            res[x] = zigzag((uint16_t)(row[x] - predict(row, up, x)));
+        }
+    }
+
+    uint64_t count[2][256] = {{0}};
+    for (size_t i = 0; i < n; i++) {
+        count[0][residual[i] & 0xFF]++;
+        count[1][residual[i] >> 8]++;
+    }
+    CodecHeader header;
+    memset(&header, 0, sizeof(header));
+    header.stripe_rows = CODEC_STRIPE_ROWS;
+    header.stripe_count = (uint32_t)stripes;
+    RansModel *model = malloc(2 * sizeof(RansModel));
+    if (!model) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (int i = 0; i < 2; i++) {
+        normalize_freq(count[i], header.freq[i]);
+        build_model(header.freq[i], &model[i]);
+    }
+
+    // Each stripe is encoded at the end of its own worst-case region, then
+    // the stripes are packed down in order behind the offset table.
+    unsigned char *data = out + sizeof(CodecHeader) + stripes * sizeof(uint64_t);
+    size_t *length = malloc((stripes ? stripes : 1) * sizeof(size_t));
+    if (!length) {
+        perror("malloc failed");
+        exit(1);
+    }
+    const size_t region = stripe_bound(width);
+    #pragma omp parallel for schedule(dynamic)
+    for (long i = 0; i < (long)stripes; i++) {
+        size_t y0 = (size_t)i * CODEC_STRIPE_ROWS;
+        size_t rows = height - y0 < CODEC_STRIPE_ROWS ? height - y0 : CODEC_STRIPE_ROWS;
+        length[i] = encode_stripe(residual + y0 * width, rows * width, model, data + (size_t)(i + 1) * region);
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < stripes; i++) {
+        memmove(data + pos, data + (i + 1) * region - length[i], length[i]);
+        pos += length[i];
+        uint64_t end = (uint64_t)(data - out) + pos;
+        memcpy(out + sizeof(CodecHeader) + i * sizeof(uint64_t), &end, sizeof(end));
+    }
+    memcpy(out, &header, sizeof(header));
+
+    free(length);
+    free(model);
+    free(residual);
+    return (size_t)(data - out) + pos;
+}
+
+static bool decode_stripe(const unsigned char *ptr, const unsigned char *end, const RansModel *model,
+                          HeightmapQ16 *q, size_t y0, size_t y1)
+{
+    if (end - ptr < 4) return false;
+    uint32_t x = (uint32_t)ptr[0] | (uint32_t)ptr[1] << 8 | (uint32_t)ptr[2] << 16 | (uint32_t)ptr[3] << 24;
+    ptr += 4;
+
+    for (size_t y = y0; y < y1; y++) {
+        uint16_t *row = heightmap_q16_row(q, y);
+        const uint16_t *up = y > y0 ? heightmap_q16_row(q, y - 1) : NULL;
+        for (size_t u = 0; u < q->width; u++) {
+            uint32_t z = 0;
+            for (int b = 0; b < 2; b++) {
+                const RansModel *m = &model[b];
+                uint32_t slot = x & (RANS_PROB_SCALE - 1);
+                uint32_t s = m->symbol[slot];
+                x = m->freq[s] * (x >> RANS_PROB_BITS) + slot - m->start[s];
+                while (x < RANS_L) {
+                    if (ptr == end) return false;
+                    x = (x << 8) | *ptr++;
+                }
+                z |= s << (8 * b);
+            }
+            row[u] = (uint16_t)(predict(row, up, u) + unzigzag((uint16_t)z));
+        }
+    }
+    return x == RANS_L && ptr == end;  // back at the encoder's initial state
+}
+
+bool heightmap_decode(const unsigned char *in, size_t size, HeightmapQ16 *q)
+{
+    CodecHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, in, sizeof(header));
+    const size_t stripes = stripe_count(q->height);
+    if (header.stripe_rows != CODEC_STRIPE_ROWS || header.stripe_count != stripes ||
+        (size - sizeof(header)) / sizeof(uint64_t) < stripes) {
+        return false;
+    }
+
+    RansModel *model = malloc(2 * sizeof(RansModel));
+    if (!model) {
+        perror("malloc failed");
+        exit(1);
+    }
+    if (q->width * q->height > 0 &&
+        !(build_model(header.freq[0], &model[0]) && build_model(header.freq[1], &model[1]))) {
+        free(model);
+        return false;
+    }
+
+    const size_t data = sizeof(header) + stripes * sizeof(uint64_t);
+    bool ok = true;
+    #pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+    for (long i = 0; i < (long)stripes; i++) {
+        uint64_t begin = data, end;
+        if (i > 0) memcpy(&begin, in + sizeof(header) + (size_t)(i - 1) * sizeof(uint64_t), sizeof(begin));
+        memcpy(&end, in + sizeof(header) + (size_t)i * sizeof(uint64_t), sizeof(end));
+        size_t y0 = (size_t)i * CODEC_STRIPE_ROWS;
+        size_t y1 = q->height - y0 < CODEC_STRIPE_ROWS ? q->height : y0 + CODEC_STRIPE_ROWS;
+        ok = ok && begin >= data && begin <= end && end <= size &&
+             decode_stripe(in + begin, in + end, model, q, y0, y1);
+    }
+    free(model);
+    return ok;
+}
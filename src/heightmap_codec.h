@@ -0,0 +1,28 @@
+#ifndef HEIGHTMAP_CODEC_H
+#define HEIGHTMAP_CODEC_H
+
+/*
+ * Lossless compression for quantized heightmaps.
+ *
+ * Each code is predicted from its already decoded neighbours as west +
+ * north - northwest, and the zigzagged 16-bit residual is entropy coded by a
+ * byte-wise rANS coder, low and high byte under separate static models.
+ * Smooth terrain leaves small residuals, so the high byte is nearly always
+ * zero or one and costs about a bit. The map is cut into stripes of rows
+ * coded independently, which lets both directions run in parallel.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "heightmap.h"
+
+// Largest stream heightmap_encode can produce for q.
+size_t heightmap_encode_bound(const HeightmapQ16 *q);
+// Compresses q's codes into out, which holds at least heightmap_encode_bound
+// bytes, and returns the stream size.
+size_t heightmap_encode(const HeightmapQ16 *q, unsigned char *out);
+// Decompresses a stream made by heightmap_encode into q, which must already
+// have the encoded width and height. False if the stream is malformed.
+bool heightmap_decode(const unsigned char *in, size_t size, HeightmapQ16 *q);
+
+#endif // HEIGHTMAP_CODEC_H
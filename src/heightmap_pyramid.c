@@ -0,0 +1,263 @@
+#include "heightmap_pyramid.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static HeightmapBounds *bounds_alloc(size_t count)
+{
+    HeightmapBounds *b = malloc(count * sizeof(HeightmapBounds));
+    if (!b) {
+        perror("heightmap pyramid allocation failed");
+        exit(1);
+    }
+    return b;
+}
+
+// Plain comparisons rather than fminf/fmaxf, whose NaN handling keeps the
+// compiler from vectorizing the build loops.
+static inline float min2(float a, float b) { return a < b ? a : b; }
+static inline float max2(float a, float b) { return a > b ? a : b; }
+
+// Level 0: each cell's bounds over its four corner heights.
+static void build_cells(HeightmapPyramid *p)
+{
+    const Heightmap *hm = p->heightmap;
+    const size_t width = hm->width, height = hm->height;
+    HeightmapBounds *out = p->bounds[0];
+
+    #pragma omp parallel for schedule(static)
+    for (size_t y = 0; y < height; y++) {
+        const float *row0 = heightmap_row(hm, y);
+        const float *row1 = heightmap_row(hm, y + 1 < height ? y + 1 : 0);
+        HeightmapBounds *cells = out + y * width;
+        float lo = min2(row0[0], row1[0]), hi = max2(row0[0], row1[0]);
+        const float lo0 = lo, hi0 = hi;
+        for (size_t x = 0; x < width; x++) {
+            float next_lo = lo0, next_hi = hi0;  // column 0 again past the right edge
+            if (x + 1 < width) {
+                next_lo = min2(row0[x + 1], row1[x + 1]);
+                next_hi = max2(row0[x + 1], row1[x + 1]);
+            }
+            cells[x].min = min2(lo, next_lo);
+            cells[x].max = max2(hi, next_hi);
+            lo = next_lo;
+            hi = next_hi;
+        }
+    }
+}
+
+// Level l from the 2 x 2 blocks of level l - 1 under each block.
+static void build_level(HeightmapPyramid *p, int l)
+{
+    const size_t cw = p->width[l - 1], ch = p->height[l - 1];
+    const size_t width = p->width[l], height = p->height[l];
+    const HeightmapBounds *child = p->bounds[l - 1];
+    HeightmapBounds *out = p->bounds[l];
+
+    #pragma omp parallel for schedule(static) if (width * height >= 4096)
+    for (size_t y = 0; y < height; y++) {
+        const HeightmapBounds *row0 = child + 2 * y * cw;
+        const HeightmapBounds *row1 = 2 * y + 1 < ch ? row0 + cw : row0;
+        for (size_t x = 0; x < width; x++) {
+            const size_t x0 = 2 * x, x1 = 2 * x + 1 < cw ? 2 * x + 1 : 2 * x;
+            out[y * width + x].min = min2(min2(row0[x0].min, row0[x1].min), min2(row1[x0].min, row1[x1].min));
+            out[y * width + x].max = max2(max2(row0[x0].max, row0[x1].max), max2(row1[x0].max, row1[x1].max));
+        }
+    }
+}
+
+HeightmapPyramid *heightmap_pyramid_create(const Heightmap *hm)
+{
+    HeightmapPyramid *p = malloc(sizeof(HeightmapPyramid));
+    if (!p) {
+        perror("heightmap pyramid allocation failed");
+        exit(1);
+    }
+    memset(p, 0, sizeof(*p));
+    p->heightmap = hm;
+
+    size_t width = hm->width, height = hm->height;
+    for (int l = 0; l < HEIGHTMAP_PYRAMID_MAX_LEVELS; l++) {
+        p->width[l] = width;
+        p->height[l] = height;
+        p->bounds[l] = bounds_alloc(width * height);
+        p->levels = l + 1;
+        if (l == 0) build_cells(p);
+        else build_level(p, l);
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    return p;
+}
+
+void heightmap_pyramid_destroy(HeightmapPyramid *p)
+{
+    if (!p) return;
+    for (int l = 0; l < p->levels; l++) free(p->bounds[l]);
+    free(p);
+}
+
+static long wrap(long i, long n)
+{
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+/*
+ * Where the ray first reaches the bilinear patch of the level 0 cell whose
+ * corner is (cx, cy), over the s in [0, length] measured from the point
+ * (px, py, z) relative to that corner. The gap between ray and patch is a
+ * quadratic in s, so the first root is exact.
+ */
+static bool hit_cell(const Heightmap *hm, long cx, long cy, double px, double py, double z,
+                     const double d[3], double length, double *s_hit, float normal[3])
+{
+    const double h00 = heightmap_at_wrap(hm, cx, cy), h10 = heightmap_at_wrap(hm, cx + 1, cy);
+    const double h01 = heightmap_at_wrap(hm, cx, cy + 1), h11 = heightmap_at_wrap(hm, cx + 1, cy + 1);
+    const double A = h10 - h00, B = h01 - h00, C = h00 - h10 - h01 + h11;
+
+    const double c = z - (h00 + A * px + B * py + C * px * py);
+    const double b = d[2] - (A * d[0] + B * d[1] + C * (px * d[1] + py * d[0]));
+    const double a = -C * d[0] * d[1];
+
+    double s = -1.0;
+    if (c <= 0.0) {
+        s = 0.0;
+    } else if (fabs(a) <= 1e-12 * (fabs(b) + fabs(c))) {
+        if (b < 0.0) s = -c / b;
+    } else {
+        const double disc = b * b - 4.0 * a * c;
+        if (disc >= 0.0) {
+            const double q = -0.5 * (b + copysign(sqrt(disc), b));
+            double r0 = q / a, r1 = q != 0.0 ? c / q : r0;
+            if (r0 > r1) { double tmp = r0; r0 = r1; r1 = tmp; }
+            s = r0 >= 0.0 ? r0 : r1;
+        }
+    }
+    if (s < 0.0 || s > length) return false;
+
+    const double fx = px + d[0] * s, fy = py + d[1] * s;
+    const double nx = -(A + C * fy), ny = -(B + C * fx);
+    const double inv = 1.0 / sqrt(nx * nx + ny * ny + 1.0);
+    normal[0] = (float)(nx * inv);
+    normal[1] = (float)(ny * inv);
+    normal[2] = (float)inv;
+    *s_hit = s;
+    return true;
+}
+
+/*
+ * Walks the ray through the pyramid from the top: a block the ray passes
+ * wholly above is stepped over in one go and the walk climbs a level, one it
+ * might touch is descended into, down to single cells that are tested
+ * exactly. Cells are tracked as unwrapped integer coordinates, so stepping
+ * out of a block is exact however the arithmetic rounds, and wrapping only
+ * happens when a block is looked up.
+ */
+bool heightmap_raycast(const HeightmapPyramid *p, const HeightmapRay *ray, HeightmapHit *hit)
+{
+    const Heightmap *hm = p->heightmap;
+    const long W = (long)hm->width, H = (long)hm->height;
+    const double o[3] = { ray->origin[0], ray->origin[1], ray->origin[2] };
+    const double d[3] = { ray->direction[0], ray->direction[1], ray->direction[2] };
+    const double t_max = ray->t_max;
+    const HeightmapBounds top = p->bounds[p->levels - 1][0];
+
+    if (hit) hit->hit = false;
+    if (!(t_max >= 0.0)) return false;
+    if (d[2] >= 0.0 && o[2] > top.max) return false;
+
+    // Blocks wider than the ray's whole footprint cannot skip any more of
+    // it, so short rays (suspension probes) start and stay low.
+    const double extent = (fabs(d[0]) + fabs(d[1])) * t_max;
+    int top_level = 0;
+    while (top_level + 1 < p->levels && (double)(1L << top_level) < extent) top_level++;
+    int level = top_level;
+    double t = 0.0;
+    long ix = (long)floor(o[0]), iy = (long)floor(o[1]);
+
+    for (;;) {
+        const long size = 1L << level;
+        const long wx = wrap(ix, W), wy = wrap(iy, H);
+        const long bx = wx >> level, by = wy >> level;
+        const long x0 = ix - (wx - (bx << level)), y0 = iy - (wy - (by << level));
+        const long x1 = x0 + (size < W - (bx << level) ? size : W - (bx << level));
+        const long y1 = y0 + (size < H - (by << level) ? size : H - (by << level));
+
+        const double tx = d[0] > 0.0 ? (x1 - o[0]) / d[0] : d[0] < 0.0 ? (x0 - o[0]) / d[0] : INFINITY;
+        const double ty = d[1] > 0.0 ? (y1 - o[1]) / d[1] : d[1] < 0.0 ? (y0 - o[1]) / d[1] : INFINITY;
+        double t_exit = tx < ty ? tx : ty;
+        if (t_exit > t_max) t_exit = t_max;
+        if (t_exit < t) t_exit = t;
+
+        const HeightmapBounds b = p->bounds[level][(size_t)by * p->width[level] + (size_t)bx];
+        const double z = o[2] + d[2] * t, z_exit = o[2] + d[2] * t_exit;
+
+        if ((z < z_exit ? z : z_exit) <= b.max) {
+            if (level > 0) {
+                level--;
+                continue;
+            }
+            double s;
+            float normal[3];
+            if (hit_cell(hm, ix, iy, o[0] + d[0] * t - ix, o[1] + d[1] * t - iy, z, d, t_exit - t, &s, normal)) {
+                if (hit) {
+                    const double th = t + s;
+                    const double x = o[0] + d[0] * th, y = o[1] + d[1] * th;
+                    hit->hit = true;
+                    hit->t = (float)th;
+                    hit->position[0] = (float)(x - floor(x / W) * W);
+                    hit->position[1] = (float)(y - floor(y / H) * H);
+                    hit->position[2] = (float)(o[2] + d[2] * th);
+                    memcpy(hit->normal, normal, sizeof(normal));
+                }
+                return true;
+            }
+        }
+
+        // Step out of the block into its neighbour, clamping the coordinate
+        // along the face so rounding cannot leave the block's span.
+        if (t_exit >= t_max) return false;
+        t = t_exit;
+        if (tx <= ty) {
+            ix = d[0] > 0.0 ? x1 : x0 - 1;
+            const long ny = (long)floor(o[1] + d[1] * t);
+            iy = ny < y0 ? y0 : ny >= y1 ? y1 - 1 : ny;
+        } else {
+            iy = d[1] > 0.0 ? y1 : y0 - 1;
+            const long nx = (long)floor(o[0] + d[0] * t);
+            ix = nx < x0 ? x0 : nx >= x1 ? x1 - 1 : nx;
+        }
+        if (d[2] >= 0.0 && o[2] + d[2] * t > top.max) return false;
+        if (level < top_level) level++;
+    }
+}
+
+void heightmap_raycast_batch(const HeightmapPyramid *p, const HeightmapRay *rays, size_t count, HeightmapHit *hits)
+{
+    #pragma omp parallel for schedule(dynamic, 64) if (count >= 256)
+    for (size_t i = 0; i < count; i++)
+        heightmap_raycast(p, &rays[i], &hits[i]);
+}
+
+// A hit exactly at b (a point lying on the surface) still counts as seen.
+bool heightmap_segment_visible(const HeightmapPyramid *p, const float a[3], const float b[3])
+{
+    HeightmapRay ray = {
+        .origin = { a[0], a[1], a[2] },
+        .direction = { b[0] - a[0], b[1] - a[1], b[2] - a[2] },
+        .t_max = 1.0f
+    };
+    HeightmapHit hit;
+    return !heightmap_raycast(p, &ray, &hit) || hit.t >= 1.0f;
+}
+
+void heightmap_segment_visible_batch(const HeightmapPyramid *p, const float (*a)[3], const float (*b)[3],
+                                     size_t count, bool *visible)
+{
+    #pragma omp parallel for schedule(dynamic, 64) if (count >= 256)
+    for (size_t i = 0; i < count; i++)
+        visible[i] = heightmap_segment_visible(p, a[i], b[i]);
+}
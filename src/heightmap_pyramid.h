@@ -0,0 +1,66 @@
+#ifndef HEIGHTMAP_PYRAMID_H
+#define HEIGHTMAP_PYRAMID_H
+
+/*
+ * Min/max pyramid over a heightmap, for ray queries that skip empty space.
+ *
+ * The terrain surface is taken as one bilinear patch per cell: cell (x, y)
+ * spans [x, x + 1] x [y, y + 1] between the four heights at its corners,
+ * wrapping at the map edges as on the torus, so a map of width x height
+ * heights has width x height cells. Level 0 of the pyramid bounds each
+ * cell; every level above bounds 2 x 2 blocks of the one below, up to a
+ * single block over the whole map.
+ *
+ * Rays live in heightmap space: x and y in cells, z in the heightmap's own
+ * height units. They wrap around the map however far they go. A ray hits
+ * where it first reaches the surface; one that starts below it hits at once.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "heightmap.h"
+
+#define HEIGHTMAP_PYRAMID_MAX_LEVELS 32
+
+typedef struct HeightmapBounds {
+    float min, max;
+} HeightmapBounds;
+
+typedef struct HeightmapPyramid {
+    const Heightmap *heightmap;  // not owned; must outlive the pyramid
+    int levels;
+    size_t width[HEIGHTMAP_PYRAMID_MAX_LEVELS];   // blocks per row at each level
+    size_t height[HEIGHTMAP_PYRAMID_MAX_LEVELS];  // block rows at each level
+    HeightmapBounds *bounds[HEIGHTMAP_PYRAMID_MAX_LEVELS];  // width x height blocks of 2^level cells
+} HeightmapPyramid;
+
+typedef struct HeightmapRay {
+    float origin[3];
+    float direction[3];  // need not be normalized; t is in multiples of it
+    float t_max;         // how far along the ray to look
+} HeightmapRay;
+
+typedef struct HeightmapHit {
+    bool hit;
+    float t;             // origin + t * direction is the hit point
+    float position[3];   // x and y wrapped onto the map
+    float normal[3];     // unit surface normal, in heightmap space
+} HeightmapHit;
+
+// Builds the pyramid over hm in parallel; exits on allocation failure.
+HeightmapPyramid *heightmap_pyramid_create(const Heightmap *hm);
+void heightmap_pyramid_destroy(HeightmapPyramid *p);
+
+// First hit of ray on the terrain within [0, t_max]. hit may be NULL when
+// only whether there is one matters.
+bool heightmap_raycast(const HeightmapPyramid *p, const HeightmapRay *ray, HeightmapHit *hit);
+// heightmap_raycast for count rays, in parallel when there are enough.
+void heightmap_raycast_batch(const HeightmapPyramid *p, const HeightmapRay *rays, size_t count, HeightmapHit *hits);
+
+// Whether the straight segment from a to b clears the terrain.
+bool heightmap_segment_visible(const HeightmapPyramid *p, const float a[3], const float b[3]);
+// heightmap_segment_visible for count segments from a[i] to b[i].
+void heightmap_segment_visible_batch(const HeightmapPyramid *p, const float (*a)[3], const float (*b)[3],
+                                     size_t count, bool *visible);
+
+#endif // HEIGHTMAP_PYRAMID_H
@@ -0,0 +1,366 @@
+#include "heightmap_sample.h"
+#include "noise_simd.h"
+#include <math.h>
+#include <stdint.h>
+#if NOISE_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/*
+ * Every path below evaluates the same expressions in the same order, and the
+ * file is built with -ffp-contract=off, so the batched kernels match
+ * heightmap_sample bit for bit.
+ */
+
+// Wraps v onto [0, n) and splits it into a sample index and the fraction
+// past it. Rounding can land exactly on n or just below 0; both are fixed up.
+static inline int split(float v, float n, int size, float *frac)
+{
+    const float w = v - floorf(v / n) * n;
+    const float f = floorf(w);
+    int i = (int)f;
+    *frac = w - f;
+    if (i >= size) i -= size;
+    if (i < 0) i += size;
+    return i;
+}
+
+static inline int next(int i, int size) { return i + 1 == size ? 0 : i + 1; }
+static inline int prev(int i, int size) { return i == 0 ? size - 1 : i - 1; }
+
+// Catmull-Rom weights of the samples at -1, 0, 1 and 2 for fraction t, and
+// their derivatives.
+static inline void cubic_weights(float t, float w[4])
+{
+    w[0] = t * (-0.5f + t * (1.0f - 0.5f * t));
+    w[1] = 1.0f + t * t * (-2.5f + 1.5f * t);
+    w[2] = t * (0.5f + t * (2.0f - 1.5f * t));
+    w[3] = t * t * (-0.5f + 0.5f * t);
+}
+
+static inline void cubic_derivatives(float t, float w[4])
+{
+    w[0] = -0.5f + t * (2.0f - 1.5f * t);
+    w[1] = t * (-5.0f + 4.5f * t);
+    w[2] = 0.5f + t * (4.0f - 4.5f * t);
+    w[3] = t * (-1.0f + 1.5f * t);
+}
+
+static inline float dot4(const float w[4], const float p[4])
+{
+    return w[0] * p[0] + w[1] * p[1] + w[2] * p[2] + w[3] * p[3];
+}
+
+// Bilinear height, and gradient when asked, from the corners of a cell:
+// a at (0, 0), b at (1, 0), c at (0, 1), d at (1, 1).
+static inline float bilinear(float a, float b, float c, float d, float fx, float fy, float *dh_dx, float *dh_dy)
+{
+    const float h0 = a + (b - a) * fx, h1 = c + (d - c) * fx;
+    const float h = h0 + (h1 - h0) * fy;
+    if (dh_dx) *dh_dx = (b - a) + ((d - c) - (b - a)) * fy;
+    if (dh_dy) *dh_dy = h1 - h0;
+    return h;
+}
+
+// Catmull-Rom height, and gradient when asked, from the 4 x 4 samples
+// around a cell, rows first.
+static inline float bicubic(const float p[4][4], float fx, float fy, float *dh_dx, float *dh_dy)
+{
+    float wx[4], wy[4], rows[4];
+    cubic_weights(fx, wx);
+    cubic_weights(fy, wy);
+    for (int j = 0; j < 4; j++) rows[j] = dot4(wx, p[j]);
+    const float h = dot4(wy, rows);
+    if (dh_dx || dh_dy) {
+        float dwx[4], dwy[4], drows[4];
+        cubic_derivatives(fx, dwx);
+        cubic_derivatives(fy, dwy);
+        for (int j = 0; j < 4; j++) drows[j] = dot4(dwx, p[j]);
+        if (dh_dx) *dh_dx = dot4(wy, drows);
+        if (dh_dy) *dh_dy = dot4(dwy, rows);
+    }
+    return h;
+}
+
+// The 4 x 4 samples around cell (ix, iy), rows first.
+static inline void gather16(const Heightmap *hm, int ix, int iy, float p[4][4])
+{
+    const int W = (int)hm->width, H = (int)hm->height;
+    const int xs[4] = { prev(ix, W), ix, next(ix, W), next(next(ix, W), W) };
+    const int ys[4] = { prev(iy, H), iy, next(iy, H), next(next(iy, H), H) };
+    for (int j = 0; j < 4; j++) {
+        const float *row = heightmap_row(hm, (size_t)ys[j]);
+        for (int i = 0; i < 4; i++) p[j][i] = row[xs[i]];
+    }
+}
+
+float heightmap_sample_grad(const Heightmap *hm, HeightmapFilter filter, float x, float y,
+                            float *dh_dx, float *dh_dy)
+{
+    const int W = (int)hm->width, H = (int)hm->height;
+    float fx, fy;
+
+    if (filter == HEIGHTMAP_FILTER_NEAREST) {
+        const int ix = split(x + 0.5f, (float)W, W, &fx), iy = split(y + 0.5f, (float)H, H, &fy);
+        if (dh_dx) *dh_dx = 0.0f;
+        if (dh_dy) *dh_dy = 0.0f;
+        return heightmap_at(hm, (size_t)ix, (size_t)iy);
+    }
+
+    const int ix = split(x, (float)W, W, &fx), iy = split(y, (float)H, H, &fy);
+    if (filter == HEIGHTMAP_FILTER_BILINEAR) {
+        const float *row0 = heightmap_row(hm, (size_t)iy), *row1 = heightmap_row(hm, (size_t)next(iy, H));
+        const int ix1 = next(ix, W);
+        return bilinear(row0[ix], row0[ix1], row1[ix], row1[ix1], fx, fy, dh_dx, dh_dy);
+    }
+
+    float p[4][4];
+    gather16(hm, ix, iy, p);
+    return bicubic(p, fx, fy, dh_dx, dh_dy);
+}
+
+float heightmap_sample(const Heightmap *hm, HeightmapFilter filter, float x, float y)
+{
+    return heightmap_sample_grad(hm, filter, x, y, NULL, NULL);
+}
+
+void heightmap_sample_normal(const Heightmap *hm, HeightmapFilter filter, float x, float y,
+                             float scale_x, float scale_y, float scale_h, float normal[3])
+{
+    float dh_dx, dh_dy;
+    heightmap_sample_grad(hm, filter, x, y, &dh_dx, &dh_dy);
+    const float nx = -dh_dx * scale_h / scale_x, ny = -dh_dy * scale_h / scale_y;
+    const float inv = 1.0f / sqrtf(nx * nx + ny * ny + 1.0f);
+    normal[0] = nx * inv;
+    normal[1] = ny * inv;
+    normal[2] = inv;
+}
+
+#if NOISE_HAVE_X86_SIMD
+typedef struct {
+    __m256i index;  // wrapped sample index
+    __m256 frac;
+} Split8;
+
+NOISE_TARGET_AVX2 static inline Split8 split_avx2(__m256 v, float n, int size)
+{
+    const __m256 vn = _mm256_set1_ps(n);
+    const __m256i vsize = _mm256_set1_epi32(size);
+    const __m256 w = _mm256_sub_ps(v, _mm256_mul_ps(_mm256_floor_ps(_mm256_div_ps(v, vn)), vn));
+    const __m256 f = _mm256_floor_ps(w);
+    __m256i i = _mm256_cvttps_epi32(f);
+    i = _mm256_sub_epi32(i, _mm256_and_si256(_mm256_cmpgt_epi32(i, _mm256_set1_epi32(size - 1)), vsize));
+    i = _mm256_add_epi32(i, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), i), vsize));
+    return (Split8){ i, _mm256_sub_ps(w, f) };
+}
+
+NOISE_TARGET_AVX2 static inline __m256i next_avx2(__m256i i, int size)
+{
+    const __m256i n = _mm256_add_epi32(i, _mm256_set1_epi32(1));
+    return _mm256_andnot_si256(_mm256_cmpeq_epi32(n, _mm256_set1_epi32(size)), n);
+}
+
+NOISE_TARGET_AVX2 static inline __m256i prev_avx2(__m256i i, int size)
+{
+    const __m256i wrap = _mm256_and_si256(_mm256_cmpeq_epi32(i, _mm256_setzero_si256()), _mm256_set1_epi32(size));
+    return _mm256_sub_epi32(_mm256_add_epi32(i, wrap), _mm256_set1_epi32(1));
+}
+
+NOISE_TARGET_AVX2 static inline __m256 at_avx2(const float *data, __m256i row, __m256i x)
+{
+    return _mm256_i32gather_ps(data, _mm256_add_epi32(row, x), 4);
+}
+
+// The Catmull-Rom row sum w0 * p0 + w1 * p1 + w2 * p2 + w3 * p3.
+NOISE_TARGET_AVX2 static inline __m256 dot4_avx2(const __m256 w[4], const __m256 p[4])
+{
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(w[0], p[0]), _mm256_mul_ps(w[1], p[1]));
+    s = _mm256_add_ps(s, _mm256_mul_ps(w[2], p[2]));
+    return _mm256_add_ps(s, _mm256_mul_ps(w[3], p[3]));
+}
+
+NOISE_TARGET_AVX2 static inline void cubic_weights_avx2(__m256 t, __m256 w[4])
+{
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), three_halves = _mm256_set1_ps(1.5f);
+    const __m256 tt = _mm256_mul_ps(t, t);
+    w[0] = _mm256_mul_ps(t, _mm256_add_ps(_mm256_set1_ps(-0.5f),
+                                          _mm256_mul_ps(t, _mm256_sub_ps(one, _mm256_mul_ps(half, t)))));
+    w[1] = _mm256_add_ps(one, _mm256_mul_ps(tt, _mm256_add_ps(_mm256_set1_ps(-2.5f), _mm256_mul_ps(three_halves, t))));
+    w[2] = _mm256_mul_ps(t, _mm256_add_ps(half, _mm256_mul_ps(t, _mm256_sub_ps(_mm256_set1_ps(2.0f),
+                                                                              _mm256_mul_ps(three_halves, t)))));
+    w[3] = _mm256_mul_ps(tt, _mm256_add_ps(_mm256_set1_ps(-0.5f), _mm256_mul_ps(half, t)));
+}
+
+NOISE_TARGET_AVX2 static void sample_avx2(const Heightmap *hm, HeightmapFilter filter, const float *x,
+                                          const float *y, size_t count, float *out)
+{
+    const int W = (int)hm->width, H = (int)hm->height;
+    const __m256i stride = _mm256_set1_epi32((int)hm->stride);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i);
+        if (filter == HEIGHTMAP_FILTER_NEAREST) {
+            vx = _mm256_add_ps(vx, _mm256_set1_ps(0.5f));
+            vy = _mm256_add_ps(vy, _mm256_set1_ps(0.5f));
+        }
+        const Split8 sx = split_avx2(vx, (float)W, W), sy = split_avx2(vy, (float)H, H);
+        const __m256i row = _mm256_mullo_epi32(sy.index, stride);
+
+        if (filter == HEIGHTMAP_FILTER_NEAREST) {
+            _mm256_storeu_ps(out + i, at_avx2(hm->data, row, sx.index));
+        } else if (filter == HEIGHTMAP_FILTER_BILINEAR) {
+            const __m256i row1 = _mm256_mullo_epi32(next_avx2(sy.index, H), stride);
+            const __m256i x1 = next_avx2(sx.index, W);
+            const __m256 a = at_avx2(hm->data, row, sx.index), b = at_avx2(hm->data, row, x1);
+            const __m256 c = at_avx2(hm->data, row1, sx.index), d = at_avx2(hm->data, row1, x1);
+            const __m256 h0 = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), sx.frac));
+            const __m256 h1 = _mm256_add_ps(c, _mm256_mul_ps(_mm256_sub_ps(d, c), sx.frac));
+            _mm256_storeu_ps(out + i, _mm256_add_ps(h0, _mm256_mul_ps(_mm256_sub_ps(h1, h0), sy.frac)));
+        } else {
+            __m256i xs[4], rows[4];
+            xs[1] = sx.index;
+            xs[0] = prev_avx2(xs[1], W);
+            xs[2] = next_avx2(xs[1], W);
+            xs[3] = next_avx2(xs[2], W);
+            __m256i ys = prev_avx2(sy.index, H);
+            for (int j = 0; j < 4; j++) {
+                rows[j] = _mm256_mullo_epi32(ys, stride);
+                ys = next_avx2(ys, H);
+            }
+            __m256 wx[4], wy[4], sums[4];
+            cubic_weights_avx2(sx.frac, wx);
+            cubic_weights_avx2(sy.frac, wy);
+            for (int j = 0; j < 4; j++) {
+                __m256 p[4];
+                for (int k = 0; k < 4; k++) p[k] = at_avx2(hm->data, rows[j], xs[k]);
+                sums[j] = dot4_avx2(wx, p);
+            }
+            _mm256_storeu_ps(out + i, dot4_avx2(wy, sums));
+        }
+    }
+    for (; i < count; i++) out[i] = heightmap_sample(hm, filter, x[i], y[i]);
+}
+#endif
+
+void heightmap_sample_points(const Heightmap *hm, HeightmapFilter filter, const float *x, const float *y,
+                             size_t count, float *out)
+{
+#if NOISE_HAVE_X86_SIMD
+    // Gathers take 32-bit offsets.
+    if (noise_simd_level() == NOISE_SIMD_AVX2 && hm->stride * hm->height <= INT32_MAX) {
+        sample_avx2(hm, filter, x, y, count, out);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++) out[i] = heightmap_sample(hm, filter, x[i], y[i]);
+}
+
+float heightmap_q16_sample_grad(const HeightmapQ16 *q, HeightmapFilter filter, float x, float y,
+                                float *dh_dx, float *dh_dy)
+{
+    const int W = (int)q->width, H = (int)q->height;
+    float fx, fy;
+
+    if (filter == HEIGHTMAP_FILTER_NEAREST) {
+        const int ix = split(x + 0.5f, (float)W, W, &fx), iy = split(y + 0.5f, (float)H, H, &fy);
+        if (dh_dx) *dh_dx = 0.0f;
+        if (dh_dy) *dh_dy = 0.0f;
+        return heightmap_q16_at(q, (size_t)ix, (size_t)iy);
+    }
+
+    const int ix = split(x, (float)W, W, &fx), iy = split(y, (float)H, H, &fy);
+    if (filter == HEIGHTMAP_FILTER_BILINEAR) {
+        const size_t ix1 = (size_t)next(ix, W), iy1 = (size_t)next(iy, H);
+        return bilinear(heightmap_q16_at(q, (size_t)ix, (size_t)iy), heightmap_q16_at(q, ix1, (size_t)iy),
+                        heightmap_q16_at(q, (size_t)ix, iy1), heightmap_q16_at(q, ix1, iy1), fx, fy, dh_dx, dh_dy);
+    }
+
+    const int xs[4] = { prev(ix, W), ix, next(ix, W), next(next(ix, W), W) };
+    const int ys[4] = { prev(iy, H), iy, next(iy, H), next(next(iy, H), H) };
+    float p[4][4];
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) p[j][i] = heightmap_q16_at(q, (size_t)xs[i], (size_t)ys[j]);
+    }
+    return bicubic(p, fx, fy, dh_dx, dh_dy);
+}
+
+float heightmap_q16_sample(const HeightmapQ16 *q, HeightmapFilter filter, float x, float y)
+{
+    return heightmap_q16_sample_grad(q, filter, x, y, NULL, NULL);
+}
+
+// Most points one run of heightmap_q16_sample_points takes, and most
+// columns it decodes.
+#define Q16_RUN_POINTS 64
+#define Q16_RUN_COLUMNS 256
+
+// Decodes count columns of row y from column x on, wrapping past the edge.
+static void decode_wrapped(const HeightmapQ16 *q, size_t y, size_t x, size_t count, float *out)
+{
+    while (count) {
+        const size_t n = q->width - x < count ? q->width - x : count;
+        heightmap_q16_decode(q, y, x, n, out);
+        out += n;
+        count -= n;
+        x = 0;
+    }
+}
+
+void heightmap_q16_sample_points(const HeightmapQ16 *q, HeightmapFilter filter, const float *x, const float *y,
+                                 size_t count, float *out)
+{
+    const int W = (int)q->width, H = (int)q->height;
+    // Rows and columns the filter reads before and after a point's cell.
+    const int before = filter == HEIGHTMAP_FILTER_BICUBIC;
+    const int after = filter == HEIGHTMAP_FILTER_NEAREST ? 0 : filter == HEIGHTMAP_FILTER_BILINEAR ? 1 : 2;
+    const float offset = filter == HEIGHTMAP_FILTER_NEAREST ? 0.5f : 0.0f;
+    float rows[4][Q16_RUN_COLUMNS];
+
+    size_t i = 0;
+    while (i < count) {
+        // A run: points in one row of cells, each at most a span to the
+        // right of the first, as a caller walking a row hands them over.
+        int ix[Q16_RUN_POINTS], iy;
+        float fx[Q16_RUN_POINTS], fy[Q16_RUN_POINTS];
+        ix[0] = split(x[i] + offset, (float)W, W, &fx[0]);
+        iy = split(y[i] + offset, (float)H, H, &fy[0]);
+        int n = 1, span = 0;
+        while (n < Q16_RUN_POINTS && i + n < count) {
+            float fxn, fyn;
+            const int ixn = split(x[i + n] + offset, (float)W, W, &fxn);
+            const int iyn = split(y[i + n] + offset, (float)H, H, &fyn);
+            int d = ixn - ix[0];
+            if (d < 0) d += W;
+            if (iyn != iy || d + before + after >= Q16_RUN_COLUMNS) break;
+            ix[n] = d;  // columns past the first cell from here on
+            fx[n] = fxn;
+            fy[n] = fyn;
+            if (d > span) span = d;
+            n++;
+        }
+
+        // Decode just the columns the run reads, then filter them exactly as
+        // heightmap_sample filters a float map.
+        const size_t x0 = (size_t)(before ? prev(ix[0], W) : ix[0]);
+        const int y0 = before ? prev(iy, H) : iy;
+        for (int r = 0, yr = y0; r <= before + after; r++, yr = next(yr, H)) {
+            decode_wrapped(q, (size_t)yr, x0, (size_t)(span + before + after + 1), rows[r]);
+        }
+        ix[0] = 0;
+        for (int k = 0; k < n; k++) {
+            const int c = ix[k] + before;
+            if (filter == HEIGHTMAP_FILTER_NEAREST) {
+                out[i + k] = rows[0][c];
+            } else if (filter == HEIGHTMAP_FILTER_BILINEAR) {
+                out[i + k] = bilinear(rows[0][c], rows[0][c + 1], rows[1][c], rows[1][c + 1], fx[k], fy[k], NULL, NULL);
+            } else {
+                float p[4][4];
+                for (int j = 0; j < 4; j++) {
+                    for (int m = 0; m < 4; m++) p[j][m] = rows[j][c - 1 + m];
+                }
+                out[i + k] = bicubic(p, fx[k], fy[k], NULL, NULL);
+            }
+        }
+        i += n;
+    }
+}
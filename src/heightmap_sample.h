@@ -0,0 +1,50 @@
+#ifndef HEIGHTMAP_SAMPLE_H
+#define HEIGHTMAP_SAMPLE_H
+
+/*
+ * Filtered heightmap lookups at fractional coordinates.
+ *
+ * Coordinates are in samples: height (i, j) sits at exactly (i, j), and
+ * anything outside [0, width) x [0, height) wraps around as on the torus.
+ * BILINEAR is the surface heightmap_pyramid intersects rays with; BICUBIC
+ * is Catmull-Rom, which passes through every sample and has a continuous
+ * gradient, so normals taken from it do not crease along cell edges.
+ */
+
+#include <stddef.h>
+#include "heightmap.h"
+
+typedef enum {
+    HEIGHTMAP_FILTER_NEAREST,
+    HEIGHTMAP_FILTER_BILINEAR,
+    HEIGHTMAP_FILTER_BICUBIC
+} HeightmapFilter;
+
+float heightmap_sample(const Heightmap *hm, HeightmapFilter filter, float x, float y);
+// Height and its derivatives along x and y, in heights per sample, from the
+// filter itself. NEAREST is a step function, so its gradient is zero.
+float heightmap_sample_grad(const Heightmap *hm, HeightmapFilter filter, float x, float y,
+                            float *dh_dx, float *dh_dy);
+// Unit normal of the surface whose samples are scale_x and scale_y apart and
+// whose heights are scaled by scale_h, with z as the height axis.
+void heightmap_sample_normal(const Heightmap *hm, HeightmapFilter filter, float x, float y,
+                             float scale_x, float scale_y, float scale_h, float normal[3]);
+
+// heightmap_sample at count points (x[i], y[i]) into out, eight at a time
+// with AVX2 gathers when noise_simd_level allows. Either way the result is
+// the same as heightmap_sample's.
+void heightmap_sample_points(const Heightmap *hm, HeightmapFilter filter, const float *x, const float *y,
+                             size_t count, float *out);
+
+// The same lookups on a map kept resident as 16-bit codes. Each gives
+// exactly what its float counterpart gives on heightmap_dequantize(q).
+float heightmap_q16_sample(const HeightmapQ16 *q, HeightmapFilter filter, float x, float y);
+float heightmap_q16_sample_grad(const HeightmapQ16 *q, HeightmapFilter filter, float x, float y,
+                                float *dh_dx, float *dh_dy);
+// heightmap_q16_sample at count points. Runs of points along a row of
+// cells decode only the columns they read, with heightmap_q16_decode's SIMD
+// kernels, rather than every code one by one.
+void heightmap_q16_sample_points(const HeightmapQ16 *q, HeightmapFilter filter, const float *x, const float *y,
+                                 size_t count, float *out);
+
+#endif // HEIGHTMAP_SAMPLE_H
@@ -0,0 +1,93 @@
+#include "io_worker.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct IoRequest {
+    IoJob job;
+    void *arg;
+    struct IoRequest *next;
+} IoRequest;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;  // a request was queued, or stopping
+static pthread_cond_t queue_idle = PTHREAD_COND_INITIALIZER;   // the queue ran dry
+static IoRequest *queue_head = NULL, *queue_tail = NULL;
+static bool running = false, stopping = false, busy = false;
+static pthread_t worker;
+
+static void *worker_main(void *unused) {
+    (void)unused;
+    pthread_mutex_lock(&queue_lock);
+    for (;;) {
+        while (!queue_head && !stopping) pthread_cond_wait(&queue_ready, &queue_lock);
+        if (!queue_head) break;  // stopping with nothing left
+        IoRequest *request = queue_head;
+        queue_head = request->next;
+        if (!queue_head) queue_tail = NULL;
+        busy = true;
+        pthread_mutex_unlock(&queue_lock);
+
+        request->job(request->arg);
+        free(request);
+
+        pthread_mutex_lock(&queue_lock);
+        busy = false;
+        if (!queue_head) pthread_cond_broadcast(&queue_idle);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return NULL;
+}
+
+void io_worker_submit(IoJob job, void *arg) {
+    IoRequest *request = malloc(sizeof(IoRequest));
+    if (!request) {
+        perror("malloc failed");
+        exit(1);
+    }
+    request->job = job;
+    request->arg = arg;
+    request->next = NULL;
+
+    pthread_mutex_lock(&queue_lock);
+    if (!running) {
+        stopping = false;
+        running = pthread_create(&worker, NULL, worker_main, NULL) == 0;
+        if (!running) {
+            pthread_mutex_unlock(&queue_lock);
+            printf("Could not start the I/O worker, writing synchronously\n");
+            free(request);
+            job(arg);
+            return;
+        }
+    }
+    if (queue_tail) queue_tail->next = request;
+    else queue_head = request;
+    queue_tail = request;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+void io_worker_flush(void) {
+    pthread_mutex_lock(&queue_lock);
+    while (running && (queue_head || busy)) pthread_cond_wait(&queue_idle, &queue_lock);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+void io_worker_shutdown(void) {
+    pthread_mutex_lock(&queue_lock);
+    if (!running) {
+        pthread_mutex_unlock(&queue_lock);
+        return;
+    }
+    stopping = true;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+
+    pthread_join(worker, NULL);
+    pthread_mutex_lock(&queue_lock);
+    running = false;
+    pthread_mutex_unlock(&queue_lock);
+}
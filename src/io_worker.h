@@ -0,0 +1,22 @@
+#ifndef IO_WORKER_H
+#define IO_WORKER_H
+
+/*
+ * A background thread for file writes nobody waits on: cache files and
+ * debug exports. The main thread queues a job and moves on, so startup
+ * blocks only on the data it needs. Jobs run one at a time, in the order
+ * they were queued.
+ */
+
+// A queued job. It owns arg and frees it when done.
+typedef void (*IoJob)(void *arg);
+
+// Queues job(arg), starting the worker on first use. Runs the job here and
+// now if the worker cannot be started.
+void io_worker_submit(IoJob job, void *arg);
+// Waits until every job queued so far has finished.
+void io_worker_flush(void);
+// Finishes the queue and stops the worker; a later submit starts it again.
+void io_worker_shutdown(void);
+
+#endif // IO_WORKER_H
@@ -2,6 +2,7 @@
 #include "render.h"
 #include "physics.h"
 #include "audio.h"
+#include "io_worker.h"
 
 int main(void) {
     //SetConfigFlags(FLAG_FULLSCREEN_MODE);
@@ -25,6 +26,7 @@ int main(void) {
     ShutdownRenderer();
     ShutdownPhysics();
     ShutdownAudio();
+    io_worker_shutdown();  // finish cache writes still in flight
     CloseWindow();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "mesh_cache.h"
+#include "save.h"
+#include "io_worker.h"
+
+// Called on each array stored after a MeshFileHeader, in file order.
+typedef bool (*MeshArrayVisit)(void *data, size_t size, void *arg);
+
+// Visits chunks' arrays in file order: the index arrays, the bounds, the
+// levels and level errors, then each chunk's vertices, normals and
+// texcoords. With alloc, each array is MemAlloc'd first, for loading.
+static bool visit_mesh_arrays(TerrainChunks *chunks, bool alloc, MeshArrayVisit visit, void *arg) {
+    const size_t index_size = chunks->wideIndices ? sizeof(uint32_t) : sizeof(unsigned short);
+    for (int si = 0; si < 2; si++) {
+        for (int sj = 0; sj < 2; sj++) {
+            for (int level = 0; level < TERRAIN_LOD_MAX_LEVELS; level++) {
+                for (unsigned edges = 0; edges < TERRAIN_LOD_EDGE_SETS; edges++) {
+                    const size_t size = (size_t)chunks->triangles[si][sj][level][edges] * 3 * index_size;
+                    if (!size) continue;
+                    void **indices = &chunks->indices[si][sj][level][edges];
+                    if (alloc) *indices = MemAlloc((unsigned int)size);
+                    if (!visit(*indices, size, arg)) return false;
+                }
+            }
+        }
+    }
+    const size_t count = (size_t)chunks->count;
+    if (!visit(chunks->bounds, count * sizeof(BoundingBox), arg) ||
+        !visit(chunks->lod->levels, count * sizeof(int), arg) ||
+        !visit(chunks->lod->errors, count * TERRAIN_LOD_MAX_LEVELS * sizeof(float), arg)) {
+        return false;
+    }
+    for (int c = 0; c < chunks->count; c++) {
+        Mesh *mesh = &chunks->meshes[c];
+        const size_t vertices = (size_t)mesh->vertexCount;
+        float **arrays[3] = { &mesh->vertices, &mesh->normals, &mesh->texcoords };
+        const size_t sizes[3] = { vertices * 3 * sizeof(float), vertices * 3 * sizeof(float),
+                                  vertices * 2 * sizeof(float) };
+        for (int a = 0; a < 3; a++) {
+            if (alloc) *arrays[a] = MemAlloc((unsigned int)sizes[a]);
+            if (!visit(*arrays[a], sizes[a], arg)) return false;
+        }
+    }
+    return true;
+}
+
+static MeshFileHeader mesh_file_header(const TerrainChunks *chunks, uint64_t key) {
+    MeshFileHeader h = { 0 };
+    memcpy(h.magic, MESH_FILE_MAGIC, sizeof(h.magic));
+    h.version = MESH_FILE_VERSION;
+    h.endian = SAVE_ENDIAN_MARKER;
+    h.embedding = chunks->embedding;
+    h.key = key;
+    h.rings = chunks->rings;
+    h.sides = chunks->sides;
+    h.chunks_i = chunks->chunksI;
+    h.chunks_j = chunks->chunksJ;
+    h.chunk_rings = chunks->chunkRings;
+    h.chunk_sides = chunks->chunkSides;
+    h.last_rings = chunks->lastRings;
+    h.last_sides = chunks->lastSides;
+    h.wide_indices = chunks->wideIndices;
+    memcpy(h.triangles, chunks->triangles, sizeof(h.triangles));
+    memcpy(h.ring_period, &chunks->ringPeriod, sizeof(h.ring_period));
+    memcpy(h.side_period, &chunks->sidePeriod, sizeof(h.side_period));
+    h.height_min = chunks->heightMin;
+    h.height_scale = chunks->heightScale;
+    return h;
+}
+
+typedef struct MeshFile {
+    const TerrainChunks *chunks;
+    uint64_t key;
+} MeshFile;
+
+static bool write_array(void *data, size_t size, void *arg) {
+    return fwrite(data, 1, size, arg) == size;
+}
+
+static bool write_mesh(const char *path, const void *data) {
+    const MeshFile *m = data;
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("Cannot open file for writing");
+        return false;
+    }
+    const MeshFileHeader h = mesh_file_header(m->chunks, m->key);
+    // Only read from, but visit_mesh_arrays also serves the loader.
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && visit_mesh_arrays((TerrainChunks *)m->chunks, false, write_array, f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) perror("Failed to write terrain chunks");
+    return ok;
+}
+
+void save_terrain_chunks(const char *filename, const TerrainChunks *chunks, uint64_t key) {
+    char *full_path = resource_path(S_MESHES, filename);
+    MeshFile m = { chunks, key };
+    if (write_file(full_path, write_mesh, &m)) {
+        printf("Terrain chunks saved to %s\n", full_path);
+    }
+    free(full_path);
+}
+
+// A finished mesh file in memory, for the I/O worker to write out.
+typedef struct MeshSave {
+    char *filename;
+    size_t size;
+    unsigned char *data;
+} MeshSave;
+
+static bool measure_array(void *data, size_t size, void *arg) {
+    (void)data;
+    *(size_t *)arg += size;
+    return true;
+}
+
+static bool copy_array(void *data, size_t size, void *arg) {
+    unsigned char **out = arg;
+    memcpy(*out, data, size);
+    *out += size;
+    return true;
+}
+
+static bool write_mesh_save(const char *path, const void *data) {
+    const MeshSave *save = data;
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("Cannot open file for writing");
+        return false;
+    }
+    bool ok = fwrite(save->data, 1, save->size, f) == save->size;
+    if (fclose(f) != 0) ok = false;
+    if (!ok) perror("Failed to write terrain chunks");
+    return ok;
+}
+
+static void save_terrain_chunks_job(void *arg) {
+    MeshSave *save = arg;
+    char *full_path = resource_path(S_MESHES, save->filename);
+    if (write_file(full_path, write_mesh_save, save)) {
+        printf("Terrain chunks saved to %s\n", full_path);
+    }
+    free(full_path);
+    free(save->filename);
+    free(save->data);
+    free(save);
+}
+
+void save_terrain_chunks_async(const char *filename, const TerrainChunks *chunks, uint64_t key) {
+    TerrainChunks *source = (TerrainChunks *)chunks;  // only read from
+    const MeshFileHeader h = mesh_file_header(chunks, key);
+    size_t size = sizeof(h);
+    visit_mesh_arrays(source, false, measure_array, &size);
+
+    MeshSave *save = malloc(sizeof(MeshSave));
+    char *name = malloc(strlen(filename) + 1);
+    unsigned char *bytes = malloc(size);
+    if (!save || !name || !bytes) {
+        perror("malloc failed");
+        exit(1);
+    }
+    save->filename = strcpy(name, filename);
+    save->size = size;
+    save->data = bytes;
+    memcpy(bytes, &h, sizeof(h));
+    unsigned char *out = bytes + sizeof(h);
+    visit_mesh_arrays(source, false, copy_array, &out);
+    io_worker_submit(save_terrain_chunks_job, save);
+}
+
+static bool read_array(void *data, size_t size, void *arg) {
+    return fread(data, 1, size, arg) == size;
+}
+
+// Whether h describes chunks GenTerrainChunks could have cut: a grid split
+// evenly, and an index array for exactly the levels of each shape.
+static bool mesh_header_valid(const MeshFileHeader *h) {
+    if (h->chunks_i == 0 || h->chunks_j == 0 || h->chunks_i * h->chunks_j > INT_MAX) return false;
+    if (h->last_rings == 0 || h->last_rings > h->chunk_rings || h->last_sides == 0 ||
+        h->last_sides > h->chunk_sides) {
+        return false;
+    }
+    if (h->rings != (h->chunks_i - 1) * h->chunk_rings + h->last_rings ||
+        h->sides != (h->chunks_j - 1) * h->chunk_sides + h->last_sides) {
+        return false;
+    }
+    if (h->wide_indices != ((h->chunk_rings + 1) * (h->chunk_sides + 1) > 65536)) return false;
+    for (int si = 0; si < 2; si++) {
+        for (int sj = 0; sj < 2; sj++) {
+            const bool shape = !(si && h->last_rings == h->chunk_rings) && !(sj && h->last_sides == h->chunk_sides);
+            const int levels = shape ? terrain_lod_levels(si ? h->last_rings : h->chunk_rings,
+                                                          sj ? h->last_sides : h->chunk_sides)
+                                     : 0;
+            for (int level = 0; level < TERRAIN_LOD_MAX_LEVELS; level++) {
+                for (unsigned edges = 0; edges < TERRAIN_LOD_EDGE_SETS; edges++) {
+                    const int32_t triangles = h->triangles[si][sj][level][edges];
+                    if (level < levels ? triangles <= 0 : triangles != 0) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool load_terrain_chunks(const char *filename, uint64_t key, TerrainChunks *chunks) {
+    char *full_path = build_fullpath(S_RESOURCES, S_MESHES, filename);
+    FILE *f = fopen(full_path, "rb");
+    if (!f) {
+        printf("Terrain chunks do not exist at %s\n", full_path);
+        free(full_path);
+        return false;
+    }
+
+    MeshFileHeader h;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, MESH_FILE_MAGIC, sizeof(h.magic)) == 0 &&
+              h.endian == SAVE_ENDIAN_MARKER && h.version == MESH_FILE_VERSION && h.key == key &&
+              mesh_header_valid(&h);
+    TerrainChunks loaded = { 0 };
+    if (ok) {
+        loaded.count = (int)(h.chunks_i * h.chunks_j);
+        loaded.embedding = (TerrainMeshEmbedding)h.embedding;
+        loaded.rings = h.rings;
+        loaded.sides = h.sides;
+        memcpy(&loaded.ringPeriod, h.ring_period, sizeof(h.ring_period));
+        memcpy(&loaded.sidePeriod, h.side_period, sizeof(h.side_period));
+        loaded.heightMin = h.height_min;
+        loaded.heightScale = h.height_scale;
+        loaded.chunksI = h.chunks_i;
+        loaded.chunksJ = h.chunks_j;
+        loaded.chunkRings = h.chunk_rings;
+        loaded.chunkSides = h.chunk_sides;
+        loaded.lastRings = h.last_rings;
+        loaded.lastSides = h.last_sides;
+        loaded.wideIndices = h.wide_indices;
+        memcpy(loaded.triangles, h.triangles, sizeof(h.triangles));
+        loaded.meshes = MemAlloc(loaded.count * sizeof(Mesh));
+        loaded.bounds = MemAlloc(loaded.count * sizeof(BoundingBox));
+        loaded.bound = MemAlloc(loaded.count * sizeof(int));
+        loaded.lod = terrain_lod_create(loaded.chunksI, loaded.chunksJ, loaded.embedding == TERRAIN_MESH_TORUS);
+        for (int c = 0; c < loaded.count; c++) {
+            int si, sj;
+            terrain_chunk_shape(&loaded, c, &si, &sj);
+            const size_t quads_i = si ? loaded.lastRings : loaded.chunkRings;
+            const size_t quads_j = sj ? loaded.lastSides : loaded.chunkSides;
+            loaded.meshes[c].vertexCount = (int)((quads_i + 1) * (quads_j + 1));
+        }
+        ok = visit_mesh_arrays(&loaded, true, read_array, f) && fgetc(f) == EOF;  // nothing after the texcoords
+    }
+    fclose(f);
+    for (int c = 0; ok && c < loaded.count; c++) {
+        int si, sj;
+        terrain_chunk_shape(&loaded, c, &si, &sj);
+        ok = loaded.lod->levels[c] == terrain_lod_levels(si ? loaded.lastRings : loaded.chunkRings,
+                                                         sj ? loaded.lastSides : loaded.chunkSides);
+        memcpy(loaded.lod->bounds + 6 * c, &loaded.bounds[c], sizeof(BoundingBox));
+    }
+    if (!ok) {
+        fprintf(stderr, "Terrain chunks at %s are stale or unreadable\n", full_path);
+        UnloadTerrainChunks(&loaded);
+        free(full_path);
+        return false;
+    }
+
+    *chunks = loaded;
+    printf("Terrain chunks loaded from %s\n", full_path);
+    free(full_path);
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "torus.h"
+
+#define S_MESHES "meshes"
+
+// Mesh files hold finished terrain chunks: the header, the shared index
+// arrays of every shape, level and stitching, then each chunk's vertices,
+// normals, texcoords, bounds, levels and level errors. That is everything
+// GenTerrainChunks computes, so loading one skips the grid and the cut, and
+// the chunks' full-resolution vertices and indices are the colliders' data.
+#define MESH_FILE_MAGIC "TMSH"
+#define MESH_FILE_VERSION 2
+
+typedef struct MeshFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t endian;        // SAVE_ENDIAN_MARKER as the writer stored it
+    uint32_t embedding;     // TerrainMeshEmbedding
+    uint64_t key;           // cache key the chunks were saved under
+    uint64_t rings, sides;
+    uint64_t chunks_i, chunks_j;
+    uint64_t chunk_rings, chunk_sides;
+    uint64_t last_rings, last_sides;
+    uint32_t wide_indices;  // 32-bit rather than 16-bit indices
+    int32_t triangles[2][2][TERRAIN_LOD_MAX_LEVELS][TERRAIN_LOD_EDGE_SETS];  // 0 where there is no array
+    float ring_period[3], side_period[3];
+    float height_min, height_scale;
+} MeshFileHeader;
+
+// Writes resources/meshes/filename from chunks' CPU-side arrays.
+void save_terrain_chunks(const char *filename, const TerrainChunks *chunks, uint64_t key);
+// save_terrain_chunks on the I/O worker (io_worker.h), from a copy of the
+// arrays, so the caller can go on deforming the chunks.
+void save_terrain_chunks_async(const char *filename, const TerrainChunks *chunks, uint64_t key);
+// Reads resources/meshes/filename into freshly MemAlloc'd arrays, as
+// CutTerrainChunks would have them, ready for UploadTerrainChunks. False if
+// the file is missing, truncated, or was saved under another key, version or
+// byte order.
+bool load_terrain_chunks(const char *filename, uint64_t key, TerrainChunks *chunks);
+
+#endif // MESH_CACHE_H
@@ -15,8 +15,12 @@
  * gradient-based noise, making it suitable for isotropic patterns.
  *
  * Functions provided:
- * - float noise3d(float x, float y, float z): returns scalar value noise in 3D space
- * - float noise4d(float x, float y, float z, float w): returns scalar value noise in 4D space
+ * - float noise2d(ctx, x, y): returns scalar value noise in 2D space
+ * - float noise3d(ctx, x, y, z): returns scalar value noise in 3D space
+ * - float noise4d(ctx, x, y, z, w): returns scalar value noise in 4D space
+ *
+ * The hash has no tables; the context seeds it by shifting the integer lattice
+ * by ctx->value_offset.
  */
 
  #include "noise3d4d.h"
@@ -28,6 +32,10 @@ static inline float lerp(float a, float b, float t) { return a * (1.0f - t) + b
 static inline float smooth_interp(float t) { return t * t * (3.0f - 2.0f * t); }
 
 // --- Hash Functions ---
+float hash2(float x, float y) {
+    return fract(sinf(x * 127.1f + y * 311.7f) * 43758.5453f);
+}
+
 float hash3(float x, float y, float z) {
     return fract(sinf(x * 127.1f + y * 311.7f + z * 74.7f) * 43758.5453f);
 }
@@ -36,11 +44,32 @@ float hash4(float x, float y, float z, float w) {
     return fract(sinf(x * 127.1f + y * 311.7f + z * 74.7f + w * 269.5f) * 43758.5453f);
 }
 
+// --- 2D Gradient Noise ---
+float noise2d(const NoiseContext *ctx, float x, float y) {
+    int ix = (int)floorf(x) + ctx->value_offset[0];
+    int iy = (int)floorf(y) + ctx->value_offset[1];
+    float fx = fract(x);
+    float fy = fract(y);
+
+    float u = smooth_interp(fx);
+    float v = smooth_interp(fy);
+
+    float n00 = hash2(ix + 0, iy + 0);
+    float n10 = hash2(ix + 1, iy + 0);
+    float n01 = hash2(ix + 0, iy + 1);
+    float n11 = hash2(ix + 1, iy + 1);
+
+    float nx0 = lerp(n00, n10, u);
+    float nx1 = lerp(n01, n11, u);
+
+    return lerp(nx0, nx1, v);
+}
+
 // --- 3D Gradient Noise ---
-float noise3d(float x, float y, float z) {
-    int ix = (int)floorf(x);
-    int iy = (int)floorf(y);
-    int iz = (int)floorf(z);
+float noise3d(const NoiseContext *ctx, float x, float y, float z) {
+    int ix = (int)floorf(x) + ctx->value_offset[0];
+    int iy = (int)floorf(y) + ctx->value_offset[1];
+    int iz = (int)floorf(z) + ctx->value_offset[2];
     float fx = fract(x);
     float fy = fract(y);
     float fz = fract(z);
@@ -70,11 +99,11 @@ float noise3d(float x, float y, float z) {
 }
 
 // --- 4D Gradient Noise ---
-float noise4d(float x, float y, float z, float w_) {
-    int ix = (int)floorf(x);
-    int iy = (int)floorf(y);
-    int iz = (int)floorf(z);
-    int iw = (int)floorf(w_);
+float noise4d(const NoiseContext *ctx, float x, float y, float z, float w_) {
+    int ix = (int)floorf(x) + ctx->value_offset[0];
+    int iy = (int)floorf(y) + ctx->value_offset[1];
+    int iz = (int)floorf(z) + ctx->value_offset[2];
+    int iw = (int)floorf(w_) + ctx->value_offset[3];
     float fx = fract(x);
     float fy = fract(y);
     float fz = fract(z);
@@ -121,4 +150,16 @@ float noise4d(float x, float y, float z, float w_) {
     float nxyz1 = lerp(nxy01, nxy11, s);
 
     return lerp(nxyz0, nxyz1, t);
-}
\ No newline at end of file
+}
+
+// --- Batched 4D value noise ---
+//
+// The sinf-based hash has no bit-exact vector counterpart, so this is a plain
+// loop over noise4d. It exists so every NoiseType offers the same batch entry
+// point to the fBm and heightmap code.
+void noise4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                   float *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = noise4d(ctx, x[i], y[i], z[i], w[i]);
+    }
+}
@@ -1,7 +1,15 @@
 #ifndef NOISE3D4D_H
 #define NOISE3D4D_H
 
-float noise3d(float x, float y, float z);
-float noise4d(float x, float y, float z, float w);
+#include <stddef.h>
+#include "noise_context.h"
+
+float noise2d(const NoiseContext *ctx, float x, float y);
+float noise3d(const NoiseContext *ctx, float x, float y, float z);
+float noise4d(const NoiseContext *ctx, float x, float y, float z, float w);
+
+// Evaluates noise4d for n points given as separate coordinate arrays.
+void noise4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                   const float *w, float *out, size_t n);
 
 #endif // NOISE3D4D_H
\ No newline at end of file
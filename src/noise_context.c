@@ -0,0 +1,89 @@
+#define _POSIX_C_SOURCE 200112L  // posix_memalign
+
+#include "noise_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>  // _aligned_malloc
+#endif
+
+static const float grad3[12][3] = {
+    {1,1,0}, {-1,1,0}, {1,-1,0}, {-1,-1,0},
+    {1,0,1}, {-1,0,1}, {1,0,-1}, {-1,0,-1},
+    {0,1,1}, {0,-1,1}, {0,1,-1}, {0,-1,-1}
+};
+
+static const float grad4[32][4] = {
+    {0,1,1,1}, {0,1,1,-1}, {0,1,-1,1}, {0,1,-1,-1},
+    {0,-1,1,1}, {0,-1,1,-1}, {0,-1,-1,1}, {0,-1,-1,-1},
+    {1,0,1,1}, {1,0,1,-1}, {1,0,-1,1}, {1,0,-1,-1},
+    {-1,0,1,1}, {-1,0,1,-1}, {-1,0,-1,1}, {-1,0,-1,-1},
+    {1,1,0,1}, {1,1,0,-1}, {1,-1,0,1}, {1,-1,0,-1},
+    {-1,1,0,1}, {-1,1,0,-1}, {-1,-1,0,1}, {-1,-1,0,-1},
+    {1,1,1,0}, {1,1,-1,0}, {1,-1,1,0}, {1,-1,-1,0},
+    {-1,1,1,0}, {-1,1,-1,0}, {-1,-1,1,0}, {-1,-1,-1,0}
+};
+
+// splitmix64: tiny, fast, and every seed (including 0) gives a good stream.
+uint64_t noise_context_next(NoiseContext *ctx)
+{
+    uint64_t z = (ctx->rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+float noise_context_next_float(NoiseContext *ctx)
+{
+    return (noise_context_next(ctx) >> 40) * (1.0f / 16777216.0f);
+}
+
+void noise_context_init(NoiseContext *ctx, uint64_t seed)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->seed = seed;
+    ctx->rng = seed;
+
+    // Fisher-Yates shuffle of 0..255
+    unsigned char p[256];
+    for (int i = 0; i < 256; i++) p[i] = (unsigned char)i;
+    for (int i = 255; i > 0; i--) {
+        int j = (int)(noise_context_next(ctx) % (uint64_t)(i + 1));
+        unsigned char tmp = p[i];
+        p[i] = p[j];
+        p[j] = tmp;
+    }
+    for (int i = 0; i < 512; i++) ctx->perm[i] = p[i & 255];
+
+    memcpy(ctx->grad3, grad3, sizeof(grad3));
+    memcpy(ctx->grad4, grad4, sizeof(grad4));
+
+    for (int i = 0; i < 4; i++) ctx->value_offset[i] = (int)(noise_context_next(ctx) & 255);
+    ctx->hash_seed = (uint32_t)(noise_context_next(ctx) >> 32);
+}
+
+NoiseContext *noise_context_create(uint64_t seed)
+{
+    NoiseContext *ctx = NULL;
+#ifdef _WIN32
+    ctx = _aligned_malloc(sizeof(NoiseContext), NOISE_CACHE_LINE);
+#else
+    if (posix_memalign((void **)&ctx, NOISE_CACHE_LINE, sizeof(NoiseContext)) != 0) ctx = NULL;
+#endif
+    if (!ctx) {
+        perror("noise context allocation failed");
+        exit(1);
+    }
+    noise_context_init(ctx, seed);
+    return ctx;
+}
+
+void noise_context_destroy(NoiseContext *ctx)
+{
+#ifdef _WIN32
+    _aligned_free(ctx);
+#else
+    free(ctx);
+#endif
+}
@@ -0,0 +1,53 @@
+#ifndef NOISE_CONTEXT_H
+#define NOISE_CONTEXT_H
+
+/*
+ * Seeded state shared by the noise functions.
+ *
+ * A NoiseContext holds the permutation and gradient tables that the Perlin,
+ * simplex and value noise read, plus the PRNG that shuffled them. Every noise
+ * and fBm function takes the context as its first argument and only reads
+ * it, so one context can be shared by any number of threads, and two
+ * contexts with different seeds can be used side by side.
+ *
+ * The struct holds no pointers and is aligned to a cache line, so a plain
+ * assignment gives a worker its own private copy.
+ */
+
+#include <stdint.h>
+
+#define NOISE_CACHE_LINE 64
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define NOISE_ALIGNED __attribute__((aligned(NOISE_CACHE_LINE)))
+#elif defined(_MSC_VER)
+    #define NOISE_ALIGNED __declspec(align(NOISE_CACHE_LINE))
+#else
+    #define NOISE_ALIGNED
+#endif
+
+typedef struct NoiseContext {
+    // 256-entry permutation repeated twice, padded so the batched kernels can
+    // gather 32 bits at any index < 512.
+    unsigned char perm[512 + 4];
+    float grad3[12][3];         // simplex 3D gradient directions
+    float grad4[32][4];         // simplex 4D gradient directions
+    int value_offset[4];        // lattice shift that seeds the value noise hash
+    uint32_t hash_seed;         // key for the integer-hash value noise
+    uint64_t seed;
+    uint64_t rng;               // splitmix64 state
+} NOISE_ALIGNED NoiseContext;
+
+// Fills ctx from seed. The same seed always gives the same tables.
+void noise_context_init(NoiseContext *ctx, uint64_t seed);
+
+// Heap-allocated, cache-aligned context; exits on allocation failure.
+NoiseContext *noise_context_create(uint64_t seed);
+void noise_context_destroy(NoiseContext *ctx);
+
+// Next value of the context's PRNG, for callers that want seeded randomness
+// (offsets, per-variant parameters) tied to the same seed as the noise.
+uint64_t noise_context_next(NoiseContext *ctx);
+float noise_context_next_float(NoiseContext *ctx);  // in [0, 1)
+
+#endif // NOISE_CONTEXT_H
@@ -0,0 +1,56 @@
+#include "noise_simd.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The level in use, or -1 until the first call decides it. OpenMP workers
+// read it concurrently, so every access is atomic.
+static atomic_int detected = -1;
+
+static NoiseSimdLevel detect_level(void)
+{
+    NoiseSimdLevel level = NOISE_SIMD_SCALAR;
+#if NOISE_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) level = NOISE_SIMD_AVX2;
+    else if (__builtin_cpu_supports("sse4.1")) level = NOISE_SIMD_SSE41;
+#endif
+
+    const char *env = getenv("NOISE_SIMD");
+    if (env) {
+        NoiseSimdLevel cap = level;
+        if (strcmp(env, "scalar") == 0) cap = NOISE_SIMD_SCALAR;
+        else if (strcmp(env, "sse41") == 0) cap = NOISE_SIMD_SSE41;
+        else if (strcmp(env, "avx2") == 0) cap = NOISE_SIMD_AVX2;
+        if (cap < level) level = cap;
+    }
+    return level;
+}
+
+NoiseSimdLevel noise_simd_level(void)
+{
+    int level = atomic_load_explicit(&detected, memory_order_relaxed);
+    if (level < 0) {
+        // Threads arriving together all detect the same level; the first
+        // to store it wins, unless noise_simd_set_level got there first.
+        int expected = -1;
+        level = (int)detect_level();
+        if (!atomic_compare_exchange_strong(&detected, &expected, level)) level = expected;
+    }
+    return (NoiseSimdLevel)level;
+}
+
+void noise_simd_set_level(NoiseSimdLevel level)
+{
+    NoiseSimdLevel supported = detect_level();
+    atomic_store(&detected, (int)(level < supported ? level : supported));
+}
+
+const char *noise_simd_name(NoiseSimdLevel level)
+{
+    switch (level) {
+        case NOISE_SIMD_AVX2:  return "avx2";
+        case NOISE_SIMD_SSE41: return "sse41";
+        default:               return "scalar";
+    }
+}
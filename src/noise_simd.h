@@ -0,0 +1,34 @@
+#ifndef NOISE_SIMD_H
+#define NOISE_SIMD_H
+
+/*
+ * Runtime selection of the SIMD width used by the batched noise kernels.
+ *
+ * The batch entry points (perlin_noise4d_batch, simplex4d_batch, ...) are
+ * compiled for every level the compiler can target and pick one at runtime,
+ * so the game binary itself never needs -mavx2. Every level produces results
+ * bit-identical to the scalar functions.
+ *
+ * The environment variable NOISE_SIMD=scalar|sse41|avx2 caps the level, which
+ * is handy when comparing paths.
+ */
+
+typedef enum {
+    NOISE_SIMD_SCALAR,
+    NOISE_SIMD_SSE41,
+    NOISE_SIMD_AVX2
+} NoiseSimdLevel;
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+    #define NOISE_HAVE_X86_SIMD 1
+    #define NOISE_TARGET_SSE41 __attribute__((target("sse4.1")))
+    #define NOISE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define NOISE_HAVE_X86_SIMD 0
+#endif
+
+NoiseSimdLevel noise_simd_level(void);
+void noise_simd_set_level(NoiseSimdLevel level);
+const char *noise_simd_name(NoiseSimdLevel level);
+
+#endif // NOISE_SIMD_H
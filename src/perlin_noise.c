@@ -1,8 +1,11 @@
 #include "perlin_noise.h"
+#include "noise_simd.h"
 #include <stdlib.h>
 #include <math.h>
 
-static unsigned char perm[512];
+#if NOISE_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
 
 static float fade(float t)
 {
@@ -29,22 +32,9 @@ static float grad(int hash, float x, float y)
     }
 }
 
-void perlin_init(int seed)
-{
-    srand(seed);
-    unsigned char p[256];
-    for (int i = 0; i < 256; i++) p[i] = (unsigned char)i;
-    for (int i = 255; i > 0; i--) {
-        int j = rand() % (i + 1);
-        unsigned char tmp = p[i];
-        p[i] = p[j];
-        p[j] = tmp;
-    }
-    for (int i = 0; i < 512; i++) perm[i] = p[i & 255];
-}
-
-float perlin_noise2d(float x, float y)
+float perlin_noise2d(const NoiseContext *ctx, float x, float y)
 {
+    const unsigned char *perm = ctx->perm;
     int xi = (int)floorf(x) & 255;
     int yi = (int)floorf(y) & 255;
     float xf = x - floorf(x);
@@ -64,6 +54,44 @@ float perlin_noise2d(float x, float y)
     return lerp(v, x1, x2);
 }
 
+// Wraps a lattice coordinate into [0, period).
+static inline int wrap_lattice(int i, int period)
+{
+    // Samples mostly stay in [0, period), so skip the division there.
+    if ((unsigned)i >= (unsigned)period) {
+        i %= period;
+        if (i < 0) i += period;
+    }
+    return i;
+}
+
+float perlin_noise2d_periodic(const NoiseContext *ctx, float x, float y, int period_x, int period_y)
+{
+    const unsigned char *perm = ctx->perm;
+    float fx = floorf(x), fy = floorf(y);
+    int x0 = wrap_lattice((int)fx, period_x), y0 = wrap_lattice((int)fy, period_y);
+    int x1 = x0 + 1 == period_x ? 0 : x0 + 1;
+    int y1 = y0 + 1 == period_y ? 0 : y0 + 1;
+    // Wrap first, then reduce to the table size: the corners stay periodic
+    // for any period, though periods above 256 repeat within themselves.
+    x0 &= 255; x1 &= 255; y0 &= 255; y1 &= 255;
+    float xf = x - fx;
+    float yf = y - fy;
+
+    float u = fade(xf);
+    float v = fade(yf);
+
+    int aa = perm[x0] + y0;
+    int ab = perm[x0] + y1;
+    int ba = perm[x1] + y0;
+    int bb = perm[x1] + y1;
+
+    float n1 = lerp(u, grad(perm[aa], xf,     yf), grad(perm[ba], xf - 1, yf));
+    float n2 = lerp(u, grad(perm[ab], xf, yf - 1), grad(perm[bb], xf - 1, yf - 1));
+
+    return lerp(v, n1, n2);
+}
+
 float grad3D(int hash, float x, float y, float z) {
     int h = hash & 15;      // 16 possible values (0–15)
     float u = h < 8 ? x : y;
@@ -71,8 +99,9 @@ float grad3D(int hash, float x, float y, float z) {
     return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
 }
 
-float perlin_noise3d(float x, float y, float z)
+float perlin_noise3d(const NoiseContext *ctx, float x, float y, float z)
 {
+    const unsigned char *perm = ctx->perm;
     int xi = (int)floorf(x) & 255;
     int yi = (int)floorf(y) & 255;
     int zi = (int)floorf(z) & 255;
@@ -124,43 +153,50 @@ float grad4D(int hash, float x, float y, float z, float w) {
     return u + v + t;
 }
 
-float perlin_noise4d(float x, float y, float z, float w)
+// Hashes of the 16 corners of lattice cell (xi, yi, zi, wi), all in 0..255.
+// Corner k is offset by bit 0 in x, bit 1 in y, bit 2 in z and bit 3 in w.
+static inline void perlin4d_hash(const unsigned char *perm, int xi, int yi, int zi, int wi, int *h)
 {
-    int xi = (int)floorf(x) & 255;
-    int yi = (int)floorf(y) & 255;
-    int zi = (int)floorf(z) & 255;
-    int wi = (int)floorf(w) & 255;
-
-    float xf = x - floorf(x);
-    float yf = y - floorf(y);
-    float zf = z - floorf(z);
-    float wf = w - floorf(w);
+    // Level by level, so the corners share their common prefixes.
+    int a0 = perm[xi], a1 = perm[xi + 1];
+    int b00 = perm[a0 + yi], b10 = perm[a1 + yi], b01 = perm[a0 + yi + 1], b11 = perm[a1 + yi + 1];
+    int c[8] = { perm[b00 + zi],     perm[b10 + zi],     perm[b01 + zi],     perm[b11 + zi],
+                 perm[b00 + zi + 1], perm[b10 + zi + 1], perm[b01 + zi + 1], perm[b11 + zi + 1] };
+    for (int k = 0; k < 8; k++) {
+        h[k] = perm[c[k] + wi];
+        h[k + 8] = perm[c[k] + wi + 1];
+    }
+}
 
+// Gradients at the corners hashed to h and their interpolation at offset
+// (xf, yf, zf, wf) inside the cell.
+static inline float perlin4d_blend(const int *h, float xf, float yf, float zf, float wf)
+{
     float u = fade(xf);
     float v = fade(yf);
     float t = fade(zf);
     float s = fade(wf);
 
     // 16 gradients from the corners of a 4D hypercube
-    float g0000 = grad4D(perm[perm[perm[perm[xi    ] + yi    ] + zi    ] + wi    ], xf,     yf,     zf,     wf);
-    float g1000 = grad4D(perm[perm[perm[perm[xi + 1] + yi    ] + zi    ] + wi    ], xf - 1, yf,     zf,     wf);
-    float g0100 = grad4D(perm[perm[perm[perm[xi    ] + yi + 1] + zi    ] + wi    ], xf,     yf - 1, zf,     wf);
-    float g1100 = grad4D(perm[perm[perm[perm[xi + 1] + yi + 1] + zi    ] + wi    ], xf - 1, yf - 1, zf,     wf);
-
-    float g0010 = grad4D(perm[perm[perm[perm[xi    ] + yi    ] + zi + 1] + wi    ], xf,     yf,     zf - 1, wf);
-    float g1010 = grad4D(perm[perm[perm[perm[xi + 1] + yi    ] + zi + 1] + wi    ], xf - 1, yf,     zf - 1, wf);
-    float g0110 = grad4D(perm[perm[perm[perm[xi    ] + yi + 1] + zi + 1] + wi    ], xf,     yf - 1, zf - 1, wf);
-    float g1110 = grad4D(perm[perm[perm[perm[xi + 1] + yi + 1] + zi + 1] + wi    ], xf - 1, yf - 1, zf - 1, wf);
-
-    float g0001 = grad4D(perm[perm[perm[perm[xi    ] + yi    ] + zi    ] + wi + 1], xf,     yf,     zf,     wf - 1);
-    float g1001 = grad4D(perm[perm[perm[perm[xi + 1] + yi    ] + zi    ] + wi + 1], xf - 1, yf,     zf,     wf - 1);
-    float g0101 = grad4D(perm[perm[perm[perm[xi    ] + yi + 1] + zi    ] + wi + 1], xf,     yf - 1, zf,     wf - 1);
-    float g1101 = grad4D(perm[perm[perm[perm[xi + 1] + yi + 1] + zi    ] + wi + 1], xf - 1, yf - 1, zf,     wf - 1);
-
-    float g0011 = grad4D(perm[perm[perm[perm[xi    ] + yi    ] + zi + 1] + wi + 1], xf,     yf,     zf - 1, wf - 1);
-    float g1011 = grad4D(perm[perm[perm[perm[xi + 1] + yi    ] + zi + 1] + wi + 1], xf - 1, yf,     zf - 1, wf - 1);
-    float g0111 = grad4D(perm[perm[perm[perm[xi    ] + yi + 1] + zi + 1] + wi + 1], xf,     yf - 1, zf - 1, wf - 1);
-    float g1111 = grad4D(perm[perm[perm[perm[xi + 1] + yi + 1] + zi + 1] + wi + 1], xf - 1, yf - 1, zf - 1, wf - 1);
+    float g0000 = grad4D(h[0],  xf,     yf,     zf,     wf);
+    float g1000 = grad4D(h[1],  xf - 1, yf,     zf,     wf);
+    float g0100 = grad4D(h[2],  xf,     yf - 1, zf,     wf);
+    float g1100 = grad4D(h[3],  xf - 1, yf - 1, zf,     wf);
+
+    float g0010 = grad4D(h[4],  xf,     yf,     zf - 1, wf);
+    float g1010 = grad4D(h[5],  xf - 1, yf,     zf - 1, wf);
+    float g0110 = grad4D(h[6],  xf,     yf - 1, zf - 1, wf);
+    float g1110 = grad4D(h[7],  xf - 1, yf - 1, zf - 1, wf);
+
+    float g0001 = grad4D(h[8],  xf,     yf,     zf,     wf - 1);
+    float g1001 = grad4D(h[9],  xf - 1, yf,     zf,     wf - 1);
+    float g0101 = grad4D(h[10], xf,     yf - 1, zf,     wf - 1);
+    float g1101 = grad4D(h[11], xf - 1, yf - 1, zf,     wf - 1);
+
+    float g0011 = grad4D(h[12], xf,     yf,     zf - 1, wf - 1);
+    float g1011 = grad4D(h[13], xf - 1, yf,     zf - 1, wf - 1);
+    float g0111 = grad4D(h[14], xf,     yf - 1, zf - 1, wf - 1);
+    float g1111 = grad4D(h[15], xf - 1, yf - 1, zf - 1, wf - 1);
 
     // Interpolate along x
     float x00 = lerp(u, g0000, g1000);
@@ -184,4 +220,615 @@ float perlin_noise4d(float x, float y, float z, float w)
 
     // Interpolate along w and return final result
     return lerp(s, z0, z1);  // Result in [-1, 1]
-}
\ No newline at end of file
+}
+
+float perlin_noise4d(const NoiseContext *ctx, float x, float y, float z, float w)
+{
+    float fx = floorf(x), fy = floorf(y), fz = floorf(z), fw = floorf(w);
+    int h[16];
+    perlin4d_hash(ctx->perm, (int)fx & 255, (int)fy & 255, (int)fz & 255, (int)fw & 255, h);
+    return perlin4d_blend(h, x - fx, y - fy, z - fz, w - fw);
+}
+
+// --- 4D Perlin noise with analytic gradient ---
+
+static float fade_deriv(float t)
+{
+    return 30.0f * t * t * (t * (t - 2.0f) + 1.0f);
+}
+
+// The vector grad4D dots with: one +-1 on three of the four axes.
+static void grad4D_vector(int hash, float *g)
+{
+    int h = hash & 31;
+    g[0] = g[1] = g[2] = g[3] = 0.0f;
+    g[h < 24 ? 0 : 1] = (h & 1) ? -1.0f : 1.0f;
+    g[h < 16 ? 1 : 2] = (h & 2) ? -1.0f : 1.0f;
+    g[h < 8  ? 2 : 3] = (h & 4) ? -1.0f : 1.0f;
+}
+
+// Lerps {value, d/dx, d/dy, d/dz, d/dw} along one axis. t is the faded
+// coordinate on that axis and dt the derivative of the fade.
+static void lerp_deriv(float t, float dt, int axis, const float *a, const float *b, float *out)
+{
+    float diff = b[0] - a[0];
+    for (int j = 1; j < 5; j++) out[j] = a[j] + t * (b[j] - a[j]);
+    out[axis + 1] = out[axis + 1] + dt * diff;
+    out[0] = a[0] + t * diff;
+}
+
+// Same value as perlin_noise4d, plus its gradient in grad[0..3].
+float perlin_noise4d_deriv(const NoiseContext *ctx, float x, float y, float z, float w, float *grad)
+{
+    const unsigned char *perm = ctx->perm;
+    int xi = (int)floorf(x) & 255;
+    int yi = (int)floorf(y) & 255;
+    int zi = (int)floorf(z) & 255;
+    int wi = (int)floorf(w) & 255;
+
+    float xf = x - floorf(x);
+    float yf = y - floorf(y);
+    float zf = z - floorf(z);
+    float wf = w - floorf(w);
+
+    // Corner k has its x/y/z/w offset in bits 0/1/2/3.
+    float c[16][5];
+    for (int k = 0; k < 16; k++) {
+        int bx = k & 1, by = (k >> 1) & 1, bz = (k >> 2) & 1, bw = (k >> 3) & 1;
+        int h = perm[perm[perm[perm[xi + bx] + yi + by] + zi + bz] + wi + bw];
+        c[k][0] = grad4D(h, xf - bx, yf - by, zf - bz, wf - bw);
+        grad4D_vector(h, &c[k][1]);
+    }
+
+    // Interpolate along x, y, z and w in the same order as perlin_noise4d.
+    float cx[8][5], cy[4][5], cz[2][5], r[5];
+    for (int k = 0; k < 8; k++) lerp_deriv(fade(xf), fade_deriv(xf), 0, c[2 * k], c[2 * k + 1], cx[k]);
+    for (int k = 0; k < 4; k++) lerp_deriv(fade(yf), fade_deriv(yf), 1, cx[2 * k], cx[2 * k + 1], cy[k]);
+    for (int k = 0; k < 2; k++) lerp_deriv(fade(zf), fade_deriv(zf), 2, cy[2 * k], cy[2 * k + 1], cz[k]);
+    lerp_deriv(fade(wf), fade_deriv(wf), 3, cz[0], cz[1], r);
+
+    grad[0] = r[1];
+    grad[1] = r[2];
+    grad[2] = r[3];
+    grad[3] = r[4];
+    return r[0];
+}
+
+// --- Batched 4D Perlin noise ---
+//
+// The vector kernels below replay perlin_noise4d operation for operation
+// (same association order, no fused multiply-add), so every lane is
+// bit-identical to the scalar function.
+
+#if NOISE_HAVE_X86_SIMD
+
+NOISE_TARGET_AVX2 static inline __m256 fade8(__m256 t)
+{
+    __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+    __m256 inner = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+    inner = _mm256_add_ps(_mm256_mul_ps(t, inner), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(t3, inner);
+}
+
+NOISE_TARGET_AVX2 static inline __m256 lerp8(__m256 t, __m256 a, __m256 b)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+NOISE_TARGET_AVX2 static inline __m256i perm8(const unsigned char *perm, __m256i idx)
+{
+    __m256i v = _mm256_i32gather_epi32((const int *)perm, idx, 1);
+    return _mm256_and_si256(v, _mm256_set1_epi32(255));
+}
+
+NOISE_TARGET_AVX2 static inline __m256 negate_if8(__m256 v, __m256i h, int bit)
+{
+    __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(bit)), _mm256_set1_epi32(bit));
+    return _mm256_xor_ps(v, _mm256_and_ps(_mm256_castsi256_ps(m), _mm256_set1_ps(-0.0f)));
+}
+
+NOISE_TARGET_AVX2 static inline __m256 grad4D8(__m256i hash, __m256 x, __m256 y, __m256 z, __m256 w)
+{
+    __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(31));
+    __m256 lt24 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(24), h));
+    __m256 lt16 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(16), h));
+    __m256 lt8  = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+    __m256 a = _mm256_blendv_ps(y, x, lt24);
+    __m256 b = _mm256_blendv_ps(z, y, lt16);
+    __m256 c = _mm256_blendv_ps(w, z, lt8);
+    __m256 u = negate_if8(a, h, 1);
+    __m256 v = negate_if8(b, h, 2);
+    __m256 t = negate_if8(c, h, 4);
+    return _mm256_add_ps(_mm256_add_ps(u, v), t);
+}
+
+// Gathers the 16 corner hashes of every lane's cell level by level, A[a],
+// B[ab], C[abc], then h[abcd], in perlin4d_hash's corner order.
+NOISE_TARGET_AVX2 static inline void perlin4d_hash8(const unsigned char *perm, __m256i xi, __m256i yi, __m256i zi,
+                                                    __m256i wi, __m256i *h)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i A0 = perm8(perm, xi);
+    __m256i A1 = perm8(perm, _mm256_add_epi32(xi, one));
+    __m256i yi1 = _mm256_add_epi32(yi, one);
+    __m256i B00 = perm8(perm, _mm256_add_epi32(A0, yi));
+    __m256i B10 = perm8(perm, _mm256_add_epi32(A1, yi));
+    __m256i B01 = perm8(perm, _mm256_add_epi32(A0, yi1));
+    __m256i B11 = perm8(perm, _mm256_add_epi32(A1, yi1));
+    __m256i zi1 = _mm256_add_epi32(zi, one);
+    __m256i C[8] = {
+        perm8(perm, _mm256_add_epi32(B00, zi)),  perm8(perm, _mm256_add_epi32(B10, zi)),
+        perm8(perm, _mm256_add_epi32(B01, zi)),  perm8(perm, _mm256_add_epi32(B11, zi)),
+        perm8(perm, _mm256_add_epi32(B00, zi1)), perm8(perm, _mm256_add_epi32(B10, zi1)),
+        perm8(perm, _mm256_add_epi32(B01, zi1)), perm8(perm, _mm256_add_epi32(B11, zi1)),
+    };
+    __m256i wi1 = _mm256_add_epi32(wi, one);
+    for (int k = 0; k < 8; k++) {
+        h[k] = perm8(perm, _mm256_add_epi32(C[k], wi));
+        h[k + 8] = perm8(perm, _mm256_add_epi32(C[k], wi1));
+    }
+}
+
+// perlin4d_blend for 8 lanes.
+NOISE_TARGET_AVX2 static inline __m256 perlin4d_blend8(const __m256i *h, __m256 xf, __m256 yf, __m256 zf, __m256 wf)
+{
+    const __m256 fone = _mm256_set1_ps(1.0f);
+    __m256 xf1 = _mm256_sub_ps(xf, fone);
+    __m256 yf1 = _mm256_sub_ps(yf, fone);
+    __m256 zf1 = _mm256_sub_ps(zf, fone);
+    __m256 wf1 = _mm256_sub_ps(wf, fone);
+
+    __m256 u = fade8(xf);
+    __m256 v = fade8(yf);
+    __m256 t = fade8(zf);
+    __m256 s = fade8(wf);
+
+    __m256 g0000 = grad4D8(h[0],  xf,  yf,  zf,  wf);
+    __m256 g1000 = grad4D8(h[1],  xf1, yf,  zf,  wf);
+    __m256 g0100 = grad4D8(h[2],  xf,  yf1, zf,  wf);
+    __m256 g1100 = grad4D8(h[3],  xf1, yf1, zf,  wf);
+
+    __m256 g0010 = grad4D8(h[4],  xf,  yf,  zf1, wf);
+    __m256 g1010 = grad4D8(h[5],  xf1, yf,  zf1, wf);
+    __m256 g0110 = grad4D8(h[6],  xf,  yf1, zf1, wf);
+    __m256 g1110 = grad4D8(h[7],  xf1, yf1, zf1, wf);
+
+    __m256 g0001 = grad4D8(h[8],  xf,  yf,  zf,  wf1);
+    __m256 g1001 = grad4D8(h[9],  xf1, yf,  zf,  wf1);
+    __m256 g0101 = grad4D8(h[10], xf,  yf1, zf,  wf1);
+    __m256 g1101 = grad4D8(h[11], xf1, yf1, zf,  wf1);
+
+    __m256 g0011 = grad4D8(h[12], xf,  yf,  zf1, wf1);
+    __m256 g1011 = grad4D8(h[13], xf1, yf,  zf1, wf1);
+    __m256 g0111 = grad4D8(h[14], xf,  yf1, zf1, wf1);
+    __m256 g1111 = grad4D8(h[15], xf1, yf1, zf1, wf1);
+
+    __m256 x00 = lerp8(u, g0000, g1000);
+    __m256 x10 = lerp8(u, g0100, g1100);
+    __m256 x01 = lerp8(u, g0010, g1010);
+    __m256 x11 = lerp8(u, g0110, g1110);
+    __m256 x02 = lerp8(u, g0001, g1001);
+    __m256 x12 = lerp8(u, g0101, g1101);
+    __m256 x03 = lerp8(u, g0011, g1011);
+    __m256 x13 = lerp8(u, g0111, g1111);
+
+    __m256 y0 = lerp8(v, x00, x10);
+    __m256 y1 = lerp8(v, x01, x11);
+    __m256 y2 = lerp8(v, x02, x12);
+    __m256 y3 = lerp8(v, x03, x13);
+
+    __m256 z0 = lerp8(t, y0, y1);
+    __m256 z1 = lerp8(t, y2, y3);
+
+    return lerp8(s, z0, z1);
+}
+
+NOISE_TARGET_AVX2 static void perlin_noise4d_avx2(const unsigned char *perm, const float *px, const float *py, const float *pz,
+                                                  const float *pw, float *out, size_t n)
+{
+    const __m256i mask = _mm256_set1_epi32(255);
+
+    for (size_t i = 0; i < n; i += 8) {
+        __m256 x = _mm256_loadu_ps(px + i);
+        __m256 y = _mm256_loadu_ps(py + i);
+        __m256 z = _mm256_loadu_ps(pz + i);
+        __m256 w = _mm256_loadu_ps(pw + i);
+
+        __m256 fx = _mm256_floor_ps(x);
+        __m256 fy = _mm256_floor_ps(y);
+        __m256 fz = _mm256_floor_ps(z);
+        __m256 fw = _mm256_floor_ps(w);
+
+        __m256i h[16];
+        perlin4d_hash8(perm, _mm256_and_si256(_mm256_cvttps_epi32(fx), mask),
+                       _mm256_and_si256(_mm256_cvttps_epi32(fy), mask),
+                       _mm256_and_si256(_mm256_cvttps_epi32(fz), mask),
+                       _mm256_and_si256(_mm256_cvttps_epi32(fw), mask), h);
+
+        __m256 r = perlin4d_blend8(h, _mm256_sub_ps(x, fx), _mm256_sub_ps(y, fy),
+                                   _mm256_sub_ps(z, fz), _mm256_sub_ps(w, fw));
+        _mm256_storeu_ps(out + i, r);
+    }
+}
+
+// Broadcast corner hashes of one cell, for the scanline kernel's cache.
+typedef struct PerlinCell8 {
+    int cell[4];
+    __m256i h[16];
+} PerlinCell8;
+
+NOISE_TARGET_AVX2 static inline const PerlinCell8 *perlin_cell8(const unsigned char *perm, PerlinCell8 *cache,
+                                                                int *next, const int *c)
+{
+    // Least recently used replacement: the entry just returned is never the
+    // next one evicted, so two lookups in a row can both be held.
+    for (int e = 0; e < 2; e++) {
+        const int *k = cache[e].cell;
+        if (k[0] == c[0] && k[1] == c[1] && k[2] == c[2] && k[3] == c[3]) {
+            *next = e ^ 1;
+            return &cache[e];
+        }
+    }
+    PerlinCell8 *entry = &cache[*next];
+    *next ^= 1;
+    int hash[16];
+    perlin4d_hash(perm, c[0], c[1], c[2], c[3], hash);
+    for (int k = 0; k < 16; k++) entry->h[k] = _mm256_set1_epi32(hash[k]);
+    for (int k = 0; k < 4; k++) entry->cell[k] = c[k];
+    return entry;
+}
+
+NOISE_TARGET_AVX2 static inline __m256i same_cell8(__m256i xi, __m256i yi, __m256i zi, __m256i wi, __m256i lane)
+{
+    return _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi32(xi, _mm256_permutevar8x32_epi32(xi, lane)),
+                         _mm256_cmpeq_epi32(yi, _mm256_permutevar8x32_epi32(yi, lane))),
+        _mm256_and_si256(_mm256_cmpeq_epi32(zi, _mm256_permutevar8x32_epi32(zi, lane)),
+                         _mm256_cmpeq_epi32(wi, _mm256_permutevar8x32_epi32(wi, lane))));
+}
+
+// Scanline variant: a block whose lanes all sit in the cells of its first
+// and last lane (one cell, or a single crossing) takes its corner hashes
+// from a two-cell cache of broadcast vectors, blended per lane, instead of
+// gathering them. Other blocks take the gather path.
+NOISE_TARGET_AVX2 static void perlin_noise4d_scanline_avx2(const unsigned char *perm, const float *px, const float *py,
+                                                           const float *pz, const float *pw, float *out, size_t n)
+{
+    const __m256i mask = _mm256_set1_epi32(255);
+    const __m256i first = _mm256_setzero_si256();
+    const __m256i last = _mm256_set1_epi32(7);
+    PerlinCell8 cache[2] = { { { -1, -1, -1, -1 }, { { 0 } } }, { { -1, -1, -1, -1 }, { { 0 } } } };
+    int next = 0;
+
+    for (size_t i = 0; i < n; i += 8) {
+        __m256 x = _mm256_loadu_ps(px + i);
+        __m256 y = _mm256_loadu_ps(py + i);
+        __m256 z = _mm256_loadu_ps(pz + i);
+        __m256 w = _mm256_loadu_ps(pw + i);
+
+        __m256 fx = _mm256_floor_ps(x);
+        __m256 fy = _mm256_floor_ps(y);
+        __m256 fz = _mm256_floor_ps(z);
+        __m256 fw = _mm256_floor_ps(w);
+
+        __m256i xi = _mm256_and_si256(_mm256_cvttps_epi32(fx), mask);
+        __m256i yi = _mm256_and_si256(_mm256_cvttps_epi32(fy), mask);
+        __m256i zi = _mm256_and_si256(_mm256_cvttps_epi32(fz), mask);
+        __m256i wi = _mm256_and_si256(_mm256_cvttps_epi32(fw), mask);
+
+        __m256i in_first = same_cell8(xi, yi, zi, wi, first);
+        __m256i in_last = same_cell8(xi, yi, zi, wi, last);
+
+        __m256i h[16];
+        if (_mm256_movemask_epi8(_mm256_or_si256(in_first, in_last)) == -1) {
+            int c0[4] = { _mm256_extract_epi32(xi, 0), _mm256_extract_epi32(yi, 0),
+                          _mm256_extract_epi32(zi, 0), _mm256_extract_epi32(wi, 0) };
+            const PerlinCell8 *a = perlin_cell8(perm, cache, &next, c0);
+            if (_mm256_movemask_epi8(in_first) == -1) {
+                for (int k = 0; k < 16; k++) h[k] = a->h[k];
+            } else {
+                int c7[4] = { _mm256_extract_epi32(xi, 7), _mm256_extract_epi32(yi, 7),
+                              _mm256_extract_epi32(zi, 7), _mm256_extract_epi32(wi, 7) };
+                const PerlinCell8 *b = perlin_cell8(perm, cache, &next, c7);
+                for (int k = 0; k < 16; k++) h[k] = _mm256_blendv_epi8(b->h[k], a->h[k], in_first);
+            }
+        } else {
+            perlin4d_hash8(perm, xi, yi, zi, wi, h);
+        }
+
+        __m256 r = perlin4d_blend8(h, _mm256_sub_ps(x, fx), _mm256_sub_ps(y, fy),
+                                   _mm256_sub_ps(z, fz), _mm256_sub_ps(w, fw));
+        _mm256_storeu_ps(out + i, r);
+    }
+}
+
+NOISE_TARGET_SSE41 static inline __m128 fade4(__m128 t)
+{
+    __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+    __m128 inner = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+    inner = _mm_add_ps(_mm_mul_ps(t, inner), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(t3, inner);
+}
+
+NOISE_TARGET_SSE41 static inline __m128 lerp4(__m128 t, __m128 a, __m128 b)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+NOISE_TARGET_SSE41 static inline __m128i perm4(const unsigned char *perm, __m128i idx)
+{
+    return _mm_setr_epi32(perm[_mm_extract_epi32(idx, 0)], perm[_mm_extract_epi32(idx, 1)],
+                          perm[_mm_extract_epi32(idx, 2)], perm[_mm_extract_epi32(idx, 3)]);
+}
+
+NOISE_TARGET_SSE41 static inline __m128 negate_if4(__m128 v, __m128i h, int bit)
+{
+    __m128i m = _mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(bit)), _mm_set1_epi32(bit));
+    return _mm_xor_ps(v, _mm_and_ps(_mm_castsi128_ps(m), _mm_set1_ps(-0.0f)));
+}
+
+NOISE_TARGET_SSE41 static inline __m128 grad4D4(__m128i hash, __m128 x, __m128 y, __m128 z, __m128 w)
+{
+    __m128i h = _mm_and_si128(hash, _mm_set1_epi32(31));
+    __m128 lt24 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(24)));
+    __m128 lt16 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(16)));
+    __m128 lt8  = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+    __m128 a = _mm_blendv_ps(y, x, lt24);
+    __m128 b = _mm_blendv_ps(z, y, lt16);
+    __m128 c = _mm_blendv_ps(w, z, lt8);
+    __m128 u = negate_if4(a, h, 1);
+    __m128 v = negate_if4(b, h, 2);
+    __m128 t = negate_if4(c, h, 4);
+    return _mm_add_ps(_mm_add_ps(u, v), t);
+}
+
+NOISE_TARGET_SSE41 static void perlin_noise4d_sse41(const unsigned char *perm, const float *px, const float *py, const float *pz,
+                                                   const float *pw, float *out, size_t n)
+{
+    const __m128i mask = _mm_set1_epi32(255);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128 fone = _mm_set1_ps(1.0f);
+
+    for (size_t i = 0; i < n; i += 4) {
+        __m128 x = _mm_loadu_ps(px + i);
+        __m128 y = _mm_loadu_ps(py + i);
+        __m128 z = _mm_loadu_ps(pz + i);
+        __m128 w = _mm_loadu_ps(pw + i);
+
+        __m128 fx = _mm_floor_ps(x);
+        __m128 fy = _mm_floor_ps(y);
+        __m128 fz = _mm_floor_ps(z);
+        __m128 fw = _mm_floor_ps(w);
+
+        __m128i xi = _mm_and_si128(_mm_cvttps_epi32(fx), mask);
+        __m128i yi = _mm_and_si128(_mm_cvttps_epi32(fy), mask);
+        __m128i zi = _mm_and_si128(_mm_cvttps_epi32(fz), mask);
+        __m128i wi = _mm_and_si128(_mm_cvttps_epi32(fw), mask);
+
+        __m128 xf = _mm_sub_ps(x, fx);
+        __m128 yf = _mm_sub_ps(y, fy);
+        __m128 zf = _mm_sub_ps(z, fz);
+        __m128 wf = _mm_sub_ps(w, fw);
+        __m128 xf1 = _mm_sub_ps(xf, fone);
+        __m128 yf1 = _mm_sub_ps(yf, fone);
+        __m128 zf1 = _mm_sub_ps(zf, fone);
+        __m128 wf1 = _mm_sub_ps(wf, fone);
+
+        __m128 u = fade4(xf);
+        __m128 v = fade4(yf);
+        __m128 t = fade4(zf);
+        __m128 s = fade4(wf);
+
+        __m128i A0 = perm4(perm, xi);
+        __m128i A1 = perm4(perm, _mm_add_epi32(xi, one));
+        __m128i yi1 = _mm_add_epi32(yi, one);
+        __m128i B00 = perm4(perm, _mm_add_epi32(A0, yi));
+        __m128i B10 = perm4(perm, _mm_add_epi32(A1, yi));
+        __m128i B01 = perm4(perm, _mm_add_epi32(A0, yi1));
+        __m128i B11 = perm4(perm, _mm_add_epi32(A1, yi1));
+        __m128i zi1 = _mm_add_epi32(zi, one);
+        __m128i C000 = perm4(perm, _mm_add_epi32(B00, zi));
+        __m128i C100 = perm4(perm, _mm_add_epi32(B10, zi));
+        __m128i C010 = perm4(perm, _mm_add_epi32(B01, zi));
+        __m128i C110 = perm4(perm, _mm_add_epi32(B11, zi));
+        __m128i C001 = perm4(perm, _mm_add_epi32(B00, zi1));
+        __m128i C101 = perm4(perm, _mm_add_epi32(B10, zi1));
+        __m128i C011 = perm4(perm, _mm_add_epi32(B01, zi1));
+        __m128i C111 = perm4(perm, _mm_add_epi32(B11, zi1));
+        __m128i wi1 = _mm_add_epi32(wi, one);
+
+        __m128 g0000 = grad4D4(perm4(perm, _mm_add_epi32(C000, wi)), xf,  yf,  zf,  wf);
+        __m128 g1000 = grad4D4(perm4(perm, _mm_add_epi32(C100, wi)), xf1, yf,  zf,  wf);
+        __m128 g0100 = grad4D4(perm4(perm, _mm_add_epi32(C010, wi)), xf,  yf1, zf,  wf);
+        __m128 g1100 = grad4D4(perm4(perm, _mm_add_epi32(C110, wi)), xf1, yf1, zf,  wf);
+
+        __m128 g0010 = grad4D4(perm4(perm, _mm_add_epi32(C001, wi)), xf,  yf,  zf1, wf);
+        __m128 g1010 = grad4D4(perm4(perm, _mm_add_epi32(C101, wi)), xf1, yf,  zf1, wf);
+        __m128 g0110 = grad4D4(perm4(perm, _mm_add_epi32(C011, wi)), xf,  yf1, zf1, wf);
+        __m128 g1110 = grad4D4(perm4(perm, _mm_add_epi32(C111, wi)), xf1, yf1, zf1, wf);
+
+        __m128 g0001 = grad4D4(perm4(perm, _mm_add_epi32(C000, wi1)), xf,  yf,  zf,  wf1);
+        __m128 g1001 = grad4D4(perm4(perm, _mm_add_epi32(C100, wi1)), xf1, yf,  zf,  wf1);
+        __m128 g0101 = grad4D4(perm4(perm, _mm_add_epi32(C010, wi1)), xf,  yf1, zf,  wf1);
+        __m128 g1101 = grad4D4(perm4(perm, _mm_add_epi32(C110, wi1)), xf1, yf1, zf,  wf1);
+
+        __m128 g0011 = grad4D4(perm4(perm, _mm_add_epi32(C001, wi1)), xf,  yf,  zf1, wf1);
+        __m128 g1011 = grad4D4(perm4(perm, _mm_add_epi32(C101, wi1)), xf1, yf,  zf1, wf1);
+        __m128 g0111 = grad4D4(perm4(perm, _mm_add_epi32(C011, wi1)), xf,  yf1, zf1, wf1);
+        __m128 g1111 = grad4D4(perm4(perm, _mm_add_epi32(C111, wi1)), xf1, yf1, zf1, wf1);
+
+        __m128 x00 = lerp4(u, g0000, g1000);
+        __m128 x10 = lerp4(u, g0100, g1100);
+        __m128 x01 = lerp4(u, g0010, g1010);
+        __m128 x11 = lerp4(u, g0110, g1110);
+        __m128 x02 = lerp4(u, g0001, g1001);
+        __m128 x12 = lerp4(u, g0101, g1101);
+        __m128 x03 = lerp4(u, g0011, g1011);
+        __m128 x13 = lerp4(u, g0111, g1111);
+
+        __m128 y0 = lerp4(v, x00, x10);
+        __m128 y1 = lerp4(v, x01, x11);
+        __m128 y2 = lerp4(v, x02, x12);
+        __m128 y3 = lerp4(v, x03, x13);
+
+        __m128 z0 = lerp4(t, y0, y1);
+        __m128 z1 = lerp4(t, y2, y3);
+
+        _mm_storeu_ps(out + i, lerp4(s, z0, z1));
+    }
+}
+
+NOISE_TARGET_AVX2 static inline __m256 fade_deriv8(__m256 t)
+{
+    __m256 a = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(30.0f), t), t);
+    __m256 b = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(t, _mm256_set1_ps(2.0f))), _mm256_set1_ps(1.0f));
+    return _mm256_mul_ps(a, b);
+}
+
+NOISE_TARGET_AVX2 static inline void grad4D_vector8(__m256i hash, __m256 *g)
+{
+    __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(31));
+    __m256 lt24 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(24), h));
+    __m256 lt16 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(16), h));
+    __m256 lt8  = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+    __m256 s0 = negate_if8(_mm256_set1_ps(1.0f), h, 1);
+    __m256 s1 = negate_if8(_mm256_set1_ps(1.0f), h, 2);
+    __m256 s2 = negate_if8(_mm256_set1_ps(1.0f), h, 4);
+    g[0] = _mm256_and_ps(lt24, s0);
+    g[1] = _mm256_blendv_ps(s0, _mm256_and_ps(lt16, s1), lt24);
+    g[2] = _mm256_blendv_ps(s1, _mm256_and_ps(lt8, s2), lt16);
+    g[3] = _mm256_andnot_ps(lt8, s2);
+}
+
+NOISE_TARGET_AVX2 static inline void lerp_deriv8(__m256 t, __m256 dt, int axis,
+                                                 const __m256 *a, const __m256 *b, __m256 *out)
+{
+    __m256 diff = _mm256_sub_ps(b[0], a[0]);
+    for (int j = 1; j < 5; j++) out[j] = _mm256_add_ps(a[j], _mm256_mul_ps(t, _mm256_sub_ps(b[j], a[j])));
+    out[axis + 1] = _mm256_add_ps(out[axis + 1], _mm256_mul_ps(dt, diff));
+    out[0] = _mm256_add_ps(a[0], _mm256_mul_ps(t, diff));
+}
+
+NOISE_TARGET_AVX2 static void perlin_noise4d_deriv_avx2(const unsigned char *perm, const float *px, const float *py, const float *pz,
+                                                        const float *pw, float *out, float *gx, float *gy,
+                                                        float *gz, float *gw, size_t n)
+{
+    const __m256i mask = _mm256_set1_epi32(255);
+    const __m256 fone = _mm256_set1_ps(1.0f);
+
+    for (size_t i = 0; i < n; i += 8) {
+        __m256 p[4] = { _mm256_loadu_ps(px + i), _mm256_loadu_ps(py + i),
+                        _mm256_loadu_ps(pz + i), _mm256_loadu_ps(pw + i) };
+        __m256i cell[4];
+        __m256 f[4], f1[4], fd[4], fdd[4];
+        for (int a = 0; a < 4; a++) {
+            __m256 fl = _mm256_floor_ps(p[a]);
+            cell[a] = _mm256_and_si256(_mm256_cvttps_epi32(fl), mask);
+            f[a] = _mm256_sub_ps(p[a], fl);
+            f1[a] = _mm256_sub_ps(f[a], fone);
+            fd[a] = fade8(f[a]);
+            fdd[a] = fade_deriv8(f[a]);
+        }
+
+        // Hash level by level; bit 0 of the index is the x offset, bit 1 y, ...
+        __m256i A[2], B[4], C[8];
+        for (int k = 0; k < 2; k++) A[k] = perm8(perm, _mm256_add_epi32(cell[0], _mm256_set1_epi32(k)));
+        for (int k = 0; k < 4; k++) B[k] = perm8(perm, _mm256_add_epi32(A[k & 1], _mm256_add_epi32(cell[1], _mm256_set1_epi32(k >> 1))));
+        for (int k = 0; k < 8; k++) C[k] = perm8(perm, _mm256_add_epi32(B[k & 3], _mm256_add_epi32(cell[2], _mm256_set1_epi32(k >> 2))));
+
+        __m256 c[16][5];
+        for (int k = 0; k < 16; k++) {
+            __m256i h = perm8(perm, _mm256_add_epi32(C[k & 7], _mm256_add_epi32(cell[3], _mm256_set1_epi32(k >> 3))));
+            c[k][0] = grad4D8(h, (k & 1) ? f1[0] : f[0], (k & 2) ? f1[1] : f[1],
+                                 (k & 4) ? f1[2] : f[2], (k & 8) ? f1[3] : f[3]);
+            grad4D_vector8(h, &c[k][1]);
+        }
+
+        __m256 cx[8][5], cy[4][5], cz[2][5], r[5];
+        for (int k = 0; k < 8; k++) lerp_deriv8(fd[0], fdd[0], 0, c[2 * k], c[2 * k + 1], cx[k]);
+        for (int k = 0; k < 4; k++) lerp_deriv8(fd[1], fdd[1], 1, cx[2 * k], cx[2 * k + 1], cy[k]);
+        for (int k = 0; k < 2; k++) lerp_deriv8(fd[2], fdd[2], 2, cy[2 * k], cy[2 * k + 1], cz[k]);
+        lerp_deriv8(fd[3], fdd[3], 3, cz[0], cz[1], r);
+
+        _mm256_storeu_ps(out + i, r[0]);
+        _mm256_storeu_ps(gx + i, r[1]);
+        _mm256_storeu_ps(gy + i, r[2]);
+        _mm256_storeu_ps(gz + i, r[3]);
+        _mm256_storeu_ps(gw + i, r[4]);
+    }
+}
+
+#endif // NOISE_HAVE_X86_SIMD
+
+void perlin_noise4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                          float *out, size_t n)
+{
+    size_t done = 0;
+#if NOISE_HAVE_X86_SIMD
+    NoiseSimdLevel level = noise_simd_level();
+    if (level >= NOISE_SIMD_AVX2) {
+        done = n & ~(size_t)7;
+        perlin_noise4d_avx2(ctx->perm, x, y, z, w, out, done);
+    } else if (level >= NOISE_SIMD_SSE41) {
+        done = n & ~(size_t)3;
+        perlin_noise4d_sse41(ctx->perm, x, y, z, w, out, done);
+    }
+#endif
+    for (size_t i = done; i < n; i++) {
+        out[i] = perlin_noise4d(ctx, x[i], y[i], z[i], w[i]);
+    }
+}
+
+void perlin_noise4d_scanline(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                             float *out, size_t n)
+{
+    const unsigned char *perm = ctx->perm;
+    size_t done = 0;
+#if NOISE_HAVE_X86_SIMD
+    // The SSE4.1 kernel already beats the cached scalar loop, so it stays.
+    NoiseSimdLevel level = noise_simd_level();
+    if (level >= NOISE_SIMD_AVX2) {
+        done = n & ~(size_t)7;
+        perlin_noise4d_scanline_avx2(perm, x, y, z, w, out, done);
+    } else if (level >= NOISE_SIMD_SSE41) {
+        done = n & ~(size_t)3;
+        perlin_noise4d_sse41(perm, x, y, z, w, out, done);
+    }
+#endif
+    int cell[4] = { -1, -1, -1, -1 };
+    int hash[16] = { 0 };
+    for (size_t i = done; i < n; i++) {
+        float fx = floorf(x[i]), fy = floorf(y[i]), fz = floorf(z[i]), fw = floorf(w[i]);
+        int xi = (int)fx & 255, yi = (int)fy & 255, zi = (int)fz & 255, wi = (int)fw & 255;
+        if (xi != cell[0] || yi != cell[1] || zi != cell[2] || wi != cell[3]) {
+            perlin4d_hash(perm, xi, yi, zi, wi, hash);
+            cell[0] = xi;
+            cell[1] = yi;
+            cell[2] = zi;
+            cell[3] = wi;
+        }
+        out[i] = perlin4d_blend(hash, x[i] - fx, y[i] - fy, z[i] - fz, w[i] - fw);
+    }
+}
+
+// Only an AVX2 kernel exists for the derivative; other levels run the scalar
+// function, which gives the same bits.
+void perlin_noise4d_deriv_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                                float *out, float *gx, float *gy, float *gz, float *gw, size_t n)
+{
+    size_t done = 0;
+#if NOISE_HAVE_X86_SIMD
+    if (noise_simd_level() >= NOISE_SIMD_AVX2) {
+        done = n & ~(size_t)7;
+        perlin_noise4d_deriv_avx2(ctx->perm, x, y, z, w, out, gx, gy, gz, gw, done);
+    }
+#endif
+    for (size_t i = done; i < n; i++) {
+        float g[4];
+        out[i] = perlin_noise4d_deriv(ctx, x[i], y[i], z[i], w[i], g);
+        gx[i] = g[0];
+        gy[i] = g[1];
+        gz[i] = g[2];
+        gw[i] = g[3];
+    }
+}
@@ -1,8 +1,34 @@
 #ifndef PERLIN_NOISE_H
 #define PERLIN_NOISE_H
 
-void perlin_init(int seed);
-float perlin_noise2d(float x, float y);
-float perlin_noise3d(float x, float y, float z);
-float perlin_noise4d(float x, float y, float z, float w);
+#include <stddef.h>
+#include "noise_context.h"
+
+float perlin_noise2d(const NoiseContext *ctx, float x, float y);
+float perlin_noise3d(const NoiseContext *ctx, float x, float y, float z);
+float perlin_noise4d(const NoiseContext *ctx, float x, float y, float z, float w);
+
+// perlin_noise2d on a lattice that wraps every period_x cells in x and
+// period_y cells in y, so noise(x + period_x, y) == noise(x, y).
+float perlin_noise2d_periodic(const NoiseContext *ctx, float x, float y, int period_x, int period_y);
+
+// Evaluates perlin_noise4d for n points given as separate coordinate arrays.
+void perlin_noise4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                          const float *w, float *out, size_t n);
+
+// perlin_noise4d_batch for coherent sequences such as heightmap rows: while
+// consecutive samples stay in one lattice cell, its 16 corner hashes are
+// reused instead of recomputed. Same results as perlin_noise4d. With AVX2
+// this is only about 1.35x faster than perlin_noise4d_batch on the
+// get_heightmap workload (bench_fbm: 662 against 894 ns/pixel), not the
+// order of magnitude the hashing alone would suggest. Most of the remaining
+// time goes to the per-sample gradient dot products and lerps, and caching
+// the decoded corner gradients as well gained under 5%.
+void perlin_noise4d_scanline(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                             const float *w, float *out, size_t n);
+
+// perlin_noise4d together with its analytic gradient (d/dx, d/dy, d/dz, d/dw).
+float perlin_noise4d_deriv(const NoiseContext *ctx, float x, float y, float z, float w, float *grad);
+void perlin_noise4d_deriv_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                                const float *w, float *out, float *gx, float *gy, float *gz, float *gw, size_t n);
 #endif // PERLIN_NOISE_H
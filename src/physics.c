@@ -3,15 +3,19 @@
 #include "audio.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "vehicle.h"
+#include "terrain.h"
 
 
 static dWorldID world;
 static dSpaceID space;
 static dJointGroupID contactGroup;
 static dGeomID groundGeom;
-static dGeomID terrainGeom;
+static TriMesh *terrainChunkTriMeshes = NULL;  // one per terrain chunk
+static int terrainChunkCount = 0;
 
 typedef struct {
     int id;
@@ -102,23 +106,11 @@ static void nearCallback(void *data, dGeomID o1, dGeomID o2)
 
 }
 
-// Convert Raylib Mesh to ODE TriMesh
-dGeomID CreateODETriMeshFromRaylibMesh(Mesh *mesh, dSpaceID space, dTriMeshDataID *outTriData)
+// Builds ODE trimesh data over arrays it takes ownership of; ODE reads them
+// in place, so they live as long as it does. The geom is left for the
+// caller.
+static TriMesh build_trimesh(float *vertices, int vertexCount, int *indices, int triangleCount)
 {
-    // Copy Raylib mesh vertex data (assumed layout: x,y,z x,y,z ...)
-    int vertexCount = mesh->vertexCount;
-    float *vertices = malloc(sizeof(float) * vertexCount * 3);
-    for (int i = 0; i < vertexCount * 3; i++) {
-        vertices[i] = mesh->vertices[i];
-    }
-
-    // Copy and widen indices from ushort to int
-    int triangleCount = mesh->triangleCount;
-    int *indices = malloc(sizeof(int) * triangleCount * 3);
-    for (int i = 0; i < triangleCount * 3; i++) {
-        indices[i] = mesh->indices[i];
-    }
-
     // Create and build trimesh data
     dTriMeshDataID triData = dGeomTriMeshDataCreate();
     dGeomTriMeshDataBuildSingle(triData,
@@ -130,16 +122,101 @@ dGeomID CreateODETriMeshFromRaylibMesh(Mesh *mesh, dSpaceID space, dTriMeshDataI
         3 * sizeof(int)            // Stride
     );
 
-    // Store the trimesh data if caller wants to keep it
-    if (outTriData) *outTriData = triData;
+    TriMesh trimesh = { NULL, triData, vertices, indices };
+    return trimesh;
+}
+
+TriMesh BuildODETriMeshData(const Mesh *mesh, const uint32_t *wide)
+{
+    // Copy Raylib mesh vertex data (assumed layout: x,y,z x,y,z ...)
+    int vertexCount = mesh->vertexCount;
+    float *vertices = malloc(sizeof(float) * vertexCount * 3);
+
+    // Copy and widen indices from ushort to int
+    int triangleCount = mesh->triangleCount;
+    int *indices = malloc(sizeof(int) * triangleCount * 3);
+    if (!vertices || !indices) {
+        perror("trimesh allocation failed");
+        exit(1);
+    }
+    memcpy(vertices, mesh->vertices, sizeof(float) * vertexCount * 3);
+    for (int i = 0; i < triangleCount * 3; i++) {
+        indices[i] = wide ? (int)wide[i] : mesh->indices[i];
+    }
+
+    return build_trimesh(vertices, vertexCount, indices, triangleCount);
+}
+
+// Convert Raylib Mesh to ODE TriMesh
+TriMesh CreateODETriMeshFromRaylibMesh(Mesh *mesh, dSpaceID space)
+{
+    TriMesh trimesh = BuildODETriMeshData(mesh, NULL);
+    trimesh.geom = dCreateTriMesh(space, trimesh.data, NULL, NULL, NULL);
+    return trimesh;
+}
+
+// The same from bare arrays with 32-bit indices, for meshes past what a
+// raylib Mesh can index.
+TriMesh CreateODETriMesh(const float *vertices, int vertexCount, const uint32_t *indices, int triangleCount,
+                         dSpaceID space)
+{
+    Mesh mesh = { .vertexCount = vertexCount, .triangleCount = triangleCount, .vertices = (float *)vertices };
+    TriMesh trimesh = BuildODETriMeshData(&mesh, indices);
+    trimesh.geom = dCreateTriMesh(space, trimesh.data, NULL, NULL, NULL);
+    return trimesh;
+}
+
+void DestroyTriMesh(TriMesh *trimesh)
+{
+    if (!trimesh->data) return;
+    if (trimesh->geom) dGeomDestroy(trimesh->geom);
+    dGeomTriMeshDataDestroy(trimesh->data);
+    free(trimesh->vertices);
+    free(trimesh->indices);
+    *trimesh = (TriMesh){ 0 };
+}
+
+// Drops every terrain chunk's collider.
+static void DestroyTerrainTriMeshes() {
+    for (int i = 0; i < terrainChunkCount; i++) {
+        DestroyTriMesh(&terrainChunkTriMeshes[i]);
+    }
+    free(terrainChunkTriMeshes);
+    terrainChunkTriMeshes = NULL;
+    terrainChunkCount = 0;
+}
+
+void SetTerrainChunkCount(int count) {
+    DestroyTerrainTriMeshes();
+    terrainChunkTriMeshes = calloc(count, sizeof(TriMesh));
+    if (!terrainChunkTriMeshes) {
+        perror("terrain collider allocation failed");
+        exit(1);
+    }
+    terrainChunkCount = count;
+}
+
+void SetTerrainChunkTriMesh(int chunk, Mesh *mesh) {
+    if (chunk < 0 || chunk >= terrainChunkCount) return;
+    DestroyTriMesh(&terrainChunkTriMeshes[chunk]);
+    terrainChunkTriMeshes[chunk] = CreateODETriMeshFromRaylibMesh(mesh, space);
+}
 
-    // Create and return the trimesh geometry
-    dGeomID geom = dCreateTriMesh(space, triData, NULL, NULL, NULL);
-    return geom;
+void SetTerrainChunkTriMeshData(int chunk, const float *vertices, int vertexCount, const uint32_t *indices,
+                                int triangleCount) {
+    if (chunk < 0 || chunk >= terrainChunkCount) return;
+    DestroyTriMesh(&terrainChunkTriMeshes[chunk]);
+    terrainChunkTriMeshes[chunk] = CreateODETriMesh(vertices, vertexCount, indices, triangleCount, space);
 }
 
-void SetTerrainTriMesh(Mesh *mesh) {
-    terrainGeom = CreateODETriMeshFromRaylibMesh(mesh, space, NULL);
+void SetTerrainChunkTriMeshBuilt(int chunk, TriMesh trimesh) {
+    if (chunk < 0 || chunk >= terrainChunkCount) {
+        DestroyTriMesh(&trimesh);
+        return;
+    }
+    DestroyTriMesh(&terrainChunkTriMeshes[chunk]);
+    trimesh.geom = dCreateTriMesh(space, trimesh.data, NULL, NULL, NULL);
+    terrainChunkTriMeshes[chunk] = trimesh;
 }
 
 size_t SCREEN_WIDTH = SIZE_MAX;
@@ -147,23 +224,11 @@ size_t SCREEN_HEIGHT = SIZE_MAX;
 float HALF_SCREEN_WIDTH = -1.0f;
 float HALF_SCREEN_HEIGHT = -1.0f;
 
-size_t MONITOR_WIDTH = SIZE_MAX;
-size_t MONITOR_HEIGHT = SIZE_MAX;
-float HALF_MONITOR_WIDTH = -1.0f;
-float HALF_MONITOR_HEIGHT = -1.0f;
-
 void InitPhysics() {
-    // Get the primary monitor's resolution before window creation
-    size_t CELL_SIZE = 50;
-    int monitor = GetCurrentMonitor();
-    MONITOR_HEIGHT = GetMonitorHeight(monitor);
-    MONITOR_WIDTH = GetMonitorWidth(monitor);
-    printf("Monitor %d: %zu x %zu\n", monitor, MONITOR_WIDTH, MONITOR_HEIGHT);
-    MONITOR_WIDTH = (MONITOR_WIDTH/CELL_SIZE)*CELL_SIZE;
-    MONITOR_HEIGHT = (MONITOR_HEIGHT/CELL_SIZE)*CELL_SIZE;
-    printf("Monitor %d: %zu x %zu\n", monitor, MONITOR_WIDTH, MONITOR_HEIGHT);
-    HALF_MONITOR_WIDTH = MONITOR_WIDTH / 2.0f;
-    HALF_MONITOR_HEIGHT = MONITOR_HEIGHT / 2.0f;
+    // Bodies start spread over the terrain's world area
+    const TerrainConfig *terrain = terrain_config();
+    const int half_world_width = (int)(terrain->world_width / 2.0f);
+    const int half_world_height = (int)(terrain->world_height / 2.0f);
 
     dInitODE();
     world = dWorldCreate();
@@ -174,7 +239,7 @@ void InitPhysics() {
     // Ground plane
     groundGeom = dCreatePlane(space, 0, 1, 0, 0);
     printf("Ground plane created\n");
-    printf("MONITOR_WIDTH: %zu, MONITOR_HEIGHT: %zu\n", MONITOR_WIDTH, MONITOR_HEIGHT);
+    printf("World: %.1f x %.1f\n", terrain->world_width, terrain->world_height);
     for (int i = 0; i < MAX_BODIES; i++) {
         objects[i].id = i;
         objects[i].body = dBodyCreate(world);
@@ -185,9 +250,9 @@ void InitPhysics() {
         dMassSetBox(&m, 1.0, CUBE_SIZE, CUBE_SIZE, CUBE_SIZE);
         dBodySetMass(objects[i].body, &m);
         dBodySetPosition(objects[i].body, 
-                         GetRandomValue(-HALF_MONITOR_HEIGHT, HALF_MONITOR_HEIGHT),
+                         GetRandomValue(-half_world_height, half_world_height),
                          GetRandomValue(450, 500),  // Start above ground
-                         GetRandomValue(-HALF_MONITOR_WIDTH, HALF_MONITOR_WIDTH));
+                         GetRandomValue(-half_world_width, half_world_width));
 
         dBodySetData(objects[i].body, &objects[i]);
         Mesh mesh = GenMeshCube(CUBE_SIZE, CUBE_SIZE, CUBE_SIZE);
@@ -246,6 +311,7 @@ void ShutdownPhysics() {
         if (objects[i].geom) dGeomDestroy(objects[i].geom);
         if (objects[i].body) dBodyDestroy(objects[i].body);
     }
+    DestroyTerrainTriMeshes();
     dJointGroupDestroy(contactGroup);
     dSpaceDestroy(space);
     dWorldDestroy(world);
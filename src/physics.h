@@ -3,6 +3,7 @@
 #include "raylib.h"
 #include "raymath.h"
 #include <ode/ode.h>
+#include <stdint.h>
 
 #define CUBE_SIZE 100.0f
 #define MAX_BODIES 100
@@ -14,7 +15,15 @@ Vector3 GetPhysicsBodyPosition(int index);
 void GetPhysicsBodyAxisAngle(int index, Vector3 *axis, float *angle);
 Model GetPhysicsBodyModel(int index);
 void ApplyRandomJumpToAllBodies();
-void SetTerrainTriMesh(Mesh *mesh);
+// A collider per terrain chunk, so an edit rebuilds only the chunks it
+// touched: SetTerrainChunkCount replaces the terrain colliders with count
+// empty ones, and SetTerrainChunkTriMesh builds (or rebuilds) one;
+// SetTerrainChunkTriMeshData from 32-bit indices. SetTerrainChunkTriMeshBuilt
+// takes data from BuildODETriMeshData and only adds the geom.
+void SetTerrainChunkCount(int count);
+void SetTerrainChunkTriMesh(int chunk, Mesh *mesh);
+void SetTerrainChunkTriMeshData(int chunk, const float *vertices, int vertexCount, const uint32_t *indices,
+                                int triangleCount);
 void AttachShaderToPhysicsBodies(Shader shader);
 bool checkColliding(dGeomID g);
 dWorldID GetPhysicsWorld();
@@ -22,6 +31,25 @@ dSpaceID GetPhysicsSpace();
 dJointGroupID GetPhysicsContactGroup();
 void CollideBodies();
 
+// An ODE trimesh and the arrays it was built from.
+typedef struct TriMesh {
+    dGeomID geom;
+    dTriMeshDataID data;
+    float *vertices;
+    int *indices;
+} TriMesh;
+
+// A trimesh's arrays and data without its geom: the costly part, which
+// touches no space, so another thread may build it (after
+// dAllocateODEDataForThread). Indices come from wide when it is not NULL,
+// else from the mesh.
+TriMesh BuildODETriMeshData(const Mesh *mesh, const uint32_t *wide);
+void SetTerrainChunkTriMeshBuilt(int chunk, TriMesh trimesh);
+TriMesh CreateODETriMeshFromRaylibMesh(Mesh *mesh, dSpaceID space);
+TriMesh CreateODETriMesh(const float *vertices, int vertexCount, const uint32_t *indices, int triangleCount,
+                         dSpaceID space);
+void DestroyTriMesh(TriMesh *trimesh);
+
 typedef struct geomInfo {
     bool collidable;
 } geomInfo ;
@@ -7,18 +7,31 @@
 #include "vehicle.h"
 #include "camera.h"
 #include "torus.h"
+#include "frustum.h"
 
 #define RLIGHTS_IMPLEMENTATION
 #include "rlights.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #define SHADER_PATH "../src/" 
 #define IMAGE_PATH "../src/assets/images/"
 #define DATA_PATH "../src/assets/data/"
 
-#define TORUS_MAJOR_SEGMENTS 256
-#define TORUS_MINOR_SEGMENTS 128
+// Largest error, in pixels, a terrain chunk's level of detail may show
+#define TERRAIN_LOD_ERROR_PIXELS 2.0f
+// Side of a terrain chunk in quads; past TERRAIN_CHUNK_QUADS_16BIT chunks take 32-bit indices
+static const size_t terrain_chunk_quads = TERRAIN_CHUNK_QUADS; // Change this to switch chunk sizes
+// Keep the unedited terrain's heightmap as 16-bit codes, half the memory,
+// meshing it from them; the first edit turns it back into floats.
+static const bool terrain_resident_q16 = false; // Change this to switch
+// The crater KEY_C leaves ahead of the car
+#define CRATER_RADIUS 30.0f
+#define CRATER_DEPTH 8.0f
+#define CRATER_AHEAD 40.0f
 
 #define FORWARD_MAX_ACCELERATION 75.0f
 #define REVERSE_MAX_ACCELERATION 25.0f
@@ -29,15 +42,234 @@ static Camera3D camera;
 
 Shader shader = { 0 };
 Light lights[MAX_LIGHTS] = { 0 };
-Model terrain = { 0 };
+static TerrainChunks terrainChunks = { 0 };
+static Material terrainMaterial = { 0 };
+static int terrainTriangles = 0;  // drawn last frame, after LOD and culling
+static TerrainRefinement *terrainRefinement = NULL;  // finer terrain on its way, if any
+static Heightmap *terrainHeightmap = NULL;  // the chunks' heightmap, edits and all
+static HeightmapQ16 *terrainHeightmapQ16 = NULL;  // or, with terrain_resident_q16 and no edits, its codes
+
+// Every deformation so far, replayed on each finer terrain level as it arrives.
+typedef struct TerrainEdit {
+    Vector3 center;
+    float radius, amount;
+    HeightmapBrush brush;
+} TerrainEdit;
+static TerrainEdit *terrainEdits = NULL;
+static int terrainEditCount = 0, terrainEditCapacity = 0;
 Model skySphere = { 0 };
 
+// A terrain level being meshed off the main thread: the chunks on the CPU
+// and their colliders' data, everything but the GPU upload and the geoms.
+typedef struct TerrainBuild {
+    pthread_t thread;
+    bool threaded;
+    atomic_bool done;
+    Heightmap *heightmap;           // the level, then with edits applied; NULL if only codes are kept
+    HeightmapQ16 *codes;            // with terrain_resident_q16 and no edits
+    TerrainEdit *edits;             // copy of the first editCount terrainEdits
+    int editCount;
+    TerrainChunks chunks;
+    TriMesh *colliders;             // per chunk, without geoms
+} TerrainBuild;
+static TerrainBuild *terrainBuild = NULL;
+
+// Frustum culling: the view of the frame being drawn, the bounds of what
+// may be drawn, and the indices that pass.
+static Frustum frustum;
+static FrustumBoxes chunkBoxes = { 0 };      // set with the terrain chunks
+static FrustumSpheres bodySpheres = { 0 };   // refilled every frame
+static FrustumBoxes vehicleBoxes = { 0 };    // refilled every frame
+static FrustumSpheres lightSpheres = { 0 };  // refilled every frame
+static uint32_t *visible = NULL;
+static size_t visibleCapacity = 0;
+static RenderCullStats cullStats = { 0 };
+
+// The visible index buffer, grown to hold count items.
+static uint32_t *VisibleBuffer(size_t count) {
+    if (count > visibleCapacity) {
+        visible = realloc(visible, count * sizeof(uint32_t));
+        if (!visible) {
+            perror("visible index allocation failed");
+            exit(1);
+        }
+        visibleCapacity = count;
+    }
+    return visible;
+}
+
 // For vehicle models
 Model box;
 Model ball;
 Model cylinder;
 vehicle *car = NULL;
 
+// A heightmap that can be edited in place: a cached map is a read-only
+// file mapping, so it is swapped for a copy.
+static Heightmap *EditableHeightmap(Heightmap *heightmap) {
+    if (!heightmap->mapping) return heightmap;
+    Heightmap *copy = heightmap_copy(heightmap);
+    heightmap_destroy(heightmap);
+    return copy;
+}
+
+// Rebuilds chunk c's collider from its full-resolution triangles.
+static void SetTerrainChunkCollider(int c) {
+    const uint32_t *wide;
+    Mesh collider = TerrainChunkCollisionMesh(&terrainChunks, c, &wide);
+    if (wide) SetTerrainChunkTriMeshData(c, collider.vertices, collider.vertexCount, wide, collider.triangleCount);
+    else SetTerrainChunkTriMesh(c, &collider);
+}
+
+// Meshes build->heightmap at its own resolution, one vertex per height,
+// with its edits, and builds a collider's data per chunk. Without edits the
+// chunks and the colliders' arrays come from the mesh cache on a warm start,
+// unless the map is to stay resident as codes. Touches neither the GPU nor
+// the physics space, so it runs on a thread of its own.
+static void *BuildTerrain(void *arg) {
+    TerrainBuild *build = arg;
+    if (build->threaded) dAllocateODEDataForThread(dAllocateMaskAll);
+    Heightmap *heightmap = build->heightmap;
+    if (build->editCount) {
+        heightmap = EditableHeightmap(heightmap);
+        for (int i = 0; i < build->editCount; i++) {
+            const TerrainEdit *edit = &build->edits[i];
+            DeformFlatTorusHeightmap(heightmap, edit->brush, edit->center, edit->radius, edit->amount);
+        }
+        TerrainGrid grid = GenFlatTorusGrid(heightmap, heightmap->width, heightmap->height);
+        build->chunks = CutTerrainChunks(&grid, terrain_chunk_quads);
+        UnloadTerrainGrid(&grid);
+    } else if (terrain_resident_q16) {
+        build->codes = heightmap_quantize(heightmap);
+        heightmap_destroy(heightmap);
+        heightmap = NULL;
+        TerrainGrid grid = GenFlatTorusGridQ16(build->codes, build->codes->width, build->codes->height);
+        build->chunks = CutTerrainChunks(&grid, terrain_chunk_quads);
+        UnloadTerrainGrid(&grid);
+    } else {
+        build->chunks = CutHeightmapChunks(heightmap, TERRAIN_MESH_FLAT, terrain_chunk_quads);
+    }
+    build->heightmap = heightmap;
+
+    build->colliders = malloc(build->chunks.count * sizeof(TriMesh));
+    if (!build->colliders) {
+        perror("terrain collider allocation failed");
+        exit(1);
+    }
+    for (int i = 0; i < build->chunks.count; i++) {
+        const uint32_t *wide;
+        Mesh collider = TerrainChunkCollisionMesh(&build->chunks, i, &wide);
+        build->colliders[i] = BuildODETriMeshData(&collider, wide);
+    }
+    if (build->threaded) dCleanupODEAllDataForThread();
+    atomic_store(&build->done, true);
+    return NULL;
+}
+
+// Starts meshing heightmap, a new terrain level, with the edits so far. On
+// its own thread when one can be started, else here and now.
+static TerrainBuild *StartTerrainBuild(Heightmap *heightmap, bool threaded) {
+    TerrainBuild *build = calloc(1, sizeof(TerrainBuild));
+    if (!build) {
+        perror("terrain build allocation failed");
+        exit(1);
+    }
+    atomic_init(&build->done, false);
+    build->heightmap = heightmap;
+    build->editCount = terrainEditCount;
+    if (terrainEditCount) {
+        build->edits = malloc(terrainEditCount * sizeof(TerrainEdit));
+        if (!build->edits) {
+            perror("terrain build allocation failed");
+            exit(1);
+        }
+        memcpy(build->edits, terrainEdits, terrainEditCount * sizeof(TerrainEdit));
+    }
+    build->threaded = threaded;  // before the thread reads it
+    if (threaded && pthread_create(&build->thread, NULL, BuildTerrain, build) != 0) build->threaded = false;
+    if (!build->threaded) BuildTerrain(build);
+    return build;
+}
+
+// Waits for build and frees it with everything it made.
+static void DiscardTerrainBuild(TerrainBuild *build) {
+    if (!build) return;
+    if (build->threaded) pthread_join(build->thread, NULL);
+    UnloadTerrainChunks(&build->chunks);
+    for (int i = 0; build->colliders && i < build->chunks.count; i++) DestroyTriMesh(&build->colliders[i]);
+    free(build->colliders);
+    heightmap_destroy(build->heightmap);
+    heightmap_q16_destroy(build->codes);
+    free(build->edits);
+    free(build);
+}
+
+// Applies one edit to the current terrain: its heightmap, the chunks it
+// reaches and their colliders.
+static void ApplyTerrainEdit(const TerrainEdit *edit) {
+    if (terrainHeightmapQ16) {
+        // The heights the chunks were meshed from, now as floats to edit.
+        terrainHeightmap = heightmap_dequantize(terrainHeightmapQ16);
+        heightmap_q16_destroy(terrainHeightmapQ16);
+        terrainHeightmapQ16 = NULL;
+    }
+    terrainHeightmap = EditableHeightmap(terrainHeightmap);
+    const HeightmapRect changed =
+        DeformFlatTorusHeightmap(terrainHeightmap, edit->brush, edit->center, edit->radius, edit->amount);
+    int *touched = malloc(terrainChunks.count * sizeof(int));
+    if (!touched) {
+        perror("terrain edit allocation failed");
+        exit(1);
+    }
+    const int count = UpdateTerrainChunks(&terrainChunks, terrainHeightmap, changed, touched);
+    for (int k = 0; k < count; k++) {
+        const int i = touched[k];
+        SetTerrainChunkCollider(i);
+        frustum_boxes_set(&chunkBoxes, i, &terrainChunks.bounds[i].min.x, &terrainChunks.bounds[i].max.x);
+    }
+    free(touched);
+}
+
+// Makes a finished build the terrain: uploads its chunks, gives its
+// colliders their geoms, then applies the edits made while it was built.
+// Only the upload and the geoms happen on the main thread.
+static void FinishTerrainBuild(TerrainBuild *build) {
+    if (build->threaded) pthread_join(build->thread, NULL);
+    UploadTerrainChunks(&build->chunks);
+    UnloadTerrainChunks(&terrainChunks);
+    terrainChunks = build->chunks;
+    heightmap_destroy(terrainHeightmap);
+    terrainHeightmap = build->heightmap;
+    heightmap_q16_destroy(terrainHeightmapQ16);
+    terrainHeightmapQ16 = build->codes;
+    SetTerrainChunkCount(terrainChunks.count);
+    frustum_boxes_free(&chunkBoxes);
+    frustum_boxes_alloc(&chunkBoxes, terrainChunks.count);
+    chunkBoxes.count = terrainChunks.count;
+    for (int i = 0; i < terrainChunks.count; i++) {
+        SetTerrainChunkTriMeshBuilt(i, build->colliders[i]);
+        frustum_boxes_set(&chunkBoxes, i, &terrainChunks.bounds[i].min.x, &terrainChunks.bounds[i].max.x);
+    }
+    for (int i = build->editCount; i < terrainEditCount; i++) ApplyTerrainEdit(&terrainEdits[i]);
+    free(build->colliders);
+    free(build->edits);
+    free(build);
+}
+
+void DeformTerrain(Vector3 center, float radius, float amount, HeightmapBrush brush) {
+    if (!terrainHeightmap && !terrainHeightmapQ16) return;
+    if (terrainEditCount == terrainEditCapacity) {
+        terrainEditCapacity = terrainEditCapacity ? 2 * terrainEditCapacity : 16;
+        terrainEdits = realloc(terrainEdits, terrainEditCapacity * sizeof(TerrainEdit));
+        if (!terrainEdits) {
+            perror("terrain edit allocation failed");
+            exit(1);
+        }
+    }
+    terrainEdits[terrainEditCount++] = (TerrainEdit){ center, radius, amount, brush };
+    ApplyTerrainEdit(&terrainEdits[terrainEditCount - 1]);
+}
+
 void InitRenderer() {
     //camera.position = (Vector3){ 10.0f, 10.0f, 10.0f };
     //camera.target = (Vector3){ 0.0f, 0.0f, 0.0f };
@@ -60,26 +292,31 @@ void InitRenderer() {
     SetShaderValue(shader, ambientLoc, (float[4]){ 0.1f, 0.1f, 0.1f, 1.0f }, SHADER_UNIFORM_VEC4);
 
     // Create lights
-    lights[0] = CreateLight(LIGHT_POINT, (Vector3){ -HALF_MONITOR_WIDTH, 200, -HALF_MONITOR_HEIGHT }, Vector3Zero(), YELLOW, shader);
-    lights[1] = CreateLight(LIGHT_POINT, (Vector3){ HALF_MONITOR_WIDTH, 200, HALF_MONITOR_HEIGHT }, Vector3Zero(), RED, shader);
-    lights[2] = CreateLight(LIGHT_POINT, (Vector3){ -HALF_MONITOR_WIDTH, 200, HALF_MONITOR_HEIGHT }, Vector3Zero(), GREEN, shader);
-    lights[3] = CreateLight(LIGHT_POINT, (Vector3){ HALF_MONITOR_WIDTH, 200, -HALF_MONITOR_HEIGHT }, Vector3Zero(), BLUE, shader);
-
-    float R = MONITOR_WIDTH / (2.0f * PI);
-    float r = MONITOR_HEIGHT / (2.0f * PI);
-    SetTorusDimensions(R, r);
-    Mesh terrain_mesh = MyGenFlatTorusMesh(TORUS_MAJOR_SEGMENTS, TORUS_MINOR_SEGMENTS);
-    SetTerrainTriMesh(&terrain_mesh);
-    GenMeshTangents(&terrain_mesh);
-    terrain = LoadModelFromMesh(terrain_mesh);
-    terrain.materials[0].shader = shader;
+    const TerrainConfig *config = terrain_config();
+    const float half_width = config->world_width / 2.0f, half_height = config->world_height / 2.0f;
+    lights[0] = CreateLight(LIGHT_POINT, (Vector3){ -half_width, 200, -half_height }, Vector3Zero(), YELLOW, shader);
+    lights[1] = CreateLight(LIGHT_POINT, (Vector3){ half_width, 200, half_height }, Vector3Zero(), RED, shader);
+    lights[2] = CreateLight(LIGHT_POINT, (Vector3){ -half_width, 200, half_height }, Vector3Zero(), GREEN, shader);
+    lights[3] = CreateLight(LIGHT_POINT, (Vector3){ half_width, 200, -half_height }, Vector3Zero(), BLUE, shader);
+
+    SetTorusDimensions(terrain_major_radius(), terrain_minor_radius());
+    // Start on the coarsest terrain level, meshed here; UpdateTerrain swaps
+    // in finer ones as the background refinement delivers them and they are
+    // meshed in turn.
+    terrainRefinement = terrain_refine_start();
+    FinishTerrainBuild(StartTerrainBuild(terrain_refine_poll(terrainRefinement), false));
+    terrainMaterial = LoadMaterialDefault();
+    terrainMaterial.shader = shader;
     Image checked = GenImageChecked(1024, 1024, 32, 32, DARKGRAY, LIGHTGRAY);
     Texture2D texChecked = LoadTextureFromImage(checked);
     SetTextureWrap(texChecked, TEXTURE_WRAP_REPEAT);
     SetTextureFilter(texChecked, TEXTURE_FILTER_BILINEAR);
-    terrain.materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = texChecked;
+    terrainMaterial.maps[MATERIAL_MAP_DIFFUSE].texture = texChecked;
 
     AttachShaderToPhysicsBodies(shader);
+    frustum_spheres_alloc(&bodySpheres, MAX_BODIES);
+    frustum_boxes_alloc(&vehicleBoxes, 6);
+    frustum_spheres_alloc(&lightSpheres, MAX_LIGHTS);
 
     // Load sky texture (should be 2:1 ratio, like 4096x2048)
     printf("Loading sky texture from: %s\n", IMAGE_PATH "starfield.jpg");
@@ -114,8 +351,27 @@ void InitRenderer() {
 
 }
 
+// Swaps in a terrain level once its mesh and colliders are built, and
+// starts building the newest level to have arrived since. One build runs at
+// a time; levels that arrive meanwhile are skipped for the newest.
+static void UpdateTerrain() {
+    if (terrainBuild) {
+        if (!atomic_load(&terrainBuild->done)) return;
+        FinishTerrainBuild(terrainBuild);
+        terrainBuild = NULL;
+    }
+    if (!terrainRefinement) return;
+    Heightmap *heightmap = terrain_refine_poll(terrainRefinement);
+    if (heightmap) terrainBuild = StartTerrainBuild(heightmap, true);
+    else if (terrain_refine_done(terrainRefinement)) {
+        terrain_refine_stop(terrainRefinement);
+        terrainRefinement = NULL;
+    }
+}
+
 void BeginRender() {
     ClearBackground(BLACK);
+    UpdateTerrain();
 
     //UpdateCameraManual(&camera);
 
@@ -130,18 +386,26 @@ void BeginRender() {
     
     // Update light values (actually, only enable/disable them)
     for (int i = 0; i < MAX_LIGHTS; i++) UpdateLightValues(shader, lights[i]);
+    Matrix projection = MatrixPerspective(
+        DEG2RAD * camera.fovy,
+        aspect,
+        1.0f,     // near clip
+        10000.0f   // far clip
+    );
+    frustum_from_matrix(&frustum, MatrixToFloatV(MatrixMultiply(GetCameraMatrix(camera), projection)).v);
+    cullStats = (RenderCullStats){ 0 };
+
     BeginMode3D(camera);
-        rlSetMatrixProjection(MatrixPerspective(
-            DEG2RAD * camera.fovy,
-            aspect,
-            1.0f,     // near clip
-            10000.0f   // far clip
-        ));
+        rlSetMatrixProjection(projection);
 
         // Draw sky sphere centered on camera (moves with it)
         DrawModel(skySphere, camera.position, 1.0f, WHITE);
 }
 
+RenderCullStats GetRenderCullStats() {
+    return cullStats;
+}
+
 float accel=0,steer=0;
 Vector3 debug = {0};
 bool antiSway = true;
@@ -244,10 +508,19 @@ void drawAllSpaceGeoms(dSpaceID space)
 }
 
 void DrawVehicle() {
+    size_t geomIndex[6];
+    vehicleBoxes.count = 0;
     for (size_t i = 0; i < 6; i++)
     {
-        if (checkColliding(car->geoms[i])) drawGeom(car->geoms[i]);
+        if (!checkColliding(car->geoms[i])) continue;
+        dReal aabb[6];
+        dGeomGetAABB(car->geoms[i], aabb);
+        const float min[3] = { aabb[0], aabb[2], aabb[4] }, max[3] = { aabb[1], aabb[3], aabb[5] };
+        frustum_boxes_set(&vehicleBoxes, vehicleBoxes.count, min, max);
+        geomIndex[vehicleBoxes.count++] = i;
     }
+    const size_t drawn = frustum_cull_boxes(&frustum, &vehicleBoxes, VisibleBuffer(vehicleBoxes.count), &cullStats.vehicle);
+    for (size_t k = 0; k < drawn; k++) drawGeom(car->geoms[geomIndex[visible[k]]]);
 
     for (size_t i = 0; i < 4; i++) {
         DrawJointAxes(car->joints[i], 1.0f);
@@ -260,7 +533,15 @@ void DrawVehicle() {
 
 
 void DrawScene() {
-    DrawModel(terrain, Vector3Zero(), 1.0f, WHITE);
+    // LOD covers every chunk, seen or not, so neighbours always stitch.
+    UpdateTerrainLod(&terrainChunks, camera.position, camera.fovy, GetScreenHeight(), TERRAIN_LOD_ERROR_PIXELS);
+    const size_t drawnChunks = frustum_cull_boxes(&frustum, &chunkBoxes, VisibleBuffer(chunkBoxes.count),
+                                                  &cullStats.terrain);
+    terrainTriangles = 0;
+    for (size_t k = 0; k < drawnChunks; k++) {
+        DrawTerrainChunk(&terrainChunks, (int)visible[k], terrainMaterial);
+        terrainTriangles += terrainChunks.meshes[visible[k]].triangleCount;
+    }
     DrawGrid(1000, 10.0f);
 
 
@@ -298,6 +579,12 @@ void DrawScene() {
 
         const dReal* cp = dBodyGetPosition(car->bodies[0]);
         camera.target = (Vector3){cp[0],cp[1]+1,cp[2]};
+
+        if (IsKeyPressed(KEY_C)) {
+            dVector3 ahead;
+            dBodyGetRelPointPos(car->bodies[0], CRATER_AHEAD, 0, 0, ahead);
+            DeformTerrain((Vector3){ ahead[0], ahead[1], ahead[2] }, CRATER_RADIUS, CRATER_DEPTH, HEIGHTMAP_BRUSH_CRATER);
+        }
         
         float lerp = 0.1f;
 
@@ -331,8 +618,19 @@ void DrawScene() {
         
         physTime = GetTime() - physTime;    
 
+    // A cube's bounding sphere reaches its corners.
+    bodySpheres.count = MAX_BODIES;
     for (int i = 0; i < MAX_BODIES; i++) {
         Vector3 pos = GetPhysicsBodyPosition(i);
+        bodySpheres.x[i] = pos.x;
+        bodySpheres.y[i] = pos.y;
+        bodySpheres.z[i] = pos.z;
+        bodySpheres.radius[i] = CUBE_SIZE * 0.8660254f;
+    }
+    const size_t drawnBodies = frustum_cull_spheres(&frustum, &bodySpheres, VisibleBuffer(MAX_BODIES), &cullStats.bodies);
+    for (size_t k = 0; k < drawnBodies; k++) {
+        const int i = (int)visible[k];
+        Vector3 pos = { bodySpheres.x[i], bodySpheres.y[i], bodySpheres.z[i] };
         float angle;
         Vector3 axis;
         GetPhysicsBodyAxisAngle(i, &axis, &angle);
@@ -346,8 +644,17 @@ void DrawScene() {
     DrawVehicle();
 
     // Draw spheres to show where the lights are
-    for (int i = 0; i < MAX_LIGHTS; i++)
+    lightSpheres.count = MAX_LIGHTS;
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        lightSpheres.x[i] = lights[i].position.x;
+        lightSpheres.y[i] = lights[i].position.y;
+        lightSpheres.z[i] = lights[i].position.z;
+        lightSpheres.radius[i] = 100.0f;
+    }
+    const size_t drawnLights = frustum_cull_spheres(&frustum, &lightSpheres, VisibleBuffer(MAX_LIGHTS), &cullStats.lights);
+    for (size_t k = 0; k < drawnLights; k++)
     {
+        const int i = (int)visible[k];
         if (lights[i].enabled) DrawSphereEx(lights[i].position, 100.0f, 8, 8, lights[i].color);
         else DrawSphereWires(lights[i].position, 100.0f, 8, 8, ColorAlpha(lights[i].color, 0.3f));
     }
@@ -359,8 +666,35 @@ void DrawScene() {
 void EndRender() {
     EndMode3D();
     DrawFPS(SCREEN_WIDTH - 100, 10);
+    DrawText(TextFormat("Terrain: %d triangles in %d of %d chunks", terrainTriangles, (int)cullStats.terrain.drawn,
+                        (int)cullStats.terrain.tested), 10, 35, 20, LIGHTGRAY);
+    DrawText(TextFormat("Culled: %d bodies, %d vehicle parts, %d lights", (int)cullStats.bodies.culled,
+                        (int)cullStats.vehicle.culled, (int)cullStats.lights.culled), 10, 60, 20, LIGHTGRAY);
+    if (terrainRefinement) {
+        DrawText(TextFormat("Refining terrain: %d%%", (int)(terrain_refine_progress(terrainRefinement) * 100.0f)),
+                 10, 10, 20, LIGHTGRAY);
+    }
 }
 
 void ShutdownRenderer() {
+    terrain_refine_stop(terrainRefinement);
+    terrainRefinement = NULL;
+    DiscardTerrainBuild(terrainBuild);
+    terrainBuild = NULL;
+    UnloadTerrainChunks(&terrainChunks);
+    heightmap_destroy(terrainHeightmap);
+    terrainHeightmap = NULL;
+    heightmap_q16_destroy(terrainHeightmapQ16);
+    terrainHeightmapQ16 = NULL;
+    free(terrainEdits);
+    terrainEdits = NULL;
+    terrainEditCount = terrainEditCapacity = 0;
+    frustum_boxes_free(&chunkBoxes);
+    frustum_spheres_free(&bodySpheres);
+    frustum_boxes_free(&vehicleBoxes);
+    frustum_spheres_free(&lightSpheres);
+    free(visible);
+    visible = NULL;
+    visibleCapacity = 0;
     // Unload models, textures, shaders
 }
\ No newline at end of file
@@ -1,19 +1,29 @@
 #ifndef RENDER_H
 #define RENDER_H
 #include "stdio.h"
+#include "raylib.h"
+#include "frustum.h"
+#include "heightmap.h"
 void InitRenderer();
 void BeginRender();
 void DrawScene();
 void EndRender();
 void ShutdownRenderer();
 
+// Frustum culling counters of the last frame drawn.
+typedef struct RenderCullStats {
+    FrustumStats terrain, bodies, vehicle, lights;
+} RenderCullStats;
+RenderCullStats GetRenderCullStats();
+
+// Deforms the terrain with brush over radius world units around center:
+// raises it amount units at the middle, or for a crater digs that deep.
+// Only the chunks the edit reaches are re-meshed, re-uploaded and given
+// new colliders, and finer terrain levels arriving later keep the edit.
+void DeformTerrain(Vector3 center, float radius, float amount, HeightmapBrush brush);
+
 extern size_t SCREEN_WIDTH;
 extern size_t SCREEN_HEIGHT;
 extern float HALF_SCREEN_WIDTH;
 extern float HALF_SCREEN_HEIGHT;
-
-extern size_t MONITOR_WIDTH;
-extern size_t MONITOR_HEIGHT;
-extern float HALF_MONITOR_WIDTH;
-extern float HALF_MONITOR_HEIGHT;
 #endif
\ No newline at end of file
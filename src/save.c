@@ -1,7 +1,25 @@
+#define _POSIX_C_SOURCE 200112L  // mmap, fstat
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "save.h"
+#include "heightmap_codec.h"
+#include "io_worker.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Header bytes before the payload, padded so row 0 is cache-line aligned in
+// a page-aligned mapping.
+#define HEIGHTMAP_FILE_DATA_OFFSET \
+    ((sizeof(HeightmapFileHeader) + HEIGHTMAP_ALIGNMENT - 1) / HEIGHTMAP_ALIGNMENT * HEIGHTMAP_ALIGNMENT)
+// Tiled files start their first tile on a page boundary.
+#define HEIGHTMAP_FILE_PAGE 4096
 
 char *build_fullpath(const char *folder1, const char *folder2, const char *filename) {
     const size_t length = strlen(folder1) + 1 + strlen(folder2) + 1 + strlen(filename) + 1; // 2 slashes + null terminator
@@ -14,16 +32,22 @@ char *build_fullpath(const char *folder1, const char *folder2, const char *filen
     return full_path;
 }
 
-bool file_exists(const char *filename) {
-    printf("Checking if file exists: %s\n", filename);
-    FILE *f = fopen(filename, "r");
-    if (f) {
-        printf("File exists: %s\n", filename);
-        fclose(f);
-        return true;  // File exists
+uint64_t cache_key(uint64_t key, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        key ^= bytes[i];
+        key *= 0x100000001b3ull;
     }
-    printf("File does not exist: %s\n", filename);
-    return false;      // File does not exist
+    return key;
+}
+
+void cache_filename(char *out, size_t size, const char *kind, uint64_t key) {
+    snprintf(out, size, "%s-%016llx.bin", kind, (unsigned long long)key);
+}
+
+bool file_exists(const char *filename) {
+    struct stat st;
+    return stat(filename, &st) == 0;  // no need to open it
 }
 
 bool heightmap_exists(const char *filename) {
@@ -38,104 +62,475 @@ bool heightmap_exists(const char *filename) {
     return file_exists(full_path);
 }   
 
-void save_matrix(const char *filename, float **matrix, int rows, int cols) {
+typedef struct HeightmapFile {
+    const Heightmap *heightmap;
+    HeightmapEncoding encoding;
+} HeightmapFile;
+
+static size_t tile_count(size_t size, size_t tile_size) {
+    return (size + tile_size - 1) / tile_size;
+}
+
+// Index then tiles, as described for HeightmapTiles.
+static bool write_tiles(FILE *f, const Heightmap *matrix, size_t tile_size, uint64_t data_offset) {
+    const size_t tiles_x = tile_count(matrix->width, tile_size), tiles_y = tile_count(matrix->height, tile_size);
+    const size_t tiles = tiles_x * tiles_y, tile_bytes = tile_size * tile_size * sizeof(float);
+    const size_t index_bytes = tiles * sizeof(uint64_t);
+    const uint64_t first = (data_offset + index_bytes + HEIGHTMAP_FILE_PAGE - 1) / HEIGHTMAP_FILE_PAGE * HEIGHTMAP_FILE_PAGE;
+
+    uint64_t *index = malloc(index_bytes);
+    float *tile = malloc(tile_bytes);
+    unsigned char *pad = calloc(1, HEIGHTMAP_FILE_PAGE);
+    if (!index || !tile || !pad) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (size_t i = 0; i < tiles; i++) index[i] = first + i * tile_bytes;
+    size_t padding = (size_t)(first - data_offset - index_bytes);
+    bool ok = fwrite(index, sizeof(uint64_t), tiles, f) == tiles && fwrite(pad, 1, padding, f) == padding;
+
+    for (size_t ty = 0; ok && ty < tiles_y; ty++) {
+        for (size_t tx = 0; ok && tx < tiles_x; tx++) {
+            memset(tile, 0, tile_bytes);
+            size_t x0 = tx * tile_size, y0 = ty * tile_size;
+            size_t w = matrix->width - x0 < tile_size ? matrix->width - x0 : tile_size;
+            size_t h = matrix->height - y0 < tile_size ? matrix->height - y0 : tile_size;
+            for (size_t y = 0; y < h; y++) {
+                memcpy(tile + y * tile_size, heightmap_row(matrix, y0 + y) + x0, w * sizeof(float));
+            }
+            ok = fwrite(tile, 1, tile_bytes, f) == tile_bytes;
+        }
+    }
+    free(pad);
+    free(tile);
+    free(index);
+    return ok;
+}
+
+static bool save_matrix(const char *filename, const void *data) {
+    const HeightmapFile *file = data;
+    const Heightmap *matrix = file->heightmap;
     FILE *f = fopen(filename, "wb");
     if (!f) {
         perror("Cannot open file for writing");
-        return;
+        return false;
     }
 
-    // Write dimensions
-    fwrite(&rows, sizeof(int), 1, f);
-    fwrite(&cols, sizeof(int), 1, f);
+    unsigned char header[HEIGHTMAP_FILE_DATA_OFFSET] = {0};
+    HeightmapFileHeader h = {0};
+    memcpy(h.magic, HEIGHTMAP_FILE_MAGIC, sizeof(h.magic));
+    h.version = HEIGHTMAP_FILE_VERSION;
+    h.endian = SAVE_ENDIAN_MARKER;
+    h.data_offset = (uint32_t)sizeof(header);
+    h.width = matrix->width;
+    h.height = matrix->height;
+    h.stride = matrix->stride;
+    h.min = matrix->min;
+    h.max = matrix->max;
+    h.params = matrix->params;
+    h.encoding = file->encoding;
 
-    // Write matrix data row by row
-    for (int i = 0; i < rows; i++) {
-        fwrite(matrix[i], sizeof(float), cols, f);
+    bool ok;
+    if (file->encoding == HEIGHTMAP_ENCODING_Q16_RANS) {
+        HeightmapQ16 *q = heightmap_quantize(matrix);
+        unsigned char *stream = malloc(heightmap_encode_bound(q));
+        if (!stream) {
+            perror("malloc failed");
+            exit(1);
+        }
+        size_t size = heightmap_encode(q, stream);
+        h.stride = h.width;
+        memcpy(header, &h, sizeof(h));
+        ok = fwrite(header, sizeof(header), 1, f) == 1 && fwrite(stream, 1, size, f) == size;
+        printf("Heightmap encoded to %zu bytes, %.2f bits per height\n", size,
+               8.0 * size / ((double)matrix->width * matrix->height));
+        free(stream);
+        heightmap_q16_destroy(q);
+    } else if (file->encoding == HEIGHTMAP_ENCODING_F32_TILED) {
+        h.stride = h.tile_size = HEIGHTMAP_TILE_SIZE;
+        memcpy(header, &h, sizeof(h));
+        ok = fwrite(header, sizeof(header), 1, f) == 1 && write_tiles(f, matrix, HEIGHTMAP_TILE_SIZE, sizeof(header));
+    } else {
+        // The rows are contiguous, padding included, so the payload is one write.
+        size_t count = matrix->stride * matrix->height;
+        memcpy(header, &h, sizeof(h));
+        ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+             fwrite(matrix->data, sizeof(float), count, f) == count;
     }
+    if (fclose(f) != 0) ok = false;
+    if (!ok) perror("Failed to write heightmap");
+    return ok;
+}
 
-    fclose(f);
+char *resource_path(const char *folder, const char *filename) {
+    const size_t length = strlen(S_RESOURCES) + 1 + strlen(folder) + 1; // 1 for PATH_SEP + 1 for null terminator
+    char folder_path[length];
+    snprintf(folder_path, length, "%s%c%s", S_RESOURCES, PATH_SEP, folder);
+    mkdir(S_RESOURCES, 0755);
+    mkdir(folder_path, 0755);
+    return build_fullpath(S_RESOURCES, folder, filename);
 }
 
-void save_heightmap(const char *filename, float **heightmap, int rows, int cols) {
-    const char *folder1 = S_RESOURCES;
-    const char *folder2 = S_HEIGHTMAPS;
+bool write_file(const char *path, bool (*write)(const char *path, const void *data), const void *data) {
+    const size_t length = strlen(path) + 5;
+    char tmp_path[length];
+    snprintf(tmp_path, length, "%s.tmp", path);
+#ifdef _WIN32
+    remove(path);  // rename does not replace an existing file here
+#endif
+    if (!write(tmp_path, data) || rename(tmp_path, path) != 0) {
+        perror("Failed to save file");
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
 
-    const size_t length = strlen(folder1) + 1 + strlen(folder2) + 1 + strlen(filename) + 1; // 2 slashes + null terminator
-    
-    char full_path[length];
-    snprintf(full_path, length, "%s%c%s%c%s", folder1, PATH_SEP, folder2, PATH_SEP, filename);
+void save_heightmap(const char *filename, const Heightmap *heightmap, HeightmapEncoding encoding) {
+    char *full_path = resource_path(S_HEIGHTMAPS, filename);
     printf("Full path: %s\n", full_path);
-    
-    if (!file_exists(full_path)) {
-        mkdir(folder1, 0755);
-        const size_t folder2_length = strlen(folder1) + 1 + strlen(folder2) + 1; // 1 for PATH_SEP + 1 for null terminator
-        char folder2_path[folder2_length];
-        snprintf(folder2_path, folder2_length, "%s%c%s", folder1, PATH_SEP, folder2);
-        mkdir(folder2_path, 0755);
+    HeightmapFile file = { heightmap, encoding };
+    if (write_file(full_path, save_matrix, &file)) {
+        printf("Heightmap saved to %s\n", full_path);
+    }
+    free(full_path);
+}
+
+typedef struct HeightmapSave {
+    char *filename;
+    Heightmap *heightmap;
+    HeightmapEncoding encoding;
+} HeightmapSave;
+
+static void save_heightmap_job(void *arg) {
+    HeightmapSave *save = arg;
+    save_heightmap(save->filename, save->heightmap, save->encoding);
+    heightmap_destroy(save->heightmap);
+    free(save->filename);
+    free(save);
+}
+
+void save_heightmap_async(const char *filename, const Heightmap *heightmap, HeightmapEncoding encoding) {
+    HeightmapSave *save = malloc(sizeof(HeightmapSave));
+    char *name = malloc(strlen(filename) + 1);
+    if (!save || !name) {
+        perror("malloc failed");
+        exit(1);
+    }
+    save->filename = strcpy(name, filename);
+    save->heightmap = heightmap_copy(heightmap);
+    save->encoding = encoding;
+    io_worker_submit(save_heightmap_job, save);
+}
+
+typedef struct PgmExport {
+    char *path;
+    size_t width, height;
+    unsigned char pixels[];
+} PgmExport;
+
+static void export_pgm_job(void *arg) {
+    PgmExport *pgm = arg;
+    FILE *f = fopen(pgm->path, "wb");
+    if (!f) {
+        perror("Cannot write image");
+    } else {
+        fprintf(f, "P5\n%zu %zu\n255\n", pgm->width, pgm->height);  // P5 = binary greyscale
+        const size_t size = pgm->width * pgm->height;
+        bool ok = fwrite(pgm->pixels, 1, size, f) == size;
+        if (fclose(f) != 0) ok = false;
+        if (ok) printf("Heightmap written to %s\n", pgm->path);
+        else perror("Error writing image data");
+    }
+    free(pgm->path);
+    free(pgm);
+}
+
+void export_heightmap_pgm(const char *path, const Heightmap *heightmap) {
+    const size_t width = heightmap->width, height = heightmap->height;
+    PgmExport *pgm = malloc(sizeof(PgmExport) + width * height);
+    char *name = malloc(strlen(path) + 1);
+    if (!pgm || !name) {
+        perror("malloc failed");
+        exit(1);
     }
+    pgm->path = strcpy(name, path);
+    pgm->width = width;
+    pgm->height = height;
+    // Quantize here, so the job does not need the map.
+    for (size_t v = 0; v < height; v++) {
+        const float *row = heightmap_row(heightmap, v);
+        for (size_t u = 0; u < width; u++) {
+            pgm->pixels[v * width + u] = (unsigned char)(row[u] * 255.0f);
+        }
+    }
+    io_worker_submit(export_pgm_job, pgm);
+}
 
-    save_matrix(full_path, heightmap, rows, cols);
-    printf("Heightmap saved to %s\n", full_path);
+// Checks a header read from a file of file_size bytes.
+static bool check_header(const HeightmapFileHeader *h, uint64_t file_size, const char *filename) {
+    if (memcmp(h->magic, HEIGHTMAP_FILE_MAGIC, sizeof(h->magic)) != 0) {
+        fprintf(stderr, "%s is not a heightmap file\n", filename);
+        return false;
+    }
+    if (h->endian != SAVE_ENDIAN_MARKER) {
+        fprintf(stderr, "%s was written with the other byte order\n", filename);
+        return false;
+    }
+    if (h->version != HEIGHTMAP_FILE_VERSION) {
+        fprintf(stderr, "%s has version %u, expected %u\n", filename, h->version, HEIGHTMAP_FILE_VERSION);
+        return false;
+    }
+    bool ok = h->width > 0 && h->height > 0 && h->data_offset >= sizeof(*h) && h->data_offset <= file_size &&
+              h->data_offset % HEIGHTMAP_ALIGNMENT == 0;
+    if (ok && h->encoding == HEIGHTMAP_ENCODING_F32) {
+        ok = h->stride >= h->width && h->stride % (HEIGHTMAP_ALIGNMENT / sizeof(float)) == 0 &&
+             h->height <= (file_size - h->data_offset) / sizeof(float) / h->stride;
+    } else if (ok && h->encoding == HEIGHTMAP_ENCODING_F32_TILED) {
+        // The tile offsets themselves are checked when the index is read.
+        ok = h->tile_size > 0 && h->tile_size % (HEIGHTMAP_ALIGNMENT / sizeof(float)) == 0 &&
+             tile_count(h->width, h->tile_size) * tile_count(h->height, h->tile_size) <=
+                 (file_size - h->data_offset) / sizeof(uint64_t);
+    } else if (ok) {
+        ok = h->encoding == HEIGHTMAP_ENCODING_Q16_RANS;
+    }
+    if (!ok) {
+        fprintf(stderr, "%s has a bad header or is truncated\n", filename);
+    }
+    return ok;
 }
 
-// Function to load a matrix from a binary file
-float **load_matrix(const char *filename, size_t *out_rows, size_t *out_cols) {
-    printf("load_matrix: Loading matrix from file: %s\n", filename);
+// A whole file in memory: mapped read-only where mmap exists, read into a
+// buffer otherwise.
+typedef struct FileView {
+    const unsigned char *bytes;
+    size_t size;
+} FileView;
+
+static bool open_view(const char *filename, FileView *view) {
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open file");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "%s is empty\n", filename);
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+        perror("Failed to map file");
+        return false;
+    }
+    view->bytes = mapping;
+    view->size = (size_t)st.st_size;
+    return true;
+#else
     FILE *f = fopen(filename, "rb");
     if (!f) {
         perror("Failed to open file");
-        return NULL;
+        return false;
+    }
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+    unsigned char *bytes = size > 0 ? malloc((size_t)size) : NULL;
+    bool ok = bytes && fseek(f, 0, SEEK_SET) == 0 && fread(bytes, 1, (size_t)size, f) == (size_t)size;
+    fclose(f);
+    if (!ok) {
+        perror("Failed to read file");
+        free(bytes);
+        return false;
     }
+    view->bytes = bytes;
+    view->size = (size_t)size;
+    return true;
+#endif
+}
 
-    int rows, cols;
+static void close_view(FileView *view) {
+#ifndef _WIN32
+    munmap((void *)view->bytes, view->size);
+#else
+    free((void *)view->bytes);
+#endif
+}
 
-    if (fread(&rows, sizeof(int), 1, f) != 1) {
-        perror("Failed to read number of rows");
-        fclose(f);
+// Validated header of view, or NULL.
+static const HeightmapFileHeader *view_header(const FileView *view, const char *filename) {
+    if (view->size < sizeof(HeightmapFileHeader)) {
+        fprintf(stderr, "%s is too short for a heightmap header\n", filename);
         return NULL;
     }
+    const HeightmapFileHeader *h = (const HeightmapFileHeader *)view->bytes;
+    return check_header(h, view->size, filename) ? h : NULL;
+}
+
+// The float rows of an F32 file, in place; the view owns the data.
+static Heightmap view_matrix(const FileView *view, const HeightmapFileHeader *h) {
+    Heightmap matrix = { 0 };
+    matrix.data = (float *)(view->bytes + h->data_offset);
+    matrix.width = (size_t)h->width;
+    matrix.height = (size_t)h->height;
+    matrix.stride = (size_t)h->stride;
+    matrix.min = h->min;
+    matrix.max = h->max;
+    matrix.params = h->params;
+    return matrix;
+}
 
-    if (fread(&cols, sizeof(int), 1, f) != 1) {
-        perror("Failed to read number of columns");
-        fclose(f);
+static HeightmapQ16 *decode_matrix(const FileView *view, const HeightmapFileHeader *h, const char *filename) {
+    HeightmapQ16 *q = heightmap_q16_create((size_t)h->width, (size_t)h->height, h->min, h->max);
+    q->params = h->params;
+    if (!heightmap_decode(view->bytes + h->data_offset, view->size - h->data_offset, q)) {
+        fprintf(stderr, "%s has a corrupt payload\n", filename);
+        heightmap_q16_destroy(q);
         return NULL;
     }
+    return q;
+}
 
-    float **matrix = malloc(rows * sizeof(float *));
-    if (!matrix) {
-        perror("Failed to allocate row pointers");
-        fclose(f);
-        return NULL;
+// Takes over view on success.
+static HeightmapTiles *view_tiles(FileView *view, const HeightmapFileHeader *h, const char *filename) {
+    HeightmapTiles *tiles = malloc(sizeof(HeightmapTiles));
+    if (!tiles) {
+        perror("malloc failed");
+        exit(1);
     }
+    tiles->width = (size_t)h->width;
+    tiles->height = (size_t)h->height;
+    tiles->tile_size = h->tile_size;
+    tiles->tiles_x = tile_count(tiles->width, tiles->tile_size);
+    tiles->tiles_y = tile_count(tiles->height, tiles->tile_size);
+    tiles->min = h->min;
+    tiles->max = h->max;
+    tiles->params = h->params;
+    tiles->offset = (const uint64_t *)(view->bytes + h->data_offset);
+    tiles->bytes = view->bytes;
+    tiles->size = view->size;
 
-    for (int i = 0; i < rows; i++) {
-        matrix[i] = malloc(cols * sizeof(float));
-        if (!matrix[i]) {
-            perror("Failed to allocate row data");
-            // Free already allocated rows
-            for (int j = 0; j < i; j++) {
-                free(matrix[j]);
-            }
-            free(matrix);
-            fclose(f);
+    const uint64_t tile_bytes = (uint64_t)tiles->tile_size * tiles->tile_size * sizeof(float);
+    for (size_t i = 0; i < tiles->tiles_x * tiles->tiles_y; i++) {
+        uint64_t offset = tiles->offset[i];
+        if (offset % HEIGHTMAP_ALIGNMENT != 0 || offset > view->size || tile_bytes > view->size - offset) {
+            fprintf(stderr, "%s has a bad tile index\n", filename);
+            free(tiles);
             return NULL;
         }
+    }
+    return tiles;
+}
 
-        if (fread(matrix[i], sizeof(float), cols, f) != (size_t)cols) {
-            perror("Failed to read row data");
-            // Clean up
-            for (int j = 0; j <= i; j++) {
-                free(matrix[j]);
-            }
-            free(matrix);
-            fclose(f);
-            return NULL;
+HeightmapTiles *heightmap_tiles_open(const char *filename) {
+    char *full_path = build_fullpath(S_RESOURCES, S_HEIGHTMAPS, filename);
+    FileView view;
+    HeightmapTiles *tiles = NULL;
+    if (open_view(full_path, &view)) {
+        const HeightmapFileHeader *h = view_header(&view, full_path);
+        if (h && h->encoding != HEIGHTMAP_ENCODING_F32_TILED) {
+            fprintf(stderr, "%s is not a tiled heightmap\n", full_path);
+        } else if (h) {
+            tiles = view_tiles(&view, h, full_path);
         }
+        if (!tiles) close_view(&view);
     }
+#ifndef _WIN32
+    // Regions are read in no particular order; readahead would only pull in
+    // neighbouring tiles nobody asked for.
+    if (tiles) posix_madvise((void *)tiles->bytes, tiles->size, POSIX_MADV_RANDOM);
+#endif
+    free(full_path);
+    return tiles;
+}
 
-    fclose(f);
-    *out_rows = rows;
-    *out_cols = cols;
+void heightmap_tiles_close(HeightmapTiles *tiles) {
+    if (!tiles) return;
+    FileView view = { tiles->bytes, tiles->size };
+    close_view(&view);
+    free(tiles);
+}
+
+Heightmap *heightmap_tiles_read(const HeightmapTiles *tiles, long x, long y, size_t width, size_t height) {
+    Heightmap *region = heightmap_create(width, height);
+    region->min = tiles->min;
+    region->max = tiles->max;
+    region->params = tiles->params;
+    const long map_w = (long)tiles->width, map_h = (long)tiles->height;
+    const size_t t = tiles->tile_size;
+    x = (x % map_w + map_w) % map_w;
+    y = (y % map_h + map_h) % map_h;
+
+    // Each region row is copied in runs that end at a tile or map edge.
+    #pragma omp parallel for schedule(static)
+    for (long v = 0; v < (long)height; v++) {
+        size_t sy = (size_t)((y + v) % map_h);
+        float *row = heightmap_row(region, (size_t)v);
+        size_t u = 0, sx = (size_t)x;
+        while (u < width) {
+            size_t ix = sx % t;
+            size_t run = t - ix;
+            if (run > tiles->width - sx) run = tiles->width - sx;
+            if (run > width - u) run = width - u;
+            const float *src = heightmap_tile(tiles, sx / t, sy / t) + (sy % t) * t + ix;
+            memcpy(row + u, src, run * sizeof(float));
+            u += run;
+            sx += run;
+            if (sx == tiles->width) sx = 0;
+        }
+    }
+    return region;
+}
+
+static Heightmap *load_matrix(const char *filename) {
+    printf("load_matrix: Mapping matrix from file: %s\n", filename);
+    FileView view;
+    if (!open_view(filename, &view)) return NULL;
+    const HeightmapFileHeader *h = view_header(&view, filename);
+    Heightmap *matrix = NULL;
+    if (h && h->encoding == HEIGHTMAP_ENCODING_F32_TILED) {
+        HeightmapTiles *tiles = view_tiles(&view, h, filename);
+        if (tiles) {
+            matrix = heightmap_tiles_read(tiles, 0, 0, tiles->width, tiles->height);
+            heightmap_tiles_close(tiles);  // also closes the view
+            return matrix;
+        }
+    } else if (h && h->encoding == HEIGHTMAP_ENCODING_Q16_RANS) {
+        HeightmapQ16 *q = decode_matrix(&view, h, filename);
+        if (q) matrix = heightmap_dequantize(q);
+        heightmap_q16_destroy(q);
+    } else if (h) {
+        Heightmap in_place = view_matrix(&view, h);
+#ifndef _WIN32
+        // Zero copy: the map keeps the mapping and unmaps it when destroyed.
+        matrix = malloc(sizeof(Heightmap));
+        if (!matrix) {
+            perror("malloc failed");
+            exit(1);
+        }
+        *matrix = in_place;
+        matrix->mapping = (void *)view.bytes;
+        matrix->mapping_size = view.size;
+        return matrix;
+#else
+        matrix = heightmap_create(in_place.width, in_place.height);
+        for (size_t i = 0; i < matrix->height; i++) {
+            memcpy(heightmap_row(matrix, i), heightmap_row(&in_place, i), matrix->width * sizeof(float));
+        }
+        matrix->min = in_place.min;
+        matrix->max = in_place.max;
+        matrix->params = in_place.params;
+#endif
+    }
+    close_view(&view);
     return matrix;
 }
+
+Heightmap *load_heightmap(const char *filename) {
+    char *full_path = build_fullpath(S_RESOURCES, S_HEIGHTMAPS, filename);
+    Heightmap *heightmap = load_matrix(full_path);
+    free(full_path);
+    return heightmap;
+}
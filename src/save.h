@@ -15,10 +15,111 @@
 #define S_HEIGHTMAPS "heightmaps"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "heightmap.h"
+
+// Every saved file records this in its header; it reads back byte-swapped on
+// a machine of the other byte order.
+#define SAVE_ENDIAN_MARKER 0x01020304u
+
+// Derived data (heightmaps, meshes) is cached under a key hashed from every
+// input that produced it, so a change to any of them misses the cache instead
+// of reusing stale data. Chain cache_key over the inputs starting from
+// CACHE_KEY_INIT; it is 64-bit FNV-1a, so the key is stable across runs.
+#define CACHE_KEY_INIT 0xcbf29ce484222325ull
+uint64_t cache_key(uint64_t key, const void *data, size_t size);
+// Writes "<kind>-<key as 16 hex digits>.bin" into out.
+void cache_filename(char *out, size_t size, const char *kind, uint64_t key);
+
+// Heightmap files are a fixed header followed by the rows exactly as they sit
+// in memory, stride floats apart from a 64-byte aligned offset, so a reader
+// can map the file and use the payload in place.
+#define HEIGHTMAP_FILE_MAGIC "HMAP"
+#define HEIGHTMAP_FILE_VERSION 2
+
+// How the payload after the header is stored.
+typedef enum {
+    HEIGHTMAP_ENCODING_F32,         // float rows as in memory; loaded zero-copy
+    HEIGHTMAP_ENCODING_Q16_RANS,    // quantized to 16 bits and compressed (heightmap_codec.h)
+    HEIGHTMAP_ENCODING_F32_TILED    // float tiles behind a tile index, for reading regions (HeightmapTiles)
+} HeightmapEncoding;
+
+// Tile edge, in heights, that save_heightmap uses for F32_TILED files. A
+// 256 x 256 tile is 256 KiB, a whole number of pages, so every tile starts
+// page-aligned and touching one never faults in its neighbours.
+#define HEIGHTMAP_TILE_SIZE 256
+
+typedef struct HeightmapFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t endian;        // SAVE_ENDIAN_MARKER as the writer stored it
+    uint32_t data_offset;   // bytes from the start of the file to row 0
+    uint64_t width, height;
+    uint64_t stride;        // floats from one row to the next
+    float min, max;
+    HeightmapParams params;
+    uint32_t encoding;      // HeightmapEncoding
+    uint32_t tile_size;     // tile edge in heights for F32_TILED, else 0
+} HeightmapFileHeader;
+
+/*
+ * An F32_TILED file opened for region reads. The payload is an index of
+ * tiles_x * tiles_y file offsets, row-major, followed by the tiles: each a
+ * tile_size x tile_size block of floats, rows tile_size apart, zero-padded
+ * past the map's right and bottom edges. The file is mapped without reading
+ * it, so only the tiles a caller touches are ever paged in; that is what lets
+ * a map far larger than memory keep just the region around the vehicle
+ * resident.
+ */
+typedef struct HeightmapTiles {
+    size_t width, height;       // of the whole map
+    size_t tile_size;
+    size_t tiles_x, tiles_y;
+    float min, max;
+    HeightmapParams params;
+    const uint64_t *offset;     // file offset of each tile
+    const unsigned char *bytes; // the file
+    size_t size;
+} HeightmapTiles;
 
 bool heightmap_exists(const char *filename);
-void save_heightmap(const char *filename, float **heightmap, int rows, int cols);
-float **load_matrix(const char *filename, size_t *out_rows, size_t *out_cols);
+// Writes resources/heightmaps/filename through a temporary file, so a reader
+// never sees a half-written map.
+void save_heightmap(const char *filename, const Heightmap *heightmap, HeightmapEncoding encoding);
+// save_heightmap on the I/O worker (io_worker.h), from a copy of heightmap,
+// so the caller can go on using or destroy its map straight away.
+void save_heightmap_async(const char *filename, const Heightmap *heightmap, HeightmapEncoding encoding);
+// Debug preview: writes heightmap as an 8-bit greyscale PGM at path, on the
+// I/O worker. Heights are taken to lie in [0, 1].
+void export_heightmap_pgm(const char *path, const Heightmap *heightmap);
+// Maps resources/heightmaps/filename read-only. For an F32 file the returned
+// heightmap's data, range and params come straight from the file: nothing is
+// copied and pages are read as they are touched. A Q16_RANS file is decoded
+// into a fresh map. NULL if the file is missing, truncated, corrupt, or has
+// another version or byte order.
+Heightmap *load_heightmap(const char *filename);
+
+// Opens resources/heightmaps/filename, which must be F32_TILED, reading only
+// its header and tile index. NULL if it is missing or not a valid tiled file.
+HeightmapTiles *heightmap_tiles_open(const char *filename);
+void heightmap_tiles_close(HeightmapTiles *tiles);
+// Copies the width x height region at (x, y), wrapping around the torus,
+// into a new heightmap carrying the whole map's range and params. Only the
+// tiles the region overlaps are touched.
+Heightmap *heightmap_tiles_read(const HeightmapTiles *tiles, long x, long y, size_t width, size_t height);
+
+// Tile (tx, ty) in place: tile_size rows, tile_size floats apart.
+static inline const float *heightmap_tile(const HeightmapTiles *tiles, size_t tx, size_t ty)
+{
+    return (const float *)(tiles->bytes + tiles->offset[ty * tiles->tiles_x + tx]);
+}
+
 char *build_fullpath(const char *folder1, const char *folder2, const char *filename);
+// Makes resources/folder if needed and returns the path of filename in it.
+char *resource_path(const char *folder, const char *filename);
+// Writes path through path.tmp with write and renames it into place, so a
+// reader never sees a half-written file. Renaming also leaves any live
+// mapping of the old file intact.
+bool write_file(const char *path, bool (*write)(const char *path, const void *data), const void *data);
 
 #endif // SAVE_H
\ No newline at end of file
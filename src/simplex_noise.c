@@ -1,9 +1,20 @@
 // simplex_noise.c
-// 3D and 4D Simplex Noise (public domain implementation based on Stefan Gustavson)
+// 2D, 3D and 4D Simplex Noise (public domain implementation based on Stefan Gustavson)
 
+#include "simplex_noise.h"
+#include "noise_simd.h"
+#include <stddef.h>
 #include <math.h>
 #include <stdint.h>
 
+#if NOISE_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Skewing and unskewing factors for 2D
+#define F2 0.3660254f  // (sqrt(3)-1)/2
+#define G2 0.2113249f  // (3-sqrt(3))/6
+
 // Skewing and unskewing factors for 3D
 #define F3 0.3333333f
 #define G3 0.1666667f
@@ -12,74 +23,69 @@
 #define F4 0.309017f   // (sqrt(5)-1)/4
 #define G4 0.1381966f  // (5-sqrt(5))/20
 
-// Gradient directions for 3D
-static const int grad3[12][3] = {
-    {1,1,0}, {-1,1,0}, {1,-1,0}, {-1,-1,0},
-    {1,0,1}, {-1,0,1}, {1,0,-1}, {-1,0,-1},
-    {0,1,1}, {0,-1,1}, {0,1,-1}, {0,-1,-1}
-};
-
-// Gradient directions for 4D
-static const int grad4[32][4] = {
-    {0,1,1,1}, {0,1,1,-1}, {0,1,-1,1}, {0,1,-1,-1},
-    {0,-1,1,1}, {0,-1,1,-1}, {0,-1,-1,1}, {0,-1,-1,-1},
-    {1,0,1,1}, {1,0,1,-1}, {1,0,-1,1}, {1,0,-1,-1},
-    {-1,0,1,1}, {-1,0,1,-1}, {-1,0,-1,1}, {-1,0,-1,-1},
-    {1,1,0,1}, {1,1,0,-1}, {1,-1,0,1}, {1,-1,0,-1},
-    {-1,1,0,1}, {-1,1,0,-1}, {-1,-1,0,1}, {-1,-1,0,-1},
-    {1,1,1,0}, {1,1,-1,0}, {1,-1,1,0}, {1,-1,-1,0},
-    {-1,1,1,0}, {-1,1,-1,0}, {-1,-1,1,0}, {-1,-1,-1,0}
-};
-
-// Permutation table (same as in Perlin's original implementation)
-static const uint8_t perm[512] = {
-    151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,
-    140,36,103,30,69,142,8,99,37,240,21,10,23,190,6,148,
-    247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,
-    57,177,33,88,237,149,56,87,174,20,125,136,171,168,68,175,
-    74,165,71,134,139,48,27,166,77,146,158,231,83,111,229,122,
-    60,211,133,230,220,105,92,41,55,46,245,40,244,102,143,54,
-    65,25,63,161,1,216,80,73,209,76,132,187,208,89,18,169,
-    200,196,135,130,116,188,159,86,164,100,109,198,173,186,3,64,
-    52,217,226,250,124,123,5,202,38,147,118,126,255,82,85,212,
-    207,206,59,227,47,16,58,17,182,189,28,42,223,183,170,213,
-    119,248,152,2,44,154,163,70,221,153,101,155,167,43,172,9,
-    129,22,39,253,19,98,108,110,79,113,224,232,178,185,112,104,
-    218,246,97,228,251,34,242,193,238,210,144,12,191,179,162,241,
-    81,51,145,235,249,14,239,107,49,192,214,31,181,199,106,157,
-    184,84,204,176,115,121,50,45,127,4,150,254,138,236,205,93,
-    222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
-
-    // Repeat
-    151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,
-    140,36,103,30,69,142,8,99,37,240,21,10,23,190,6,148,
-    247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,
-    57,177,33,88,237,149,56,87,174,20,125,136,171,168,68,175,
-    74,165,71,134,139,48,27,166,77,146,158,231,83,111,229,122,
-    60,211,133,230,220,105,92,41,55,46,245,40,244,102,143,54,
-    65,25,63,161,1,216,80,73,209,76,132,187,208,89,18,169,
-    200,196,135,130,116,188,159,86,164,100,109,198,173,186,3,64,
-    52,217,226,250,124,123,5,202,38,147,118,126,255,82,85,212,
-    207,206,59,227,47,16,58,17,182,189,28,42,223,183,170,213,
-    119,248,152,2,44,154,163,70,221,153,101,155,167,43,172,9,
-    129,22,39,253,19,98,108,110,79,113,224,232,178,185,112,104,
-    218,246,97,228,251,34,242,193,238,210,144,12,191,179,162,241,
-    81,51,145,235,249,14,239,107,49,192,214,31,181,199,106,157,
-    184,84,204,176,115,121,50,45,127,4,150,254,138,236,205,93,
-    222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180
-};
-
 // Dot product helpers
-static inline float dot3(const int* g, float x, float y, float z) {
+static inline float dot2(const float* g, float x, float y) {
+    return g[0]*x + g[1]*y;
+}
+
+static inline float dot3(const float* g, float x, float y, float z) {
     return g[0]*x + g[1]*y + g[2]*z;
 }
 
-static inline float dot4(const int* g, float x, float y, float z, float w) {
+static inline float dot4(const float* g, float x, float y, float z, float w) {
     return g[0]*x + g[1]*y + g[2]*z + g[3]*w;
 }
 
+// Simplex noise in 2D
+float simplex2d(const NoiseContext *ctx, float x, float y) {
+    const unsigned char *perm = ctx->perm;
+    float s = (x + y) * F2;
+    int i = (int)floorf(x + s);
+    int j = (int)floorf(y + s);
+
+    float t = (i + j) * G2;
+    float X0 = i - t, Y0 = j - t;
+    float x0 = x - X0, y0 = y - Y0;
+
+    int i1, j1;
+    if (x0 > y0) { i1 = 1; j1 = 0; }
+    else         { i1 = 0; j1 = 1; }
+
+    float x1 = x0 - i1 + G2, y1 = y0 - j1 + G2;
+    float x2 = x0 - 1 + 2*G2, y2 = y0 - 1 + 2*G2;
+
+    int gi0 = perm[(i + perm[j & 255]) & 255] % 12;
+    int gi1 = perm[(i+i1 + perm[(j+j1) & 255]) & 255] % 12;
+    int gi2 = perm[(i+1 + perm[(j+1) & 255]) & 255] % 12;
+
+    float n0, n1, n2;
+    float t0 = 0.5f - x0*x0 - y0*y0;
+    if (t0 < 0) n0 = 0.0f;
+    else {
+        t0 *= t0;
+        n0 = t0 * t0 * dot2(ctx->grad3[gi0], x0, y0);
+    }
+
+    float t1 = 0.5f - x1*x1 - y1*y1;
+    if (t1 < 0) n1 = 0.0f;
+    else {
+        t1 *= t1;
+        n1 = t1 * t1 * dot2(ctx->grad3[gi1], x1, y1);
+    }
+
+    float t2 = 0.5f - x2*x2 - y2*y2;
+    if (t2 < 0) n2 = 0.0f;
+    else {
+        t2 *= t2;
+        n2 = t2 * t2 * dot2(ctx->grad3[gi2], x2, y2);
+    }
+
+    return 70.0f * (n0 + n1 + n2);
+}
+
 // Simplex noise in 3D
-float simplex3d(float x, float y, float z) {
+float simplex3d(const NoiseContext *ctx, float x, float y, float z) {
+    const unsigned char *perm = ctx->perm;
     float s = (x + y + z) * F3;
     int i = (int)floorf(x + s);
     int j = (int)floorf(y + s);
@@ -115,35 +121,36 @@ float simplex3d(float x, float y, float z) {
     if (t0 < 0) n0 = 0.0f;
     else {
         t0 *= t0;
-        n0 = t0 * t0 * dot3(grad3[gi0], x0, y0, z0);
+        n0 = t0 * t0 * dot3(ctx->grad3[gi0], x0, y0, z0);
     }
 
     float t1 = 0.6f - x1*x1 - y1*y1 - z1*z1;
     if (t1 < 0) n1 = 0.0f;
     else {
         t1 *= t1;
-        n1 = t1 * t1 * dot3(grad3[gi1], x1, y1, z1);
+        n1 = t1 * t1 * dot3(ctx->grad3[gi1], x1, y1, z1);
     }
 
     float t2 = 0.6f - x2*x2 - y2*y2 - z2*z2;
     if (t2 < 0) n2 = 0.0f;
     else {
         t2 *= t2;
-        n2 = t2 * t2 * dot3(grad3[gi2], x2, y2, z2);
+        n2 = t2 * t2 * dot3(ctx->grad3[gi2], x2, y2, z2);
     }
 
     float t3 = 0.6f - x3*x3 - y3*y3 - z3*z3;
     if (t3 < 0) n3 = 0.0f;
     else {
         t3 *= t3;
-        n3 = t3 * t3 * dot3(grad3[gi3], x3, y3, z3);
+        n3 = t3 * t3 * dot3(ctx->grad3[gi3], x3, y3, z3);
     }
 
     return 32.0f * (n0 + n1 + n2 + n3);
 }
 
 // Simplex noise in 4D
-float simplex4d(float x, float y, float z, float w) {
+float simplex4d(const NoiseContext *ctx, float x, float y, float z, float w) {
+    const unsigned char *perm = ctx->perm;
     float s = (x + y + z + w) * F4;
     int i = (int)floorf(x + s);
     int j = (int)floorf(y + s);
@@ -206,36 +213,414 @@ float simplex4d(float x, float y, float z, float w) {
     if (t0 < 0) n0 = 0.0f;
     else {
         t0 *= t0;
-        n0 = t0 * t0 * dot4(grad4[gi0], x0, y0, z0, w0);
+        n0 = t0 * t0 * dot4(ctx->grad4[gi0], x0, y0, z0, w0);
     }
 
     float t1 = 0.6f - x1*x1 - y1*y1 - z1*z1 - w1*w1;
     if (t1 < 0) n1 = 0.0f;
     else {
         t1 *= t1;
-        n1 = t1 * t1 * dot4(grad4[gi1], x1, y1, z1, w1);
+        n1 = t1 * t1 * dot4(ctx->grad4[gi1], x1, y1, z1, w1);
     }
 
     float t2 = 0.6f - x2*x2 - y2*y2 - z2*z2 - w2*w2;
     if (t2 < 0) n2 = 0.0f;
     else {
         t2 *= t2;
-        n2 = t2 * t2 * dot4(grad4[gi2], x2, y2, z2, w2);
+        n2 = t2 * t2 * dot4(ctx->grad4[gi2], x2, y2, z2, w2);
     }
 
     float t3 = 0.6f - x3*x3 - y3*y3 - z3*z3 - w3*w3;
     if (t3 < 0) n3 = 0.0f;
     else {
         t3 *= t3;
-        n3 = t3 * t3 * dot4(grad4[gi3], x3, y3, z3, w3);
+        n3 = t3 * t3 * dot4(ctx->grad4[gi3], x3, y3, z3, w3);
     }
 
     float t4 = 0.6f - x4*x4 - y4*y4 - z4*z4 - w4*w4;
     if (t4 < 0) n4 = 0.0f;
     else {
         t4 *= t4;
-        n4 = t4 * t4 * dot4(grad4[gi4], x4, y4, z4, w4);
+        n4 = t4 * t4 * dot4(ctx->grad4[gi4], x4, y4, z4, w4);
     }
 
     return 27.0f * (n0 + n1 + n2 + n3 + n4);
 }
+
+// One simplex corner's contribution, adding its gradient into grad:
+// n = t^4 (g.x) with t = 0.6 - |x|^2, so dn/dx = t^4 g - 8 t^3 (g.x) x.
+static inline float corner_deriv(const float *g, float x, float y, float z, float w, float *grad) {
+    float t = 0.6f - x*x - y*y - z*z - w*w;
+    if (t < 0) return 0.0f;
+    float t2 = t * t;
+    float d = dot4(g, x, y, z, w);
+    float t4 = t2 * t2;
+    float k = -8.0f * t2 * t * d;
+    grad[0] += t4 * g[0] + k * x;
+    grad[1] += t4 * g[1] + k * y;
+    grad[2] += t4 * g[2] + k * z;
+    grad[3] += t4 * g[3] + k * w;
+    return t2 * t2 * d;
+}
+
+// Same value as simplex4d, plus its gradient in grad[0..3].
+float simplex4d_deriv(const NoiseContext *ctx, float x, float y, float z, float w, float *grad) {
+    const unsigned char *perm = ctx->perm;
+    float s = (x + y + z + w) * F4;
+    int i = (int)floorf(x + s);
+    int j = (int)floorf(y + s);
+    int k = (int)floorf(z + s);
+    int l = (int)floorf(w + s);
+
+    float t = (i + j + k + l) * G4;
+    float X0 = i - t, Y0 = j - t, Z0 = k - t, W0 = l - t;
+    float x0 = x - X0, y0 = y - Y0, z0 = z - Z0, w0 = w - W0;
+
+    int rankx = (x0 > y0) + (x0 > z0) + (x0 > w0);
+    int ranky = (y0 > x0) + (y0 > z0) + (y0 > w0);
+    int rankz = (z0 > x0) + (z0 > y0) + (z0 > w0);
+    int rankw = (w0 > x0) + (w0 > y0) + (w0 > z0);
+
+    int i1 = rankx >= 3, j1 = ranky >= 3, k1 = rankz >= 3, l1 = rankw >= 3;
+    int i2 = rankx >= 2, j2 = ranky >= 2, k2 = rankz >= 2, l2 = rankw >= 2;
+    int i3 = rankx >= 1, j3 = ranky >= 1, k3 = rankz >= 1, l3 = rankw >= 1;
+
+    float x1 = x0 - i1 + G4, y1 = y0 - j1 + G4, z1 = z0 - k1 + G4, w1 = w0 - l1 + G4;
+    float x2 = x0 - i2 + 2.0f * G4, y2 = y0 - j2 + 2.0f * G4, z2 = z0 - k2 + 2.0f * G4, w2 = w0 - l2 + 2.0f * G4;
+    float x3 = x0 - i3 + 3.0f * G4, y3 = y0 - j3 + 3.0f * G4, z3 = z0 - k3 + 3.0f * G4, w3 = w0 - l3 + 3.0f * G4;
+    float x4 = x0 - 1.0f + 4.0f * G4, y4 = y0 - 1.0f + 4.0f * G4, z4 = z0 - 1.0f + 4.0f * G4, w4 = w0 - 1.0f + 4.0f * G4;
+
+    int gi0 = perm[(i + perm[(j + perm[(k + perm[l & 255]) & 255]) & 255]) & 255] & 31;
+    int gi1 = perm[(i+i1 + perm[(j+j1 + perm[(k+k1 + perm[(l+l1) & 255]) & 255]) & 255]) & 255] & 31;
+    int gi2 = perm[(i+i2 + perm[(j+j2 + perm[(k+k2 + perm[(l+l2) & 255]) & 255]) & 255]) & 255] & 31;
+    int gi3 = perm[(i+i3 + perm[(j+j3 + perm[(k+k3 + perm[(l+l3) & 255]) & 255]) & 255]) & 255] & 31;
+    int gi4 = perm[(i+1 + perm[(j+1 + perm[(k+1 + perm[(l+1) & 255]) & 255]) & 255]) & 255] & 31;
+
+    float g[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float n0 = corner_deriv(ctx->grad4[gi0], x0, y0, z0, w0, g);
+    float n1 = corner_deriv(ctx->grad4[gi1], x1, y1, z1, w1, g);
+    float n2 = corner_deriv(ctx->grad4[gi2], x2, y2, z2, w2, g);
+    float n3 = corner_deriv(ctx->grad4[gi3], x3, y3, z3, w3, g);
+    float n4 = corner_deriv(ctx->grad4[gi4], x4, y4, z4, w4, g);
+
+    for (int a = 0; a < 4; a++) grad[a] = 27.0f * g[a];
+    return 27.0f * (n0 + n1 + n2 + n3 + n4);
+}
+
+
+// --- Batched 4D simplex noise ---
+//
+// Lane-for-lane replay of simplex4d: same operation order and no fused
+// multiply-add, so the results are bit-identical to the scalar function.
+
+#if NOISE_HAVE_X86_SIMD
+
+NOISE_TARGET_AVX2 static inline __m256i sperm8(const unsigned char *perm, __m256i idx)
+{
+    __m256i v = _mm256_i32gather_epi32((const int *)perm, idx, 1);
+    return _mm256_and_si256(v, _mm256_set1_epi32(255));
+}
+
+// perm[(i + perm[(j + perm[(k + perm[l & 255]) & 255]) & 255]) & 255] & 31
+NOISE_TARGET_AVX2 static inline __m256i hash4_8(const unsigned char *perm, __m256i i, __m256i j, __m256i k, __m256i l)
+{
+    const __m256i m = _mm256_set1_epi32(255);
+    __m256i h = sperm8(perm, _mm256_and_si256(l, m));
+    h = sperm8(perm, _mm256_and_si256(_mm256_add_epi32(k, h), m));
+    h = sperm8(perm, _mm256_and_si256(_mm256_add_epi32(j, h), m));
+    h = sperm8(perm, _mm256_and_si256(_mm256_add_epi32(i, h), m));
+    return _mm256_and_si256(h, _mm256_set1_epi32(31));
+}
+
+NOISE_TARGET_AVX2 static inline __m256 corner8(const float *g, __m256i gi, __m256 x, __m256 y, __m256 z, __m256 w)
+{
+    __m256 t = _mm256_sub_ps(_mm256_set1_ps(0.6f), _mm256_mul_ps(x, x));
+    t = _mm256_sub_ps(t, _mm256_mul_ps(y, y));
+    t = _mm256_sub_ps(t, _mm256_mul_ps(z, z));
+    t = _mm256_sub_ps(t, _mm256_mul_ps(w, w));
+    __m256 inside = _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_NLT_UQ);
+
+    __m256i base = _mm256_slli_epi32(gi, 2);
+    __m256 gx = _mm256_i32gather_ps(g, base, 4);
+    __m256 gy = _mm256_i32gather_ps(g + 1, base, 4);
+    __m256 gz = _mm256_i32gather_ps(g + 2, base, 4);
+    __m256 gw = _mm256_i32gather_ps(g + 3, base, 4);
+    __m256 d = _mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y));
+    d = _mm256_add_ps(d, _mm256_mul_ps(gz, z));
+    d = _mm256_add_ps(d, _mm256_mul_ps(gw, w));
+
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 n = _mm256_mul_ps(_mm256_mul_ps(t2, t2), d);
+    return _mm256_and_ps(n, inside);
+}
+
+NOISE_TARGET_AVX2 static inline __m256 rank_ge8(__m256i rank, int k)
+{
+    __m256i m = _mm256_cmpgt_epi32(rank, _mm256_set1_epi32(k - 1));
+    return _mm256_and_ps(_mm256_castsi256_ps(m), _mm256_set1_ps(1.0f));
+}
+
+NOISE_TARGET_AVX2 static void simplex4d_avx2(const NoiseContext *ctx, const float *px, const float *py,
+                                             const float *pz, const float *pw, float *out, size_t n)
+{
+    const unsigned char *perm = ctx->perm;
+    const float *grad = &ctx->grad4[0][0];
+    const __m256 g1 = _mm256_set1_ps(G4);
+    const __m256 g2 = _mm256_set1_ps(2.0f * G4);
+    const __m256 g3 = _mm256_set1_ps(3.0f * G4);
+    const __m256 g4m1 = _mm256_set1_ps(4.0f * G4);
+    const __m256 fone = _mm256_set1_ps(1.0f);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    for (size_t idx = 0; idx < n; idx += 8) {
+        __m256 x = _mm256_loadu_ps(px + idx);
+        __m256 y = _mm256_loadu_ps(py + idx);
+        __m256 z = _mm256_loadu_ps(pz + idx);
+        __m256 w = _mm256_loadu_ps(pw + idx);
+
+        __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), w), _mm256_set1_ps(F4));
+        __m256i i = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(x, s)));
+        __m256i j = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(y, s)));
+        __m256i k = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(z, s)));
+        __m256i l = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(w, s)));
+
+        __m256i sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(i, j), k), l);
+        __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(sum), g1);
+        __m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(_mm256_cvtepi32_ps(i), t));
+        __m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(_mm256_cvtepi32_ps(j), t));
+        __m256 z0 = _mm256_sub_ps(z, _mm256_sub_ps(_mm256_cvtepi32_ps(k), t));
+        __m256 w0 = _mm256_sub_ps(w, _mm256_sub_ps(_mm256_cvtepi32_ps(l), t));
+
+        // Comparison masks are -1 where true, so subtracting them counts.
+        __m256i xy = _mm256_castps_si256(_mm256_cmp_ps(x0, y0, _CMP_GT_OQ));
+        __m256i xz = _mm256_castps_si256(_mm256_cmp_ps(x0, z0, _CMP_GT_OQ));
+        __m256i xw = _mm256_castps_si256(_mm256_cmp_ps(x0, w0, _CMP_GT_OQ));
+        __m256i yx = _mm256_castps_si256(_mm256_cmp_ps(y0, x0, _CMP_GT_OQ));
+        __m256i yz = _mm256_castps_si256(_mm256_cmp_ps(y0, z0, _CMP_GT_OQ));
+        __m256i yw = _mm256_castps_si256(_mm256_cmp_ps(y0, w0, _CMP_GT_OQ));
+        __m256i zx = _mm256_castps_si256(_mm256_cmp_ps(z0, x0, _CMP_GT_OQ));
+        __m256i zy = _mm256_castps_si256(_mm256_cmp_ps(z0, y0, _CMP_GT_OQ));
+        __m256i zw = _mm256_castps_si256(_mm256_cmp_ps(z0, w0, _CMP_GT_OQ));
+        __m256i wx = _mm256_castps_si256(_mm256_cmp_ps(w0, x0, _CMP_GT_OQ));
+        __m256i wy = _mm256_castps_si256(_mm256_cmp_ps(w0, y0, _CMP_GT_OQ));
+        __m256i wz = _mm256_castps_si256(_mm256_cmp_ps(w0, z0, _CMP_GT_OQ));
+        __m256i zero = _mm256_setzero_si256();
+        __m256i rankx = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_sub_epi32(zero, xy), xz), xw);
+        __m256i ranky = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_sub_epi32(zero, yx), yz), yw);
+        __m256i rankz = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_sub_epi32(zero, zx), zy), zw);
+        __m256i rankw = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_sub_epi32(zero, wx), wy), wz);
+
+        __m256 i1 = rank_ge8(rankx, 3), j1 = rank_ge8(ranky, 3), k1 = rank_ge8(rankz, 3), l1 = rank_ge8(rankw, 3);
+        __m256 i2 = rank_ge8(rankx, 2), j2 = rank_ge8(ranky, 2), k2 = rank_ge8(rankz, 2), l2 = rank_ge8(rankw, 2);
+        __m256 i3 = rank_ge8(rankx, 1), j3 = rank_ge8(ranky, 1), k3 = rank_ge8(rankz, 1), l3 = rank_ge8(rankw, 1);
+
+        __m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, i1), g1);
+        __m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, j1), g1);
+        __m256 z1 = _mm256_add_ps(_mm256_sub_ps(z0, k1), g1);
+        __m256 w1 = _mm256_add_ps(_mm256_sub_ps(w0, l1), g1);
+
+        __m256 x2 = _mm256_add_ps(_mm256_sub_ps(x0, i2), g2);
+        __m256 y2 = _mm256_add_ps(_mm256_sub_ps(y0, j2), g2);
+        __m256 z2 = _mm256_add_ps(_mm256_sub_ps(z0, k2), g2);
+        __m256 w2 = _mm256_add_ps(_mm256_sub_ps(w0, l2), g2);
+
+        __m256 x3 = _mm256_add_ps(_mm256_sub_ps(x0, i3), g3);
+        __m256 y3 = _mm256_add_ps(_mm256_sub_ps(y0, j3), g3);
+        __m256 z3 = _mm256_add_ps(_mm256_sub_ps(z0, k3), g3);
+        __m256 w3 = _mm256_add_ps(_mm256_sub_ps(w0, l3), g3);
+
+        __m256 x4 = _mm256_add_ps(_mm256_sub_ps(x0, fone), g4m1);
+        __m256 y4 = _mm256_add_ps(_mm256_sub_ps(y0, fone), g4m1);
+        __m256 z4 = _mm256_add_ps(_mm256_sub_ps(z0, fone), g4m1);
+        __m256 w4 = _mm256_add_ps(_mm256_sub_ps(w0, fone), g4m1);
+
+        __m256i gi0 = hash4_8(perm, i, j, k, l);
+        __m256i gi1 = hash4_8(perm, _mm256_add_epi32(i, _mm256_cvttps_epi32(i1)), _mm256_add_epi32(j, _mm256_cvttps_epi32(j1)),
+                              _mm256_add_epi32(k, _mm256_cvttps_epi32(k1)), _mm256_add_epi32(l, _mm256_cvttps_epi32(l1)));
+        __m256i gi2 = hash4_8(perm, _mm256_add_epi32(i, _mm256_cvttps_epi32(i2)), _mm256_add_epi32(j, _mm256_cvttps_epi32(j2)),
+                              _mm256_add_epi32(k, _mm256_cvttps_epi32(k2)), _mm256_add_epi32(l, _mm256_cvttps_epi32(l2)));
+        __m256i gi3 = hash4_8(perm, _mm256_add_epi32(i, _mm256_cvttps_epi32(i3)), _mm256_add_epi32(j, _mm256_cvttps_epi32(j3)),
+                              _mm256_add_epi32(k, _mm256_cvttps_epi32(k3)), _mm256_add_epi32(l, _mm256_cvttps_epi32(l3)));
+        __m256i gi4 = hash4_8(perm, _mm256_add_epi32(i, one), _mm256_add_epi32(j, one),
+                              _mm256_add_epi32(k, one), _mm256_add_epi32(l, one));
+
+        __m256 n0 = corner8(grad, gi0, x0, y0, z0, w0);
+        __m256 n1 = corner8(grad, gi1, x1, y1, z1, w1);
+        __m256 n2 = corner8(grad, gi2, x2, y2, z2, w2);
+        __m256 n3 = corner8(grad, gi3, x3, y3, z3, w3);
+        __m256 n4 = corner8(grad, gi4, x4, y4, z4, w4);
+
+        __m256 total = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), n3), n4);
+        _mm256_storeu_ps(out + idx, _mm256_mul_ps(_mm256_set1_ps(27.0f), total));
+    }
+}
+
+NOISE_TARGET_SSE41 static inline __m128i sperm4(const unsigned char *perm, __m128i idx)
+{
+    return _mm_setr_epi32(perm[_mm_extract_epi32(idx, 0)], perm[_mm_extract_epi32(idx, 1)],
+                          perm[_mm_extract_epi32(idx, 2)], perm[_mm_extract_epi32(idx, 3)]);
+}
+
+NOISE_TARGET_SSE41 static inline __m128i hash4_4(const unsigned char *perm, __m128i i, __m128i j, __m128i k, __m128i l)
+{
+    const __m128i m = _mm_set1_epi32(255);
+    __m128i h = sperm4(perm, _mm_and_si128(l, m));
+    h = sperm4(perm, _mm_and_si128(_mm_add_epi32(k, h), m));
+    h = sperm4(perm, _mm_and_si128(_mm_add_epi32(j, h), m));
+    h = sperm4(perm, _mm_and_si128(_mm_add_epi32(i, h), m));
+    return _mm_and_si128(h, _mm_set1_epi32(31));
+}
+
+NOISE_TARGET_SSE41 static inline __m128 corner4(const float *g, __m128i gi, __m128 x, __m128 y, __m128 z, __m128 w)
+{
+    __m128 t = _mm_sub_ps(_mm_set1_ps(0.6f), _mm_mul_ps(x, x));
+    t = _mm_sub_ps(t, _mm_mul_ps(y, y));
+    t = _mm_sub_ps(t, _mm_mul_ps(z, z));
+    t = _mm_sub_ps(t, _mm_mul_ps(w, w));
+    __m128 inside = _mm_cmpnlt_ps(t, _mm_setzero_ps());
+
+    // Gradient rows are 16 bytes: load each lane's row and transpose.
+    __m128 r0 = _mm_loadu_ps(g + 4 * _mm_extract_epi32(gi, 0));
+    __m128 r1 = _mm_loadu_ps(g + 4 * _mm_extract_epi32(gi, 1));
+    __m128 r2 = _mm_loadu_ps(g + 4 * _mm_extract_epi32(gi, 2));
+    __m128 r3 = _mm_loadu_ps(g + 4 * _mm_extract_epi32(gi, 3));
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    __m128 d = _mm_add_ps(_mm_mul_ps(r0, x), _mm_mul_ps(r1, y));
+    d = _mm_add_ps(d, _mm_mul_ps(r2, z));
+    d = _mm_add_ps(d, _mm_mul_ps(r3, w));
+
+    __m128 t2 = _mm_mul_ps(t, t);
+    __m128 n = _mm_mul_ps(_mm_mul_ps(t2, t2), d);
+    return _mm_and_ps(n, inside);
+}
+
+NOISE_TARGET_SSE41 static inline __m128 rank_ge4(__m128i rank, int k)
+{
+    __m128i m = _mm_cmpgt_epi32(rank, _mm_set1_epi32(k - 1));
+    return _mm_and_ps(_mm_castsi128_ps(m), _mm_set1_ps(1.0f));
+}
+
+NOISE_TARGET_SSE41 static void simplex4d_sse41(const NoiseContext *ctx, const float *px, const float *py,
+                                              const float *pz, const float *pw, float *out, size_t n)
+{
+    const unsigned char *perm = ctx->perm;
+    const float *grad = &ctx->grad4[0][0];
+    const __m128 g1 = _mm_set1_ps(G4);
+    const __m128 g2 = _mm_set1_ps(2.0f * G4);
+    const __m128 g3 = _mm_set1_ps(3.0f * G4);
+    const __m128 g4m1 = _mm_set1_ps(4.0f * G4);
+    const __m128 fone = _mm_set1_ps(1.0f);
+    const __m128i one = _mm_set1_epi32(1);
+
+    for (size_t idx = 0; idx < n; idx += 4) {
+        __m128 x = _mm_loadu_ps(px + idx);
+        __m128 y = _mm_loadu_ps(py + idx);
+        __m128 z = _mm_loadu_ps(pz + idx);
+        __m128 w = _mm_loadu_ps(pw + idx);
+
+        __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(x, y), z), w), _mm_set1_ps(F4));
+        __m128i i = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(x, s)));
+        __m128i j = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(y, s)));
+        __m128i k = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(z, s)));
+        __m128i l = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(w, s)));
+
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_add_epi32(i, j), k), l);
+        __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(sum), g1);
+        __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+        __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+        __m128 z0 = _mm_sub_ps(z, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+        __m128 w0 = _mm_sub_ps(w, _mm_sub_ps(_mm_cvtepi32_ps(l), t));
+
+        __m128i zero = _mm_setzero_si128();
+        __m128i rankx = _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(zero,
+                        _mm_castps_si128(_mm_cmpgt_ps(x0, y0))), _mm_castps_si128(_mm_cmpgt_ps(x0, z0))),
+                        _mm_castps_si128(_mm_cmpgt_ps(x0, w0)));
+        __m128i ranky = _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(zero,
+                        _mm_castps_si128(_mm_cmpgt_ps(y0, x0))), _mm_castps_si128(_mm_cmpgt_ps(y0, z0))),
+                        _mm_castps_si128(_mm_cmpgt_ps(y0, w0)));
+        __m128i rankz = _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(zero,
+                        _mm_castps_si128(_mm_cmpgt_ps(z0, x0))), _mm_castps_si128(_mm_cmpgt_ps(z0, y0))),
+                        _mm_castps_si128(_mm_cmpgt_ps(z0, w0)));
+        __m128i rankw = _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(zero,
+                        _mm_castps_si128(_mm_cmpgt_ps(w0, x0))), _mm_castps_si128(_mm_cmpgt_ps(w0, y0))),
+                        _mm_castps_si128(_mm_cmpgt_ps(w0, z0)));
+
+        __m128 i1 = rank_ge4(rankx, 3), j1 = rank_ge4(ranky, 3), k1 = rank_ge4(rankz, 3), l1 = rank_ge4(rankw, 3);
+        __m128 i2 = rank_ge4(rankx, 2), j2 = rank_ge4(ranky, 2), k2 = rank_ge4(rankz, 2), l2 = rank_ge4(rankw, 2);
+        __m128 i3 = rank_ge4(rankx, 1), j3 = rank_ge4(ranky, 1), k3 = rank_ge4(rankz, 1), l3 = rank_ge4(rankw, 1);
+
+        __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), g1);
+        __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, j1), g1);
+        __m128 z1 = _mm_add_ps(_mm_sub_ps(z0, k1), g1);
+        __m128 w1 = _mm_add_ps(_mm_sub_ps(w0, l1), g1);
+
+        __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, i2), g2);
+        __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, j2), g2);
+        __m128 z2 = _mm_add_ps(_mm_sub_ps(z0, k2), g2);
+        __m128 w2 = _mm_add_ps(_mm_sub_ps(w0, l2), g2);
+
+        __m128 x3 = _mm_add_ps(_mm_sub_ps(x0, i3), g3);
+        __m128 y3 = _mm_add_ps(_mm_sub_ps(y0, j3), g3);
+        __m128 z3 = _mm_add_ps(_mm_sub_ps(z0, k3), g3);
+        __m128 w3 = _mm_add_ps(_mm_sub_ps(w0, l3), g3);
+
+        __m128 x4 = _mm_add_ps(_mm_sub_ps(x0, fone), g4m1);
+        __m128 y4 = _mm_add_ps(_mm_sub_ps(y0, fone), g4m1);
+        __m128 z4 = _mm_add_ps(_mm_sub_ps(z0, fone), g4m1);
+        __m128 w4 = _mm_add_ps(_mm_sub_ps(w0, fone), g4m1);
+
+        __m128i gi0 = hash4_4(perm, i, j, k, l);
+        __m128i gi1 = hash4_4(perm, _mm_add_epi32(i, _mm_cvttps_epi32(i1)), _mm_add_epi32(j, _mm_cvttps_epi32(j1)),
+                              _mm_add_epi32(k, _mm_cvttps_epi32(k1)), _mm_add_epi32(l, _mm_cvttps_epi32(l1)));
+        __m128i gi2 = hash4_4(perm, _mm_add_epi32(i, _mm_cvttps_epi32(i2)), _mm_add_epi32(j, _mm_cvttps_epi32(j2)),
+                              _mm_add_epi32(k, _mm_cvttps_epi32(k2)), _mm_add_epi32(l, _mm_cvttps_epi32(l2)));
+        __m128i gi3 = hash4_4(perm, _mm_add_epi32(i, _mm_cvttps_epi32(i3)), _mm_add_epi32(j, _mm_cvttps_epi32(j3)),
+                              _mm_add_epi32(k, _mm_cvttps_epi32(k3)), _mm_add_epi32(l, _mm_cvttps_epi32(l3)));
+        __m128i gi4 = hash4_4(perm, _mm_add_epi32(i, one), _mm_add_epi32(j, one),
+                              _mm_add_epi32(k, one), _mm_add_epi32(l, one));
+
+        __m128 n0 = corner4(grad, gi0, x0, y0, z0, w0);
+        __m128 n1 = corner4(grad, gi1, x1, y1, z1, w1);
+        __m128 n2 = corner4(grad, gi2, x2, y2, z2, w2);
+        __m128 n3 = corner4(grad, gi3, x3, y3, z3, w3);
+        __m128 n4 = corner4(grad, gi4, x4, y4, z4, w4);
+
+        __m128 total = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), n3), n4);
+        _mm_storeu_ps(out + idx, _mm_mul_ps(_mm_set1_ps(27.0f), total));
+    }
+}
+
+#endif // NOISE_HAVE_X86_SIMD
+
+void simplex4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                     float *out, size_t n)
+{
+    size_t done = 0;
+#if NOISE_HAVE_X86_SIMD
+    NoiseSimdLevel level = noise_simd_level();
+    if (level >= NOISE_SIMD_AVX2) {
+        done = n & ~(size_t)7;
+        simplex4d_avx2(ctx, x, y, z, w, out, done);
+    } else if (level >= NOISE_SIMD_SSE41) {
+        done = n & ~(size_t)3;
+        simplex4d_sse41(ctx, x, y, z, w, out, done);
+    }
+#endif
+    for (size_t i = done; i < n; i++) {
+        out[i] = simplex4d(ctx, x[i], y[i], z[i], w[i]);
+    }
+}
+
+// No vector kernel yet: the skewed-simplex gradient is scalar only.
+void simplex4d_deriv_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z, const float *w,
+                           float *out, float *gx, float *gy, float *gz, float *gw, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        float g[4];
+        out[i] = simplex4d_deriv(ctx, x[i], y[i], z[i], w[i], g);
+        gx[i] = g[0];
+        gy[i] = g[1];
+        gz[i] = g[2];
+        gw[i] = g[3];
+    }
+}
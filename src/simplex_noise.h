@@ -1,9 +1,21 @@
 #ifndef SIMPLEX_NOISE_H
 #define SIMPLEX_NOISE_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "noise_context.h"
 
-float simplex3d(float x, float y, float z);
-float simplex4d(float x, float y, float z, float w);
+float simplex2d(const NoiseContext *ctx, float x, float y);
+float simplex3d(const NoiseContext *ctx, float x, float y, float z);
+float simplex4d(const NoiseContext *ctx, float x, float y, float z, float w);
+
+// Evaluates simplex4d for n points given as separate coordinate arrays.
+void simplex4d_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                     const float *w, float *out, size_t n);
+
+// simplex4d together with its analytic gradient (d/dx, d/dy, d/dz, d/dw).
+float simplex4d_deriv(const NoiseContext *ctx, float x, float y, float z, float w, float *grad);
+void simplex4d_deriv_batch(const NoiseContext *ctx, const float *x, const float *y, const float *z,
+                           const float *w, float *out, float *gx, float *gy, float *gz, float *gw, size_t n);
 
 #endif // SIMPLEX_NOISE_H
\ No newline at end of file
@@ -0,0 +1,77 @@
+/*
+ * spectral.c
+ *
+ * Spectral-synthesis heightmaps. Instead of summing noise octaves at every
+ * pixel, the whole map is built at once: each frequency bin gets a random
+ * complex value scaled by the square root of the target power spectrum, and
+ * one inverse real 2D FFT turns the spectrum into heights. The discrete
+ * transform is periodic by construction, so the map tiles exactly, which is
+ * what the torus needs, and the cost is O(N log N) for N pixels.
+ */
+
+#include "spectral.h"
+#include "fft.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Counter-based randomness so every bin can be filled independently (and in
+// parallel) while the result depends only on the seed.
+static inline uint64_t bin_random(uint64_t key, uint64_t index)
+{
+    uint64_t z = key + (index + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void spectral_synthesis(const NoiseContext *ctx, float *out, size_t width, size_t height, float extent_x,
+                        float extent_y, float beta, float min_frequency)
+{
+    const size_t bins = width / 2 + 1;
+    FftComplex *spectrum = malloc(bins * height * sizeof(FftComplex));
+    if (!spectrum) {
+        perror("malloc failed");
+        exit(1);
+    }
+
+    const uint64_t key = ((uint64_t)ctx->hash_seed << 32) ^ ctx->seed;
+    const float f0_sq = min_frequency * min_frequency;
+    const float exponent = -0.25f * beta;  // amplitude = power^(1/2)
+
+    // White noise uniform in [-1, 1) per component: the field sums many bins,
+    // so it comes out Gaussian without a per-bin Box-Muller.
+    #pragma omp parallel for schedule(static)
+    for (long y = 0; y < (long)height; y++) {
+        long ky = y <= (long)height / 2 ? y : y - (long)height;
+        float fy = (float)ky / extent_y;
+        FftComplex *row = spectrum + (size_t)y * bins;
+        for (size_t x = 0; x < bins; x++) {
+            float fx = (float)x / extent_x;
+            uint64_t r = bin_random(key, (uint64_t)y * bins + x);
+            float re = (float)(r >> 40) * (2.0f / 16777216.0f) - 1.0f;
+            float im = (float)((r >> 8) & 0xFFFFFF) * (2.0f / 16777216.0f) - 1.0f;
+            float amplitude = powf(fx * fx + fy * fy + f0_sq, exponent);
+            row[x] = (FftComplex){ re * amplitude, im * amplitude };
+        }
+    }
+    spectrum[0] = (FftComplex){ 0.0f, 0.0f };  // zero mean
+
+    fft2d_real_inverse(spectrum, out, width, height);
+    free(spectrum);
+
+    const long n = (long)(width * height);
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    #pragma omp parallel for reduction(min:lo) reduction(max:hi) schedule(static)
+    for (long i = 0; i < n; i++) {
+        if (out[i] < lo) lo = out[i];
+        if (out[i] > hi) hi = out[i];
+    }
+    const float inv_range = hi > lo ? 1.0f / (hi - lo) : 0.0f;
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++) {
+        out[i] = fminf((out[i] - lo) * inv_range, 1.0f);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+#include <stddef.h>
+#include "noise_context.h"
+
+// Spectral synthesis: fills out (width x height, row-major) with a periodic
+// random field by shaping seeded white noise in the frequency domain and
+// inverse transforming it. The map spans extent_x by extent_y units, which
+// need not be square pixels, and the power spectrum falls off as
+//   P(f) = (f^2 + f0^2)^(-beta / 2),   f in cycles per unit,
+// so beta sets the roughness (larger is smoother) and min_frequency (f0)
+// flattens the spectrum below the largest feature size. The result wraps
+// seamlessly in both directions and is normalised to [0, 1].
+void spectral_synthesis(const NoiseContext *ctx, float *out, size_t width, size_t height, float extent_x,
+                        float extent_y, float beta, float min_frequency);
+
+#endif // SPECTRAL_H
@@ -0,0 +1,605 @@
+/*
+ * terrain.c
+ *
+ * Heightmap generation for the terrain configuration. Nothing here touches
+ * raylib, so bake_terrain can generate and cache maps without a window.
+ */
+
+#include "terrain.h"
+#include "fbm_with_function_pointer.h"
+#include "noise_simd.h"
+#include "io_worker.h"
+#include "spectral.h"
+
+#include <assert.h>
+#include <math.h>
+#include <omp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef PI
+#define PI 3.14159265358979323846f  // as in raylib.h
+#endif
+
+// The game's terrain, independent of the display it runs on.
+static TerrainConfig terrain = { 1900, 1050, 1900.0f, 1050.0f, HEIGHTMAP_ENCODING_F32 }; // Change this to switch terrain sizes
+
+// Heightmap generator settings, shared by get_heightmap and heightmap_gradient.
+static const HeightmapGenerator heightmap_generator = HEIGHTMAP_GEN_TORUS4D; // Change this to switch generators
+static const NoiseType heightmap_noise = NOISE_PERLIN;            // Change this to switch noise types
+static const HeightmapWarp heightmap_warp = HEIGHTMAP_WARP_GRADIENT; // Change this to switch warp modes
+static const float heightmap_scale = 0.005f;
+static const float disp_offset = 0.1f;
+static const float displacement_strength = 1.0f;
+static const float spectral_beta = 3.0f;  // spectral generator roughness: 2 + 2H for Hurst exponent H
+static const int fbm_octaves = 6;
+static const float fbm_lacunarity = 2.0f;  // whole, so periodic octaves keep tiling
+static const float fbm_gain = 0.5f;
+static const uint64_t heightmap_seed = 42;
+static NoiseContext heightmap_ctx;  // seeded by seed_heightmap_ctx
+
+// Shared by a generator and whoever watches it: rows finished so far, and a
+// flag that makes the generator skip every row it has not yet started.
+typedef struct GenerateProgress {
+    atomic_size_t rows;
+    atomic_bool cancel;
+} GenerateProgress;
+
+static bool generate_cancelled(GenerateProgress *progress) {
+    return progress && atomic_load_explicit(&progress->cancel, memory_order_relaxed);
+}
+
+static void generate_rows_done(GenerateProgress *progress, size_t rows) {
+    if (progress) atomic_fetch_add_explicit(&progress->rows, rows, memory_order_relaxed);
+}
+
+const TerrainConfig *terrain_config(void) {
+    return &terrain;
+}
+
+void terrain_set_config(const TerrainConfig *config) {
+    if (config->width == 0 || config->height == 0 || !(config->world_width > 0.0f) || !(config->world_height > 0.0f)) {
+        printf("Invalid terrain size: %zu x %zu samples over %f x %f units\n", config->width, config->height,
+               config->world_width, config->world_height);
+        exit(1);
+    }
+    terrain = *config;
+}
+
+bool terrain_debug_export(void) {
+    static int enabled = -1;
+    if (enabled < 0) {
+        const char *env = getenv("TERRAIN_DEBUG_EXPORT");
+        enabled = env && *env && strcmp(env, "0") != 0;
+    }
+    return enabled;
+}
+
+float terrain_major_radius(void) {
+    return terrain.world_width / (2.0f * PI);
+}
+
+float terrain_minor_radius(void) {
+    return terrain.world_height / (2.0f * PI);
+}
+
+static void seed_heightmap_ctx(void) {
+    static bool seeded = false;
+    if (!seeded) {
+        noise_context_init(&heightmap_ctx, heightmap_seed);
+        seeded = true;
+    }
+}
+
+// Only Perlin and simplex noise have analytic derivatives.
+static bool noise_has_deriv(NoiseType type) {
+    return type == NOISE_PERLIN || type == NOISE_SIMPLEX;
+}
+
+// Gradient warping needs an analytic-derivative noise.
+static HeightmapWarp effective_warp(void) {
+    return noise_has_deriv(heightmap_noise) ? heightmap_warp : HEIGHTMAP_WARP_OFFSETS;
+}
+
+// heightmap_gradient only covers the 4D torus generator.
+bool heightmap_has_gradient(void) {
+    return heightmap_generator == HEIGHTMAP_GEN_TORUS4D && noise_has_deriv(heightmap_noise);
+}
+
+// Number of lattice cells the periodic generator fits across size world
+// units: the scale rounded to a whole period, so features keep about the
+// size the 4D torus gives them.
+static int periodic_cells(float size) {
+    int cells = (int)lroundf(size * heightmap_scale);
+    return cells > 0 ? cells : 1;
+}
+
+// Fills heightmap from periodic 2D fBm with the offset warp. The warp
+// displacement is itself periodic, so the warped sample wraps with the map
+// and the result tiles seamlessly, at three 2D fBm calls per pixel instead
+// of five 4D ones.
+static void generate_periodic_heightmap(Heightmap *heightmap, GenerateProgress *progress) {
+    NoisePeriodicFunction2D fn = NULL;
+    switch (heightmap_noise) {
+        case NOISE_PERLIN:
+            fn = perlin_noise2d_periodic;
+            break;
+        case NOISE_VALUE_HASH:
+            fn = hash_noise2d_periodic;
+            break;
+        default:
+            printf("Noise type %d has no periodic variant, using Perlin noise\n", heightmap_noise);
+            fn = perlin_noise2d_periodic;
+            break;
+    }
+    const size_t width = heightmap->width, height = heightmap->height;
+    const int period_x = periodic_cells(terrain.world_width);
+    const int period_y = periodic_cells(terrain.world_height);
+    const float step_x = (float)period_x / width;
+    const float step_y = (float)period_y / height;
+    const int lacunarity = (int)fbm_lacunarity;
+    printf("Periodic 2D noise, %d x %d lattice cells\n", period_x, period_y);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t v = 0; v < height; v++) {
+        if (generate_cancelled(progress)) continue;
+        float y = v * step_y;
+        float *row = heightmap_row(heightmap, v);
+        for (size_t u = 0; u < width; u++) {
+            float x = u * step_x;
+            float dx = fbm2d_periodic_fn(&heightmap_ctx, x + disp_offset, y, period_x, period_y,
+                                         fbm_octaves, lacunarity, fbm_gain, fn);
+            float dy = fbm2d_periodic_fn(&heightmap_ctx, x, y + disp_offset, period_x, period_y,
+                                         fbm_octaves, lacunarity, fbm_gain, fn);
+            float n = fbm2d_periodic_fn(&heightmap_ctx, x + displacement_strength * dx, y + displacement_strength * dy,
+                                        period_x, period_y, fbm_octaves, lacunarity, fbm_gain, fn);
+            float warped_noise = powf(n, 4.0f);  // boost height contrast
+            assert(warped_noise >= 0.0f && warped_noise <= 1.0f); // Ensure noise is in [0, 1]
+            row[u] = warped_noise;
+        }
+        generate_rows_done(progress, 1);
+    }
+}
+
+// Fills heightmap by spectral synthesis. The spectrum is flat below
+// heightmap_scale cycles per world unit, so the largest features match the
+// noise generators' lattice size.
+static void generate_spectral_heightmap(Heightmap *heightmap, GenerateProgress *progress) {
+    const size_t width = heightmap->width, height = heightmap->height;
+    if (generate_cancelled(progress)) return;  // one transform, so only cancellable before it
+    printf("Spectral synthesis, beta %.2f\n", spectral_beta);
+    // Synthesise straight into the map unless its rows are padded.
+    float *field = heightmap->data;
+    if (heightmap->stride != width) {
+        field = malloc(width * height * sizeof(float));
+        if (!field) {
+            perror("malloc failed");
+            exit(1);
+        }
+    }
+    spectral_synthesis(&heightmap_ctx, field, width, height, terrain.world_width, terrain.world_height, spectral_beta,
+                       heightmap_scale);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t v = 0; v < height; v++) {
+        const float *src = field + v * width;
+        float *row = heightmap_row(heightmap, v);
+        for (size_t u = 0; u < width; u++) {
+            row[u] = powf(src[u], 4.0f);  // boost height contrast
+        }
+    }
+    if (field != heightmap->data) free(field);
+    generate_rows_done(progress, height);
+}
+
+// The settings above, as recorded in the heightmap file header.
+static HeightmapParams heightmap_params(void) {
+    HeightmapParams params;
+    memset(&params, 0, sizeof(params));
+    params.seed = heightmap_seed;
+    params.generator = heightmap_generator;
+    params.noise = heightmap_noise;
+    params.warp = effective_warp();
+    params.octaves = fbm_octaves;
+    params.scale = heightmap_scale;
+    params.lacunarity = fbm_lacunarity;
+    params.gain = fbm_gain;
+    params.disp_offset = disp_offset;
+    params.displacement_strength = displacement_strength;
+    params.spectral_beta = spectral_beta;
+    return params;
+}
+
+// Generates the terrain at width x height samples over the configured world
+// size, so lower resolutions show the same terrain in less detail. With a
+// progress, reports finished rows there and stops early if it is cancelled,
+// leaving the skipped rows zero.
+static Heightmap *generate_heightmap(size_t width, size_t height, GenerateProgress *progress) {
+    Heightmap *heightmap = heightmap_create(width, height);
+
+    const float scale = heightmap_scale;
+    printf("Generating heightmap with scale: %f\n", scale);
+    printf("Terrain: %zu x %zu samples over %.1f x %.1f units\n", width, height,
+           terrain.world_width, terrain.world_height);
+    if (heightmap_generator != HEIGHTMAP_GEN_TORUS4D) {
+        if (heightmap_generator == HEIGHTMAP_GEN_SPECTRAL) generate_spectral_heightmap(heightmap, progress);
+        else generate_periodic_heightmap(heightmap, progress);
+        return heightmap;
+    }
+    const float R = terrain_major_radius(), r = terrain_minor_radius();
+    printf("R: %f, r: %f\n", R, r);
+    NoiseBatchFunction4D fn = NULL;
+    NoiseDerivBatchFunction4D deriv_fn = NULL;
+    switch (heightmap_noise) {
+        case NOISE_VALUE:
+            fn = noise4d_batch;
+            break;
+        case NOISE_PERLIN:
+            printf("Using Perlin noise with seed %llu\n", (unsigned long long)heightmap_seed);
+            fn = perlin_noise4d_scanline;  // Use Perlin noise, reusing corner hashes along each row
+            deriv_fn = perlin_noise4d_deriv_batch;
+            break;
+        case NOISE_SIMPLEX:
+            fn = simplex4d_batch;  // Use Simplex noise
+            deriv_fn = simplex4d_deriv_batch;
+            break;
+        case NOISE_VALUE_HASH:
+            fn = hash_noise4d_batch;  // Integer-hash value noise
+            break;
+        default:
+            fprintf(stderr, "Unknown noise type: %d\n", heightmap_noise);
+            exit(1);
+    }
+    const HeightmapWarp warp = effective_warp();
+    printf("Noise kernels: %s, warp: %s\n", noise_simd_name(noise_simd_level()),
+           warp == HEIGHTMAP_WARP_GRADIENT ? "gradient" : "offsets");
+
+    // The u angle terms are the same on every row, so take them once per
+    // column; each row then only needs its own v terms.
+    float *col_x = malloc(2 * width * sizeof(float));
+    if (!col_x) {
+        perror("malloc failed");
+        exit(1);
+    }
+    float *col_y = col_x + width;
+    for (size_t u = 0; u < width; u++) {
+        col_x[u] = R * cos(u * 2.0f * PI / width) * scale;
+        col_y[u] = R * sin(u * 2.0f * PI / width) * scale;
+    }
+
+    // Each row is generated as a batch. The offset warp runs four displacement
+    // fBm passes; the gradient warp gets the same first-order information from
+    // a single value-and-gradient pass. Both finish with the warped sample.
+    #pragma omp parallel
+    {
+        float *buf = malloc(12 * width * sizeof(float));
+        if (!buf) {
+            perror("malloc failed");
+            exit(1);
+        }
+        float *nx = buf,             *ny = buf + width,     *nz = buf + 2 * width,  *nw = buf + 3 * width;
+        float *ox = buf + 4 * width, *oy = buf + 5 * width, *oz = buf + 6 * width,  *ow = buf + 7 * width;
+        float *dx = buf + 8 * width, *dy = buf + 9 * width, *dz = buf + 10 * width, *dw = buf + 11 * width;
+
+        #pragma omp for schedule(static)
+        for (size_t v = 0; v < height; v++) {
+            if (generate_cancelled(progress)) continue;
+            float row_nz = r * cos(v * 2.0f * PI / height) * scale;
+            float row_nw = r * sin(v * 2.0f * PI / height) * scale;
+            memcpy(nx, col_x, width * sizeof(float));
+            memcpy(ny, col_y, width * sizeof(float));
+            for (size_t u = 0; u < width; u++) {
+                nz[u] = row_nz;
+                nw[u] = row_nw;
+            }
+
+            if (warp == HEIGHTMAP_WARP_GRADIENT) {
+                float *f = heightmap_row(heightmap, v);
+                fbm4d_deriv_batch_fn(&heightmap_ctx, nx, ny, nz, nw, f, dx, dy, dz, dw, width,
+                                     fbm_octaves, fbm_lacunarity, fbm_gain, deriv_fn);
+                for (size_t u = 0; u < width; u++) {
+                    dx[u] = f[u] + disp_offset * dx[u];
+                    dy[u] = f[u] + disp_offset * dy[u];
+                    dz[u] = f[u] + disp_offset * dz[u];
+                    dw[u] = f[u] + disp_offset * dw[u];
+                }
+            } else {
+                for (size_t u = 0; u < width; u++) {
+                    ox[u] = nx[u] + disp_offset;
+                    oy[u] = ny[u] + disp_offset;
+                    oz[u] = nz[u] + disp_offset;
+                    ow[u] = nw[u] + disp_offset;
+                }
+                fbm4d_batch_fn(&heightmap_ctx, ox, ny, nz, nw, dx, width, fbm_octaves, fbm_lacunarity, fbm_gain, fn);
+                fbm4d_batch_fn(&heightmap_ctx, nx, oy, nz, nw, dy, width, fbm_octaves, fbm_lacunarity, fbm_gain, fn);
+                fbm4d_batch_fn(&heightmap_ctx, nx, ny, oz, nw, dz, width, fbm_octaves, fbm_lacunarity, fbm_gain, fn);
+                fbm4d_batch_fn(&heightmap_ctx, nx, ny, nz, ow, dw, width, fbm_octaves, fbm_lacunarity, fbm_gain, fn);
+            }
+
+            for (size_t u = 0; u < width; u++) {
+                ox[u] = nx[u] + displacement_strength * dx[u];
+                oy[u] = ny[u] + displacement_strength * dy[u];
+                oz[u] = nz[u] + displacement_strength * dz[u];
+                ow[u] = nw[u] + displacement_strength * dw[u];
+            }
+
+            float *row = heightmap_row(heightmap, v);
+            fbm4d_batch_fn(&heightmap_ctx, ox, oy, oz, ow, row, width, fbm_octaves, fbm_lacunarity, fbm_gain, fn);
+
+            for (size_t u = 0; u < width; u++) {
+                float warped_noise = powf(row[u], 4.0f);  // boost height contrast
+                assert(warped_noise >= 0.0f && warped_noise <= 1.0f); // Ensure noise is in [0, 1]
+                row[u] = warped_noise;
+            }
+            generate_rows_done(progress, 1);
+        }
+        free(buf);
+    }
+    free(col_x);
+    return heightmap;
+}
+
+uint64_t terrain_cache_key(void) {
+    const HeightmapParams params = heightmap_params();
+    const uint64_t size[2] = { terrain.width, terrain.height };
+    const float world[2] = { terrain.world_width, terrain.world_height };
+    uint64_t key = cache_key(CACHE_KEY_INIT, &params, sizeof(params));
+    key = cache_key(key, size, sizeof(size));
+    return cache_key(key, world, sizeof(world));
+}
+
+
+// The cached map for the current settings, or NULL if there is none or it
+// does not match them.
+static Heightmap *load_cached_heightmap(const char *filename) {
+    const HeightmapParams params = heightmap_params();
+    if (!heightmap_exists(filename)) {
+        printf("Heightmap does not exist at %s, generating new one.\n", filename);
+        return NULL;
+    }
+    Heightmap *heightmap = load_heightmap(filename);
+    if (heightmap && heightmap->height == terrain.height && heightmap->width == terrain.width &&
+        memcmp(&heightmap->params, &params, sizeof(params)) == 0) {
+        printf("Heightmap loaded from %s\n", filename);
+        return heightmap;
+    }
+    printf("Heightmap at %s is stale or unreadable, generating new one.\n", filename);
+    heightmap_destroy(heightmap);
+    return NULL;
+}
+
+// Stamps a freshly generated map with the settings and its range.
+static void finish_heightmap(Heightmap *heightmap) {
+    heightmap->params = heightmap_params();
+    heightmap_update_range(heightmap);
+}
+
+Heightmap *get_heightmap(void) {
+    // A map generated earlier in this run may still be on its way to disk;
+    // waiting for it is far cheaper than generating it again.
+    io_worker_flush();
+    seed_heightmap_ctx();
+    char filename[64];
+    cache_filename(filename, sizeof(filename), "heightmap", terrain_cache_key());
+
+    Heightmap *heightmap = load_cached_heightmap(filename);
+    if (heightmap) return heightmap;
+
+    heightmap = generate_heightmap(terrain.width, terrain.height, NULL);
+    finish_heightmap(heightmap);
+    printf("Heightmap generated with dimensions: %zu x %zu\n", terrain.width, terrain.height);
+    save_heightmap_async(filename, heightmap, terrain.encoding);
+    return heightmap;
+}
+
+struct TerrainRefinement {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    bool threaded;
+    bool finished;              // no more levels are coming
+    Heightmap *ready;           // newest finished level nobody has taken yet
+    size_t rows_total;          // rows of every level the thread generates
+    GenerateProgress progress;
+    char filename[64];
+};
+
+// Samples along one side at a level, each level halving the last.
+static size_t level_size(size_t size, int level) {
+    size_t s = size >> level;
+    return s ? s : 1;
+}
+
+// Replaces the untaken level, if any, with heightmap.
+static void publish_level(TerrainRefinement *r, Heightmap *heightmap) {
+    pthread_mutex_lock(&r->lock);
+    heightmap_destroy(r->ready);
+    r->ready = heightmap;
+    pthread_mutex_unlock(&r->lock);
+}
+
+// Generates the levels finer than the coarsest, ending with the full map,
+// which goes to the cache like get_heightmap's.
+static void *refine_levels(void *arg) {
+    TerrainRefinement *r = arg;
+    // Leave a core to the game. The setting is this thread's own, but put it
+    // back in case this runs on the caller's thread.
+    const int threads = omp_get_num_procs() - 1, saved_threads = omp_get_max_threads();
+    omp_set_num_threads(threads > 0 ? threads : 1);
+
+    for (int level = TERRAIN_COARSEST_LEVEL - 1; level >= 0; level--) {
+        const double start = omp_get_wtime();
+        Heightmap *heightmap = generate_heightmap(level_size(terrain.width, level), level_size(terrain.height, level),
+                                                  &r->progress);
+        if (generate_cancelled(&r->progress)) {
+            heightmap_destroy(heightmap);
+            printf("Terrain refinement cancelled\n");
+            break;
+        }
+        finish_heightmap(heightmap);
+        printf("Terrain level %d ready: %zu x %zu in %.0f ms, %.0f%% of refinement done\n", level, heightmap->width,
+               heightmap->height, (omp_get_wtime() - start) * 1e3, terrain_refine_progress(r) * 100.0f);
+        if (level == 0) save_heightmap_async(r->filename, heightmap, terrain.encoding);
+        publish_level(r, heightmap);
+    }
+
+    pthread_mutex_lock(&r->lock);
+    r->finished = true;
+    pthread_mutex_unlock(&r->lock);
+    omp_set_num_threads(saved_threads);
+    return NULL;
+}
+
+TerrainRefinement *terrain_refine_start(void) {
+    io_worker_flush();
+    seed_heightmap_ctx();
+    TerrainRefinement *r = calloc(1, sizeof(TerrainRefinement));
+    if (!r) {
+        perror("malloc failed");
+        exit(1);
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    atomic_init(&r->progress.rows, 0);
+    atomic_init(&r->progress.cancel, false);
+    cache_filename(r->filename, sizeof(r->filename), "heightmap", terrain_cache_key());
+
+    r->ready = load_cached_heightmap(r->filename);
+    if (r->ready) {
+        r->finished = true;
+        return r;
+    }
+
+    const double start = omp_get_wtime();
+    r->ready = generate_heightmap(level_size(terrain.width, TERRAIN_COARSEST_LEVEL),
+                                  level_size(terrain.height, TERRAIN_COARSEST_LEVEL), NULL);
+    finish_heightmap(r->ready);
+    printf("Terrain level %d ready: %zu x %zu in %.0f ms\n", TERRAIN_COARSEST_LEVEL, r->ready->width,
+           r->ready->height, (omp_get_wtime() - start) * 1e3);
+
+    for (int level = TERRAIN_COARSEST_LEVEL - 1; level >= 0; level--) {
+        r->rows_total += level_size(terrain.height, level);
+    }
+    r->threaded = pthread_create(&r->thread, NULL, refine_levels, r) == 0;
+    if (!r->threaded) {
+        printf("Could not start terrain refinement, generating the full map now\n");
+        refine_levels(r);
+    }
+    return r;
+}
+
+Heightmap *terrain_refine_poll(TerrainRefinement *r) {
+    pthread_mutex_lock(&r->lock);
+    Heightmap *heightmap = r->ready;
+    r->ready = NULL;
+    pthread_mutex_unlock(&r->lock);
+    return heightmap;
+}
+
+float terrain_refine_progress(TerrainRefinement *r) {
+    pthread_mutex_lock(&r->lock);
+    const bool finished = r->finished;
+    pthread_mutex_unlock(&r->lock);
+    if (finished || r->rows_total == 0) return 1.0f;
+    return (float)atomic_load_explicit(&r->progress.rows, memory_order_relaxed) / r->rows_total;
+}
+
+bool terrain_refine_done(TerrainRefinement *r) {
+    pthread_mutex_lock(&r->lock);
+    const bool done = r->finished && !r->ready;
+    pthread_mutex_unlock(&r->lock);
+    return done;
+}
+
+void terrain_refine_stop(TerrainRefinement *r) {
+    if (!r) return;
+    atomic_store(&r->progress.cancel, true);
+    if (r->threaded) pthread_join(r->thread, NULL);
+    heightmap_destroy(r->ready);
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
+
+// Analytic height and gradient of the generated heightmap at pixel (u, v),
+// by the chain rule through the torus embedding, the warp and the contrast
+// boost. The offset warp is differentiated exactly. The gradient warp's
+// displacement depends on the noise Hessian, which is taken as a central
+// difference of the analytic gradient along the surface directions. Returns
+// false for noise types without an analytic derivative and for the periodic
+// and spectral generators.
+bool heightmap_gradient(float u, float v, float *height, float *dh_du, float *dh_dv) {
+    if (heightmap_generator != HEIGHTMAP_GEN_TORUS4D) return false;
+    NoiseDerivFunction4D noise = NULL;
+    switch (heightmap_noise) {
+        case NOISE_PERLIN:  noise = perlin_noise4d_deriv; break;
+        case NOISE_SIMPLEX: noise = simplex4d_deriv;      break;
+        default: return false;
+    }
+
+    seed_heightmap_ctx();
+    const NoiseContext *ctx = &heightmap_ctx;
+    const float scale = heightmap_scale;
+    const float R = terrain_major_radius(), r = terrain_minor_radius();
+    const size_t width = terrain.width, rows = terrain.height;
+    // Same expressions as get_heightmap, so pixel centres reproduce it exactly.
+    float n[4] = { R * cos(u * 2.0f * PI / width) * scale, R * sin(u * 2.0f * PI / width) * scale,
+                   r * cos(v * 2.0f * PI / rows) * scale, r * sin(v * 2.0f * PI / rows) * scale };
+    // Tangents of the embedding, per pixel.
+    float dn_du[4] = { -n[1] * 2.0f * PI / width, n[0] * 2.0f * PI / width, 0.0f, 0.0f };
+    float dn_dv[4] = { 0.0f, 0.0f, -n[3] * 2.0f * PI / rows, n[2] * 2.0f * PI / rows };
+
+    // Displacement d and its derivatives along u and v.
+    float d[4], dd_du[4], dd_dv[4];
+    if (effective_warp() == HEIGHTMAP_WARP_GRADIENT) {
+        const float step = 0.05f;  // pixels
+        float g[4], gp[4], gm[4];
+        float f = fbm4d_deriv_fn(ctx, n[0], n[1], n[2], n[3], fbm_octaves, fbm_lacunarity, fbm_gain, noise, g);
+        float f_du = 0.0f, f_dv = 0.0f;
+        for (int j = 0; j < 4; j++) {
+            f_du += g[j] * dn_du[j];
+            f_dv += g[j] * dn_dv[j];
+        }
+        fbm4d_deriv_fn(ctx, n[0] + step * dn_du[0], n[1] + step * dn_du[1], n[2], n[3],
+                       fbm_octaves, fbm_lacunarity, fbm_gain, noise, gp);
+        fbm4d_deriv_fn(ctx, n[0] - step * dn_du[0], n[1] - step * dn_du[1], n[2], n[3],
+                       fbm_octaves, fbm_lacunarity, fbm_gain, noise, gm);
+        for (int i = 0; i < 4; i++) {
+            d[i] = f + disp_offset * g[i];
+            dd_du[i] = f_du + disp_offset * (gp[i] - gm[i]) / (2.0f * step);
+        }
+        fbm4d_deriv_fn(ctx, n[0], n[1], n[2] + step * dn_dv[2], n[3] + step * dn_dv[3],
+                       fbm_octaves, fbm_lacunarity, fbm_gain, noise, gp);
+        fbm4d_deriv_fn(ctx, n[0], n[1], n[2] - step * dn_dv[2], n[3] - step * dn_dv[3],
+                       fbm_octaves, fbm_lacunarity, fbm_gain, noise, gm);
+        for (int i = 0; i < 4; i++) {
+            dd_dv[i] = f_dv + disp_offset * (gp[i] - gm[i]) / (2.0f * step);
+        }
+    } else {
+        for (int i = 0; i < 4; i++) {
+            float p[4] = { n[0], n[1], n[2], n[3] };
+            float g[4];
+            p[i] += disp_offset;
+            d[i] = fbm4d_deriv_fn(ctx, p[0], p[1], p[2], p[3], fbm_octaves, fbm_lacunarity, fbm_gain, noise, g);
+            dd_du[i] = g[0] * dn_du[0] + g[1] * dn_du[1];
+            dd_dv[i] = g[2] * dn_dv[2] + g[3] * dn_dv[3];
+        }
+    }
+
+    float q[4], G[4];
+    for (int i = 0; i < 4; i++) q[i] = n[i] + displacement_strength * d[i];
+    float F = fbm4d_deriv_fn(ctx, q[0], q[1], q[2], q[3], fbm_octaves, fbm_lacunarity, fbm_gain, noise, G);
+
+    // h = F(q)^4, dq/du = dn/du + s * dd/du
+    float k = 4.0f * F * F * F;
+    float du = 0.0f, dv = 0.0f;
+    for (int j = 0; j < 4; j++) {
+        du += G[j] * (dn_du[j] + displacement_strength * dd_du[j]);
+        dv += G[j] * (dn_dv[j] + displacement_strength * dd_dv[j]);
+    }
+
+    *height = powf(F, 4.0f);
+    *dh_du = k * du;
+    *dh_dv = k * dv;
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+/*
+ * Terrain heightmap generation, independent of the window and the GPU.
+ *
+ * A TerrainConfig fixes the heightmap resolution and, separately, the size
+ * of the world it covers: the flat map spans world_width x world_height
+ * units, and the torus has those as its circumferences. The noise is
+ * sampled in world units, so changing the resolution changes only the
+ * detail, not the terrain.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "heightmap.h"
+#include "save.h"
+
+typedef struct TerrainConfig {
+    size_t width, height;             // heightmap samples along the major and minor circles
+    float world_width, world_height;  // world units the heightmap spans
+    HeightmapEncoding encoding;       // how get_heightmap stores a map it generates
+} TerrainConfig;
+
+// How get_heightmap displaces its sample point before the final fBm:
+// OFFSETS evaluates four extra fBm passes at offset positions, GRADIENT
+// reuses the analytic gradient of a single pass.
+typedef enum {
+    HEIGHTMAP_WARP_OFFSETS,
+    HEIGHTMAP_WARP_GRADIENT
+} HeightmapWarp;
+
+// Where get_heightmap samples its noise: TORUS4D maps each pixel onto a 4D
+// Clifford torus so 4D noise wraps in both directions, PERIODIC2D samples 2D
+// noise whose lattice itself wraps at the heightmap edges, and SPECTRAL
+// shapes white noise with a 1/f^beta spectrum and inverse FFTs it.
+typedef enum {
+    HEIGHTMAP_GEN_TORUS4D,
+    HEIGHTMAP_GEN_PERIODIC2D,
+    HEIGHTMAP_GEN_SPECTRAL
+} HeightmapGenerator;
+
+// The current configuration; starts out as the game's default terrain.
+const TerrainConfig *terrain_config(void);
+// Replaces the configuration; exits if a size is zero.
+void terrain_set_config(const TerrainConfig *config);
+
+// Whether to write debug previews of the terrain (heightmap PGMs) and print
+// the mesh build timings. Off unless the TERRAIN_DEBUG_EXPORT environment
+// variable is set to non-zero.
+bool terrain_debug_export(void);
+
+// Torus radii whose circumferences are the world size.
+float terrain_major_radius(void);
+float terrain_minor_radius(void);
+
+// Cache key of the heightmap for the generator settings and the
+// configuration's sizes (not its encoding, which any loader reads).
+uint64_t terrain_cache_key(void);
+
+// The heightmap for the generator settings and configuration, mapped from
+// its cache file in resources/heightmaps if one exists (read-only), or
+// generated and returned while the I/O worker saves it there. The caller
+// destroys it.
+Heightmap *get_heightmap(void);
+
+/*
+ * Progressive generation: the same heightmap as get_heightmap, delivered
+ * coarse first. Starting generates level TERRAIN_COARSEST_LEVEL (1/8 of the
+ * resolution, in milliseconds) before returning; a background thread, with
+ * its own OpenMP team, then generates each finer level up to the full map,
+ * which it saves to the cache. A cached map is delivered at once as the only
+ * level. Every level covers the whole world, so any of them can stand in for
+ * the terrain.
+ */
+#define TERRAIN_COARSEST_LEVEL 3
+
+typedef struct TerrainRefinement TerrainRefinement;
+
+TerrainRefinement *terrain_refine_start(void);
+// The newest level finished since the last poll, or NULL. Levels not polled
+// in time are skipped. The caller destroys the map.
+Heightmap *terrain_refine_poll(TerrainRefinement *r);
+// Share of the background levels' rows generated so far, from 0 to 1.
+float terrain_refine_progress(TerrainRefinement *r);
+// True once the full map has been generated and polled, or refinement was
+// cancelled.
+bool terrain_refine_done(TerrainRefinement *r);
+// Cancels refinement if it is still running, waits for the thread and frees
+// r with any level not yet polled.
+void terrain_refine_stop(TerrainRefinement *r);
+
+// Whether heightmap_gradient covers the current generator settings.
+bool heightmap_has_gradient(void);
+bool heightmap_gradient(float u, float v, float *height, float *dh_du, float *dh_dv);
+
+#endif // TERRAIN_H
@@ -0,0 +1,266 @@
+#include "terrain_lod.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *lod_alloc(size_t size)
+{
+    void *p = malloc(size);
+    if (!p) {
+        perror("terrain lod allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+// A level's lines along an axis of q quads: every step-th vertex, then the
+// last, which closes a short final cell.
+static inline size_t lod_cells(size_t q, size_t step) { return (q + step - 1) / step; }
+static inline size_t lod_line(size_t k, size_t q, size_t step) { return k * step < q ? k * step : q; }
+
+int terrain_lod_levels(size_t quads_i, size_t quads_j)
+{
+    int levels = 1;
+    while (levels < TERRAIN_LOD_MAX_LEVELS && ((size_t)1 << levels) < quads_i && ((size_t)1 << levels) < quads_j)
+        levels++;
+    return levels;
+}
+
+// Where triangles go: 16- or 32-bit indices, or nowhere when only counting.
+typedef struct LodOut {
+    uint16_t *short_indices;
+    uint32_t *wide_indices;
+} LodOut;
+
+// Appends triangle (a, b, c), swapped round if need be to turn like the
+// full-resolution ones, which go from +j to +i.
+static size_t emit(LodOut out, size_t n, size_t quads_j, size_t a, size_t b, size_t c)
+{
+    const long stride = (long)quads_j + 1;
+    const long ai = (long)a / stride, aj = (long)a % stride;
+    const long bi = (long)b / stride - ai, bj = (long)b % stride - aj;
+    const long ci = (long)c / stride - ai, cj = (long)c % stride - aj;
+    const bool swap = bi * cj - bj * ci > 0;
+    if (out.short_indices) {
+        out.short_indices[n] = (uint16_t)a;
+        out.short_indices[n + 1] = (uint16_t)(swap ? c : b);
+        out.short_indices[n + 2] = (uint16_t)(swap ? b : c);
+    } else if (out.wide_indices) {
+        out.wide_indices[n] = (uint32_t)a;
+        out.wide_indices[n + 1] = (uint32_t)(swap ? c : b);
+        out.wide_indices[n + 2] = (uint32_t)(swap ? b : c);
+    }
+    return n + 3;
+}
+
+/*
+ * One transition strip: the trapezoid between the chunk's edge line (fixed
+ * coordinate edge, every edge_step-th vertex over q quads) and the inner line
+ * at coordinate inner (lines 1 to last of step). along_j says whether the
+ * lines run along j. Each triangle takes the next vertex of whichever line
+ * comes first, preferring the inner line on ties so an unstitched strip is
+ * plain quads.
+ */
+static size_t zip(LodOut out, size_t n, size_t quads_j, bool along_j, size_t q,
+                  size_t edge, size_t edge_step, size_t inner, size_t step, size_t last)
+{
+    const size_t stride = quads_j + 1;
+    #define LOD_VERTEX(fixed, t) (along_j ? (fixed) * stride + (t) : (t) * stride + (fixed))
+    const size_t edge_last = lod_cells(q, edge_step);
+    size_t a = 0, b = 1;
+    while (a < edge_last || b < last) {
+        const size_t a0 = lod_line(a, q, edge_step), b0 = lod_line(b, q, step);
+        if (b == last || (a < edge_last && lod_line(a + 1, q, edge_step) < lod_line(b + 1, q, step))) {
+            n = emit(out, n, quads_j, LOD_VERTEX(edge, a0), LOD_VERTEX(edge, lod_line(a + 1, q, edge_step)),
+                     LOD_VERTEX(inner, b0));
+            a++;
+        } else {
+            n = emit(out, n, quads_j, LOD_VERTEX(edge, a0), LOD_VERTEX(inner, b0),
+                     LOD_VERTEX(inner, lod_line(b + 1, q, step)));
+            b++;
+        }
+    }
+    #undef LOD_VERTEX
+    return n;
+}
+
+static size_t lod_indices(size_t quads_i, size_t quads_j, int level, unsigned edges, LodOut out)
+{
+    const size_t step = (size_t)1 << level, stride = quads_j + 1;
+    const size_t ni = lod_cells(quads_i, step), nj = lod_cells(quads_j, step);
+    // A chunk one cell across has no inside to stitch around.
+    const bool strips = ni >= 2 && nj >= 2;
+    const size_t first = strips ? 1 : 0;
+    size_t n = 0;
+    for (size_t a = first; a + first < ni; a++) {
+        const size_t i0 = lod_line(a, quads_i, step), i1 = lod_line(a + 1, quads_i, step);
+        for (size_t b = first; b + first < nj; b++) {
+            const size_t j0 = lod_line(b, quads_j, step), j1 = lod_line(b + 1, quads_j, step);
+            const size_t v00 = i0 * stride + j0, v01 = i0 * stride + j1;
+            const size_t v10 = i1 * stride + j0, v11 = i1 * stride + j1;
+            n = emit(out, n, quads_j, v00, v01, v10);
+            n = emit(out, n, quads_j, v10, v01, v11);
+        }
+    }
+    if (!strips) return n;
+
+    const size_t in_i0 = lod_line(1, quads_i, step), in_i1 = lod_line(ni - 1, quads_i, step);
+    const size_t in_j0 = lod_line(1, quads_j, step), in_j1 = lod_line(nj - 1, quads_j, step);
+    const size_t step_i0 = edges & TERRAIN_LOD_EDGE_I0 ? 2 * step : step;
+    const size_t step_i1 = edges & TERRAIN_LOD_EDGE_I1 ? 2 * step : step;
+    const size_t step_j0 = edges & TERRAIN_LOD_EDGE_J0 ? 2 * step : step;
+    const size_t step_j1 = edges & TERRAIN_LOD_EDGE_J1 ? 2 * step : step;
+    n = zip(out, n, quads_j, true, quads_j, 0, step_i0, in_i0, step, nj - 1);
+    n = zip(out, n, quads_j, true, quads_j, quads_i, step_i1, in_i1, step, nj - 1);
+    n = zip(out, n, quads_j, false, quads_i, 0, step_j0, in_j0, step, ni - 1);
+    n = zip(out, n, quads_j, false, quads_i, quads_j, step_j1, in_j1, step, ni - 1);
+    return n;
+}
+
+size_t terrain_lod_indices(size_t quads_i, size_t quads_j, int level, unsigned edges, uint16_t *out)
+{
+    return lod_indices(quads_i, quads_j, level, edges, (LodOut){ out, NULL });
+}
+
+size_t terrain_lod_indices32(size_t quads_i, size_t quads_j, int level, unsigned edges, uint32_t *out)
+{
+    return lod_indices(quads_i, quads_j, level, edges, (LodOut){ NULL, out });
+}
+
+void terrain_lod_errors(const float *vertices, size_t quads_i, size_t quads_j, int levels, float *errors)
+{
+    const size_t stride = quads_j + 1;
+    errors[0] = 0.0f;
+    for (int l = 1; l < levels; l++) {
+        const size_t step = (size_t)1 << l;
+        const size_t ni = lod_cells(quads_i, step), nj = lod_cells(quads_j, step);
+        float error = errors[l - 1];
+        for (size_t a = 0; a < ni; a++) {
+            const size_t i0 = lod_line(a, quads_i, step), i1 = lod_line(a + 1, quads_i, step);
+            for (size_t b = 0; b < nj; b++) {
+                const size_t j0 = lod_line(b, quads_j, step), j1 = lod_line(b + 1, quads_j, step);
+                const float *p00 = vertices + 3 * (i0 * stride + j0), *p01 = vertices + 3 * (i0 * stride + j1);
+                const float *p10 = vertices + 3 * (i1 * stride + j0), *p11 = vertices + 3 * (i1 * stride + j1);
+                for (size_t i = i0; i <= i1; i++) {
+                    const float u = (float)(i - i0) / (i1 - i0);
+                    for (size_t j = j0; j <= j1; j++) {
+                        const float v = (float)(j - j0) / (j1 - j0);
+                        const float *p = vertices + 3 * (i * stride + j);
+                        // The cell splits along p01 - p10, as the quads do.
+                        float d2 = 0.0f;
+                        for (int k = 0; k < 3; k++) {
+                            const float s = u + v <= 1.0f
+                                ? p00[k] + u * (p10[k] - p00[k]) + v * (p01[k] - p00[k])
+                                : p11[k] + (1.0f - u) * (p01[k] - p11[k]) + (1.0f - v) * (p10[k] - p11[k]);
+                            d2 += (p[k] - s) * (p[k] - s);
+                        }
+                        if (d2 > error * error) error = sqrtf(d2);
+                    }
+                }
+            }
+        }
+        errors[l] = error;
+    }
+}
+
+TerrainLod *terrain_lod_create(size_t chunks_i, size_t chunks_j, bool wraps)
+{
+    TerrainLod *lod = lod_alloc(sizeof(TerrainLod));
+    memset(lod, 0, sizeof(*lod));
+    lod->chunks_i = chunks_i;
+    lod->chunks_j = chunks_j;
+    lod->count = (int)(chunks_i * chunks_j);
+    lod->wraps = wraps;
+    lod->levels = lod_alloc(lod->count * sizeof(int));
+    lod->errors = lod_alloc(lod->count * TERRAIN_LOD_MAX_LEVELS * sizeof(float));
+    lod->bounds = lod_alloc(lod->count * 6 * sizeof(float));
+    lod->level = lod_alloc(lod->count * sizeof(int));
+    lod->edges = lod_alloc(lod->count * sizeof(unsigned));
+    memset(lod->level, 0, lod->count * sizeof(int));
+    memset(lod->edges, 0, lod->count * sizeof(unsigned));
+    // Levels past a chunk's own stay 0, so saved chunks hold no stray bytes.
+    memset(lod->errors, 0, lod->count * TERRAIN_LOD_MAX_LEVELS * sizeof(float));
+    return lod;
+}
+
+void terrain_lod_destroy(TerrainLod *lod)
+{
+    if (!lod) return;
+    free(lod->levels);
+    free(lod->errors);
+    free(lod->bounds);
+    free(lod->level);
+    free(lod->edges);
+    free(lod);
+}
+
+void terrain_lod_set_chunk(TerrainLod *lod, int c, const float *vertices, size_t quads_i, size_t quads_j,
+                           const float min[3], const float max[3])
+{
+    lod->levels[c] = terrain_lod_levels(quads_i, quads_j);
+    terrain_lod_errors(vertices, quads_i, quads_j, lod->levels[c], lod->errors + c * TERRAIN_LOD_MAX_LEVELS);
+    memcpy(lod->bounds + 6 * c, min, 3 * sizeof(float));
+    memcpy(lod->bounds + 6 * c + 3, max, 3 * sizeof(float));
+}
+
+// Chunk c's neighbour on side 0 to 3 (I0, I1, J0, J1), or -1 past an edge
+// that does not wrap.
+static int neighbour(const TerrainLod *lod, int c, int side)
+{
+    const long ni = (long)lod->chunks_i, nj = (long)lod->chunks_j;
+    long ci = c / nj, cj = c % nj;
+    if (side == 0) ci--;
+    else if (side == 1) ci++;
+    else if (side == 2) cj--;
+    else cj++;
+    if (ci < 0 || ci >= ni || cj < 0 || cj >= nj) {
+        if (!lod->wraps) return -1;
+        ci = (ci + ni) % ni;
+        cj = (cj + nj) % nj;
+    }
+    return (int)(ci * nj + cj);
+}
+
+void terrain_lod_select(TerrainLod *lod, const float eye[3], float projection_scale, float max_error_pixels)
+{
+    #pragma omp parallel for schedule(static) if (lod->count >= 1024)
+    for (int c = 0; c < lod->count; c++) {
+        const float *box = lod->bounds + 6 * c;
+        float d2 = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            const float d = eye[k] < box[k] ? box[k] - eye[k] : eye[k] > box[k + 3] ? eye[k] - box[k + 3] : 0.0f;
+            d2 += d * d;
+        }
+        // error * projection_scale / distance <= max_error_pixels, without the division
+        const float budget = max_error_pixels * sqrtf(d2) / projection_scale;
+        const float *errors = lod->errors + c * TERRAIN_LOD_MAX_LEVELS;
+        int level = lod->levels[c] - 1;
+        while (level > 0 && errors[level] > budget) level--;
+        lod->level[c] = level;
+    }
+
+    // Refining a chunk can push its neighbours over the one-level limit in
+    // turn, so sweep until nothing changes; levels only ever go down.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int c = 0; c < lod->count; c++) {
+            for (int side = 0; side < 4; side++) {
+                const int n = neighbour(lod, c, side);
+                if (n >= 0 && lod->level[c] > lod->level[n] + 1) {
+                    lod->level[c] = lod->level[n] + 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < lod->count; c++) {
+        unsigned edges = 0;
+        for (int side = 0; side < 4; side++) {
+            const int n = neighbour(lod, c, side);
+            if (n >= 0 && lod->level[n] > lod->level[c]) edges |= 1u << side;
+        }
+        lod->edges[c] = edges;
+    }
+}
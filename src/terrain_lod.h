@@ -0,0 +1,73 @@
+#ifndef TERRAIN_LOD_H
+#define TERRAIN_LOD_H
+
+/*
+ * Geomipmapping over a grid of terrain chunks, CPU side only.
+ *
+ * A chunk is a (quads_i + 1) x (quads_j + 1) grid of vertices, ring-major
+ * (vertex (i, j) is i * (quads_j + 1) + j). Level L keeps every 2^L-th
+ * line along each axis and always the last one, so chunks of any size have
+ * every level up to the one that would leave a single cell. The outermost
+ * ring of cells is a transition strip on each side: it zips the chunk's
+ * own lines to the lines along that edge, which are those of the neighbour
+ * when the neighbour is coarser. Neighbours differ by at most one level, so
+ * both chunks then use the same vertices along their shared edge and the
+ * surface has no cracks.
+ *
+ * Levels are chosen per chunk from the screen-space size of each level's
+ * geometric error: the largest distance from a full-resolution vertex to
+ * the level's surface, seen from the closest point of the chunk's box.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TERRAIN_LOD_MAX_LEVELS 8
+
+// Sides of a chunk whose neighbour is one level coarser.
+#define TERRAIN_LOD_EDGE_I0 1u  // vertices with i = 0, shared with the chunk before along i
+#define TERRAIN_LOD_EDGE_I1 2u  // i = quads_i
+#define TERRAIN_LOD_EDGE_J0 4u  // j = 0
+#define TERRAIN_LOD_EDGE_J1 8u  // j = quads_j
+#define TERRAIN_LOD_EDGE_SETS 16
+
+// Levels a chunk of quads_i x quads_j quads has.
+int terrain_lod_levels(size_t quads_i, size_t quads_j);
+// Writes the triangles of a chunk at a level, stitched to coarser
+// neighbours on the given edges, into out (if not NULL) and returns how
+// many indices there are. Triangles turn the same way as the full-resolution
+// quads (v00, v01, v10), (v10, v01, v11).
+size_t terrain_lod_indices(size_t quads_i, size_t quads_j, int level, unsigned edges, uint16_t *out);
+// The same with 32-bit indices, for chunks of more than 65536 vertices.
+size_t terrain_lod_indices32(size_t quads_i, size_t quads_j, int level, unsigned edges, uint32_t *out);
+// Geometric error of each of the first levels of a chunk, in world units,
+// from its xyz vertices. errors[0] is 0 and the rest never decrease.
+void terrain_lod_errors(const float *vertices, size_t quads_i, size_t quads_j, int levels, float *errors);
+
+// Chunk c is (c / chunks_j, c % chunks_j).
+typedef struct TerrainLod {
+    size_t chunks_i, chunks_j;
+    int count;
+    bool wraps;       // the last chunks along each axis border the first
+    int *levels;      // per chunk
+    float *errors;    // TERRAIN_LOD_MAX_LEVELS per chunk
+    float *bounds;    // min xyz, max xyz per chunk
+    int *level;       // per chunk, chosen by terrain_lod_select
+    unsigned *edges;  // per chunk, TERRAIN_LOD_EDGE_* bits to stitch, chosen with level
+} TerrainLod;
+
+TerrainLod *terrain_lod_create(size_t chunks_i, size_t chunks_j, bool wraps);
+void terrain_lod_destroy(TerrainLod *lod);
+// Records chunk c's levels, errors and bounding box. Chunks may be set from
+// several threads at once.
+void terrain_lod_set_chunk(TerrainLod *lod, int c, const float *vertices, size_t quads_i, size_t quads_j,
+                           const float min[3], const float max[3]);
+// Picks the coarsest level of each chunk whose error spans at most
+// max_error_pixels on screen, then refines chunks until no neighbours differ
+// by more than one level, and sets the edges to stitch. projection_scale is
+// the screen height over 2 tan(fovy / 2): the pixels one world unit spans at
+// distance one.
+void terrain_lod_select(TerrainLod *lod, const float eye[3], float projection_scale, float max_error_pixels);
+
+#endif // TERRAIN_LOD_H
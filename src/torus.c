@@ -1,17 +1,23 @@
 #include "physics.h"
+#include "rlgl.h"
 
 #include "torus.h"
-#include "fbm_with_function_pointer.h"
+#include "heightmap.h"
+#include "heightmap_sample.h"
 
 #include <stdlib.h>
 
 #include <stdio.h>
+#include <string.h>
 
 #include <float.h>
 
 #include "save.h"
+#include "mesh_cache.h"
 
 #include <assert.h>
+#include <omp.h>
+#include <GL/gl.h>  // glDrawElements, for chunks with 32-bit indices
 
 typedef struct TorusCoords {
     float theta, phi;
@@ -28,473 +34,815 @@ void SetTorusDimensions(float major, float minor) {
     R = major;
     r = minor;
 }
-#define WRAP_MOD(a, m) (((a) % (m) + (m)) % (m))
-
-float **get_heightmap(const char *filename) {
-    float **heightmap = NULL;
-    if(heightmap_exists(filename)) {
-        size_t rows = 0, cols = 0;
-        char *fullpath = build_fullpath(S_RESOURCES, S_HEIGHTMAPS, filename);
-        heightmap = load_matrix(fullpath, &rows, &cols);
-        assert(heightmap != NULL && rows > 0 && cols > 0);
-        assert(rows == MONITOR_HEIGHT && cols == MONITOR_WIDTH);
-        printf("Heightmap loaded from %s\n", filename);
-        return heightmap;
-    } 
-    printf("Heightmap does not exist at %s, generating new one.\n", filename);
-    heightmap = malloc(MONITOR_HEIGHT * sizeof(float *));
-    for (size_t i = 0; i < MONITOR_HEIGHT; i++) {
-        heightmap[i] = malloc(MONITOR_WIDTH * sizeof(float));
-    }
-
-    perlin_init(42);  // consistent seed
-
-    float scale = 0.005f;
-    printf("Generating heightmap with scale: %f\n", scale);
-    printf("MONITOR_WIDTH: %zu, MONITOR_HEIGHT: %zu\n", MONITOR_WIDTH, MONITOR_HEIGHT);
-    printf("R: %f, r: %f\n", R, r);
-    NoiseType noiseType = NOISE_PERLIN;  // Change this to switch noise types
-    NoiseFunction4D fn = NULL;
-    switch (noiseType) {
-        case NOISE_VALUE:
-            fn = noise4d;
-            break;
-        case NOISE_PERLIN:
-            printf("Using Perlin noise with seed 42\n");
-            perlin_init(42);  // Reinitialize Perlin noise with a consistent seed
-            fn = perlin_noise4d;  // Use Perlin noise
-            break;
-        case NOISE_SIMPLEX:
-            fn = simplex4d;  // Use Simplex noise
-            break;
-        default:
-            fprintf(stderr, "Unknown noise type: %d\n", noiseType);
-            exit(1);
-    }
 
-    #pragma omp parallel for schedule(static)
-    for (size_t v = 0; v < MONITOR_HEIGHT; v++) {
-        for (size_t u = 0; u < MONITOR_WIDTH; u++) {
-            float nx = R * cos(u * 2.0f * PI / MONITOR_WIDTH) * scale;
-            float ny = R * sin(u * 2.0f * PI / MONITOR_WIDTH) * scale;
-            float nz = r * cos(v * 2.0f * PI / MONITOR_HEIGHT) * scale;
-            float nw = r * sin(v * 2.0f * PI / MONITOR_HEIGHT) * scale;
-
-            const float disp_offset = 0.1f;
-            const float displacement_strength = 1.0f;
-
-            float dx = fbm4d_fn(nx + disp_offset, ny, nz, nw, 6, 2.0f, 0.5f, fn);
-            float dy = fbm4d_fn(nx, ny + disp_offset, nz, nw, 6, 2.0f, 0.5f, fn);
-            float dz = fbm4d_fn(nx, ny, nz + disp_offset, nw, 6, 2.0f, 0.5f, fn);
-            float dw = fbm4d_fn(nx, ny, nz, nw + disp_offset, 6, 2.0f, 0.5f, fn);
-
-            float warped_noise = fbm4d_fn(
-                nx + displacement_strength * dx,
-                ny + displacement_strength * dy,
-                nz + displacement_strength * dz,
-                nw + displacement_strength * dw,
-                6, 2.0f, 0.5f, fn
-            );
-
-            warped_noise = powf(warped_noise, 4.0f);  // boost height contrast
-            assert(warped_noise >= 0.0f && warped_noise <= 1.0f); // Ensure noise is in [0, 1]
-            heightmap[v][u] = warped_noise;
-        }
-    }
-    printf("Heightmap generated with dimensions: %zu x %zu\n", MONITOR_WIDTH, MONITOR_HEIGHT);
-    return heightmap;
+static const HeightmapFilter terrain_filter = HEIGHTMAP_FILTER_BILINEAR;  // Change this to switch how meshes sample the heightmap
+// Flat mesh normals from heightmap_gradient. Off: it runs five fBm passes per
+// vertex, so the default 1900 x 1050 grid takes 19.3 s instead of 0.2 s on one core.
+static const bool terrain_analytic_normals = false;
+static const bool terrain_filter_normals = false;  // Otherwise flat mesh normals from terrain_filter's gradient
+static const uint32_t terrain_mesh_version = 4;  // Bump when the chunk builders change, to drop cached chunks
+
+// Side of the square blocks of rings and sides build_terrain_grid samples together
+#define TERRAIN_SAMPLE_BLOCK 64
+
+// Heights span [0, upper bound] above the surface, from the heightmap's min to its max.
+#define TERRAIN_FLAT_HEIGHT 50.0f
+#define TERRAIN_TORUS_HEIGHT 400.0f
+
+// Wraps (i), (j) onto the stored rings and sides, at most one period out,
+// and returns how far the vertex there must move to stand at (i, j).
+static inline Vector3 grid_offset(long rings, long sides, long *i, long *j, Vector3 ring_period,
+                                  Vector3 side_period) {
+    Vector3 offset = { 0.0f, 0.0f, 0.0f };
+    if (*i < 0) { *i += rings; offset = Vector3Subtract(offset, ring_period); }
+    else if (*i >= rings) { *i -= rings; offset = Vector3Add(offset, ring_period); }
+    if (*j < 0) { *j += sides; offset = Vector3Subtract(offset, side_period); }
+    else if (*j >= sides) { *j -= sides; offset = Vector3Add(offset, side_period); }
+    return offset;
 }
 
-// Generates a torus mesh with the specified number of rings and sides.
-Mesh MyGenTorusMesh(size_t rings, size_t sides) {
-    unsigned char **image = malloc(MONITOR_HEIGHT * sizeof(unsigned char *));
-    if (!image) {
-        perror("malloc failed");
-        exit(1);
-    }
-
-    for (size_t y = 0; y < MONITOR_HEIGHT; y++) {
-        image[y] = malloc(MONITOR_WIDTH * sizeof(unsigned char));
-        if (!image[y]) {
-            perror("malloc failed");
-            exit(1);
-        }
-    }
-
-    float **heightmap = get_heightmap("heightmap.bin");
-
-    float min = FLT_MIN;
-    float max = -FLT_MAX;
-    for (size_t v = 0; v < MONITOR_HEIGHT; v++) {
-        for (size_t u = 0; u < MONITOR_WIDTH; u++) {
-            float height = heightmap[v][u];
-            assert(height >= 0.0f && height <= 1.0f); // Ensure noise is in [0, 1]
-            if (height < min) min = height;
-            if (height > max) max = height;
-            image[v][u] = (unsigned char)(height * 255.0f);
-        }
-    }
-    printf("Heightmap min: %f, max: %f\n", min, max);
+// Vertex (i, j) of the grid for any i and j one period out, wrapping onto
+// the stored rings and sides. A wrapped flat vertex is shifted by a whole
+// world, so faces and normals across the seam see the terrain continue.
+static inline Vector3 grid_vertex(const Vector3 *vertices, long rings, long sides, long i, long j,
+                                  Vector3 ring_period, Vector3 side_period) {
+    const Vector3 offset = grid_offset(rings, sides, &i, &j, ring_period, side_period);
+    return Vector3Add(vertices[i * sides + j], offset);
+}
 
-    FILE *f = fopen("heightmap_T.pgm", "wb");
-    if (!f) {
-        perror("Cannot write image");
-        exit(1);
+// Where a vertex at ring angle theta and side angle phi stands, raised by
+// height: off the tube of the torus, or on the plane it unrolls to.
+static inline Vector3 grid_position(bool torus, float theta, float phi, float height) {
+    if (torus) {
+        const float cosTheta = cosf(theta), sinTheta = sinf(theta);
+        const float cosPhi = cosf(phi), sinPhi = sinf(phi);
+        Vector3 position = { (R + r * cosPhi) * cosTheta, r * sinPhi, (R + r * cosPhi) * sinTheta };
+        Vector3 normal = { cosPhi * cosTheta, sinPhi, cosPhi * sinTheta };
+        return Vector3Add(position, Vector3Scale(normal, height));
     }
+    const TerrainConfig *config = terrain_config();
+    return (Vector3){ config->world_height / 2.0f - phi * r, height, R * theta - config->world_width / 2.0f };
+}
 
-    fprintf(f, "P5\n%zu %zu\n255\n", MONITOR_WIDTH, MONITOR_HEIGHT);  // P5 = binary greyscale
-    for (size_t y = 0; y < MONITOR_HEIGHT; y++) {
-        if (fwrite(image[y], sizeof(unsigned char), MONITOR_WIDTH, f) != MONITOR_WIDTH) {
-            perror("Error writing image data");
-            fclose(f);
-            exit(1);
-        }
-    }
-    fclose(f);
+static inline Vector3 face_normal(Vector3 a, Vector3 b, Vector3 c) {
+    return Vector3Normalize(Vector3CrossProduct(Vector3Subtract(b, a), Vector3Subtract(c, a)));
+}
 
-    printf("Heightmap written to heightmap_T.pgm\n");
+// The map a grid samples: a float heightmap, or the same map kept resident
+// as 16-bit codes, which samples to the same heights as its dequantized copy.
+typedef struct GridSource {
+    const Heightmap *heightmap;
+    const HeightmapQ16 *q16;
+    size_t width, height;
+    float min, max;
+} GridSource;
+
+static inline void source_sample_points(const GridSource *source, const float *x, const float *y, size_t count,
+                                        float *out) {
+    if (source->q16) heightmap_q16_sample_points(source->q16, terrain_filter, x, y, count, out);
+    else heightmap_sample_points(source->heightmap, terrain_filter, x, y, count, out);
+}
 
-    // Free the image memory
-    for (size_t y = 0; y < MONITOR_HEIGHT; y++) {
-        free(image[y]);
-    }
-    free(image);
+static inline void source_sample_grad(const GridSource *source, float x, float y, float *dh_dx, float *dh_dy) {
+    if (source->q16) heightmap_q16_sample_grad(source->q16, terrain_filter, x, y, dh_dx, dh_dy);
+    else heightmap_sample_grad(source->heightmap, terrain_filter, x, y, dh_dx, dh_dy);
+}
 
-    float upper_bound = 400.0f;
+/*
+ * Builds a terrain grid, CPU side only, from a heightmap of any resolution
+ * over the configured world. Ring i and side j sample the heightmap at
+ * (i / rings, j / sides) of its width and height whatever the embedding, so
+ * both embeddings show the same terrain. Every stage runs in parallel over
+ * rings and writes straight into the grid's arrays:
+ *
+ *   sample     - heights, in blocks of rings and sides a heightmap row
+ *                per batch
+ *   positions  - vertices and texcoords
+ *   normals    - both triangles of every quad, then at each vertex the sum
+ *                of the six triangles around it (a gather, so rings are
+ *                independent)
+ */
+static TerrainGrid build_terrain_grid(const GridSource *source, TerrainMeshEmbedding embedding, size_t rings,
+                                      size_t sides) {
+    const TerrainConfig *config = terrain_config();
+    const bool torus = embedding == TERRAIN_MESH_TORUS;
+    if (terrain_debug_export() && source->heightmap)
+        export_heightmap_pgm(torus ? "heightmap_T.pgm" : "heightmap.pgm", source->heightmap);
+    double t0 = omp_get_wtime();
+
+    float min = source->min;
+    float max = source->max;
+    printf("Heightmap min: %f, max: %f\n", min, max);
+    float upper_bound = torus ? TERRAIN_TORUS_HEIGHT : TERRAIN_FLAT_HEIGHT;
     float lower_bound = 0.0f;
     float gradient = (upper_bound - lower_bound) / (max - min);
     printf("Gradient: %f\n", gradient);
 
+    // Normals from a gradient only exist for the flat embedding.
+    const bool analytic_normals = !torus && terrain_analytic_normals && heightmap_has_gradient();
+    const bool smooth_normals = analytic_normals || (!torus && terrain_filter_normals);
+    // Heightmap samples per world unit, and full-resolution pixels (what
+    // heightmap_gradient takes) per sample.
+    const float sample_u = source->width / config->world_width;
+    const float sample_v = source->height / config->world_height;
+    const float pixel_u = (float)config->width / source->width;
+    const float pixel_v = (float)config->height / source->height;
+
+    const long nr = (long)rings, ns = (long)sides;
+    const size_t vertexCount = rings * sides;
+    Vector3 *vertices = MemAlloc(vertexCount * sizeof(Vector3));
+    Vector3 *normals = MemAlloc(vertexCount * sizeof(Vector3));
+    Vector2 *texcoords = MemAlloc(vertexCount * sizeof(Vector2));
+    // Scratch, reused by every stage: heights and sample coordinates, then
+    // the two face normals of each quad.
+    float *heights = MemAlloc(vertexCount * sizeof(float));
+    float *su = MemAlloc(vertexCount * sizeof(float));
+    float *sv = MemAlloc(vertexCount * sizeof(float));
+    Vector3 *faces = MemAlloc(2 * vertexCount * sizeof(Vector3));
+
+    // 1. Sample heights. A ring runs down a heightmap column, so sample
+    // square blocks of rings and sides a side at a time instead, along
+    // heightmap rows, and write each block back ring by ring.
+    const long blocks_i = (nr + TERRAIN_SAMPLE_BLOCK - 1) / TERRAIN_SAMPLE_BLOCK;
+    const long blocks_j = (ns + TERRAIN_SAMPLE_BLOCK - 1) / TERRAIN_SAMPLE_BLOCK;
+    #pragma omp parallel for schedule(static)
+    for (long b = 0; b < blocks_i * blocks_j; b++) {
+        const long i0 = b / blocks_j * TERRAIN_SAMPLE_BLOCK, j0 = b % blocks_j * TERRAIN_SAMPLE_BLOCK;
+        const long count_i = nr - i0 < TERRAIN_SAMPLE_BLOCK ? nr - i0 : TERRAIN_SAMPLE_BLOCK;
+        const long count_j = ns - j0 < TERRAIN_SAMPLE_BLOCK ? ns - j0 : TERRAIN_SAMPLE_BLOCK;
+        float x[TERRAIN_SAMPLE_BLOCK], y[TERRAIN_SAMPLE_BLOCK];
+        float block[TERRAIN_SAMPLE_BLOCK][TERRAIN_SAMPLE_BLOCK];  // [side][ring]
+        for (long k = 0; k < count_i; k++) x[k] = (float)(i0 + k) / rings * source->width;
+        for (long l = 0; l < count_j; l++) {
+            const float v = (float)(j0 + l) / sides * source->height;
+            for (long k = 0; k < count_i; k++) y[k] = v;
+            source_sample_points(source, x, y, count_i, block[l]);
+        }
+        for (long k = 0; k < count_i; k++) {
+            const size_t row = (i0 + k) * sides + j0;
+            for (long l = 0; l < count_j; l++) heights[row + l] = block[l][k];
+            if (!smooth_normals) continue;  // only smooth normals sample again
+            for (long l = 0; l < count_j; l++) {
+                su[row + l] = x[k];
+                sv[row + l] = (float)(j0 + l) / sides * source->height;
+            }
+        }
+    }
+    double t1 = omp_get_wtime();
 
-    // 1. Allocate vertex and normal grids
-    Vector3 **vertexGrid = MemAlloc(rings * sizeof(Vector3 *));
-    Vector3 **normalGrid = MemAlloc(rings * sizeof(Vector3 *));
-    for (size_t i = 0; i < rings; i++) {
-        vertexGrid[i] = MemAlloc(sides * sizeof(Vector3));
-        normalGrid[i] = MemAlloc(sides * sizeof(Vector3));
+    // 2. Positions and texcoords
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < nr; i++) {
+        const float theta = (float)i / rings * 2.0f * PI;
         for (size_t j = 0; j < sides; j++) {
-            normalGrid[i][j] = (Vector3){0.0f, 0.0f, 0.0f};
+            const size_t idx = (size_t)i * sides + j;
+            const float phi = (float)j / sides * 2.0f * PI;
+            const float adjusted_height = lower_bound + (heights[idx] - min) * gradient;
+            vertices[idx] = grid_position(torus, theta, phi, adjusted_height);
+            texcoords[idx] = (Vector2){ (float)j / sides, (float)i / rings };
         }
     }
+    double t2 = omp_get_wtime();
+
+    // 3. Normals. The torus closes up on itself; the flat world repeats a
+    // period over.
+    const Vector3 ring_period = torus ? Vector3Zero() : (Vector3){ 0.0f, 0.0f, config->world_width };
+    const Vector3 side_period = torus ? Vector3Zero() : (Vector3){ -config->world_height, 0.0f, 0.0f };
+    if (smooth_normals) {
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < nr; i++) {
+            for (size_t j = 0; j < sides; j++) {
+                const size_t idx = (size_t)i * sides + j;
+                // x runs against the heightmap rows and z along its columns.
+                float h, dh_du, dh_dv;
+                if (analytic_normals && heightmap_gradient(su[idx] * pixel_u, sv[idx] * pixel_v, &h, &dh_du, &dh_dv)) {
+                    normals[idx] = (Vector3){ gradient * dh_dv * sample_v * pixel_v, 1.0f,
+                                              -gradient * dh_du * sample_u * pixel_u };
+                } else {
+                    source_sample_grad(source, su[idx], sv[idx], &dh_du, &dh_dv);
+                    normals[idx] = (Vector3){ gradient * dh_dv * sample_v, 1.0f, -gradient * dh_du * sample_u };
+                }
+                normals[idx] = Vector3Normalize(normals[idx]);
+            }
+        }
+    } else {
+        // Quad (i, j) has triangles (p00, p01, p10) and (p10, p01, p11).
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < nr; i++) {
+            for (long j = 0; j < ns; j++) {
+                Vector3 p00 = vertices[i * ns + j];
+                Vector3 p01 = grid_vertex(vertices, nr, ns, i, j + 1, ring_period, side_period);
+                Vector3 p10 = grid_vertex(vertices, nr, ns, i + 1, j, ring_period, side_period);
+                Vector3 p11 = grid_vertex(vertices, nr, ns, i + 1, j + 1, ring_period, side_period);
+                faces[2 * (i * ns + j)] = face_normal(p00, p01, p10);
+                faces[2 * (i * ns + j) + 1] = face_normal(p10, p01, p11);
+            }
+        }
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < nr; i++) {
+            const long im = i ? i - 1 : nr - 1;
+            for (long j = 0; j < ns; j++) {
+                const long jm = j ? j - 1 : ns - 1;
+                // The vertex is p00 of its own quad, p01 of the one before it
+                // along the ring, p10 of the one on the ring before, and p11
+                // of the one before both.
+                Vector3 n = faces[2 * (i * ns + j)];
+                n = Vector3Add(n, faces[2 * (i * ns + jm)]);
+                n = Vector3Add(n, faces[2 * (i * ns + jm) + 1]);
+                n = Vector3Add(n, faces[2 * (im * ns + j)]);
+                n = Vector3Add(n, faces[2 * (im * ns + j) + 1]);
+                n = Vector3Add(n, faces[2 * (im * ns + jm) + 1]);
+                normals[i * ns + j] = Vector3Normalize(n);
+            }
+        }
+    }
+    double t3 = omp_get_wtime();
+
+    MemFree(heights);
+    MemFree(su);
+    MemFree(sv);
+    MemFree(faces);
+    if (terrain_debug_export())
+        printf("Terrain mesh %zu x %zu: sample %.2f ms, positions %.2f ms, normals %.2f ms\n",
+               rings, sides, (t1 - t0) * 1e3, (t2 - t1) * 1e3, (t3 - t2) * 1e3);
+
+    TerrainGrid grid = { 0 };
+    grid.embedding = embedding;
+    grid.rings = rings;
+    grid.sides = sides;
+    grid.vertexCount = (int)vertexCount;
+    grid.vertices = (float *)vertices;
+    grid.normals = (float *)normals;
+    grid.texcoords = (float *)texcoords;
+    grid.ringPeriod = ring_period;
+    grid.sidePeriod = side_period;
+    grid.heightMin = min;
+    grid.heightScale = gradient;
+    return grid;
+}
 
-    // 2. Fill vertexGrid with positions (and optionally sample height)
-    for (size_t i = 0; i < rings; i++) {
-        float theta = (float)i / rings * 2.0f * PI;
-        float cosTheta = cosf(theta);
-        float sinTheta = sinf(theta);
-        for (size_t j = 0; j < sides; j++) {
-            float phi = ((float)j / sides) * 2.0f * PI;
-            float cosPhi = cosf(phi);
-            float sinPhi = sinf(phi);
+void UnloadTerrainGrid(TerrainGrid *grid) {
+    MemFree(grid->vertices);
+    MemFree(grid->normals);
+    MemFree(grid->texcoords);
+    *grid = (TerrainGrid){ 0 };
+}
 
-            float x = (R + r * cosPhi) * cosTheta;
-            float y = r * sinPhi;
-            float z = (R + r * cosPhi) * sinTheta;
+static GridSource float_source(const Heightmap *heightmap) {
+    return (GridSource){ heightmap, NULL, heightmap->width, heightmap->height, heightmap->min, heightmap->max };
+}
 
-            float nx = cosPhi * cosTheta;
-            float ny = sinPhi;
-            float nz = cosPhi * sinTheta;
+static GridSource q16_source(const HeightmapQ16 *q) {
+    return (GridSource){ NULL, q, q->width, q->height, q->min, q->max };
+}
 
-            Vector3 position = (Vector3){ x, y, z };
-            Vector3 normal = (Vector3){ nx, ny, nz };
+TerrainGrid GenFlatTorusGrid(const Heightmap *heightmap, size_t rings, size_t sides) {
+    const GridSource source = float_source(heightmap);
+    return build_terrain_grid(&source, TERRAIN_MESH_FLAT, rings, sides);
+}
 
-            int sx = WRAP_MOD((int)z, MONITOR_WIDTH);
-            int sy = WRAP_MOD((int)(MONITOR_HEIGHT - x), MONITOR_HEIGHT);
+TerrainGrid GenTorusGrid(const Heightmap *heightmap, size_t rings, size_t sides) {
+    const GridSource source = float_source(heightmap);
+    return build_terrain_grid(&source, TERRAIN_MESH_TORUS, rings, sides);
+}
 
-            float height = heightmap[sy][sx];
-            float adjusted_height = lower_bound + (height - min) * gradient;
-            
-            vertexGrid[i][j] = Vector3Add(position,Vector3Scale(normal, adjusted_height)); 
-        }
+TerrainGrid GenFlatTorusGridQ16(const HeightmapQ16 *q, size_t rings, size_t sides) {
+    const GridSource source = q16_source(q);
+    return build_terrain_grid(&source, TERRAIN_MESH_FLAT, rings, sides);
+}
+
+TerrainGrid GenTorusGridQ16(const HeightmapQ16 *q, size_t rings, size_t sides) {
+    const GridSource source = q16_source(q);
+    return build_terrain_grid(&source, TERRAIN_MESH_TORUS, rings, sides);
+}
+
+#ifndef RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES
+#define RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES 6  // Mesh.vboId slot of the index buffer
+#endif
+
+
+// Points chunk c's vertex array at an index buffer; with no vertex arrays
+// DrawMesh binds vboId[6] itself. The mesh only keeps 16-bit indices.
+static void bind_chunk_indices(TerrainChunks *chunks, int c, int level, unsigned edges) {
+    int si, sj;
+    terrain_chunk_shape(chunks, c, &si, &sj);
+    Mesh *mesh = &chunks->meshes[c];
+    mesh->indices = chunks->wideIndices ? NULL : chunks->indices[si][sj][level][edges];
+    mesh->triangleCount = chunks->triangles[si][sj][level][edges];
+    const int key = level * TERRAIN_LOD_EDGE_SETS + (int)edges;
+    if (chunks->bound[c] == key) return;
+    mesh->vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES] = chunks->indexBuffers[si][sj][level][edges];
+    if (rlEnableVertexArray(mesh->vaoId)) {
+        rlEnableVertexBufferElement(mesh->vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES]);
+        rlDisableVertexArray();
     }
+    chunks->bound[c] = key;
+}
 
-    char *filename = "heightmap.bin";
-    if(!heightmap_exists(filename)) {
-        save_heightmap(filename, heightmap, MONITOR_HEIGHT, MONITOR_WIDTH);
-        printf("Heightmap saved to %s\n", filename);
-    } else {
-        printf("Heightmap already exists at %s, skipping save.\n", filename);
+TerrainChunks CutTerrainChunks(const TerrainGrid *grid, size_t chunkQuads) {
+    TerrainChunks chunks = { 0 };
+    const long rings = (long)grid->rings, sides = (long)grid->sides;
+    if (chunkQuads == 0) {
+        printf("Invalid terrain chunk size: 0 quads\n");
+        exit(1);
     }
-    for (size_t i = 0; i < MONITOR_HEIGHT; i++) {
-        free(heightmap[i]);
+    // Even out the chunks along each axis, so at most the last is short.
+    chunks.chunksI = (grid->rings + chunkQuads - 1) / chunkQuads;
+    chunks.chunksJ = (grid->sides + chunkQuads - 1) / chunkQuads;
+    chunks.chunkRings = (grid->rings + chunks.chunksI - 1) / chunks.chunksI;
+    chunks.chunkSides = (grid->sides + chunks.chunksJ - 1) / chunks.chunksJ;
+    chunks.lastRings = grid->rings - (chunks.chunksI - 1) * chunks.chunkRings;
+    chunks.lastSides = grid->sides - (chunks.chunksJ - 1) * chunks.chunkSides;
+    chunks.wideIndices = (chunks.chunkRings + 1) * (chunks.chunkSides + 1) > 65536;
+    const size_t index_size = chunks.wideIndices ? sizeof(uint32_t) : sizeof(unsigned short);
+    chunks.count = (int)(chunks.chunksI * chunks.chunksJ);
+    chunks.meshes = MemAlloc(chunks.count * sizeof(Mesh));
+    chunks.bounds = MemAlloc(chunks.count * sizeof(BoundingBox));
+    chunks.bound = MemAlloc(chunks.count * sizeof(int));
+    chunks.lod = terrain_lod_create(chunks.chunksI, chunks.chunksJ, grid->embedding == TERRAIN_MESH_TORUS);
+    chunks.embedding = grid->embedding;
+    chunks.rings = grid->rings;
+    chunks.sides = grid->sides;
+    chunks.ringPeriod = grid->ringPeriod;
+    chunks.sidePeriod = grid->sidePeriod;
+    chunks.heightMin = grid->heightMin;
+    chunks.heightScale = grid->heightScale;
+
+    // Every level and stitching of each shape there is.
+    for (int si = 0; si < 2; si++) {
+        for (int sj = 0; sj < 2; sj++) {
+            if ((si && chunks.lastRings == chunks.chunkRings) || (sj && chunks.lastSides == chunks.chunkSides)) continue;
+            const size_t quads_i = si ? chunks.lastRings : chunks.chunkRings;
+            const size_t quads_j = sj ? chunks.lastSides : chunks.chunkSides;
+            const int levels = terrain_lod_levels(quads_i, quads_j);
+            for (int level = 0; level < levels; level++) {
+                for (unsigned edges = 0; edges < TERRAIN_LOD_EDGE_SETS; edges++) {
+                    const size_t count = terrain_lod_indices(quads_i, quads_j, level, edges, NULL);
+                    void *indices = MemAlloc(count * index_size);
+                    if (chunks.wideIndices) terrain_lod_indices32(quads_i, quads_j, level, edges, indices);
+                    else terrain_lod_indices(quads_i, quads_j, level, edges, indices);
+                    chunks.indices[si][sj][level][edges] = indices;
+                    chunks.triangles[si][sj][level][edges] = (int)(count / 3);
+                }
+            }
+        }
     }
-    free(heightmap);
-
 
-    for (size_t i = 0; i < rings; i++) {
-        size_t i1 = (i + 1) % rings;
-        for (size_t j = 0; j < sides; j++) {
-            size_t j1 = (j + 1) % sides;
-
-            Vector3 p00 = vertexGrid[i][j];
-            Vector3 p01 = vertexGrid[i][j1];
-            Vector3 p10 = vertexGrid[i1][j];
-            Vector3 p11 = vertexGrid[i1][j1];
-
-            // Triangle 1: p00, p01, p10
-            Vector3 edge1 = Vector3Subtract(p01, p00);
-            Vector3 edge2 = Vector3Subtract(p10, p00);
-            Vector3 n1 = Vector3Normalize(Vector3CrossProduct(edge1, edge2));
-
-            normalGrid[i][j] = Vector3Add(normalGrid[i][j], n1);
-            normalGrid[i][j1] = Vector3Add(normalGrid[i][j1], n1);
-            normalGrid[i1][j] = Vector3Add(normalGrid[i1][j], n1);
-
-            // Triangle 2: p10, p01, p11
-            Vector3 edge3 = Vector3Subtract(p01, p10);
-            Vector3 edge4 = Vector3Subtract(p11, p10);
-            Vector3 n2 = Vector3Normalize(Vector3CrossProduct(edge3, edge4));
-
-            normalGrid[i1][j] = Vector3Add(normalGrid[i1][j], n2);
-            normalGrid[i][j1] = Vector3Add(normalGrid[i][j1], n2);
-            normalGrid[i1][j1] = Vector3Add(normalGrid[i1][j1], n2);
+    const Vector3 *vertices = (const Vector3 *)grid->vertices;
+    const Vector3 *normals = (const Vector3 *)grid->normals;
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < chunks.count; c++) {
+        int si, sj;
+        terrain_chunk_shape(&chunks, c, &si, &sj);
+        const long quads_i = si ? chunks.lastRings : chunks.chunkRings;
+        const long quads_j = sj ? chunks.lastSides : chunks.chunkSides;
+        const long i0 = c / chunks.chunksJ * chunks.chunkRings, j0 = c % chunks.chunksJ * chunks.chunkSides;
+
+        // Every chunk closes up to the next one, the last ones across the
+        // seams, so the torus's wrap and the flat world's repeat both show.
+        Mesh *mesh = &chunks.meshes[c];
+        mesh->vertexCount = (quads_i + 1) * (quads_j + 1);
+        Vector3 *v = MemAlloc(mesh->vertexCount * sizeof(Vector3));
+        Vector3 *n = MemAlloc(mesh->vertexCount * sizeof(Vector3));
+        Vector2 *t = MemAlloc(mesh->vertexCount * sizeof(Vector2));
+        BoundingBox box = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+        for (long i = 0; i <= quads_i; i++) {
+            for (long j = 0; j <= quads_j; j++) {
+                const long gi = i0 + i, gj = j0 + j;
+                const size_t k = i * (quads_j + 1) + j;
+                v[k] = grid_vertex(vertices, rings, sides, gi, gj, grid->ringPeriod, grid->sidePeriod);
+                n[k] = normals[(gi % rings) * sides + gj % sides];
+                t[k] = (Vector2){ (float)gj / sides, (float)gi / rings };
+                box.min = Vector3Min(box.min, v[k]);
+                box.max = Vector3Max(box.max, v[k]);
+            }
         }
+        mesh->vertices = (float *)v;
+        mesh->normals = (float *)n;
+        mesh->texcoords = (float *)t;
+        chunks.bounds[c] = box;
+        terrain_lod_set_chunk(chunks.lod, c, mesh->vertices, quads_i, quads_j,
+                              (const float[3]){ box.min.x, box.min.y, box.min.z },
+                              (const float[3]){ box.max.x, box.max.y, box.max.z });
     }
+    return chunks;
+}
 
-    // 3. Generate indices (each quad = 2 triangles = 6 indices)
-    int indexCount = rings * sides * 6;
-    unsigned short *indices = MemAlloc(indexCount * sizeof(unsigned short)); // Use uint16 for Raylib
-    size_t k = 0;
-    for (size_t i = 0; i < rings; i++) {
-        size_t i1 = (i + 1) % rings;
-        for (size_t j = 0; j < sides; j++) {
-            size_t j1 = (j + 1) % sides;
-
-            int v00 = i * sides + j;
-            int v01 = i * sides + j1;
-            int v10 = i1 * sides + j;
-            int v11 = i1 * sides + j1;
-
-            // Triangle 1
-            indices[k++] = v00;
-            indices[k++] = v01;
-            indices[k++] = v10;
-
-            // Triangle 2
-            indices[k++] = v10;
-            indices[k++] = v01;
-            indices[k++] = v11;
+void UploadTerrainChunks(TerrainChunks *chunks) {
+    const size_t index_size = chunks->wideIndices ? sizeof(uint32_t) : sizeof(unsigned short);
+    // Upload each index array once; chunks switch between them as their
+    // level changes.
+    for (int si = 0; si < 2; si++) {
+        for (int sj = 0; sj < 2; sj++) {
+            for (int level = 0; level < TERRAIN_LOD_MAX_LEVELS; level++) {
+                for (unsigned edges = 0; edges < TERRAIN_LOD_EDGE_SETS; edges++) {
+                    if (!chunks->indices[si][sj][level][edges]) continue;
+                    chunks->indexBuffers[si][sj][level][edges] = rlLoadVertexBufferElement(
+                        chunks->indices[si][sj][level][edges],
+                        chunks->triangles[si][sj][level][edges] * 3 * (int)index_size, false);
+                }
+            }
         }
     }
-
-    int vertexCount = rings * sides;
-    Vector3 *flatVertices = MemAlloc(vertexCount * sizeof(Vector3));
-    Vector3 *flatNormals = MemAlloc(vertexCount * sizeof(Vector3));
-    Vector2 *texcoords = MemAlloc(vertexCount * sizeof(Vector2));
-
-    for (size_t i = 0; i < rings; i++) {
-        for (size_t j = 0; j < sides; j++) {
-            size_t idx = i * sides + j;
-            flatVertices[idx] = vertexGrid[i][j];
-            flatNormals[idx] = Vector3Normalize(normalGrid[i][j]);
-            texcoords[idx] = (Vector2){ (float)j / sides, (float)i / rings };
+    for (int c = 0; c < chunks->count; c++) {
+        Mesh *mesh = &chunks->meshes[c];
+        UploadMesh(mesh, true);  // no indices yet, so no copy of them is uploaded
+        if (chunks->wideIndices && !mesh->vaoId) {
+            printf("Terrain chunks of %zu x %zu quads need 32-bit indices, which need vertex arrays\n",
+                   chunks->chunkRings, chunks->chunkSides);
+            exit(1);
         }
+        chunks->bound[c] = -1;
+        bind_chunk_indices(chunks, c, 0, 0);
     }
+}
 
+TerrainChunks GenTerrainChunks(const TerrainGrid *grid, size_t chunkQuads) {
+    double t0 = omp_get_wtime();
+    TerrainChunks chunks = CutTerrainChunks(grid, chunkQuads);
+    double t1 = omp_get_wtime();
+    UploadTerrainChunks(&chunks);
+    if (terrain_debug_export())
+        printf("Terrain chunks: %d of %zu x %zu quads, %d triangles; cut %.2f ms, upload %.2f ms\n", chunks.count,
+               chunks.chunkRings, chunks.chunkSides, (int)(grid->rings * grid->sides * 2), (t1 - t0) * 1e3,
+               (omp_get_wtime() - t1) * 1e3);
+    return chunks;
+}
 
+// Cache key of terrain chunks: the heightmap they sample, the embedding,
+// grid and chunk size, the torus radii and how they sampled the heightmap.
+static uint64_t chunk_cache_key(TerrainMeshEmbedding embedding, size_t rings, size_t sides, size_t chunkQuads) {
+    const uint64_t grid[3] = { rings, sides, chunkQuads };
+    const int32_t kind[2] = { embedding, terrain_filter };
+    const float radii[2] = { R, r };
+    const uint8_t normals[2] = { terrain_analytic_normals && heightmap_has_gradient(), terrain_filter_normals };
+    uint64_t key = cache_key(terrain_cache_key(), &terrain_mesh_version, sizeof(terrain_mesh_version));
+    key = cache_key(key, kind, sizeof(kind));
+    key = cache_key(key, grid, sizeof(grid));
+    key = cache_key(key, radii, sizeof(radii));
+    return cache_key(key, normals, sizeof(normals));
+}
 
-    Mesh mesh = { 0 };
-    mesh.vertexCount = vertexCount;
-    mesh.triangleCount = indexCount / 3;
-    mesh.vertices = (float *)flatVertices;
-    mesh.normals = (float *)flatNormals;
-    mesh.texcoords = (float *)texcoords;
-    mesh.indices = (unsigned short *)indices;
+TerrainChunks CutHeightmapChunks(const Heightmap *heightmap, TerrainMeshEmbedding embedding, size_t chunkQuads) {
+    const TerrainConfig *config = terrain_config();
+    // The heightmap's key only describes the full map.
+    const bool cached = heightmap->width == config->width && heightmap->height == config->height;
+    const uint64_t key = chunk_cache_key(embedding, heightmap->width, heightmap->height, chunkQuads);
+    char filename[64];
+    cache_filename(filename, sizeof(filename), "chunks", key);
+    TerrainChunks chunks;
+    if (cached && load_terrain_chunks(filename, key, &chunks)) return chunks;
+
+    TerrainGrid grid = embedding == TERRAIN_MESH_TORUS ? GenTorusGrid(heightmap, heightmap->width, heightmap->height)
+                                                       : GenFlatTorusGrid(heightmap, heightmap->width, heightmap->height);
+    chunks = CutTerrainChunks(&grid, chunkQuads);
+    UnloadTerrainGrid(&grid);
+    if (cached) save_terrain_chunks_async(filename, &chunks, key);
+    return chunks;
+}
 
-    UploadMesh(&mesh, false);
-    return mesh;
+TerrainChunks LoadTerrainChunks(const Heightmap *heightmap, TerrainMeshEmbedding embedding, size_t chunkQuads) {
+    TerrainChunks chunks = CutHeightmapChunks(heightmap, embedding, chunkQuads);
+    UploadTerrainChunks(&chunks);
+    return chunks;
 }
 
-Mesh MyGenFlatTorusMesh(size_t rings, size_t sides) {
-    unsigned char **image = malloc(MONITOR_HEIGHT * sizeof(unsigned char *));
-    if (!image) {
-        perror("malloc failed");
-        exit(1);
+void UnloadTerrainChunks(TerrainChunks *chunks) {
+    for (int c = 0; c < chunks->count; c++) {
+        // The shared index arrays and buffers go once, below.
+        chunks->meshes[c].indices = NULL;
+        if (chunks->meshes[c].vboId) chunks->meshes[c].vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES] = 0;
+        UnloadMesh(chunks->meshes[c]);
     }
-
-    for (size_t y = 0; y < MONITOR_HEIGHT; y++) {
-        image[y] = malloc(MONITOR_WIDTH * sizeof(unsigned char));
-        if (!image[y]) {
-            perror("malloc failed");
-            exit(1);
+    for (int si = 0; si < 2; si++) {
+        for (int sj = 0; sj < 2; sj++) {
+            for (int level = 0; level < TERRAIN_LOD_MAX_LEVELS; level++) {
+                for (unsigned edges = 0; edges < TERRAIN_LOD_EDGE_SETS; edges++) {
+                    if (chunks->indexBuffers[si][sj][level][edges]) {
+                        rlUnloadVertexBuffer(chunks->indexBuffers[si][sj][level][edges]);
+                    }
+                    MemFree(chunks->indices[si][sj][level][edges]);
+                }
+            }
         }
     }
+    MemFree(chunks->meshes);
+    MemFree(chunks->bounds);
+    MemFree(chunks->bound);
+    terrain_lod_destroy(chunks->lod);
+    *chunks = (TerrainChunks){ 0 };
+}
 
-    float **heightmap = get_heightmap("heightmap.bin");
-
-    float min = FLT_MIN;
-    float max = -FLT_MAX;
-    for (size_t v = 0; v < MONITOR_HEIGHT; v++) {
-        for (size_t u = 0; u < MONITOR_WIDTH; u++) {
-            float height = heightmap[v][u];
-            assert(height >= 0.0f && height <= 1.0f); // Ensure noise is in [0, 1]
-            if (height < min) min = height;
-            if (height > max) max = height;
-            image[v][u] = (unsigned char)(height * 255.0f);
-        }
+int UpdateTerrainLod(TerrainChunks *chunks, Vector3 eye, float fovy, int screenHeight, float max_error_pixels) {
+    if (!chunks->lod) return 0;
+    const float projection_scale = screenHeight / (2.0f * tanf(DEG2RAD * fovy / 2.0f));
+    terrain_lod_select(chunks->lod, (const float[3]){ eye.x, eye.y, eye.z }, projection_scale, max_error_pixels);
+    int triangles = 0;
+    for (int c = 0; c < chunks->count; c++) {
+        bind_chunk_indices(chunks, c, chunks->lod->level[c], chunks->lod->edges[c]);
+        triangles += chunks->meshes[c].triangleCount;
     }
-    printf("Heightmap min: %f, max: %f\n", min, max);
+    return triangles;
+}
 
-    FILE *f = fopen("heightmap.pgm", "wb");
-    if (!f) {
-        perror("Cannot write image");
-        exit(1);
+// DrawMesh with an identity transform, for a chunk with 32-bit indices,
+// which DrawMesh would draw as 16-bit ones: the same uniforms and textures,
+// then the chunk's vertex array drawn with the indices bound to it.
+static void draw_wide_chunk(const Mesh *mesh, Material material) {
+    const int *locs = material.shader.locs;
+    rlEnableShader(material.shader.id);
+    if (locs[SHADER_LOC_COLOR_DIFFUSE] != -1) {
+        const Color color = material.maps[MATERIAL_MAP_DIFFUSE].color;
+        const float values[4] = { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
+        rlSetUniform(locs[SHADER_LOC_COLOR_DIFFUSE], values, SHADER_UNIFORM_VEC4, 1);
     }
-
-    fprintf(f, "P5\n%zu %zu\n255\n", MONITOR_WIDTH, MONITOR_HEIGHT);  // P5 = binary greyscale
-    for (size_t y = 0; y < MONITOR_HEIGHT; y++) {
-        if (fwrite(image[y], sizeof(unsigned char), MONITOR_WIDTH, f) != MONITOR_WIDTH) {
-            perror("Error writing image data");
-            fclose(f);
-            exit(1);
-        }
+    if (locs[SHADER_LOC_COLOR_SPECULAR] != -1) {
+        const Color color = material.maps[MATERIAL_MAP_SPECULAR].color;
+        const float values[4] = { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
+        rlSetUniform(locs[SHADER_LOC_COLOR_SPECULAR], values, SHADER_UNIFORM_VEC4, 1);
     }
-    fclose(f);
-
-    printf("Heightmap written to heightmap_T.pgm\n");
-
-    // Free the image memory
-    for (size_t y = 0; y < MONITOR_HEIGHT; y++) {
-        free(image[y]);
+    const Matrix view = rlGetMatrixModelview(), projection = rlGetMatrixProjection();
+    const Matrix model = rlGetMatrixTransform();
+    if (locs[SHADER_LOC_MATRIX_VIEW] != -1) rlSetUniformMatrix(locs[SHADER_LOC_MATRIX_VIEW], view);
+    if (locs[SHADER_LOC_MATRIX_PROJECTION] != -1) rlSetUniformMatrix(locs[SHADER_LOC_MATRIX_PROJECTION], projection);
+    if (locs[SHADER_LOC_MATRIX_MODEL] != -1) rlSetUniformMatrix(locs[SHADER_LOC_MATRIX_MODEL], MatrixIdentity());
+    if (locs[SHADER_LOC_MATRIX_NORMAL] != -1) {
+        rlSetUniformMatrix(locs[SHADER_LOC_MATRIX_NORMAL], MatrixTranspose(MatrixInvert(model)));
     }
-    free(image);
-
-    // 1. Allocate vertex and normal grids
-    Vector3 **vertexGrid = MemAlloc(rings * sizeof(Vector3 *));
-    Vector3 **normalGrid = MemAlloc(rings * sizeof(Vector3 *));
-    for (size_t i = 0; i < rings; i++) {
-        vertexGrid[i] = MemAlloc(sides * sizeof(Vector3));
-        normalGrid[i] = MemAlloc(sides * sizeof(Vector3));
-        for (size_t j = 0; j < sides; j++) {
-            normalGrid[i][j] = (Vector3){0.0f, 0.0f, 0.0f};
+    for (int i = 0; i <= MATERIAL_MAP_BRDF; i++) {
+        if (material.maps[i].texture.id == 0) continue;
+        rlActiveTextureSlot(i);
+        if (i == MATERIAL_MAP_IRRADIANCE || i == MATERIAL_MAP_PREFILTER || i == MATERIAL_MAP_CUBEMAP) {
+            rlEnableTextureCubemap(material.maps[i].texture.id);
+        } else {
+            rlEnableTexture(material.maps[i].texture.id);
         }
+        rlSetUniform(locs[SHADER_LOC_MAP_DIFFUSE + i], &i, SHADER_UNIFORM_INT, 1);
     }
+    rlSetUniformMatrix(locs[SHADER_LOC_MATRIX_MVP], MatrixMultiply(MatrixMultiply(model, view), projection));
+
+    rlEnableVertexArray(mesh->vaoId);
+    glDrawElements(GL_TRIANGLES, mesh->triangleCount * 3, GL_UNSIGNED_INT, 0);
+    rlDisableVertexArray();
+
+    for (int i = 0; i <= MATERIAL_MAP_BRDF; i++) {
+        if (material.maps[i].texture.id == 0) continue;
+        rlActiveTextureSlot(i);
+        if (i == MATERIAL_MAP_IRRADIANCE || i == MATERIAL_MAP_PREFILTER || i == MATERIAL_MAP_CUBEMAP) {
+            rlDisableTextureCubemap();
+        } else {
+            rlDisableTexture();
+        }
+    }
+    rlDisableShader();
+}
 
-    // 2. Fill vertexGrid with positions (and optionally sample height)
-    float upper_bound = 50.0f;
-    float lower_bound = 0.0f;
-    float gradient = (upper_bound - lower_bound) / (max - min);
-    printf("Gradient: %f\n", gradient);
-    for (size_t i = 0; i < rings; i++) {
-        float theta = (float)i / rings * 2.0f * PI;
-        for (size_t j = 0; j < sides; j++) {
-            float phi = (float)j / sides * 2.0f * PI;
-
-            float x = HALF_MONITOR_HEIGHT - phi * r;
-            float z = R * theta - HALF_MONITOR_WIDTH;
+void DrawTerrainChunk(const TerrainChunks *chunks, int c, Material material) {
+    if (chunks->wideIndices) draw_wide_chunk(&chunks->meshes[c], material);
+    else DrawMesh(chunks->meshes[c], material, MatrixIdentity());
+}
 
-            int sx = WRAP_MOD((int)(z + HALF_MONITOR_WIDTH), MONITOR_WIDTH);
-            int sy = WRAP_MOD((int)(HALF_MONITOR_HEIGHT - x), MONITOR_HEIGHT);
+HeightmapRect DeformFlatTorusHeightmap(Heightmap *heightmap, HeightmapBrush brush, Vector3 center, float radius,
+                                       float amount) {
+    // The inverse of the flat positions: z runs along the heightmap's
+    // columns and x back up its rows.
+    const TerrainConfig *config = terrain_config();
+    float u = (center.z + config->world_width / 2.0f) / config->world_width * heightmap->width;
+    float v = (config->world_height / 2.0f - center.x) / config->world_height * heightmap->height;
+    u = fmodf(u, (float)heightmap->width);
+    v = fmodf(v, (float)heightmap->height);
+    if (u < 0.0f) u += heightmap->width;
+    if (v < 0.0f) v += heightmap->height;
+    const float scale = TERRAIN_FLAT_HEIGHT / (heightmap->max - heightmap->min);
+    return heightmap_stamp(heightmap, brush, u, v, radius / config->world_width * heightmap->width,
+                           radius / config->world_height * heightmap->height, amount / scale);
+}
 
-            float height = heightmap[sy][sx];
-            float adjusted_height = lower_bound + (height - min) * gradient;
 
-            vertexGrid[i][j] = (Vector3){ x, adjusted_height, z };
+// Floor and ceiling of a / b, for b > 0 and a of either sign.
+static inline long floor_div(long a, long b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+static inline long ceil_div(long a, long b) { return -floor_div(-a, b); }
+
+// Vertices first to last of chunk `chunk` along one axis, the copies of
+// unwrapped grid vertices from `vertex` on.
+typedef struct ChunkRun {
+    long chunk, first, last, vertex;
+} ChunkRun;
+
+// The runs of the chunks along an axis of n quads, count chunks of size
+// quads, that hold any of unwrapped vertices lo to hi, or a copy of one a
+// period away: a chunk holds its vertices k size to k size + its quads.
+static int chunk_runs(long lo, long hi, long n, long size, long count, ChunkRun *runs) {
+    int m = 0;
+    for (long shift = -n; shift <= n; shift += n) {
+        const long a = lo + shift < 0 ? 0 : lo + shift, b = hi + shift > n ? n : hi + shift;
+        if (a > b) continue;
+        const long k0 = a == 0 ? 0 : (a - 1) / size, k1 = b / size < count - 1 ? b / size : count - 1;
+        for (long k = k0; k <= k1; k++) {
+            const long start = k * size, end = k + 1 == count ? n : start + size;
+            const long first = a > start ? a : start, last = b < end ? b : end;
+            if (first <= last) runs[m++] = (ChunkRun){ k, first - start, last - start, first - shift };
         }
     }
+    return m;
+}
 
-    char *filename = "heightmap.bin";
-    if(!heightmap_exists(filename)) {
-        save_heightmap(filename, heightmap, MONITOR_HEIGHT, MONITOR_WIDTH);
-        printf("Heightmap saved to %s\n", filename);
-    } else {
-        printf("Heightmap already exists at %s, skipping save.\n", filename);
-    }
-    for (size_t i = 0; i < MONITOR_HEIGHT; i++) {
-        free(heightmap[i]);
-    }
-    free(heightmap);
+// Corner (di, dj) of the quad at patch vertex (a, b), which wraps to grid
+// vertex (wi, wj), moved as grid_vertex moves it.
+static inline Vector3 patch_corner(const TerrainChunks *chunks, const Vector3 *base, long ph, long a, long b,
+                                   long wi, long wj, long di, long dj) {
+    long i = wi + di, j = wj + dj;
+    const Vector3 offset = grid_offset((long)chunks->rings, (long)chunks->sides, &i, &j, chunks->ringPeriod,
+                                       chunks->sidePeriod);
+    return Vector3Add(base[(a + di) * ph + b + dj], offset);
+}
 
-    for (size_t i = 0; i < rings; i++) {
-        size_t i1 = (i + 1) % rings;
-        for (size_t j = 0; j < sides; j++) {
-            size_t j1 = (j + 1) % sides;
-
-            Vector3 p00 = vertexGrid[i][j];
-            Vector3 p01 = vertexGrid[i][j1];
-            Vector3 p10 = vertexGrid[i1][j];
-            Vector3 p11 = vertexGrid[i1][j1];
-
-            // Triangle 1: p00, p01, p10
-            Vector3 edge1 = Vector3Subtract(p01, p00);
-            Vector3 edge2 = Vector3Subtract(p10, p00);
-            Vector3 n1 = Vector3Normalize(Vector3CrossProduct(edge1, edge2));
-
-            normalGrid[i][j] = Vector3Add(normalGrid[i][j], n1);
-            normalGrid[i][j1] = Vector3Add(normalGrid[i][j1], n1);
-            normalGrid[i1][j] = Vector3Add(normalGrid[i1][j], n1);
-
-            // Triangle 2: p10, p01, p11
-            Vector3 edge3 = Vector3Subtract(p01, p10);
-            Vector3 edge4 = Vector3Subtract(p11, p10);
-            Vector3 n2 = Vector3Normalize(Vector3CrossProduct(edge3, edge4));
-
-            normalGrid[i1][j] = Vector3Add(normalGrid[i1][j], n2);
-            normalGrid[i][j1] = Vector3Add(normalGrid[i][j1], n2);
-            normalGrid[i1][j1] = Vector3Add(normalGrid[i1][j1], n2);
+/*
+ * Works on a patch of the grid around the change: every vertex whose height
+ * the filter takes from a changed sample, plus two all round, since a
+ * vertex's normal sums the faces of the quads around it. Each patch vertex
+ * is built as build_terrain_grid builds the vertex it wraps to, and each
+ * face and normal from the same neighbours, so an edited chunk matches a
+ * chunk cut from a grid built over the edited map.
+ */
+int UpdateTerrainChunks(TerrainChunks *chunks, const Heightmap *heightmap, HeightmapRect changed, int *touched) {
+    if (!chunks->count || changed.x1 < changed.x0 || changed.y1 < changed.y0) return 0;
+    const TerrainConfig *config = terrain_config();
+    const bool torus = chunks->embedding == TERRAIN_MESH_TORUS;
+    const long rings = (long)chunks->rings, sides = (long)chunks->sides;
+    const long width = (long)heightmap->width, height = (long)heightmap->height;
+
+    // Vertices within the filter's reach of a changed sample, ring i at
+    // sample i / rings of the width.
+    const long reach = terrain_filter == HEIGHTMAP_FILTER_BICUBIC ? 2 : 1;
+    long i0 = floor_div((changed.x0 - reach) * rings, width), j0 = floor_div((changed.y0 - reach) * sides, height);
+    long i1 = ceil_div((changed.x1 + reach) * rings, width), j1 = ceil_div((changed.y1 + reach) * sides, height);
+    if (i1 - i0 >= rings) i1 = i0 + rings - 1;
+    if (j1 - j0 >= sides) j1 = j0 + sides - 1;
+    // Start within the first period, so chunk_runs finds every copy.
+    const long wrap_i = floor_div(i0, rings) * rings, wrap_j = floor_div(j0, sides) * sides;
+    i0 -= wrap_i;
+    i1 -= wrap_i;
+    j0 -= wrap_j;
+    j1 -= wrap_j;
+    const long pi0 = i0 - 2, pj0 = j0 - 2, pw = i1 - i0 + 5, ph = j1 - j0 + 5;
+
+    // Positions of the vertices the patch wraps to, as stage 2 places them.
+    Vector3 *base = MemAlloc(pw * ph * sizeof(Vector3));
+    Vector3 *normals = MemAlloc(pw * ph * sizeof(Vector3));
+    Vector3 *faces = MemAlloc(2 * pw * ph * sizeof(Vector3));
+    #pragma omp parallel for schedule(static) if (pw * ph >= 16384)
+    for (long a = 0; a < pw; a++) {
+        const long wi = ((pi0 + a) % rings + rings) % rings;
+        const float theta = (float)wi / rings * 2.0f * PI;
+        const float su = (float)wi / rings * heightmap->width;
+        for (long b = 0; b < ph; b++) {
+            const long wj = ((pj0 + b) % sides + sides) % sides;
+            const float phi = (float)wj / sides * 2.0f * PI;
+            const float sv = (float)wj / sides * heightmap->height;
+            const float h = heightmap_sample(heightmap, terrain_filter, su, sv);
+            base[a * ph + b] = grid_position(torus, theta, phi, (h - chunks->heightMin) * chunks->heightScale);
         }
     }
 
-    // 3. Generate indices (each quad = 2 triangles = 6 indices)
-    int indexCount = rings * sides * 6;
-    unsigned short *indices = MemAlloc(indexCount * sizeof(unsigned short)); // Use uint16 for Raylib
-    size_t k = 0;
-    for (size_t i = 0; i < rings - 1; i++) {
-        size_t i1 = i + 1;
-        for (size_t j = 0; j < sides - 1; j++) {
-            size_t j1 = j + 1;
-
-            int v00 = i * sides + j;
-            int v01 = i * sides + j1;
-            int v10 = i1 * sides + j;
-            int v11 = i1 * sides + j1;
-
-            // Triangle 1
-            indices[k++] = v00;
-            indices[k++] = v01;
-            indices[k++] = v10;
-
-            // Triangle 2
-            indices[k++] = v10;
-            indices[k++] = v01;
-            indices[k++] = v11;
+    // Normals of the changed vertices and one more all round. heightmap_gradient
+    // knows nothing of edits, so analytic normals fall back to the filter's.
+    const bool smooth_normals = !torus && (terrain_filter_normals ||
+                                           (terrain_analytic_normals && heightmap_has_gradient()));
+    if (smooth_normals) {
+        const float sample_u = heightmap->width / config->world_width;
+        const float sample_v = heightmap->height / config->world_height;
+        for (long a = 1; a < pw - 1; a++) {
+            const long wi = ((pi0 + a) % rings + rings) % rings;
+            for (long b = 1; b < ph - 1; b++) {
+                const long wj = ((pj0 + b) % sides + sides) % sides;
+                float dh_du, dh_dv;
+                heightmap_sample_grad(heightmap, terrain_filter, (float)wi / rings * heightmap->width,
+                                      (float)wj / sides * heightmap->height, &dh_du, &dh_dv);
+                normals[a * ph + b] = Vector3Normalize((Vector3){ chunks->heightScale * dh_dv * sample_v, 1.0f,
+                                                                  -chunks->heightScale * dh_du * sample_u });
+            }
+        }
+    } else {
+        // The quad each vertex wraps to, as stage 3 takes it.
+        for (long a = 0; a < pw - 1; a++) {
+            const long wi = ((pi0 + a) % rings + rings) % rings;
+            for (long b = 0; b < ph - 1; b++) {
+                const long wj = ((pj0 + b) % sides + sides) % sides;
+                const Vector3 p01 = patch_corner(chunks, base, ph, a, b, wi, wj, 0, 1);
+                const Vector3 p10 = patch_corner(chunks, base, ph, a, b, wi, wj, 1, 0);
+                const Vector3 p11 = patch_corner(chunks, base, ph, a, b, wi, wj, 1, 1);
+                faces[2 * (a * ph + b)] = face_normal(base[a * ph + b], p01, p10);
+                faces[2 * (a * ph + b) + 1] = face_normal(p10, p01, p11);
+            }
+        }
+        for (long a = 1; a < pw - 1; a++) {
+            for (long b = 1; b < ph - 1; b++) {
+                Vector3 n = faces[2 * (a * ph + b)];
+                n = Vector3Add(n, faces[2 * (a * ph + b - 1)]);
+                n = Vector3Add(n, faces[2 * (a * ph + b - 1) + 1]);
+                n = Vector3Add(n, faces[2 * ((a - 1) * ph + b)]);
+                n = Vector3Add(n, faces[2 * ((a - 1) * ph + b) + 1]);
+                n = Vector3Add(n, faces[2 * ((a - 1) * ph + b - 1) + 1]);
+                normals[a * ph + b] = Vector3Normalize(n);
+            }
         }
     }
 
-    int vertexCount = rings * sides;
-    Vector3 *flatVertices = MemAlloc(vertexCount * sizeof(Vector3));
-    Vector3 *flatNormals = MemAlloc(vertexCount * sizeof(Vector3));
-    Vector2 *texcoords = MemAlloc(vertexCount * sizeof(Vector2));
+    // Every copy of the patch's inner vertices in the chunks: the rows and
+    // columns of chunks reaching them, and the copies across the seams.
+    ChunkRun *runsI = MemAlloc(3 * chunks->chunksI * sizeof(ChunkRun));
+    ChunkRun *runsJ = MemAlloc(3 * chunks->chunksJ * sizeof(ChunkRun));
+    const int ni = chunk_runs(i0 - 1, i1 + 1, rings, (long)chunks->chunkRings, (long)chunks->chunksI, runsI);
+    const int nj = chunk_runs(j0 - 1, j1 + 1, sides, (long)chunks->chunkSides, (long)chunks->chunksJ, runsJ);
+    long *rowsLo = MemAlloc(ni * nj * sizeof(long)), *rowsHi = MemAlloc(ni * nj * sizeof(long));
+    int count = 0;
+    for (int ri = 0; ri < ni; ri++) {
+        const ChunkRun *run_i = &runsI[ri];
+        const long gi0 = run_i->chunk * (long)chunks->chunkRings;
+        for (int rj = 0; rj < nj; rj++) {
+            const ChunkRun *run_j = &runsJ[rj];
+            const long gj0 = run_j->chunk * (long)chunks->chunkSides;
+            const int c = (int)(run_i->chunk * (long)chunks->chunksJ + run_j->chunk);
+            const long stride = (run_j->chunk + 1 == (long)chunks->chunksJ ? (long)chunks->lastSides
+                                                                          : (long)chunks->chunkSides) + 1;
+            Vector3 *v = (Vector3 *)chunks->meshes[c].vertices, *n = (Vector3 *)chunks->meshes[c].normals;
+            for (long li = run_i->first; li <= run_i->last; li++) {
+                const long a = run_i->vertex + li - run_i->first - pi0;
+                for (long lj = run_j->first; lj <= run_j->last; lj++) {
+                    const long b = run_j->vertex + lj - run_j->first - pj0;
+                    // As GenTerrainChunks takes it from the grid.
+                    long i = gi0 + li, j = gj0 + lj;
+                    const Vector3 offset = grid_offset(rings, sides, &i, &j, chunks->ringPeriod, chunks->sidePeriod);
+                    v[li * stride + lj] = Vector3Add(base[a * ph + b], offset);
+                    n[li * stride + lj] = normals[a * ph + b];
+                }
+            }
+            int t = 0;
+            while (t < count && touched[t] != c) t++;
+            if (t == count) {
+                touched[count++] = c;
+                rowsLo[t] = run_i->first;
+                rowsHi[t] = run_i->last;
+            }
+            if (run_i->first < rowsLo[t]) rowsLo[t] = run_i->first;
+            if (run_i->last > rowsHi[t]) rowsHi[t] = run_i->last;
+        }
+    }
 
-    for (size_t i = 0; i < rings; i++) {
-        for (size_t j = 0; j < sides; j++) {
-            size_t idx = i * sides + j;
-            flatVertices[idx] = vertexGrid[i][j];
-            flatNormals[idx] = Vector3Normalize(normalGrid[i][j]);
-            texcoords[idx] = (Vector2){ (float)j / sides, (float)i / rings };
+    for (int t = 0; t < count; t++) {
+        const int c = touched[t];
+        int si, sj;
+        terrain_chunk_shape(chunks, c, &si, &sj);
+        const size_t quads_i = si ? chunks->lastRings : chunks->chunkRings;
+        const size_t quads_j = sj ? chunks->lastSides : chunks->chunkSides;
+        Mesh *mesh = &chunks->meshes[c];
+        // Rows are contiguous, so the changed rows go up in one piece.
+        const size_t row = (quads_j + 1) * 3, first = (size_t)rowsLo[t] * row;
+        const int size = (int)((rowsHi[t] - rowsLo[t] + 1) * row * sizeof(float));
+        UpdateMeshBuffer(*mesh, 0, mesh->vertices + first, size, (int)(first * sizeof(float)));
+        UpdateMeshBuffer(*mesh, 2, mesh->normals + first, size, (int)(first * sizeof(float)));
+        // A crater can lower the floor of the box as well as raise it.
+        BoundingBox box = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+        const Vector3 *v = (const Vector3 *)mesh->vertices;
+        for (int k = 0; k < mesh->vertexCount; k++) {
+            box.min = Vector3Min(box.min, v[k]);
+            box.max = Vector3Max(box.max, v[k]);
         }
+        chunks->bounds[c] = box;
+        terrain_lod_set_chunk(chunks->lod, c, mesh->vertices, quads_i, quads_j,
+                              (const float[3]){ box.min.x, box.min.y, box.min.z },
+                              (const float[3]){ box.max.x, box.max.y, box.max.z });
     }
 
-    Mesh mesh = { 0 };
-    mesh.vertexCount = vertexCount;
-    mesh.triangleCount = indexCount / 3;
-    mesh.vertices = (float *)flatVertices;
-    mesh.normals = (float *)flatNormals;
-    mesh.texcoords = (float *)texcoords;
-    mesh.indices = (unsigned short *)indices;
+    MemFree(base);
+    MemFree(normals);
+    MemFree(faces);
+    MemFree(runsI);
+    MemFree(runsJ);
+    MemFree(rowsLo);
+    MemFree(rowsHi);
+    return count;
+}
 
-    UploadMesh(&mesh, false);
+Mesh TerrainChunkCollisionMesh(const TerrainChunks *chunks, int c, const uint32_t **wide) {
+    int si, sj;
+    terrain_chunk_shape(chunks, c, &si, &sj);
+    Mesh mesh = chunks->meshes[c];
+    mesh.indices = chunks->wideIndices ? NULL : chunks->indices[si][sj][0][0];
+    mesh.triangleCount = chunks->triangles[si][sj][0][0];
+    *wide = chunks->wideIndices ? chunks->indices[si][sj][0][0] : NULL;
     return mesh;
 }
 
 
 
 float get_theta(float u) {
-        return 2 * PI * u / MONITOR_WIDTH;
+        return 2 * PI * u / terrain_config()->world_width;
 }
 
 float get_phi(float v) {
-        return 2 * PI * v / MONITOR_HEIGHT;
+        return 2 * PI * v / terrain_config()->world_height;
 }
 
 Vector3 get_torus_normal(float u, float v) {
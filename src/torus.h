@@ -5,20 +5,128 @@
 #include "raymath.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "heightmap.h"
+#include "terrain.h"
+#include "terrain_lod.h"
 
 extern size_t SCREEN_WIDTH;
 extern size_t SCREEN_HEIGHT;
 extern float HALF_SCREEN_WIDTH;
 extern float HALF_SCREEN_HEIGHT;
 
-extern size_t MONITOR_WIDTH;
-extern size_t MONITOR_HEIGHT;
-extern float HALF_MONITOR_WIDTH;
-extern float HALF_MONITOR_HEIGHT;
-
 void SetTorusDimensions(float major, float minor);
-Mesh MyGenTorusMesh(size_t rings, size_t sides);
-Mesh MyGenFlatTorusMesh(size_t rings, size_t sides);
+
+typedef enum { TERRAIN_MESH_FLAT, TERRAIN_MESH_TORUS } TerrainMeshEmbedding;
+
+// The terrain's vertices on the CPU, rings x sides of them on the torus or
+// the flat world it unrolls to, for GenTerrainChunks to cut up; it is not
+// bound by the 65536 vertices a raylib Mesh can index. Each ring is `sides`
+// vertices. A vertex past the edge is the vertex it wraps to, moved by
+// ringPeriod or sidePeriod (zero on the torus, which closes up). A height h
+// of the heightmap stands (h - heightMin) * heightScale above the surface.
+typedef struct TerrainGrid {
+    TerrainMeshEmbedding embedding;
+    size_t rings, sides;
+    int vertexCount;
+    float *vertices, *normals, *texcoords;
+    Vector3 ringPeriod, sidePeriod;
+    float heightMin, heightScale;
+} TerrainGrid;
+
+// The one grid builder, with either embedding.
+TerrainGrid GenFlatTorusGrid(const Heightmap *heightmap, size_t rings, size_t sides);
+TerrainGrid GenTorusGrid(const Heightmap *heightmap, size_t rings, size_t sides);
+// The same from a map kept resident as 16-bit codes: the grid of
+// heightmap_dequantize(q), without the float copy.
+TerrainGrid GenFlatTorusGridQ16(const HeightmapQ16 *q, size_t rings, size_t sides);
+TerrainGrid GenTorusGridQ16(const HeightmapQ16 *q, size_t rings, size_t sides);
+void UnloadTerrainGrid(TerrainGrid *grid);
+
+// Default side of a chunk, in quads: (128 + 1)^2 vertices fit in 16-bit indices.
+#define TERRAIN_CHUNK_QUADS 128
+// Largest side of a chunk with 16-bit indices; larger chunks take 32-bit ones.
+#define TERRAIN_CHUNK_QUADS_16BIT 255
+
+// A TerrainGrid cut into uploaded meshes of at most chunkQuads squared
+// quads, with a bounding box each. Chunks are as even as the grid allows, so
+// only the last row and column can be smaller. Each chunk draws at the level
+// of detail UpdateTerrainLod picked for it, with index arrays and GPU index
+// buffers shared by every chunk of its shape, indexed [short along
+// rings][short along sides][level][edges to stitch]. The indices are 16-bit
+// (unsigned short) unless a chunk has more vertices than they reach; then
+// they are 32-bit (uint32_t), the meshes' own indices stay NULL, and
+// DrawTerrainChunk draws them, which DrawMesh cannot. The vertex and normal
+// buffers are dynamic, for UpdateTerrainChunks.
+typedef struct TerrainChunks {
+    int count;
+    TerrainMeshEmbedding embedding;  // and the rest of the grid's layout, to rebuild vertices from
+    size_t rings, sides;
+    Vector3 ringPeriod, sidePeriod;
+    float heightMin, heightScale;
+    size_t chunksI, chunksJ;        // chunks along rings and sides; chunk c is (c / chunksJ, c % chunksJ)
+    size_t chunkRings, chunkSides;  // quads in a full chunk
+    size_t lastRings, lastSides;    // quads in the last row and column of chunks
+    Mesh *meshes;
+    BoundingBox *bounds;
+    TerrainLod *lod;
+    bool wideIndices;
+    void *indices[2][2][TERRAIN_LOD_MAX_LEVELS][TERRAIN_LOD_EDGE_SETS];
+    int triangles[2][2][TERRAIN_LOD_MAX_LEVELS][TERRAIN_LOD_EDGE_SETS];
+    unsigned int indexBuffers[2][2][TERRAIN_LOD_MAX_LEVELS][TERRAIN_LOD_EDGE_SETS];
+    int *bound;  // per chunk, level * TERRAIN_LOD_EDGE_SETS + edges of the index buffer its vertex array holds
+} TerrainChunks;
+
+// Which shared index arrays chunk c draws with: short along rings, along sides.
+static inline void terrain_chunk_shape(const TerrainChunks *chunks, int c, int *si, int *sj) {
+    *si = (size_t)c / chunks->chunksJ + 1 == chunks->chunksI && chunks->lastRings != chunks->chunkRings;
+    *sj = (size_t)c % chunks->chunksJ + 1 == chunks->chunksJ && chunks->lastSides != chunks->chunkSides;
+}
+
+// CutTerrainChunks then UploadTerrainChunks.
+TerrainChunks GenTerrainChunks(const TerrainGrid *grid, size_t chunkQuads);
+// The chunks of grid on the CPU only, with their index arrays, bounds and
+// level errors, for UploadTerrainChunks or the mesh cache (mesh_cache.h).
+TerrainChunks CutTerrainChunks(const TerrainGrid *grid, size_t chunkQuads);
+// Uploads the index arrays and every chunk's mesh and sets them to full
+// detail.
+void UploadTerrainChunks(TerrainChunks *chunks);
+// CutTerrainChunks for heightmap, unedited, at its own resolution. Chunks of
+// the full map come from the mesh cache when they are there and go to it
+// when they are not, so a warm start skips the grid and the cut as well as
+// generating the map. A coarser level is built without the cache. Touches
+// no GPU state, so it can run off the main thread.
+TerrainChunks CutHeightmapChunks(const Heightmap *heightmap, TerrainMeshEmbedding embedding, size_t chunkQuads);
+// CutHeightmapChunks then UploadTerrainChunks.
+TerrainChunks LoadTerrainChunks(const Heightmap *heightmap, TerrainMeshEmbedding embedding, size_t chunkQuads);
+void UnloadTerrainChunks(TerrainChunks *chunks);
+// Draws chunk c at its level of detail, as DrawMesh would with an identity
+// transform, whatever the width of its indices.
+void DrawTerrainChunk(const TerrainChunks *chunks, int c, Material material);
+// Picks every chunk's level of detail for a camera at eye, keeping each
+// level's error within max_error_pixels on a screen screenHeight pixels high,
+// and points the chunks' meshes at the matching index buffers. Returns the
+// triangles the chunks now draw.
+int UpdateTerrainLod(TerrainChunks *chunks, Vector3 eye, float fovy, int screenHeight, float max_error_pixels);
+
+// Applies brush to a heightmap the flat embedding lays over the world: a
+// circle of radius world units around center's x and z, raised (for a
+// crater, dug) amount world units at the middle. Returns the samples
+// changed, for UpdateTerrainChunks.
+HeightmapRect DeformFlatTorusHeightmap(Heightmap *heightmap, HeightmapBrush brush, Vector3 center, float radius,
+                                       float amount);
+// Rebuilds the vertices and normals of every chunk that shows any of the
+// changed samples of heightmap, the map the chunks were built from, edited
+// since, and re-uploads just the rows that moved; also their bounds and
+// level errors. The work grows with the edit and the chunks it reaches, not
+// the world. Writes the chunks updated to touched, which has room for
+// chunks->count, and returns how many.
+int UpdateTerrainChunks(TerrainChunks *chunks, const Heightmap *heightmap, HeightmapRect changed, int *touched);
+// Chunk c at full resolution, for a collider; shares the chunk's arrays. With
+// 32-bit indices the mesh's indices are NULL and wide points at them instead,
+// otherwise wide is NULL.
+Mesh TerrainChunkCollisionMesh(const TerrainChunks *chunks, int c, const uint32_t **wide);
 
 Vector3 get_torus_position(float u, float v);
 Vector3 get_torus_normal(float u, float v);
@@ -0,0 +1,84 @@
+/*
+ * bake_terrain.c
+ *
+ * Generates the terrain heightmap without a window or GPU and writes it to
+ * the cache in resources/heightmaps, where the game maps it at startup
+ * instead of generating it. The file is named after terrain_cache_key, so
+ * the game only loads a baked map if the static configuration in terrain.c
+ * (the terrain sizes and the generator, noise and warp switches) matches the
+ * one baked: baking another resolution or world size does nothing for the
+ * game until terrain.c is changed to match. The encoding is not part of the
+ * key, since the loader reads any; a map already in the cache is rewritten
+ * in the requested one. Generation runs on all OpenMP threads
+ * (OMP_NUM_THREADS to limit).
+ *
+ * Usage: bake_terrain [-e f32|q16|tiled] [width height [world_width world_height]]
+ *
+ * Run it from the directory the game runs from. Giving only a resolution
+ * keeps the world size, so e.g. "bake_terrain 16384 16384" bakes the same
+ * terrain at 16k x 16k samples.
+ */
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "terrain.h"
+#include "io_worker.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-e f32|q16|tiled] [width height [world_width world_height]]\n", argv0);
+    exit(1);
+}
+
+static HeightmapEncoding parse_encoding(const char *name, const char *argv0)
+{
+    if (strcmp(name, "f32") == 0) return HEIGHTMAP_ENCODING_F32;
+    if (strcmp(name, "q16") == 0) return HEIGHTMAP_ENCODING_Q16_RANS;
+    if (strcmp(name, "tiled") == 0) return HEIGHTMAP_ENCODING_F32_TILED;
+    usage(argv0);
+    return HEIGHTMAP_ENCODING_F32;
+}
+
+int main(int argc, char **argv)
+{
+    TerrainConfig config = *terrain_config();
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "-e") == 0) {
+        config.encoding = parse_encoding(argv[arg + 1], argv[0]);
+        arg += 2;
+    }
+    const int sizes = argc - arg;
+    if (sizes != 0 && sizes != 2 && sizes != 4) usage(argv[0]);
+    if (sizes >= 2) {
+        config.width = strtoul(argv[arg], NULL, 10);
+        config.height = strtoul(argv[arg + 1], NULL, 10);
+    }
+    if (sizes == 4) {
+        config.world_width = strtof(argv[arg + 2], NULL);
+        config.world_height = strtof(argv[arg + 3], NULL);
+    }
+    terrain_set_config(&config);
+
+    char filename[64];
+    cache_filename(filename, sizeof(filename), "heightmap", terrain_cache_key());
+    printf("Baking %zu x %zu terrain over %.1f x %.1f units on %d threads\n", config.width, config.height,
+           config.world_width, config.world_height, omp_get_max_threads());
+
+    // get_heightmap saves only a map it generates, so one it finds in the
+    // cache would otherwise keep whatever encoding it was first baked with.
+    const bool cached = heightmap_exists(filename);
+    double t0 = omp_get_wtime();
+    Heightmap *heightmap = get_heightmap();
+    double t1 = omp_get_wtime();
+    const float min = heightmap->min, max = heightmap->max;
+    io_worker_shutdown();  // the cache file is written in the background
+    if (cached) save_heightmap(filename, heightmap, config.encoding);
+    heightmap_destroy(heightmap);
+    double t2 = omp_get_wtime();
+    printf("%s/%s/%s: %zu x %zu, heights %f to %f, %.2f s to generate, %.2f s to write\n", S_RESOURCES,
+           S_HEIGHTMAPS, filename, config.width, config.height, min, max, t1 - t0, t2 - t1);
+    return 0;
+}